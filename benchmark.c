@@ -0,0 +1,705 @@
+// This program measures the performance of the high-accuracy modules
+
+// usage: benchmark mult | dot | batch | suite [max_digits] | strassen [digits]
+//   mult: measures the crossovers between schoolbook, Karatsuba and Toom-3
+//         multiplication and prints the thresholds to pass to
+//         ha_int_set_mult_thresholds
+//   dot: measures dot products of fractions with every term reduced and with
+//        the reduction deferred to the end (see ha_frac_set_lazy)
+//   batch: measures additions and multiplications of complex numbers one
+//          call at a time and through the batch functions
+//   suite: measures every primitive on random operands of 10, 100, ... up to
+//          max_digits digits (100000 by default), and the matrix operations
+//          on random matrices of increasing size, printing one line per
+//          measurement (see bench_suite)
+//   strassen: measures the crossover between tiled and Strassen-Winograd
+//             matrix multiplication for entries with digits-digit
+//             numerators (10 by default), and prints the threshold to pass
+//             to ha_matrix_set_strassen_threshold
+// build: cc -std=c11 -O2 -o benchmark benchmark.c high-accuracy-*.c
+//          read-input.c -lpthread
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-expr.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-matrix.h"
+#include "read-input.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_RUSAGE
+#include <sys/resource.h>
+#endif
+
+
+// seconds spent on each measurement, long enough to average out noise
+static const double MIN_MEASURE_TIME = 0.05;
+
+// now() gives the current time in seconds
+// time: O(1)
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// random_digits(digits) gives the decimal digits of a random positive integer
+//   with the given number of digits
+// requires: digits > 0
+// effects: allocates memory (caller must free)
+// time: O(digits)
+static char *random_digits(int digits) {
+  assert(digits > 0);
+  char *s = malloc((digits + 1) * sizeof(char));
+  s[0] = '1' + rand() % 9;
+  for (int i = 1; i < digits; ++i) {
+    s[i] = '0' + rand() % 10;
+  }
+  s[digits] = '\0';
+  return s;
+}
+
+// random_int(digits) gives a random positive integer with the given number of
+//   digits
+// requires: digits > 0
+// effects: allocates memory (client must call ha_int_destroy)
+// time: O(digits^2)
+static struct ha_int *random_int(int digits) {
+  assert(digits > 0);
+  char *s = random_digits(digits);
+  struct ha_int *n = ha_int_create(s);
+  free(s);
+  return n;
+}
+
+// time_mult(digits) gives the average time in seconds of one ha_int_mult on
+//   two random digits-digit operands with the current thresholds
+// requires: digits > 0
+// time: about MIN_MEASURE_TIME
+static double time_mult(int digits) {
+  assert(digits > 0);
+  struct ha_int *n = random_int(digits);
+  struct ha_int *m = random_int(digits);
+  int reps = 0;
+  const double start = now();
+  double elapsed = 0;
+  while (elapsed < MIN_MEASURE_TIME) {
+    ha_int_destroy(ha_int_mult(n, m));
+    ++reps;
+    elapsed = now() - start;
+  }
+  ha_int_destroy(n);
+  ha_int_destroy(m);
+  return elapsed / reps;
+}
+
+// find_crossover(lower, start) gives the smallest operand size (in digits,
+//   growing geometrically from start) from which one top-level step of the
+//   faster method beats the slower one at two successive sizes
+// notes: lower(digits, use_fast) sets the thresholds so that only the slower
+//          method is used (use_fast is false), or so that the faster method is
+//          used for operands of the given size but not below
+//        a win must be by more than 2% so that timing noise between two equal
+//          methods does not count
+// requires: start > 0
+// time: O(MIN_MEASURE_TIME * log(result))
+static int find_crossover(void (*lower)(int digits, bool use_fast), int start) {
+  assert(start > 0);
+  int first_win = 0;
+  for (int digits = start; digits < 100000; digits += digits / 4 + 1) {
+    lower(digits, false);
+    const double slow = time_mult(digits);
+    lower(digits, true);
+    const double fast = time_mult(digits);
+    if (fast < slow * 0.98) {
+      if (first_win) {
+        return first_win;
+      }
+      first_win = digits;
+    } else {
+      first_win = 0;
+    }
+  }
+  return 100000;
+}
+
+static int tuned_karatsuba = INT_MAX;
+
+// karatsuba_only(digits, use_fast) switches between schoolbook only and
+//   Karatsuba from digits on
+static void karatsuba_only(int digits, bool use_fast) {
+  ha_int_set_mult_thresholds(use_fast ? digits : INT_MAX, INT_MAX);
+}
+
+// toom3_after_karatsuba(digits, use_fast) switches between schoolbook and
+//   Karatsuba only, and Toom-3 from digits on
+static void toom3_after_karatsuba(int digits, bool use_fast) {
+  ha_int_set_mult_thresholds(tuned_karatsuba, use_fast ? digits : INT_MAX);
+}
+
+// bench_mult() measures and prints the multiplication thresholds
+// effects: produces output
+//          changes the multiplication thresholds
+static void bench_mult(void) {
+  tuned_karatsuba = find_crossover(karatsuba_only, 20);
+  const int toom3 = find_crossover(toom3_after_karatsuba, tuned_karatsuba);
+  ha_int_set_mult_thresholds(tuned_karatsuba, toom3);
+  int karatsuba_digits = 0;
+  int toom3_digits = 0;
+  ha_int_get_mult_thresholds(&karatsuba_digits, &toom3_digits);
+  printf("karatsuba_threshold_digits %d\n", karatsuba_digits);
+  printf("toom3_threshold_digits %d\n", toom3_digits);
+}
+
+// number of distinct denominators in the dot product workload, products of
+// small primes as in the entries of a rational matrix
+#define DOT_DENOMS 8
+static const char *const dot_denoms[DOT_DENOMS] = {
+  "1", "2", "6", "12", "60", "210", "360", "2520"
+};
+
+// random_frac(digits) gives a random fraction with a digits-digit numerator
+//   and one of DOT_DENOMS denominators
+// requires: digits > 0
+// effects: allocates memory (client must call ha_frac_destroy)
+// time: O(digits^2)
+static struct ha_frac *random_frac(int digits) {
+  assert(digits > 0);
+  struct ha_int *nume = random_int(digits);
+  char *s = ha_int_to_str(nume);
+  struct ha_frac *num = ha_frac_create(s, dot_denoms[rand() % DOT_DENOMS]);
+  free(s);
+  ha_int_destroy(nume);
+  return num;
+}
+
+// time_dot(n, m, len, lazy) gives the average time in seconds of the dot
+//   product of the first len entries of n and m, reduced once at the end if
+//   lazy is true and after every term otherwise
+// requires: len > 0
+// time: about MIN_MEASURE_TIME
+static double time_dot(struct ha_frac **n, struct ha_frac **m, int len,
+                       bool lazy) {
+  assert(len > 0);
+  const bool previous = ha_frac_set_lazy(lazy);
+  struct ha_frac *acc = ha_frac_create("0", "1");
+  struct ha_frac *zero = ha_frac_create("0", "1");
+  int reps = 0;
+  const double start = now();
+  double elapsed = 0;
+  while (elapsed < MIN_MEASURE_TIME) {
+    ha_frac_set(acc, zero);
+    for (int i = 0; i < len; ++i) {
+      ha_frac_addmul(acc, n[i], m[i]);
+    }
+    ha_frac_normalize(acc);
+    ++reps;
+    elapsed = now() - start;
+  }
+  ha_frac_destroy(acc);
+  ha_frac_destroy(zero);
+  ha_frac_set_lazy(previous);
+  return elapsed / reps;
+}
+
+// bench_dot() measures and prints the time per term of dot products with
+//   eager and with deferred reduction, for several lengths and sizes
+// effects: produces output
+static void bench_dot(void) {
+  const int max_len = 1000;
+  const int digits[] = {5, 50, 500};
+  for (int d = 0; d < 3; ++d) {
+    struct ha_frac *n[max_len];
+    struct ha_frac *m[max_len];
+    for (int i = 0; i < max_len; ++i) {
+      n[i] = random_frac(digits[d]);
+      m[i] = random_frac(digits[d]);
+    }
+    for (int len = 10; len <= max_len; len *= 10) {
+      const double eager = time_dot(n, m, len, false);
+      const double lazy = time_dot(n, m, len, true);
+      printf("dot digits %d len %d eager_ns_per_term %.0f "
+             "lazy_ns_per_term %.0f speedup %.2f\n", digits[d], len,
+             eager / len * 1e9, lazy / len * 1e9, eager / lazy);
+    }
+    for (int i = 0; i < max_len; ++i) {
+      ha_frac_destroy(n[i]);
+      ha_frac_destroy(m[i]);
+    }
+  }
+}
+
+// random_batch_comp(digits, complex) gives a random number with digits-digit
+//   numerators and denominators, and an imaginary part of 0 unless complex
+//   is true
+// requires: digits > 0
+// effects: allocates memory (client must call ha_comp_destroy)
+// time: O(digits^2)
+static struct ha_comp *random_batch_comp(int digits, bool complex) {
+  assert(digits > 0);
+  char *parts[4];
+  for (int i = 0; i < 4; ++i) {
+    parts[i] = random_digits(digits);
+  }
+  struct ha_comp *num = ha_comp_create(parts[0], parts[1],
+                                       complex ? parts[2] : "0", parts[3]);
+  for (int i = 0; i < 4; ++i) {
+    free(parts[i]);
+  }
+  return num;
+}
+
+// time_batch(n, m, nb, mb, len, mult) gives the average time in seconds of
+//   len additions (or multiplications if mult is true) of the numbers of n
+//   and m, one call at a time if nb and mb are NULL, and of the batches nb
+//   and mb of size len otherwise
+// requires: len > 0
+// time: about MIN_MEASURE_TIME
+static double time_batch(struct ha_comp **n, struct ha_comp **m,
+                         const struct ha_comp_batch *nb,
+                         const struct ha_comp_batch *mb, int len, bool mult) {
+  assert(len > 0);
+  struct ha_comp *result = ha_comp_create("0", "1", "0", "1");
+  struct ha_comp_batch *results = ha_comp_batch_create(len);
+  int reps = 0;
+  const double start = now();
+  double elapsed = 0;
+  while (elapsed < MIN_MEASURE_TIME) {
+    if (nb && mult) {
+      ha_comp_mult_batch(results, nb, mb);
+    } else if (nb) {
+      ha_comp_add_batch(results, nb, mb);
+    } else {
+      for (int i = 0; i < len; ++i) {
+        if (mult) {
+          ha_comp_mult_into(result, n[i], m[i]);
+        } else {
+          ha_comp_add_into(result, n[i], m[i]);
+        }
+      }
+    }
+    ++reps;
+    elapsed = now() - start;
+  }
+  ha_comp_destroy(result);
+  ha_comp_batch_destroy(results);
+  return elapsed / reps;
+}
+
+// bench_batch() measures and prints the time per operation of additions and
+//   multiplications of real and of complex numbers, one call at a time and
+//   in batches, for several sizes
+// effects: produces output
+static void bench_batch(void) {
+  const int len = 1000;
+  const int digits[] = {3, 9, 50};
+  for (int d = 0; d < 3; ++d) {
+    for (int complex = 0; complex <= 1; ++complex) {
+      struct ha_comp *n[len];
+      struct ha_comp *m[len];
+      struct ha_comp_batch *nb = ha_comp_batch_create(len);
+      struct ha_comp_batch *mb = ha_comp_batch_create(len);
+      for (int i = 0; i < len; ++i) {
+        n[i] = random_batch_comp(digits[d], complex);
+        m[i] = random_batch_comp(digits[d], complex);
+        ha_comp_batch_set(nb, i, n[i]);
+        ha_comp_batch_set(mb, i, m[i]);
+      }
+      for (int mult = 0; mult <= 1; ++mult) {
+        const double single = time_batch(n, m, NULL, NULL, len, mult);
+        const double batch = time_batch(n, m, nb, mb, len, mult);
+        printf("batch %s %s digits %d single_ns_per_op %.0f "
+               "batch_ns_per_op %.0f speedup %.2f\n",
+               complex ? "complex" : "real", mult ? "mult" : "add",
+               digits[d], single / len * 1e9, batch / len * 1e9,
+               single / batch);
+      }
+      for (int i = 0; i < len; ++i) {
+        ha_comp_destroy(n[i]);
+        ha_comp_destroy(m[i]);
+      }
+      ha_comp_batch_destroy(nb);
+      ha_comp_batch_destroy(mb);
+    }
+  }
+}
+
+// Suite: every measurement prints one line of the form
+//   suite <name> digits <d> [n <n>] ns_per_op <t> allocs_per_op <a>
+//     peak_rss_kb <k>
+// where allocs_per_op counts the calls to the allocator behind the
+// allocation module (see ha_alloc_set_functions), not the structs recycled
+// through its free lists, and peak_rss_kb is the peak resident set size of
+// the process so far (-1 where it is not known). The operands come from a
+// fixed seed, so two runs measure the same work.
+
+// number of allocations made through the allocation module
+static size_t alloc_count;
+
+// counting_alloc(size) is malloc, counting the allocations in alloc_count
+static void *counting_alloc(size_t size) {
+  ++alloc_count;
+  return malloc(size);
+}
+
+// peak_rss_kb() gives the peak resident set size of the process in
+//   kilobytes, or -1 if it is not known
+// time: O(1)
+static long peak_rss_kb(void) {
+#ifdef HAVE_RUSAGE
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // in bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return -1;
+}
+
+// the operands of the suite for one size
+struct operands {
+  char *digits; // the digits of n
+  char *text; // a complex number in the syntax of read_input
+  struct ha_int *n;
+  struct ha_int *m;
+  struct ha_int *wide; // twice the digits of n and m, for divisions
+  struct ha_frac *p;
+  struct ha_frac *q;
+  struct ha_comp *x;
+  struct ha_comp *y;
+  struct ha_matrix *a;
+  struct ha_matrix *b;
+};
+
+struct suite_op {
+  const char *name;
+  void (*run)(const struct operands *ops);
+};
+
+// measure(op, ops, digits, n) measures op on ops and prints its line, where
+//   n is the size of the matrices, 0 for numbers
+// effects: produces output
+// time: about MIN_MEASURE_TIME, or one run of op if that is longer
+static void measure(const struct suite_op *op, const struct operands *ops,
+                    int digits, int n) {
+  op->run(ops); // warms up the caches and free lists
+  const size_t allocs = alloc_count;
+  int reps = 0;
+  const double start = now();
+  double elapsed = 0;
+  while (elapsed < MIN_MEASURE_TIME) {
+    op->run(ops);
+    ++reps;
+    elapsed = now() - start;
+  }
+  printf("suite %s digits %d", op->name, digits);
+  if (n) {
+    printf(" n %d", n);
+  }
+  printf(" ns_per_op %.1f allocs_per_op %.2f peak_rss_kb %ld\n",
+         elapsed / reps * 1e9, (double)(alloc_count - allocs) / reps,
+         peak_rss_kb());
+  fflush(stdout);
+}
+
+static void int_create(const struct operands *ops) {
+  ha_int_destroy(ha_int_create(ops->digits));
+}
+
+static void int_to_str(const struct operands *ops) {
+  free(ha_int_to_str(ops->n));
+}
+
+static void int_add(const struct operands *ops) {
+  ha_int_destroy(ha_int_add(ops->n, ops->m));
+}
+
+static void int_sub(const struct operands *ops) {
+  ha_int_destroy(ha_int_sub(ops->n, ops->m));
+}
+
+static void int_mult(const struct operands *ops) {
+  ha_int_destroy(ha_int_mult(ops->n, ops->m));
+}
+
+static void int_quotient(const struct operands *ops) {
+  ha_int_destroy(ha_int_quotient(ops->wide, ops->m));
+}
+
+static void int_gcd(const struct operands *ops) {
+  ha_int_destroy(ha_int_gcd(ops->n, ops->m));
+}
+
+static void frac_add(const struct operands *ops) {
+  ha_frac_destroy(ha_frac_add(ops->p, ops->q));
+}
+
+static void frac_mult(const struct operands *ops) {
+  ha_frac_destroy(ha_frac_mult(ops->p, ops->q));
+}
+
+static void frac_div(const struct operands *ops) {
+  ha_frac_destroy(ha_frac_div(ops->p, ops->q));
+}
+
+static void frac_to_str(const struct operands *ops) {
+  free(ha_frac_to_str(ops->p));
+}
+
+static void comp_add(const struct operands *ops) {
+  ha_comp_destroy(ha_comp_add(ops->x, ops->y));
+}
+
+static void comp_mult(const struct operands *ops) {
+  ha_comp_destroy(ha_comp_mult(ops->x, ops->y));
+}
+
+static void comp_div(const struct operands *ops) {
+  ha_comp_destroy(ha_comp_div(ops->x, ops->y));
+}
+
+static void comp_read_input(const struct operands *ops) {
+  ha_comp_destroy(read_input(ops->text));
+}
+
+static void matrix_mult(const struct operands *ops) {
+  ha_matrix_destroy(ha_matrix_mult(ops->a, ops->b));
+}
+
+static void matrix_det(const struct operands *ops) {
+  ha_comp_destroy(ha_matrix_det(ops->a));
+}
+
+static void matrix_det_modular(const struct operands *ops) {
+  ha_comp_destroy(ha_matrix_det_modular(ops->a));
+}
+
+static void matrix_inverse(const struct operands *ops) {
+  ha_matrix_destroy(ha_matrix_inverse(ops->a));
+}
+
+// a * b + b * a - a, one matrix per operation
+static void matrix_expr_eager(const struct operands *ops) {
+  struct ha_matrix *ab = ha_matrix_mult(ops->a, ops->b);
+  struct ha_matrix *ba = ha_matrix_mult(ops->b, ops->a);
+  struct ha_matrix *sum = ha_matrix_add(ab, ba);
+  ha_matrix_destroy(ha_matrix_sub(sum, ops->a));
+  ha_matrix_destroy(ab);
+  ha_matrix_destroy(ba);
+  ha_matrix_destroy(sum);
+}
+
+// a * b + b * a - a, as a lazy expression
+static void matrix_expr_lazy(const struct operands *ops) {
+  struct ha_expr_graph *g = ha_expr_graph_create();
+  const struct ha_expr *a = ha_expr_matrix(g, ops->a);
+  const struct ha_expr *b = ha_expr_matrix(g, ops->b);
+  const struct ha_expr *e = ha_expr_sub(g, ha_expr_add(g, ha_expr_mult(g, a, b),
+                                                       ha_expr_mult(g, b, a)),
+                                        a);
+  ha_matrix_destroy(ha_expr_eval(g, e));
+  ha_expr_graph_destroy(g);
+}
+
+static const struct suite_op number_ops[] = {
+  {"int_create", int_create}, {"int_to_str", int_to_str},
+  {"int_add", int_add}, {"int_sub", int_sub}, {"int_mult", int_mult},
+  {"int_quotient", int_quotient}, {"int_gcd", int_gcd},
+  {"frac_add", frac_add}, {"frac_mult", frac_mult}, {"frac_div", frac_div},
+  {"frac_to_str", frac_to_str},
+  {"comp_add", comp_add}, {"comp_mult", comp_mult}, {"comp_div", comp_div},
+  {"read_input", comp_read_input}
+};
+
+static const struct suite_op matrix_ops[] = {
+  {"matrix_mult", matrix_mult}, {"matrix_det", matrix_det},
+  {"matrix_det_modular", matrix_det_modular},
+  {"matrix_inverse", matrix_inverse},
+  {"matrix_expr_eager", matrix_expr_eager},
+  {"matrix_expr_lazy", matrix_expr_lazy}
+};
+
+// random_comp(digits) gives a random complex number with digits-digit
+//   numerators and denominators
+// requires: digits > 0
+// effects: allocates memory (client must call ha_comp_destroy)
+// time: O(digits^2)
+static struct ha_comp *random_comp(int digits) {
+  assert(digits > 0);
+  char *parts[4];
+  for (int i = 0; i < 4; ++i) {
+    parts[i] = random_digits(digits);
+  }
+  struct ha_comp *num = ha_comp_create(parts[0], parts[1], parts[2],
+                                       parts[3]);
+  for (int i = 0; i < 4; ++i) {
+    free(parts[i]);
+  }
+  return num;
+}
+
+// random_matrix(n, digits) gives a random n x n matrix of fractions with
+//   digits-digit numerators and the denominators of the dot workload
+// requires: n > 0, digits > 0
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(n^2 * digits^2)
+static struct ha_matrix *random_matrix(int n, int digits) {
+  assert(n > 0);
+  assert(digits > 0);
+  struct ha_matrix *mat = ha_matrix_create(n, n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      char *s = random_digits(digits);
+      struct ha_comp *x = ha_comp_create(s, dot_denoms[rand() % DOT_DENOMS],
+                                         "0", "1");
+      ha_matrix_set(mat, i, j, x);
+      ha_comp_destroy(x);
+      free(s);
+    }
+  }
+  return mat;
+}
+
+// bench_suite(max_digits) measures and prints the number operations for
+//   10, 100, ... digits up to max_digits, then the matrix operations for
+//   matrices of 4 x 4 to 32 x 32 with 10-digit entries
+// requires: max_digits > 0
+// effects: produces output
+static void bench_suite(int max_digits) {
+  assert(max_digits > 0);
+  const int op_num = sizeof(number_ops) / sizeof(number_ops[0]);
+  for (int digits = 10; digits <= max_digits; digits *= 10) {
+    struct operands ops = {0};
+    ops.digits = random_digits(digits);
+    ops.n = ha_int_create(ops.digits);
+    ops.m = random_int(digits);
+    ops.wide = random_int(2 * digits);
+    ops.p = ha_frac_create(ops.digits, dot_denoms[DOT_DENOMS - 1]);
+    char *nume = random_digits(digits);
+    char *denom = random_digits(digits);
+    ops.q = ha_frac_create(nume, denom);
+    ops.x = random_comp(digits);
+    ops.y = random_comp(digits);
+    ops.text = malloc(2 * strlen(nume) + 2 * strlen(denom) + 5);
+    sprintf(ops.text, "%s/%s+%s/%si", nume, denom, denom, nume);
+    free(nume);
+    free(denom);
+    for (int i = 0; i < op_num; ++i) {
+      measure(&number_ops[i], &ops, digits, 0);
+    }
+    free(ops.digits);
+    free(ops.text);
+    ha_int_destroy(ops.n);
+    ha_int_destroy(ops.m);
+    ha_int_destroy(ops.wide);
+    ha_frac_destroy(ops.p);
+    ha_frac_destroy(ops.q);
+    ha_comp_destroy(ops.x);
+    ha_comp_destroy(ops.y);
+  }
+
+  const int matrix_op_num = sizeof(matrix_ops) / sizeof(matrix_ops[0]);
+  const int digits = 10;
+  for (int n = 4; n <= 32; n *= 2) {
+    struct operands ops = {0};
+    ops.a = random_matrix(n, digits);
+    ops.b = random_matrix(n, digits);
+    for (int i = 0; i < matrix_op_num; ++i) {
+      measure(&matrix_ops[i], &ops, digits, n);
+    }
+    ha_matrix_destroy(ops.a);
+    ha_matrix_destroy(ops.b);
+  }
+}
+
+// time_matrix_mult(n, m) gives the average time in seconds of one
+//   ha_matrix_mult of n and m with the current threshold
+// time: about MIN_MEASURE_TIME
+static double time_matrix_mult(const struct ha_matrix *n,
+                               const struct ha_matrix *m) {
+  int reps = 0;
+  const double start = now();
+  double elapsed = 0;
+  while (elapsed < MIN_MEASURE_TIME) {
+    ha_matrix_destroy(ha_matrix_mult(n, m));
+    ++reps;
+    elapsed = now() - start;
+  }
+  return elapsed / reps;
+}
+
+// bench_strassen(digits) measures and prints the smallest size (growing
+//   geometrically from 8) from which one Strassen-Winograd step beats the
+//   tiled product at two successive sizes, as in find_crossover
+// requires: digits > 0
+// effects: produces output
+//          changes the Strassen threshold
+static void bench_strassen(int digits) {
+  assert(digits > 0);
+  const int max_size = 256;
+  int first_win = 0;
+  int threshold = INT_MAX;
+  for (int size = 8; size <= max_size && threshold == INT_MAX;
+       size += size / 2) {
+    struct ha_matrix *n = random_matrix(size, digits);
+    struct ha_matrix *m = random_matrix(size, digits);
+    ha_matrix_set_strassen_threshold(INT_MAX);
+    const double tiled = time_matrix_mult(n, m);
+    ha_matrix_set_strassen_threshold(size); // the halves are tiled
+    const double strassen = time_matrix_mult(n, m);
+    ha_matrix_destroy(n);
+    ha_matrix_destroy(m);
+    if (strassen < tiled * 0.98) {
+      if (first_win) {
+        threshold = first_win;
+      }
+      first_win = size;
+    } else {
+      first_win = 0;
+    }
+  }
+  ha_matrix_set_strassen_threshold(threshold);
+  printf("strassen_threshold_size %d\n", threshold);
+}
+
+int main(int argc, char *argv[]) {
+  ha_alloc_set_functions(counting_alloc, free); // before anything allocates
+  srand(136);
+  if (argc == 2 && !strcmp(argv[1], "mult")) {
+    bench_mult();
+    return 0;
+  } else if (argc == 2 && !strcmp(argv[1], "dot")) {
+    bench_dot();
+    return 0;
+  } else if (argc == 2 && !strcmp(argv[1], "batch")) {
+    bench_batch();
+    return 0;
+  } else if ((argc == 2 || argc == 3) && !strcmp(argv[1], "suite")) {
+    const int max_digits = argc == 3 ? atoi(argv[2]) : 100000;
+    if (max_digits > 0) {
+      bench_suite(max_digits);
+      return 0;
+    }
+  } else if ((argc == 2 || argc == 3) && !strcmp(argv[1], "strassen")) {
+    const int digits = argc == 3 ? atoi(argv[2]) : 10;
+    if (digits > 0) {
+      bench_strassen(digits);
+      return 0;
+    }
+  }
+  fprintf(stderr, "usage: %s mult | dot | batch | suite [max_digits] | "
+          "strassen [digits]\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,337 @@
+// This module provides the memory management shared by the high-accuracy
+//   modules
+
+// For all program scope functions, see high-accuracy-alloc.h for details
+
+// Arena: a list of blocks served from front to back with a bump pointer.
+//   Requests too big for a block get a block of their own.
+// Free lists: the structs of the number modules are all small, so heap
+//   structs are grouped into size classes of NODE_ALIGN bytes and released
+//   structs are kept per thread, up to MAX_FREE_NODES per class.
+// Cleanups: the caches the number modules keep per thread are registered
+//   with the thread that created them, which runs their cleanups when it
+//   trims. On POSIX systems, a thread-specific key with a destructor trims
+//   every thread that registered one as it exits.
+// Statistics: with HA_STATS, heap buffers carry their size in front of them
+//   so that releasing one can count its bytes; an arena counts the bytes it
+//   hands out, and frees them all at once when it is reset.
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-stats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+// size of a regular arena block in bytes
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// granularity of struct size classes, and number of classes
+#define NODE_ALIGN 16
+#define NODE_CLASSES 16
+
+// maximal number of structs kept per class in a free list
+#define MAX_FREE_NODES 4096
+
+// size of the header in front of a heap buffer when counting, which keeps the
+// buffer aligned
+#define SIZE_HEADER sizeof(max_align_t)
+
+
+struct block {
+  struct block *next;
+  size_t size; // bytes available in data
+  size_t used; // bytes handed out from the front of data
+  alignas(max_align_t) unsigned char data[];
+};
+
+struct ha_arena {
+  struct block *head; // block currently served from, NULL if none
+};
+
+struct node {
+  struct node *next;
+};
+
+
+static void *(*alloc_fn)(size_t size) = malloc;
+static void (*release_fn)(void *ptr) = free;
+
+static _Thread_local struct ha_arena *current;
+static _Thread_local struct node *free_nodes[NODE_CLASSES];
+static _Thread_local int free_count[NODE_CLASSES];
+static _Thread_local void (*cleanups[HA_ALLOC_CLEANUP_MAX])(void);
+static _Thread_local int cleanup_count;
+
+#ifdef HAVE_PTHREADS
+// key whose destructor trims the threads that registered a cleanup
+static pthread_key_t exit_key;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+
+// round_up(size, align) gives the smallest multiple of align that is at least
+//   size
+// requires: align is a power of 2
+// time: O(1)
+static size_t round_up(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+// new_block(size, next) gives a new block with size bytes available, followed
+//   by next
+// effects: allocates memory
+// time: O(1)
+static struct block *new_block(size_t size, struct block *next) {
+  struct block *b = alloc_fn(sizeof(struct block) + size);
+  b->next = next;
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+// free_blocks(b) frees b and the blocks after it
+// effects: the blocks are no longer valid
+// time: O(number of blocks)
+static void free_blocks(struct block *b) {
+  while (b) {
+    struct block *next = b->next;
+    release_fn(b);
+    b = next;
+  }
+}
+
+#ifdef HA_STATS
+// arena_used(arena) gives the number of bytes arena has handed out since it
+//   was created or last reset
+// time: O(number of blocks)
+static size_t arena_used(const struct ha_arena *arena) {
+  assert(arena);
+  size_t used = 0;
+  for (const struct block *b = arena->head; b; b = b->next) {
+    used += b->used;
+  }
+  return used;
+}
+#endif
+
+// heap_alloc(size) gives size bytes from the heap
+// effects: allocates memory
+// time: O(1)
+static void *heap_alloc(size_t size) {
+#ifdef HA_STATS
+  size_t *header = alloc_fn(SIZE_HEADER + size);
+  *header = size;
+  HA_STATS_BYTES((int64_t)size);
+  return (unsigned char *)header + SIZE_HEADER;
+#else
+  return alloc_fn(size);
+#endif
+}
+
+// heap_release(ptr) frees ptr, which came from heap_alloc
+// effects: ptr is no longer valid
+// time: O(1)
+static void heap_release(void *ptr) {
+#ifdef HA_STATS
+  if (!ptr) {
+    return;
+  }
+  size_t *header = (void *)((unsigned char *)ptr - SIZE_HEADER);
+  HA_STATS_BYTES(-(int64_t)*header);
+  release_fn(header);
+#else
+  release_fn(ptr);
+#endif
+}
+
+// arena_alloc(arena, size) gives size bytes from arena
+// effects: may allocate a new block
+// time: O(1)
+static void *arena_alloc(struct ha_arena *arena, size_t size) {
+  assert(arena);
+  size = round_up(size, alignof(max_align_t));
+  HA_STATS_BYTES((int64_t)size);
+  struct block *b = arena->head;
+  if (!b || b->size - b->used < size) {
+    if (size > ARENA_BLOCK_SIZE / 4) {
+      // an own block, kept behind the head so that the head stays in use
+      struct block *own = new_block(size, b ? b->next : NULL);
+      own->used = size;
+      if (b) {
+        b->next = own;
+      } else {
+        arena->head = own;
+      }
+      return own->data;
+    }
+    b = new_block(ARENA_BLOCK_SIZE, b);
+    arena->head = b;
+  }
+  void *ptr = b->data + b->used;
+  b->used += size;
+  return ptr;
+}
+
+struct ha_arena *ha_arena_create(void) {
+  struct ha_arena *arena = alloc_fn(sizeof(struct ha_arena));
+  arena->head = NULL;
+  return arena;
+}
+
+void ha_arena_destroy(struct ha_arena *arena) {
+  assert(arena);
+  assert(arena != current);
+  HA_STATS_BYTES(-(int64_t)arena_used(arena));
+  free_blocks(arena->head);
+  release_fn(arena);
+}
+
+void ha_arena_reset(struct ha_arena *arena) {
+  assert(arena);
+  struct block *b = arena->head;
+  if (!b) {
+    return;
+  }
+  HA_STATS_BYTES(-(int64_t)arena_used(arena));
+  if (b->next) {
+    // replace the blocks by one big enough for all of them, so that the
+    // same work after the reset fits into a single block
+    size_t size = 0;
+    for (struct block *i = b; i; i = i->next) {
+      size += i->size;
+    }
+    free_blocks(b);
+    b = new_block(size, NULL);
+    arena->head = b;
+  }
+  b->used = 0;
+}
+
+struct ha_arena *ha_arena_use(struct ha_arena *arena) {
+  struct ha_arena *previous = current;
+  current = arena;
+  return previous;
+}
+
+struct ha_arena *ha_arena_current(void) {
+  return current;
+}
+
+void ha_alloc_set_functions(void *(*alloc)(size_t size),
+                            void (*release)(void *ptr)) {
+  assert(alloc);
+  assert(release);
+  alloc_fn = alloc;
+  release_fn = release;
+}
+
+void ha_alloc_trim(void) {
+  // the cleanups give their structs back to the free lists, so they go first
+  while (cleanup_count > 0) {
+    --cleanup_count;
+    cleanups[cleanup_count]();
+  }
+  for (int i = 0; i < NODE_CLASSES; ++i) {
+    while (free_nodes[i]) {
+      struct node *next = free_nodes[i]->next;
+      release_fn(free_nodes[i]);
+      free_nodes[i] = next;
+    }
+    free_count[i] = 0;
+  }
+}
+
+void *ha_alloc(struct ha_arena *owner, size_t size) {
+  if (owner) {
+    return arena_alloc(owner, size);
+  }
+  return heap_alloc(size);
+}
+
+void ha_release(struct ha_arena *owner, void *ptr) {
+  if (!owner) {
+    heap_release(ptr);
+  }
+}
+
+// node_class(size) gives the free list index for structs of size bytes, or
+//   NODE_CLASSES if they are too big to be kept
+// time: O(1)
+static int node_class(size_t size) {
+  assert(size > 0);
+  const size_t i = (size - 1) / NODE_ALIGN;
+  return i < NODE_CLASSES ? (int)i : NODE_CLASSES;
+}
+
+void *ha_alloc_node(struct ha_arena *owner, size_t size) {
+  if (owner) {
+    return arena_alloc(owner, size);
+  }
+  HA_STATS_BYTES((int64_t)size);
+  const int i = node_class(size);
+  if (i == NODE_CLASSES) {
+    return alloc_fn(size);
+  }
+  struct node *n = free_nodes[i];
+  if (n) {
+    free_nodes[i] = n->next;
+    --free_count[i];
+    return n;
+  }
+  // every struct of a class gets the same size so that it can be reused
+  return alloc_fn((i + 1) * NODE_ALIGN);
+}
+
+void ha_release_node(struct ha_arena *owner, void *ptr, size_t size) {
+  if (owner) {
+    return;
+  }
+  HA_STATS_BYTES(-(int64_t)size);
+  const int i = node_class(size);
+  if (i == NODE_CLASSES || free_count[i] >= MAX_FREE_NODES) {
+    release_fn(ptr);
+    return;
+  }
+  struct node *n = ptr;
+  n->next = free_nodes[i];
+  free_nodes[i] = n;
+  ++free_count[i];
+}
+
+#ifdef HAVE_PTHREADS
+// trim_at_exit(value) trims the exiting thread, as the destructor of exit_key
+// time: see ha_alloc_trim
+static void trim_at_exit(void *value) {
+  (void)value;
+  ha_alloc_trim();
+}
+
+// create_exit_key() creates exit_key, once per process
+// time: O(1)
+static void create_exit_key(void) {
+  pthread_key_create(&exit_key, trim_at_exit);
+}
+#endif
+
+void ha_alloc_on_trim(void (*cleanup)(void)) {
+  assert(cleanup);
+  for (int i = 0; i < cleanup_count; ++i) {
+    if (cleanups[i] == cleanup) {
+      return;
+    }
+  }
+  assert(cleanup_count < HA_ALLOC_CLEANUP_MAX);
+  cleanups[cleanup_count] = cleanup;
+  ++cleanup_count;
+#ifdef HAVE_PTHREADS
+  // any value but NULL has the destructor run
+  pthread_once(&exit_key_once, create_exit_key);
+  pthread_setspecific(exit_key, cleanups);
+#endif
+}
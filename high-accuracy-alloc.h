@@ -0,0 +1,121 @@
+// This module provides the memory management shared by the high-accuracy
+//   modules
+
+// Allocation context: every thread has a current context that new numbers
+//   take their storage from. It is the heap by default, where the small
+//   fixed-size structs (ha_int, ha_frac and ha_comp) are recycled through
+//   per-thread free lists instead of going back to the allocator. It can be
+//   switched to an arena, where storage is carved out of large blocks and
+//   only given back all at once by ha_arena_reset or ha_arena_destroy.
+// A number keeps the context it was created in for its whole life: its
+//   storage always grows from and goes back to that context, whichever
+//   context is current when it is used.
+// Scoping temporaries to an arena:
+//   struct ha_arena *previous = ha_arena_use(arena);
+//   ... numbers created here live in arena ...
+//   ha_arena_use(previous);
+//   ... copy out the results to keep ...
+//   ha_arena_reset(arena);
+
+#include <stddef.h>
+
+
+struct ha_arena;
+
+
+// ha_arena_create() creates an empty arena
+// effects: allocates memory (client must call ha_arena_destroy)
+// time: O(1)
+struct ha_arena *ha_arena_create(void);
+
+// ha_arena_destroy(arena) destroys arena and every number created in it
+// requires: arena is not the current context of any thread
+// effects: arena and the numbers created in it are no longer valid
+// time: O(number of blocks)
+void ha_arena_destroy(struct ha_arena *arena);
+
+// ha_arena_reset(arena) gives back the storage of every number created in
+//   arena so that it can be reused
+// notes: the blocks are kept (merged into one if there were several), so an
+//          arena reset after every operation soon stops allocating
+// effects: the numbers created in arena are no longer valid
+// time: O(number of blocks)
+void ha_arena_reset(struct ha_arena *arena);
+
+// ha_arena_use(arena) makes arena the current context of the calling thread
+//   and returns the previous one, where NULL stands for the heap
+// requires: arena is NULL or is not in use by another thread
+// effects: numbers created by the calling thread from now on live in arena
+// time: O(1)
+struct ha_arena *ha_arena_use(struct ha_arena *arena);
+
+// ha_arena_current() gives the current context of the calling thread, or
+//   NULL for the heap
+// time: O(1)
+struct ha_arena *ha_arena_current(void);
+
+// ha_alloc_set_functions(alloc, release) replaces malloc and free as the
+//   allocator behind the heap context and the arena blocks
+// notes: strings returned by the _to_str functions still come from malloc,
+//          since they are freed by the caller
+// requires: alloc and release are not NULL
+//           no memory has been allocated through this module yet
+// effects: changes the allocator of every thread
+// time: O(1)
+void ha_alloc_set_functions(void *(*alloc)(size_t size),
+                            void (*release)(void *ptr));
+
+// ha_alloc_trim() gives the caches of the number modules (their scratch
+//   numbers, for example) and the structs kept in the free lists of the
+//   calling thread back to the allocator
+// notes: a thread that exits does so by itself on POSIX systems; without
+//          them, a thread that created numbers should call it before it
+//          exits
+//        the caches are created again if the thread goes on
+// effects: may free memory
+// time: O(number of cached structs)
+void ha_alloc_trim(void);
+
+
+// The functions below are the allocation primitives of the high-accuracy
+//   modules. owner is the context the memory belongs to: NULL for the heap,
+//   or an arena.
+
+// number of cleanup functions a thread can have registered at once
+#define HA_ALLOC_CLEANUP_MAX 16
+
+// ha_alloc(owner, size) gives size bytes of memory from owner
+// effects: allocates memory (client must call ha_release with owner)
+// time: O(1)
+void *ha_alloc(struct ha_arena *owner, size_t size);
+
+// ha_release(owner, ptr) gives ptr back to owner
+// notes: memory from an arena is only reclaimed by ha_arena_reset
+// requires: ptr came from ha_alloc(owner, _)
+// effects: ptr is no longer valid
+// time: O(1)
+void ha_release(struct ha_arena *owner, void *ptr);
+
+// ha_alloc_node(owner, size) gives a struct of size bytes from owner, reusing
+//   one from the free lists if possible
+// effects: allocates memory (client must call ha_release_node with owner and
+//          the same size)
+// time: O(1)
+void *ha_alloc_node(struct ha_arena *owner, size_t size);
+
+// ha_release_node(owner, ptr, size) gives the struct ptr of size bytes back to
+//   owner, keeping it in a free list if it came from the heap
+// requires: ptr came from ha_alloc_node(owner, size)
+// effects: ptr is no longer valid
+// time: O(1)
+void ha_release_node(struct ha_arena *owner, void *ptr, size_t size);
+
+// ha_alloc_on_trim(cleanup) has the calling thread run cleanup when it calls
+//   ha_alloc_trim or exits; a module calls it as it creates a per-thread
+//   cache, with the function that destroys that cache
+// notes: registering a function that is already registered does nothing
+// requires: cleanup is not NULL
+//           at most HA_ALLOC_CLEANUP_MAX functions are registered at once
+// effects: modifies the state of the calling thread
+// time: O(HA_ALLOC_CLEANUP_MAX)
+void ha_alloc_on_trim(void (*cleanup)(void));
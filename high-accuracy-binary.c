@@ -0,0 +1,530 @@
+// This module saves numbers and matrices in a compact binary format and loads
+//   them back
+
+// For all program scope functions, see high-accuracy-binary.h for details
+
+// The following applies to all functions:
+// requires: all parameters are valid (not NULL)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-binary.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-matrix.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FORMAT_MAGIC "HAbn"
+#define FORMAT_VERSION 1
+#define HEADER_SIZE 16
+#define RECORD_HEADER_SIZE 8
+#define RECORD_ALIGN 8 // records start at multiples of it
+
+// kinds of data
+#define KIND_INT 1
+#define KIND_FRAC 2
+#define KIND_COMP 3
+#define KIND_MATRIX 4
+
+// flags of an integer record
+#define FLAG_NEGATIVE 1u
+#define FLAG_REDUCED 2u // fraction in lowest terms
+#define FLAG_SAME_DENOM 4u // denominator of the previous fraction
+
+// size of the blocks a file that cannot be mapped is read in
+#define READ_BLOCK_SIZE (64 * 1024)
+
+
+struct ha_image {
+  void *data; // the contents, NULL if the file is empty
+  size_t size;
+  bool mapped; // data is mapped rather than from malloc
+};
+
+struct decoder {
+  const unsigned char *pos; // next record
+  const unsigned char *end; // end of the data
+  int limb_bytes; // size of a limb in the data
+  bool borrow; // limbs may be borrowed from the data
+  const struct ha_int *denom; // denominator of the previous fraction, NULL
+                              // if there is none
+};
+
+
+// little_endian() determines if this system stores the least significant
+//   byte first, as the format does
+// time: O(1)
+static bool little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+// padded(size) gives size rounded up to a multiple of RECORD_ALIGN
+// time: O(1)
+static size_t padded(size_t size) {
+  return (size + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+// put_u32(p, x) stores x at p
+// requires: p has room for 4 bytes
+// time: O(1)
+static void put_u32(unsigned char *p, uint32_t x) {
+  assert(p);
+  for (int i = 0; i < 4; ++i) {
+    p[i] = (unsigned char)(x >> (8 * i));
+  }
+}
+
+// get_u32(p) gives the value stored at p
+// requires: p has 4 bytes
+// time: O(1)
+static uint32_t get_u32(const unsigned char *p) {
+  assert(p);
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+// put_header(buf, kind, rows, cols) appends the header of data of the given
+//   kind and size to buf
+// effects: modifies buf
+//          may allocate memory
+// time: O(1)
+static void put_header(struct ha_buffer *buf, int kind, int rows, int cols) {
+  assert(buf);
+  unsigned char *p = (unsigned char *)ha_buffer_reserve(buf, HEADER_SIZE);
+  memcpy(p, FORMAT_MAGIC, 4);
+  p[4] = FORMAT_VERSION & 0xff;
+  p[5] = FORMAT_VERSION >> 8;
+  p[6] = LIMB_BITS;
+  p[7] = kind;
+  put_u32(p + 8, rows);
+  put_u32(p + 12, cols);
+  buf->len += HEADER_SIZE;
+}
+
+// put_int(buf, n, flags) appends the record of n with the given flags to buf,
+//   adding FLAG_NEGATIVE if n is negative
+// effects: modifies buf
+//          may allocate memory
+// time: O(logn)
+static void put_int(struct ha_buffer *buf, const struct ha_int *n,
+                    uint32_t flags) {
+  assert(buf);
+  assert(n);
+  const size_t size = n->len * sizeof(ha_limb);
+  unsigned char *p = (unsigned char *)ha_buffer_reserve(
+                       buf, RECORD_HEADER_SIZE + padded(size));
+  put_u32(p, n->len);
+  put_u32(p + 4, n->sign ? flags : flags | FLAG_NEGATIVE);
+  p += RECORD_HEADER_SIZE;
+  if (little_endian()) {
+    memcpy(p, n->limbs, size);
+  } else {
+    for (size_t i = 0; i < size; ++i) {
+      p[i] = (unsigned char)(n->limbs[i / sizeof(ha_limb)] >>
+                             (i % sizeof(ha_limb) * 8));
+    }
+  }
+  memset(p + size, 0, padded(size) - size);
+  buf->len += RECORD_HEADER_SIZE + padded(size);
+}
+
+// put_frac(buf, num, denom) appends the records of num to buf, without its
+//   denominator if it is denom, the denominator of the fraction before it
+// notes: denom is NULL for the first fraction
+// effects: modifies buf
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+static void put_frac(struct ha_buffer *buf, const struct ha_frac *num,
+                     const struct ha_int *denom) {
+  assert(buf);
+  assert(num);
+  const bool same = denom && ha_int_eq(denom, &num->denom);
+  uint32_t flags = num->nega ? FLAG_NEGATIVE : 0;
+  if (num->reduced) {
+    flags |= FLAG_REDUCED;
+  }
+  if (same) {
+    flags |= FLAG_SAME_DENOM;
+  }
+  put_int(buf, &num->nume, flags);
+  if (!same) {
+    put_int(buf, &num->denom, 0);
+  }
+}
+
+void ha_int_encode(struct ha_buffer *buf, const struct ha_int *n) {
+  assert(buf);
+  assert(n);
+  put_header(buf, KIND_INT, 1, 1);
+  put_int(buf, n, 0);
+}
+
+void ha_frac_encode(struct ha_buffer *buf, const struct ha_frac *num) {
+  assert(buf);
+  assert(num);
+  put_header(buf, KIND_FRAC, 1, 1);
+  put_frac(buf, num, NULL);
+}
+
+void ha_comp_encode(struct ha_buffer *buf, const struct ha_comp *num) {
+  assert(buf);
+  assert(num);
+  put_header(buf, KIND_COMP, 1, 1);
+  put_frac(buf, &num->real, NULL);
+  put_frac(buf, &num->ima, &num->real.denom);
+}
+
+void ha_matrix_encode(struct ha_buffer *buf, const struct ha_matrix *mat) {
+  assert(buf);
+  assert(mat);
+  const int rows = ha_matrix_rows(mat);
+  const int cols = ha_matrix_cols(mat);
+  put_header(buf, KIND_MATRIX, rows, cols);
+  const struct ha_int *denom = NULL;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const struct ha_comp *num = ha_matrix_get(mat, i, j);
+      put_frac(buf, &num->real, denom);
+      put_frac(buf, &num->ima, &num->real.denom);
+      denom = &num->ima.denom;
+    }
+  }
+}
+
+// print_invalid_data() prints the error message of data that cannot be
+//   loaded
+// effects: produces output
+// time: O(1)
+static void print_invalid_data(void) {
+  printf("Error: the data is truncated or invalid\n");
+}
+
+// start_decoder(dec, data, len, kind, rows, cols, borrow) checks the header of
+//   the len bytes at data and sets up dec to read the records after it,
+//   storing the size in rows and cols, or returns false if the data does not
+//   hold the given kind
+// notes: if the header is invalid, an error message is printed
+// effects: modifies dec, rows and cols
+//          may produce output (error message)
+// time: O(1)
+static bool start_decoder(struct decoder *dec, const void *data, size_t len,
+                          int kind, int *rows, int *cols, bool borrow) {
+  assert(dec);
+  assert(data || len == 0);
+  assert(rows);
+  assert(cols);
+  const unsigned char *p = data;
+  if (len < HEADER_SIZE || memcmp(p, FORMAT_MAGIC, 4)) {
+    printf("Error: the data is not in the binary format\n");
+    return false;
+  }
+  const int version = p[4] | p[5] << 8;
+  if (version != FORMAT_VERSION) {
+    printf("Error: version %d of the binary format is not supported\n",
+           version);
+    return false;
+  }
+  const uint32_t r = get_u32(p + 8);
+  const uint32_t c = get_u32(p + 12);
+  if ((p[6] != 32 && p[6] != 64) || p[7] != kind || r == 0 || c == 0 ||
+      r > INT_MAX || c > INT_MAX || (uint64_t)r * c > INT_MAX ||
+      (kind != KIND_MATRIX && (r != 1 || c != 1)) ||
+      (uint64_t)r * c > (len - HEADER_SIZE) / (2 * RECORD_HEADER_SIZE)) {
+    print_invalid_data();
+    return false;
+  }
+  *rows = r;
+  *cols = c;
+  dec->pos = p + HEADER_SIZE;
+  dec->end = p + len;
+  dec->limb_bytes = p[6] / 8;
+  dec->borrow = borrow && (size_t)dec->limb_bytes == sizeof(ha_limb) &&
+                little_endian() && (uintptr_t)data % RECORD_ALIGN == 0;
+  dec->denom = NULL;
+  return true;
+}
+
+// lend(dst, src) makes dst use the borrowed limbs of src
+// requires: src->cap == 0
+// effects: modifies dst
+// time: O(1)
+static void lend(struct ha_int *dst, const struct ha_int *src) {
+  assert(dst);
+  assert(src);
+  assert(src->cap == 0);
+  ha_int_clear(dst);
+  dst->sign = src->sign;
+  dst->len = src->len;
+  dst->cap = 0;
+  dst->limbs = src->limbs;
+}
+
+// read_int(dec, dst, flags) reads the next record of dec into dst, with its
+//   sign, and stores its flags in flags, or returns false if it is invalid
+// effects: modifies dec, dst and flags
+//          may allocate memory
+// time: O(size of the record), O(1) if the limbs are borrowed
+static bool read_int(struct decoder *dec, struct ha_int *dst,
+                     uint32_t *flags) {
+  assert(dec);
+  assert(dst);
+  assert(flags);
+  const size_t left = dec->end - dec->pos;
+  if (left < RECORD_HEADER_SIZE) {
+    return false;
+  }
+  const uint32_t len = get_u32(dec->pos);
+  *flags = get_u32(dec->pos + 4);
+  const size_t size = (size_t)len * dec->limb_bytes;
+  const unsigned char *limbs = dec->pos + RECORD_HEADER_SIZE;
+  if (len > INT_MAX / 2 || padded(size) > left - RECORD_HEADER_SIZE) {
+    return false;
+  }
+  const bool negative = *flags & FLAG_NEGATIVE;
+  if (len == 0 ? negative
+               : !memcmp(limbs + size - dec->limb_bytes, "\0\0\0\0\0\0\0\0",
+                         dec->limb_bytes)) {
+    return false; // not normalized
+  }
+  if (dec->borrow && len > INLINE_LIMBS) {
+    ha_int_clear(dst);
+    dst->sign = !negative;
+    dst->len = len;
+    dst->cap = 0;
+    dst->limbs = (ha_limb *)limbs;
+  } else {
+    ha_int_set_bytes(dst, limbs, size, negative);
+  }
+  dec->pos = limbs + padded(size);
+  return true;
+}
+
+// read_frac(dec, dst) reads the next fraction of dec into dst, or returns
+//   false if it is invalid
+// effects: modifies dec and dst
+//          may allocate memory
+// time: O(size of the records), O(1) if the limbs are borrowed
+static bool read_frac(struct decoder *dec, struct ha_frac *dst) {
+  assert(dec);
+  assert(dst);
+  uint32_t flags = 0;
+  if (!read_int(dec, &dst->nume, &flags) ||
+      (flags & ~(FLAG_NEGATIVE | FLAG_REDUCED | FLAG_SAME_DENOM))) {
+    return false;
+  }
+  dst->nega = !dst->nume.sign;
+  dst->nume.sign = true;
+  dst->reduced = flags & FLAG_REDUCED;
+  if (flags & FLAG_SAME_DENOM) {
+    if (!dec->denom) {
+      return false;
+    }
+    if (dec->denom->cap == 0) {
+      lend(&dst->denom, dec->denom);
+    } else {
+      ha_int_set(&dst->denom, dec->denom);
+    }
+  } else if (!read_int(dec, &dst->denom, &flags) || flags ||
+             !ha_int_sign(&dst->denom)) {
+    return false;
+  }
+  dec->denom = &dst->denom;
+  return true;
+}
+
+// read_comp(dec, dst) reads the next complex number of dec into dst, or
+//   returns false if it is invalid
+// effects: modifies dec and dst
+//          may allocate memory
+// time: O(size of the records), O(1) if the limbs are borrowed
+static bool read_comp(struct decoder *dec, struct ha_comp *dst) {
+  assert(dec);
+  assert(dst);
+  return read_frac(dec, &dst->real) && read_frac(dec, &dst->ima);
+}
+
+struct ha_int *ha_int_decode(const void *data, size_t len) {
+  struct decoder dec;
+  int rows = 0;
+  int cols = 0;
+  if (!start_decoder(&dec, data, len, KIND_INT, &rows, &cols, false)) {
+    return NULL;
+  }
+  struct ha_int *result = ha_int_create("0");
+  uint32_t flags = 0;
+  if (!read_int(&dec, result, &flags) || (flags & ~FLAG_NEGATIVE) ||
+      dec.pos != dec.end) {
+    print_invalid_data();
+    ha_int_destroy(result);
+    return NULL;
+  }
+  return result;
+}
+
+struct ha_frac *ha_frac_decode(const void *data, size_t len) {
+  struct decoder dec;
+  int rows = 0;
+  int cols = 0;
+  if (!start_decoder(&dec, data, len, KIND_FRAC, &rows, &cols, false)) {
+    return NULL;
+  }
+  struct ha_frac *result = ha_frac_create("0", "1");
+  if (!read_frac(&dec, result) || dec.pos != dec.end) {
+    print_invalid_data();
+    ha_frac_destroy(result);
+    return NULL;
+  }
+  return result;
+}
+
+struct ha_comp *ha_comp_decode(const void *data, size_t len) {
+  struct decoder dec;
+  int rows = 0;
+  int cols = 0;
+  if (!start_decoder(&dec, data, len, KIND_COMP, &rows, &cols, false)) {
+    return NULL;
+  }
+  struct ha_comp *result = ha_comp_create("0", "1", "0", "1");
+  if (!read_comp(&dec, result) || dec.pos != dec.end) {
+    print_invalid_data();
+    ha_comp_destroy(result);
+    return NULL;
+  }
+  return result;
+}
+
+// load_matrix(data, len, borrow) loads the matrix encoded in the len bytes at
+//   data, borrowing its limbs from data where possible if borrow is true, or
+//   returns NULL if the bytes are not a matrix
+// notes: if the data is invalid, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(s), O(r * c) if all the limbs are borrowed
+static struct ha_matrix *load_matrix(const void *data, size_t len,
+                                     bool borrow) {
+  struct decoder dec;
+  int rows = 0;
+  int cols = 0;
+  if (!start_decoder(&dec, data, len, KIND_MATRIX, &rows, &cols, borrow)) {
+    return NULL;
+  }
+  struct ha_matrix *mat = ha_matrix_create(rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      if (!read_comp(&dec, ha_matrix_at(mat, i, j))) {
+        print_invalid_data();
+        ha_matrix_destroy(mat);
+        return NULL;
+      }
+    }
+  }
+  if (dec.pos != dec.end) {
+    print_invalid_data();
+    ha_matrix_destroy(mat);
+    return NULL;
+  }
+  return mat;
+}
+
+struct ha_matrix *ha_matrix_decode(const void *data, size_t len) {
+  return load_matrix(data, len, false);
+}
+
+struct ha_matrix *ha_matrix_view(const void *data, size_t len) {
+  return load_matrix(data, len, true);
+}
+
+struct ha_image *ha_image_open(const char *path) {
+  assert(path);
+  struct ha_image *image = malloc(sizeof(struct ha_image));
+  image->data = NULL;
+  image->size = 0;
+  image->mapped = false;
+#ifdef HAVE_MMAP
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Error: cannot open %s\n", path);
+    free(image);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      close(fd); // the mapping stays valid
+      image->data = map;
+      image->size = st.st_size;
+      image->mapped = true;
+      return image;
+    }
+  }
+  close(fd);
+#endif
+  // not mappable (an empty file, a pipe, or no mmap): read it into memory
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf("Error: cannot open %s\n", path);
+    free(image);
+    return NULL;
+  }
+  size_t cap = 0;
+  size_t got = 0;
+  do {
+    image->size += got;
+    if (cap - image->size < READ_BLOCK_SIZE) {
+      cap = cap ? 2 * cap : READ_BLOCK_SIZE;
+      image->data = realloc(image->data, cap);
+    }
+    got = fread((char *)image->data + image->size, 1, cap - image->size,
+                file);
+  } while (got > 0);
+  fclose(file);
+  return image;
+}
+
+void ha_image_close(struct ha_image *image) {
+  assert(image);
+#ifdef HAVE_MMAP
+  if (image->mapped) {
+    munmap(image->data, image->size);
+    free(image);
+    return;
+  }
+#endif
+  free(image->data);
+  free(image);
+}
+
+const void *ha_image_data(const struct ha_image *image) {
+  assert(image);
+  return image->data;
+}
+
+size_t ha_image_size(const struct ha_image *image) {
+  assert(image);
+  return image->size;
+}
+
+struct ha_matrix *ha_image_matrix(const struct ha_image *image) {
+  assert(image);
+  return ha_matrix_view(image->data, image->size);
+}
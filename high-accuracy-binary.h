@@ -0,0 +1,153 @@
+// This module saves numbers and matrices in a compact binary format and loads
+//   them back
+
+// The format stores the limbs themselves, so nothing is converted to or from
+// decimal, and a matrix loaded from a mapped file can use the limbs where
+// they lie in the file instead of copying them (see ha_image_open).
+
+// Format (version 1), with all fields little-endian:
+//   header, 16 bytes: the magic "HAbn", the version (16 bits), the limb size
+//     in bits (8 bits, 32 or 64), the kind (8 bits: 1 for an integer, 2 for
+//     a fraction, 3 for a complex number, 4 for a matrix), then the numbers
+//     of rows and columns (32 bits each, both 1 for a number)
+//   integer: the number of limbs and the flags (32 bits each), then the
+//     limbs, least significant first, padded with zeros to a multiple of 8
+//     bytes; flag 1 means negative
+//   fraction: the numerator, with the flags of the fraction (1 for negative,
+//     2 for known to be in lowest terms, 4 for the denominator being the one
+//     of the previous fraction), then the denominator unless it is omitted
+//   complex number: the real part, then the imaginary part
+//   matrix: the entries, in row-major order
+// Every record starts at a multiple of 8 bytes, so limbs read in place are
+// aligned. Numbers must be normalized: no zero top limb, no negative 0 and
+// no zero denominator.
+
+// The following applies to all functions:
+// requires: all parameters are valid (not NULL)
+// time: s is the size of the encoded data
+
+// Borrowed limbs: a value loaded by ha_matrix_view points into the data it
+// was loaded from, which must outlive it. It behaves as any other value, and
+// is copied into its own storage the first time it is written.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-matrix.h"
+
+
+struct ha_image;
+
+
+// ha_int_encode(buf, n) appends n to buf, in the binary format
+// effects: modifies buf
+//          may allocate memory
+// time: O(logn)
+void ha_int_encode(struct ha_buffer *buf, const struct ha_int *n);
+
+// ha_frac_encode(buf, num) appends num to buf, in the binary format
+// effects: modifies buf
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+void ha_frac_encode(struct ha_buffer *buf, const struct ha_frac *num);
+
+// ha_comp_encode(buf, num) appends num to buf, in the binary format
+// notes: the imaginary part shares the denominator of the real part if they
+//          are equal
+// effects: modifies buf
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+void ha_comp_encode(struct ha_buffer *buf, const struct ha_comp *num);
+
+// ha_matrix_encode(buf, mat) appends mat to buf, in the binary format
+// notes: every fraction whose denominator is the one of the fraction before
+//          it (including 1) stores no denominator
+// effects: modifies buf
+//          may allocate memory
+// time: O(r * c * e), where r and c are the numbers of rows and columns of
+//       mat and e is the time of comparing two entries
+void ha_matrix_encode(struct ha_buffer *buf, const struct ha_matrix *mat);
+
+// ha_int_decode(data, len) loads the integer encoded in the len bytes at data,
+//   or returns NULL if they are not one
+// notes: if the data is invalid, an error message is printed
+// effects: may allocate memory (client must call ha_int_destroy)
+//          may produce output (error message)
+// time: O(s)
+struct ha_int *ha_int_decode(const void *data, size_t len);
+
+// ha_frac_decode(data, len) loads the fraction encoded in the len bytes at
+//   data, or returns NULL if they are not one
+// notes: if the data is invalid, an error message is printed
+// effects: may allocate memory (client must call ha_frac_destroy)
+//          may produce output (error message)
+// time: O(s)
+struct ha_frac *ha_frac_decode(const void *data, size_t len);
+
+// ha_comp_decode(data, len) loads the complex number encoded in the len bytes
+//   at data, or returns NULL if they are not one
+// notes: if the data is invalid, an error message is printed
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(s)
+struct ha_comp *ha_comp_decode(const void *data, size_t len);
+
+// ha_matrix_decode(data, len) loads the matrix encoded in the len bytes at
+//   data, or returns NULL if they are not one
+// notes: if the data is invalid, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(s)
+struct ha_matrix *ha_matrix_decode(const void *data, size_t len);
+
+// ha_matrix_view(data, len) loads the matrix encoded in the len bytes at data
+//   as ha_matrix_decode, but with the limbs of its large entries borrowed
+//   from data instead of copied, or returns NULL if the bytes are not a
+//   matrix
+// notes: limbs are borrowed only if they were written with the limb size and
+//          byte order of this build and data is aligned to 8 bytes; the
+//          others are copied
+//        if the data is invalid, an error message is printed
+// requires: data stays valid and unchanged until the matrix is destroyed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c), where r and c are the numbers of rows and columns, if all
+//       the limbs are borrowed, O(s) otherwise
+struct ha_matrix *ha_matrix_view(const void *data, size_t len);
+
+// ha_image_open(path) gives the contents of the file at path, mapped into
+//   memory where the system supports it and read otherwise, or returns NULL
+//   if the file cannot be opened
+// notes: if the file cannot be opened, an error message is printed
+// requires: path is a valid string
+// effects: may allocate memory (client must call ha_image_close)
+//          may produce output (error message)
+// time: O(1) if the file is mapped, O(s) otherwise
+struct ha_image *ha_image_open(const char *path);
+
+// ha_image_close(image) unmaps or frees the contents of image
+// requires: the matrices viewed from image have been destroyed
+// effects: image is no longer valid
+// time: O(1)
+void ha_image_close(struct ha_image *image);
+
+// ha_image_data(image) gives where the contents of image start
+// notes: mapped contents start at a page boundary, so they can be given to
+//          ha_matrix_view
+// time: O(1)
+const void *ha_image_data(const struct ha_image *image);
+
+// ha_image_size(image) gives the size of the contents of image in bytes
+// time: O(1)
+size_t ha_image_size(const struct ha_image *image);
+
+// ha_image_matrix(image) views the matrix stored in image, as
+//   ha_matrix_view(ha_image_data(image), ha_image_size(image))
+// requires: image stays open until the matrix is destroyed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c) if all the limbs are borrowed, O(s) otherwise
+struct ha_matrix *ha_image_matrix(const struct ha_image *image);
@@ -0,0 +1,77 @@
+// This module provides the growable character buffers the high-accuracy
+//   modules write their output into
+
+// For all program scope functions, see high-accuracy-buffer.h for details
+
+// The characters come from malloc rather than from an allocation context,
+// since the strings made from them are freed by the caller.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "high-accuracy-buffer.h"
+
+// capacity of a buffer on its first write
+#define MIN_BUFFER_CAP 64
+
+
+void ha_buffer_init(struct ha_buffer *buf) {
+  assert(buf);
+  buf->data = NULL;
+  buf->len = 0;
+  buf->cap = 0;
+}
+
+void ha_buffer_free(struct ha_buffer *buf) {
+  assert(buf);
+  free(buf->data);
+  buf->data = NULL;
+  buf->len = 0;
+  buf->cap = 0;
+}
+
+char *ha_buffer_reserve(struct ha_buffer *buf, size_t n) {
+  assert(buf);
+  // one more character is always kept for the '\0' of ha_buffer_release
+  if (buf->cap - buf->len <= n) {
+    size_t cap = buf->cap ? buf->cap : MIN_BUFFER_CAP;
+    while (cap - buf->len <= n) {
+      cap *= 2;
+    }
+    buf->data = realloc(buf->data, cap);
+    buf->cap = cap;
+  }
+  return buf->data + buf->len;
+}
+
+void ha_buffer_append(struct ha_buffer *buf, const char *s, size_t n) {
+  assert(buf);
+  assert(s);
+  memcpy(ha_buffer_reserve(buf, n), s, n);
+  buf->len += n;
+}
+
+void ha_buffer_putc(struct ha_buffer *buf, char c) {
+  assert(buf);
+  *ha_buffer_reserve(buf, 1) = c;
+  ++buf->len;
+}
+
+char *ha_buffer_release(struct ha_buffer *buf) {
+  assert(buf);
+  *ha_buffer_reserve(buf, 0) = '\0';
+  char *s = buf->data;
+  ha_buffer_init(buf);
+  return s;
+}
+
+bool ha_buffer_flush(struct ha_buffer *buf, FILE *file) {
+  assert(buf);
+  assert(file);
+  const size_t written = buf->len ? fwrite(buf->data, 1, buf->len, file) : 0;
+  const bool ok = written == buf->len && fflush(file) == 0;
+  buf->len = 0;
+  return ok;
+}
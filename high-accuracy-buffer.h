@@ -0,0 +1,77 @@
+// This module provides the growable character buffers the high-accuracy
+//   modules write their output into
+
+// The _write functions of the number and matrix modules append to an
+// ha_buffer supplied by the caller, so a whole matrix is formatted without
+// any intermediate string and reaches its file with one write:
+//   struct ha_buffer buf;
+//   ha_buffer_init(&buf);
+//   ha_matrix_write(&buf, mat);
+//   ha_buffer_flush(&buf, file);
+//   ha_buffer_free(&buf);
+
+#ifndef HIGH_ACCURACY_BUFFER_H
+#define HIGH_ACCURACY_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+
+struct ha_buffer {
+  char *data; // the characters written so far, from malloc
+  size_t len; // number of characters written
+  size_t cap; // number of characters data has room for
+};
+
+
+// ha_buffer_init(buf) sets up buf as an empty buffer
+// requires: buf is not NULL
+// effects: buf is valid (client must call ha_buffer_free)
+// time: O(1)
+void ha_buffer_init(struct ha_buffer *buf);
+
+// ha_buffer_free(buf) frees the characters of buf
+// requires: buf is valid (not NULL)
+// effects: buf is no longer valid
+// time: O(1)
+void ha_buffer_free(struct ha_buffer *buf);
+
+// ha_buffer_reserve(buf, n) makes room for n more characters in buf and gives
+//   where they go
+// notes: the characters count once buf->len is increased by the caller
+// requires: buf is valid (not NULL)
+// effects: may allocate memory
+// time: O(1) amortized
+char *ha_buffer_reserve(struct ha_buffer *buf, size_t n);
+
+// ha_buffer_append(buf, s, n) appends the n characters at s to buf
+// requires: buf and s are valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O(n) amortized
+void ha_buffer_append(struct ha_buffer *buf, const char *s, size_t n);
+
+// ha_buffer_putc(buf, c) appends c to buf
+// requires: buf is valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O(1) amortized
+void ha_buffer_putc(struct ha_buffer *buf, char c);
+
+// ha_buffer_release(buf) gives the characters of buf as a string and leaves
+//   buf empty
+// requires: buf is valid (not NULL)
+// effects: allocates memory (caller must free)
+// time: O(1) amortized
+char *ha_buffer_release(struct ha_buffer *buf);
+
+// ha_buffer_flush(buf, file) writes the characters of buf to file at once and
+//   empties buf, or returns false if they could not all be written
+// requires: buf and file are valid (not NULL)
+// effects: produces output
+//          modifies buf
+// time: O(buf->len)
+bool ha_buffer_flush(struct ha_buffer *buf, FILE *file);
+
+#endif
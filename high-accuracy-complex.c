@@ -1,216 +1,631 @@
-// This module provides basic calculations for arbitrarily large complex numbers
-
-// For all program scope functions, see high-accuracy-complex.h for details
-
-// The following applies to all functions:
-// requires: all number parameters are valid (not NULL)
-
-#include <assert.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <stdbool.h>
-#include "high-accuracy-complex.h"
-#include "high-accuracy-fraction.h"
-
-struct ha_comp {
-  struct ha_frac *real;
-  struct ha_frac *ima;
-};
-
-// ha_comp(ha_comp_create_with_ha_frac) returns a pointer p at a struct ha_comp
-// with p->real = real, p->ima = ima
-// effects: allocates memory(caller must call ha_comp_destroy)
-// time: O(1)
-static struct ha_comp *ha_comp_create_with_ha_frac(struct ha_frac *real, 
-                                                   struct ha_frac *ima) {
-  assert(real);
-  assert(ima);
-  struct ha_comp *result = malloc(sizeof(struct ha_comp));
-  result->real = real;
-  result->ima = ima;
-  return result;
-}
-
-struct ha_comp *ha_comp_create(const char *real_nume, const char *real_denom,
-                               const char *ima_nume, const char *ima_denom) {
-  assert(real_nume);
-  assert(real_denom);
-  assert(ima_nume);
-  assert(ima_denom);
-  struct ha_frac *real = ha_frac_create(real_nume, real_denom);
-  struct ha_frac *ima = ha_frac_create(ima_nume, ima_denom);
-  if (real && ima) {
-    return ha_comp_create_with_ha_frac(real, ima);
-  } else {
-    if (real) {
-      ha_frac_destroy(real);
-    }
-    if (ima) {
-      ha_frac_destroy(ima);
-    }
-    return NULL;
-  }
-}
-
-void ha_comp_destroy(struct ha_comp *num) {
-  assert(num);
-  ha_frac_destroy(num->real);
-  ha_frac_destroy(num->ima);
-  free(num);
-}
-
-// ha_frac_cmp_with_n(num, n) returns 1 if num > n, 0 if num == n, -1 if num < n
-// time: O((n2) * log(n2))
-static int ha_frac_cmp_with_n(const struct ha_frac *num, const char *n) {
-  assert(num);
-  assert(n);
-  struct ha_frac *temp = ha_frac_create(n, "1");
-  int sign = ha_frac_cmp(num, temp);
-  ha_frac_destroy(temp);
-  return sign;
-}
-
-// ha_frac_sign(num) returns 1 if num is positive, 0 if num == n, -1 if num is 
-// negative
-// time: O((n2) * log(n2))
-static int ha_frac_sign(const struct ha_frac *num) {
-  assert(num);
-  return ha_frac_cmp_with_n(num, "0");
-}
-
-void ha_comp_print(const struct ha_comp *num, bool newline) {
-  assert(num);
-  char *num_str = ha_comp_to_str(num);
-  printf("%s", num_str);
-  free(num_str);
-  if (newline) {
-    printf("\n");
-  }
-}
-
-bool ha_comp_is_zero(const struct ha_comp *num) {
-  assert(num);
-  if (!ha_frac_sign(num->real) && !ha_frac_sign(num->ima)) {
-    return true;
-  } else {
-    return false;
-  }
-}
-
-bool ha_comp_is_one(const struct ha_comp *num) {
-  assert(num);
-  if (ha_frac_sign(num->ima)) {
-    return false;
-  } else {
-    if (!ha_frac_cmp_with_n(num->real, "1")) {
-      return true;
-    } else {
-      return false;
-    }
-  }
-}
-
-struct ha_comp *ha_comp_add(const struct ha_comp *n, const struct ha_comp *m) {
-  assert(n);
-  assert(m);
-  struct ha_frac *new_real = ha_frac_add(n->real, m->real);
-  struct ha_frac *new_ima = ha_frac_add(n->ima, m->ima);
-  return ha_comp_create_with_ha_frac(new_real, new_ima);
-}
-
-struct ha_comp *ha_comp_sub(const struct ha_comp *n, const struct ha_comp *m) {
-  assert(n);
-  assert(m);
-  struct ha_frac *new_real = ha_frac_sub(n->real, m->real);
-  struct ha_frac *new_ima = ha_frac_sub(n->ima, m->ima);
-  return ha_comp_create_with_ha_frac(new_real, new_ima);
-}
-
-struct ha_comp *ha_comp_mult(const struct ha_comp *n, const struct ha_comp *m) {
-  assert(n);
-  assert(m);
-  struct ha_frac *real_real = ha_frac_mult(n->real, m->real);
-  struct ha_frac *ima_ima = ha_frac_mult(n->ima, m->ima);
-  struct ha_frac *new_real = ha_frac_sub(real_real, ima_ima);
-  ha_frac_destroy(real_real);
-  ha_frac_destroy(ima_ima);
-  struct ha_frac *real_ima = ha_frac_mult(n->real, m->ima);
-  struct ha_frac *ima_real = ha_frac_mult(n->ima, m->real);
-  struct ha_frac *new_ima = ha_frac_add(real_ima, ima_real);
-  ha_frac_destroy(real_ima);
-  ha_frac_destroy(ima_real);
-  return ha_comp_create_with_ha_frac(new_real, new_ima);
-}
-
-struct ha_comp *ha_comp_div(const struct ha_comp *n, const struct ha_comp *m) {
-  assert(n);
-  assert(m);
-  assert(!ha_comp_is_zero(m));
-  struct ha_frac *zero = ha_frac_create("0", "1");
-  struct ha_frac *nega_m_ima = ha_frac_sub(zero, m->ima);
-  ha_frac_destroy(zero);
-  struct ha_comp *m_conju = 
-    ha_comp_create_with_ha_frac(ha_frac_copy(m->real), nega_m_ima);
-  struct ha_comp *m_mult_m_conju = ha_comp_mult(m, m_conju);
-  struct ha_frac *div = m_mult_m_conju->real;
-  struct ha_comp *n_mult_m_conju = ha_comp_mult(n, m_conju);
-  ha_comp_destroy(m_conju);
-  struct ha_frac *new_real = ha_frac_div(n_mult_m_conju->real, div);
-  struct ha_frac *new_ima = ha_frac_div(n_mult_m_conju->ima, div);
-  ha_comp_destroy(m_mult_m_conju);
-  ha_comp_destroy(n_mult_m_conju);
-  return ha_comp_create_with_ha_frac(new_real, new_ima);
-}
-
-char *ha_comp_to_str(const struct ha_comp *num) {
-  assert(num);
-  char *real = ha_frac_to_str(num->real);
-  char *ima = ha_frac_to_str(num->ima);
-  bool real_eq_zero = !strcmp("0", real);
-  bool ima_eq_zero = !strcmp("0", ima);
-  int termi_idx = strlen(real);
-  char *result = malloc((termi_idx + 1) * sizeof(char));
-  strcpy(result, real);
-  if (!ima_eq_zero) {
-    if (real_eq_zero) {
-      result[0] = '\0';
-      termi_idx = 0;
-    }
-    char *temp_ima = ima;
-    if (!real_eq_zero || ima[0] == '-') {
-      ++termi_idx;
-      result = realloc(result, (termi_idx + 1) * sizeof(char));
-      result[termi_idx] = '\0';
-      if (ima[0] == '-') {
-        result[termi_idx - 1] = '-';
-        temp_ima = ima + 1;
-      } else {
-        result[termi_idx - 1] = '+';
-      }
-    }
-    if (ha_frac_is_frac(num->ima)) {
-      int old_termi = termi_idx;
-      termi_idx += strlen(temp_ima) + 3;
-      result = realloc(result, (termi_idx + 1) * sizeof(char));
-      result[old_termi] = '(';
-      result[old_termi + 1] = '\0';
-      strcat(result, temp_ima);
-      result[termi_idx - 2] = ')';
-    } else {
-      if (strcmp(temp_ima, "1")) {
-        termi_idx += strlen(temp_ima) + 1;
-        result = realloc(result, (termi_idx + 1) * sizeof(char));
-        strcat(result, temp_ima);
-      } else {
-        ++termi_idx;
-        result = realloc(result, (termi_idx + 1) * sizeof(char));
-      }
-    }
-    result[termi_idx - 1] = 'i';
-    result[termi_idx] = '\0';
-  }
-  free(real);
-  free(ima);
-  return result;
-}
+// This module provides basic calculations for arbitrarily large complex numbers
+
+// For all program scope functions, see high-accuracy-complex.h for details
+
+// The following applies to all functions:
+// requires: all number parameters are valid (not NULL)
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+
+void ha_comp_init(struct ha_comp *num, struct ha_arena *arena) {
+  assert(num);
+  ha_frac_init(&num->real, arena);
+  ha_frac_init(&num->ima, arena);
+}
+
+void ha_comp_clear(struct ha_comp *num) {
+  assert(num);
+  ha_frac_clear(&num->real);
+  ha_frac_clear(&num->ima);
+}
+
+// CONSTANT(k) is the initializer of the constant k of comp_constants
+#define CONSTANT(k) \
+  {CONSTANT_FRAC(k, comp_constants[(k) + HA_INT_CONSTANT_MAX].real), \
+   CONSTANT_FRAC(0, comp_constants[(k) + HA_INT_CONSTANT_MAX].ima)}
+
+// the constants of ha_comp_constant, from -HA_INT_CONSTANT_MAX on
+static const struct ha_comp comp_constants[2 * HA_INT_CONSTANT_MAX + 1] = {
+  CONSTANT_TABLE(CONSTANT)
+};
+
+// new_zero() returns a new ha_comp equal to 0 from the current allocation
+//   context
+// effects: allocates memory(caller must call ha_comp_destroy)
+// time: O(1)
+static struct ha_comp *new_zero(void) {
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_comp *result = ha_alloc_node(arena, sizeof(struct ha_comp));
+  ha_comp_init(result, arena);
+  return result;
+}
+
+// ha_comp(ha_comp_create_with_ha_frac) returns a pointer p at a struct ha_comp
+// with p->real = real, p->ima = ima, and destroys real and ima
+// effects: allocates memory(caller must call ha_comp_destroy)
+//          real and ima are no longer valid
+// time: O(1)
+static struct ha_comp *ha_comp_create_with_ha_frac(struct ha_frac *real, 
+                                                   struct ha_frac *ima) {
+  assert(real);
+  assert(ima);
+  struct ha_comp *result = new_zero();
+  ha_frac_swap(&result->real, real);
+  ha_frac_swap(&result->ima, ima);
+  ha_frac_destroy(real);
+  ha_frac_destroy(ima);
+  return result;
+}
+
+struct ha_comp *ha_comp_create(const char *real_nume, const char *real_denom,
+                               const char *ima_nume, const char *ima_denom) {
+  assert(real_nume);
+  assert(real_denom);
+  assert(ima_nume);
+  assert(ima_denom);
+  struct ha_frac *real = ha_frac_create(real_nume, real_denom);
+  struct ha_frac *ima = ha_frac_create(ima_nume, ima_denom);
+  if (real && ima) {
+    return ha_comp_create_with_ha_frac(real, ima);
+  } else {
+    if (real) {
+      ha_frac_destroy(real);
+    }
+    if (ima) {
+      ha_frac_destroy(ima);
+    }
+    return NULL;
+  }
+}
+
+void ha_comp_destroy(struct ha_comp *num) {
+  assert(num);
+  struct ha_arena *arena = num->real.nume.arena;
+  ha_comp_clear(num);
+  ha_release_node(arena, num, sizeof(struct ha_comp));
+}
+
+void ha_comp_print(const struct ha_comp *num, bool newline) {
+  assert(num);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_comp_write(&buf, num);
+  if (newline) {
+    ha_buffer_putc(&buf, '\n');
+  }
+  ha_buffer_flush(&buf, stdout);
+  ha_buffer_free(&buf);
+}
+
+bool ha_comp_is_zero(const struct ha_comp *num) {
+  assert(num);
+  return !ha_frac_sign(&num->real) && !ha_frac_sign(&num->ima);
+}
+
+bool ha_comp_is_one(const struct ha_comp *num) {
+  assert(num);
+  return !ha_frac_sign(&num->ima) && ha_frac_is_one(&num->real);
+}
+
+void ha_comp_approx(const struct ha_comp *num, double *real, double *ima) {
+  assert(num);
+  assert(real);
+  assert(ima);
+  *real = ha_frac_approx(&num->real);
+  *ima = ha_frac_approx(&num->ima);
+}
+
+const struct ha_comp *ha_comp_constant(int k) {
+  assert(-HA_INT_CONSTANT_MAX <= k && k <= HA_INT_CONSTANT_MAX);
+  return &comp_constants[k + HA_INT_CONSTANT_MAX];
+}
+
+// number of scratch fractions the arithmetic below needs at the same time
+#define SCRATCH_NUM 2
+
+// number of scratch integers the Gaussian integer kernels need at the same
+// time
+#define SCRATCH_INT_NUM 10
+
+// per-thread scratch numbers, created on first use and reused by every call
+// so that the arithmetic does not allocate once they are big enough; they
+// always live on the heap, since they outlast any arena
+static _Thread_local struct ha_frac *scratch_fracs[SCRATCH_NUM];
+static _Thread_local struct ha_int *scratch_ints[SCRATCH_INT_NUM];
+
+// release_scratch() destroys the scratch numbers of the current thread, as
+//   its cleanup (see ha_alloc_on_trim)
+// time: O(SCRATCH_NUM + SCRATCH_INT_NUM)
+static void release_scratch(void) {
+  for (int i = 0; i < SCRATCH_NUM; ++i) {
+    if (scratch_fracs[i]) {
+      ha_frac_destroy(scratch_fracs[i]);
+      scratch_fracs[i] = NULL;
+    }
+  }
+  for (int i = 0; i < SCRATCH_INT_NUM; ++i) {
+    if (scratch_ints[i]) {
+      ha_int_destroy(scratch_ints[i]);
+      scratch_ints[i] = NULL;
+    }
+  }
+}
+
+// scratch(i) gives the i-th scratch fraction of the current thread
+// requires: 0 <= i < SCRATCH_NUM
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1)
+static struct ha_frac *scratch(int i) {
+  assert(0 <= i && i < SCRATCH_NUM);
+  if (!scratch_fracs[i]) {
+    ha_alloc_on_trim(release_scratch);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    scratch_fracs[i] = ha_frac_create("0", "1");
+    ha_arena_use(arena);
+  }
+  return scratch_fracs[i];
+}
+
+// scratch_int(i) gives the i-th scratch integer of the current thread
+// requires: 0 <= i < SCRATCH_INT_NUM
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1)
+static struct ha_int *scratch_int(int i) {
+  assert(0 <= i && i < SCRATCH_INT_NUM);
+  if (!scratch_ints[i]) {
+    ha_alloc_on_trim(release_scratch);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    scratch_ints[i] = ha_int_create("0");
+    ha_arena_use(arena);
+  }
+  return scratch_ints[i];
+}
+
+// is_real(num) determines if the imaginary part of num is 0
+// time: O(1)
+static bool is_real(const struct ha_comp *num) {
+  assert(num);
+  return ha_int_sign(&num->ima.nume) == 0;
+}
+
+// write_ima(buf, ima, after_real) appends the imaginary part ima to buf as a
+//   term of ha_comp_to_str: its sign ('+' only after the real part), then
+//   (p/q)i, ki or i
+// requires: ima != 0
+// effects: modifies buf
+// time: O(log(ima_nume) + log(ima_denom))
+static void write_ima(struct ha_buffer *buf, const struct ha_frac *ima,
+                      bool after_real) {
+  assert(buf);
+  assert(ima);
+  if (ima->nega) {
+    ha_buffer_putc(buf, '-');
+  } else if (after_real) {
+    ha_buffer_putc(buf, '+');
+  }
+  const bool is_frac = ha_frac_is_frac(ima);
+  if (is_frac) {
+    ha_buffer_putc(buf, '(');
+  }
+  const size_t start = buf->len;
+  ha_frac_write(buf, ima);
+  if (ima->nega) { // the sign is already written
+    memmove(buf->data + start, buf->data + start + 1, buf->len - start - 1);
+    --buf->len;
+  }
+  if (is_frac) {
+    ha_buffer_putc(buf, ')');
+  } else if (buf->len - start == 1 && buf->data[start] == '1') {
+    --buf->len; // written as i rather than 1i
+  }
+  ha_buffer_putc(buf, 'i');
+}
+
+// signed_nume(dst, num, scale) sets dst to the numerator of num times scale,
+//   with the sign of num
+// effects: modifies dst
+// time: O(log(num_nume) * log(scale))
+static void signed_nume(struct ha_int *dst, const struct ha_frac *num,
+                        const struct ha_int *scale) {
+  assert(dst);
+  assert(num);
+  assert(scale);
+  ha_int_mult_into(dst, &num->nume, scale);
+  if (num->nega) {
+    ha_int_negate(dst);
+  }
+}
+
+// to_gaussian(re, im, den, num, t, u) sets re, im and den so that
+//   num = (re + im * i) / den, where den is the least common multiple of
+//   the denominators of num
+// requires: re, im, den, t and u are distinct scratch integers
+// effects: modifies re, im, den, t and u
+// time: O((n2)^2 + log(n1) * log(n2))
+static void to_gaussian(struct ha_int *re, struct ha_int *im,
+                        struct ha_int *den, const struct ha_comp *num,
+                        struct ha_int *t, struct ha_int *u) {
+  assert(re);
+  assert(im);
+  assert(den);
+  assert(num);
+  assert(t);
+  assert(u);
+  const struct ha_int *real_denom = &num->real.denom;
+  const struct ha_int *ima_denom = &num->ima.denom;
+  if (ha_int_eq(real_denom, ima_denom)) { // integers most of the time
+    ha_int_set(re, &num->real.nume);
+    ha_int_set(im, &num->ima.nume);
+    if (num->real.nega) {
+      ha_int_negate(re);
+    }
+    if (num->ima.nega) {
+      ha_int_negate(im);
+    }
+    ha_int_set(den, real_denom);
+    return;
+  }
+  ha_int_gcd_into(t, real_denom, ima_denom);
+  ha_int_divmod_into(u, NULL, ima_denom, t);
+  signed_nume(re, &num->real, u);
+  ha_int_mult_into(den, real_denom, u);
+  ha_int_divmod_into(u, NULL, real_denom, t);
+  signed_nume(im, &num->ima, u);
+}
+
+// gauss_mult(re, im, p, q, r, s, t, u) sets re + im * i to
+//   (p + q * i) * (r + s * i)
+// notes: takes three integer products instead of four: with k1 = r(p + q),
+//          k2 = p(s - r) and k3 = q(r + s), the product is
+//          (k1 - k3) + (k1 + k2)i
+// requires: re, im, t and u are distinct from each other and from p, q, r, s
+// effects: modifies re, im, t and u
+// time: O(k^2) at worst, where k is the number of digits of the largest
+//       operand
+static void gauss_mult(struct ha_int *re, struct ha_int *im,
+                       const struct ha_int *p, const struct ha_int *q,
+                       const struct ha_int *r, const struct ha_int *s,
+                       struct ha_int *t, struct ha_int *u) {
+  assert(re);
+  assert(im);
+  assert(p);
+  assert(q);
+  assert(r);
+  assert(s);
+  assert(t);
+  assert(u);
+  ha_int_add_into(t, p, q);
+  ha_int_mult_into(u, r, t); // k1
+  ha_int_sub_into(t, s, r);
+  ha_int_mult_into(im, p, t); // k2
+  ha_int_add_into(t, r, s);
+  ha_int_mult_into(re, q, t); // k3
+  ha_int_sub_into(re, u, re);
+  ha_int_add_into(im, u, im);
+}
+
+void ha_comp_set(struct ha_comp *dst, const struct ha_comp *num) {
+  assert(dst);
+  assert(num);
+  ha_frac_set(&dst->real, &num->real);
+  ha_frac_set(&dst->ima, &num->ima);
+}
+
+void ha_comp_add_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  ha_frac_add_into(&dst->real, &n->real, &m->real);
+  ha_frac_add_into(&dst->ima, &n->ima, &m->ima);
+}
+
+void ha_comp_sub_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  ha_frac_sub_into(&dst->real, &n->real, &m->real);
+  ha_frac_sub_into(&dst->ima, &n->ima, &m->ima);
+}
+
+// mult_parts(real, ima, n, m) sets real and ima to the real and imaginary
+//   parts of n * m
+// notes: real and ima may belong to n or m
+//        a real factor takes two fraction products instead of four, and
+//          other factors go through gauss_mult
+//        uses the scratch integers
+// effects: modifies real and ima
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+static void mult_parts(struct ha_frac *real, struct ha_frac *ima,
+                       const struct ha_comp *n, const struct ha_comp *m) {
+  assert(real);
+  assert(ima);
+  assert(n);
+  assert(m);
+  // the imaginary part goes first: the real part of the real factor is still
+  // needed afterwards, while the parts ima may belong to are not
+  if (is_real(m)) { // (a + bi) * c = ac + bci
+    ha_frac_mult_into(ima, &n->ima, &m->real);
+    ha_frac_mult_into(real, &n->real, &m->real);
+    return;
+  } else if (is_real(n)) { // a * (c + di) = ac + adi
+    ha_frac_mult_into(ima, &n->real, &m->ima);
+    ha_frac_mult_into(real, &n->real, &m->real);
+    return;
+  }
+  // n * m = (p + qi)(r + si) / (dn * dm) over the Gaussian integers, so
+  // that each part is reduced once at the end
+  struct ha_int *p = scratch_int(0);
+  struct ha_int *q = scratch_int(1);
+  struct ha_int *dn = scratch_int(2);
+  struct ha_int *r = scratch_int(3);
+  struct ha_int *s = scratch_int(4);
+  struct ha_int *dm = scratch_int(5);
+  struct ha_int *t = scratch_int(6);
+  struct ha_int *u = scratch_int(7);
+  struct ha_int *new_real = scratch_int(8);
+  struct ha_int *new_ima = scratch_int(9);
+  to_gaussian(p, q, dn, n, t, u);
+  to_gaussian(r, s, dm, m, t, u);
+  gauss_mult(new_real, new_ima, p, q, r, s, t, u);
+  ha_int_mult_into(t, dn, dm);
+  ha_frac_set_quotient(real, new_real, t);
+  ha_frac_set_quotient(ima, new_ima, t);
+}
+
+void ha_comp_mult_into(struct ha_comp *dst, const struct ha_comp *n,
+                       const struct ha_comp *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  mult_parts(&dst->real, &dst->ima, n, m);
+}
+
+void ha_comp_div_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  assert(!ha_comp_is_zero(m));
+  if (is_real(m)) { // (a + bi) / c = a/c + (b/c)i
+    ha_frac_div_into(&dst->ima, &n->ima, &m->real);
+    ha_frac_div_into(&dst->real, &n->real, &m->real);
+    return;
+  }
+  // with n = (p + qi) / dn and m = (r + si) / dm,
+  // n / m = dm * (p + qi)(r - si) / (dn * (r^2 + s^2)): the squared norm is
+  // taken directly and both parts share one denominator, reduced against
+  // each of them (see high-accuracy-complex.h)
+  struct ha_int *p = scratch_int(0);
+  struct ha_int *q = scratch_int(1);
+  struct ha_int *dn = scratch_int(2);
+  struct ha_int *r = scratch_int(3);
+  struct ha_int *s = scratch_int(4);
+  struct ha_int *dm = scratch_int(5);
+  struct ha_int *t = scratch_int(6);
+  struct ha_int *u = scratch_int(7);
+  struct ha_int *new_real = scratch_int(8);
+  struct ha_int *new_ima = scratch_int(9);
+  to_gaussian(p, q, dn, n, t, u);
+  to_gaussian(r, s, dm, m, t, u);
+  ha_int_negate(s);
+  gauss_mult(new_real, new_ima, p, q, r, s, t, u);
+  ha_int_mult_into(t, r, r);
+  ha_int_addmul(t, s, s);
+  ha_int_mult_into(t, t, dn);
+  ha_int_mult_into(new_real, new_real, dm);
+  ha_int_mult_into(new_ima, new_ima, dm);
+  ha_frac_set_quotient(&dst->real, new_real, t);
+  ha_frac_set_quotient(&dst->ima, new_ima, t);
+}
+
+void ha_comp_fma(struct ha_comp *acc, const struct ha_comp *n,
+                 const struct ha_comp *m) {
+  assert(acc);
+  assert(n);
+  assert(m);
+  struct ha_frac *product_real = scratch(0);
+  struct ha_frac *product_ima = scratch(1);
+  mult_parts(product_real, product_ima, n, m);
+  ha_frac_add_into(&acc->real, &acc->real, product_real);
+  ha_frac_add_into(&acc->ima, &acc->ima, product_ima);
+}
+
+struct ha_comp *ha_comp_add(const struct ha_comp *n, const struct ha_comp *m) {
+  assert(n);
+  assert(m);
+  struct ha_comp *result = new_zero();
+  ha_comp_add_into(result, n, m);
+  return result;
+}
+
+struct ha_comp *ha_comp_sub(const struct ha_comp *n, const struct ha_comp *m) {
+  assert(n);
+  assert(m);
+  struct ha_comp *result = new_zero();
+  ha_comp_sub_into(result, n, m);
+  return result;
+}
+
+struct ha_comp *ha_comp_mult(const struct ha_comp *n, const struct ha_comp *m) {
+  assert(n);
+  assert(m);
+  struct ha_comp *result = new_zero();
+  ha_comp_mult_into(result, n, m);
+  return result;
+}
+
+struct ha_comp *ha_comp_div(const struct ha_comp *n, const struct ha_comp *m) {
+  assert(n);
+  assert(m);
+  assert(!ha_comp_is_zero(m));
+  struct ha_comp *result = new_zero();
+  ha_comp_div_into(result, n, m);
+  return result;
+}
+
+void ha_comp_write(struct ha_buffer *buf, const struct ha_comp *num) {
+  assert(buf);
+  assert(num);
+  const bool real_eq_zero = ha_int_sign(&num->real.nume) == 0;
+  if (!real_eq_zero || is_real(num)) {
+    ha_frac_write(buf, &num->real);
+  }
+  if (!is_real(num)) {
+    write_ima(buf, &num->ima, !real_eq_zero);
+  }
+}
+
+char *ha_comp_to_str(const struct ha_comp *num) {
+  assert(num);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_comp_write(&buf, num);
+  return ha_buffer_release(&buf);
+}
+
+
+// Batches
+
+
+struct ha_comp_batch {
+  struct ha_arena *arena; // context of the struct and its parts
+  struct ha_frac_batch *real;
+  struct ha_frac_batch *ima;
+};
+
+struct ha_comp_batch *ha_comp_batch_create(int count) {
+  assert(count > 0);
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_comp_batch *batch = ha_alloc(arena, sizeof(struct ha_comp_batch));
+  batch->arena = arena;
+  batch->real = ha_frac_batch_create(count);
+  batch->ima = ha_frac_batch_create(count);
+  return batch;
+}
+
+void ha_comp_batch_destroy(struct ha_comp_batch *batch) {
+  assert(batch);
+  ha_frac_batch_destroy(batch->real);
+  ha_frac_batch_destroy(batch->ima);
+  ha_release(batch->arena, batch);
+}
+
+int ha_comp_batch_size(const struct ha_comp_batch *batch) {
+  assert(batch);
+  return ha_frac_batch_size(batch->real);
+}
+
+void ha_comp_batch_get(const struct ha_comp_batch *batch, int i,
+                       struct ha_comp *dst) {
+  assert(batch);
+  assert(dst);
+  ha_frac_batch_get(batch->real, i, &dst->real);
+  ha_frac_batch_get(batch->ima, i, &dst->ima);
+}
+
+void ha_comp_batch_set(struct ha_comp_batch *batch, int i,
+                       const struct ha_comp *num) {
+  assert(batch);
+  assert(num);
+  ha_frac_batch_set(batch->real, i, &num->real);
+  ha_frac_batch_set(batch->ima, i, &num->ima);
+}
+
+void ha_comp_add_batch(struct ha_comp_batch *dst,
+                       const struct ha_comp_batch *n,
+                       const struct ha_comp_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  ha_frac_add_batch(dst->real, n->real, m->real);
+  ha_frac_add_batch(dst->ima, n->ima, m->ima);
+}
+
+void ha_comp_sub_batch(struct ha_comp_batch *dst,
+                       const struct ha_comp_batch *n,
+                       const struct ha_comp_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  ha_frac_sub_batch(dst->real, n->real, m->real);
+  ha_frac_sub_batch(dst->ima, n->ima, m->ima);
+}
+
+// number of scratch fraction batches of ha_comp_mult_batch
+#define SCRATCH_BATCH_NUM 3
+
+// per-thread scratch fraction batches of ha_comp_mult_batch, on the heap like
+// the scratch numbers, and replaced when a batch of another size comes
+static _Thread_local struct ha_frac_batch *scratch_batches[SCRATCH_BATCH_NUM];
+
+// release_scratch_batches() destroys the scratch fraction batches of the
+//   current thread, as its cleanup (see ha_alloc_on_trim)
+// time: O(total size of the batches)
+static void release_scratch_batches(void) {
+  for (int i = 0; i < SCRATCH_BATCH_NUM; ++i) {
+    if (scratch_batches[i]) {
+      ha_frac_batch_destroy(scratch_batches[i]);
+      scratch_batches[i] = NULL;
+    }
+  }
+}
+
+// scratch_batch(i, count) gives the i-th scratch fraction batch of the current
+//   thread, of size count
+// requires: 0 <= i < SCRATCH_BATCH_NUM
+//           count > 0
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1), O(count) if the size changes
+static struct ha_frac_batch *scratch_batch(int i, int count) {
+  assert(0 <= i && i < SCRATCH_BATCH_NUM);
+  struct ha_frac_batch **batch = &scratch_batches[i];
+  if (*batch && ha_frac_batch_size(*batch) != count) {
+    ha_frac_batch_destroy(*batch);
+    *batch = NULL;
+  }
+  if (!*batch) {
+    ha_alloc_on_trim(release_scratch_batches);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    *batch = ha_frac_batch_create(count);
+    ha_arena_use(arena);
+  }
+  return *batch;
+}
+
+void ha_comp_mult_batch(struct ha_comp_batch *dst,
+                        const struct ha_comp_batch *n,
+                        const struct ha_comp_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  if (ha_frac_batch_is_zero(n->ima) && ha_frac_batch_is_zero(m->ima)) {
+    // real numbers: the imaginary part of dst becomes 0 * 0
+    ha_frac_mult_batch(dst->ima, n->ima, m->ima);
+    ha_frac_mult_batch(dst->real, n->real, m->real);
+    return;
+  }
+  const int count = ha_comp_batch_size(dst);
+  struct ha_frac_batch *real_real = scratch_batch(0, count);
+  struct ha_frac_batch *ima_ima = scratch_batch(1, count);
+  struct ha_frac_batch *real_ima = scratch_batch(2, count);
+  // (a + bi)(c + di) = (ac - bd) + (ad + bc)i, with every operand read
+  // before dst overwrites it
+  ha_frac_mult_batch(real_real, n->real, m->real);
+  ha_frac_mult_batch(ima_ima, n->ima, m->ima);
+  ha_frac_mult_batch(real_ima, n->real, m->ima);
+  ha_frac_mult_batch(dst->ima, n->ima, m->real);
+  ha_frac_add_batch(dst->ima, dst->ima, real_ima);
+  ha_frac_sub_batch(dst->real, real_real, ima_ima);
+}
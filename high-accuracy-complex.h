@@ -1,82 +1,237 @@
-#include <stdbool.h>
-#include "high-accuracy-fraction.h"
-
-// This module provides basic calculations for arbitrarily large complex numbers
-
-// The following applies to all functions:
-// requires: all number parameters are valid (not NULL)
-// time: n1 = max(real_nume, ima_nume), n2 = max(real_denom, ima_denom) if not 
-// specified (so numbers of digits are log(n1), log(n2)), if there are 
-// 2 numbers, n1, n2 are max(real_nume, ima_nume), max(real_denom, ima_denom)
-// of the first number paremeter, m1, m2 are of the second
-
-
-struct ha_comp;
-
-// ha_comp_create(real_nume, real_denom, ima_nume, ima_denom) returns a struct
-// ha_comp with the parameters given, or returns NULL if at least one of them
-// is invalid
-// notes: valid real_nume, real_denom, ima_nume, ima_denom satisfy:
-//          1. all of them are valid integers
-//          2. both denoms are non-zero
-//        if either one is invalid, error message(s) will be 
-//        printed
-// examples: 0 1 0 1=> 0
-//           1 2 0 2=> 1/2
-//           12 34 1 2=> 6/17+(1/2)i
-//           -1 2 -3 3=> -1/2-i
-//           1 0 1 1is invalid (returns NULL)
-// requires: real_nume, real_denom, ima_nume, ima_denom are not NULL
-// effects: may allocate memory (client must call ha_comp_destroy)
-//          may produce output (error message)
-// time: O(n * logn * logm) or O(m * logn *logm) 
-// where n = max(real_nume, ima_nume), m = max(real_denom, ima_denom) 
-struct ha_comp *ha_comp_create(const char *real_nume, const char *real_denom,
-                               const char *ima_nume, const char *ima_denom);
-
-// ha_comp_destroy(num) destroys num
-// effects: num is no longer valid
-// time: O(1)
-void ha_comp_destroy(struct ha_comp *num);
-
-// ha_frac_print() prints num followed by an optional \n (if newline is true)
-// notes: if num is real, then print the real part only
-//        if num is not real, assume real = a and ima = b, then print a+bi if b
-// is an int; otherwise print a+(b)i
-// effects: prints output
-// time: O((n2) * log(n2) + log(n1))
-void ha_comp_print(const struct ha_comp *num, bool newline);
-
-// ha_comp_is_zero(num) returns true is num == 0; false otherwise
-// time: O((n2) * log(n2))
-bool ha_comp_is_zero(const struct ha_comp *num);
-
-// ha_comp_is_zero(num) returns true is num == 1; false otherwise
-// time: O((n2) * log(n2))
-bool ha_comp_is_one(const struct ha_comp *num);
-
-// ha_comp_add(n, m) gives n + m
-// effects: allocates memory (caller must call ha_comp_destroy)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_comp *ha_comp_add(const struct ha_comp *n, const struct ha_comp *m);
-
-// ha_comp_add(n, m) gives n - m
-// effects: allocates memory (caller must call ha_comp_destroy)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_comp *ha_comp_sub(const struct ha_comp *n, const struct ha_comp *m);
-
-// ha_comp_add(n, m) gives n * m
-// effects: allocates memory (caller must call ha_comp_destroy)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_comp *ha_comp_mult(const struct ha_comp *n, const struct ha_comp *m);
-
-// ha_comp_add(n, m) gives n / m
-// requires: m != 0
-// effects: allocates memory (caller must call ha_comp_destroy)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_comp *ha_comp_div(const struct ha_comp *n, const struct ha_comp *m);
-
-// ha_comp_to_str(num) returns the cooresponding string of num
-// effects: allocates memory(caller must free)
-// time: O(log(n1) + log(n2))
-char *ha_comp_to_str(const struct ha_comp *num);
+#include <stdbool.h>
+#include "high-accuracy-fraction.h"
+
+// This module provides basic calculations for arbitrarily large complex numbers
+
+// The following applies to all functions:
+// requires: all number parameters are valid (not NULL)
+// time: n1 = max(real_nume, ima_nume), n2 = max(real_denom, ima_denom) if not 
+// specified (so numbers of digits are log(n1), log(n2)), if there are 
+// 2 numbers, n1, n2 are max(real_nume, ima_nume), max(real_denom, ima_denom)
+// of the first number paremeter, m1, m2 are of the second
+
+// Functions ending in _into (and ha_comp_fma) write their result into an
+// existing ha_comp instead of allocating a new one. The destination may be
+// one of the operands, and its storage is reused whenever it is big enough.
+
+// Real numbers (imaginary part 0) are recognized in O(1). Multiplying by one
+// or dividing by one only works on the parts that can be nonzero, so real
+// matrices cost about a quarter of the complex arithmetic.
+
+// Otherwise, products and quotients are computed over the Gaussian integers:
+// both operands are brought to the form (p + qi) / d, and both parts of the
+// result come out over one shared denominator (the squared norm of the
+// divisor, for a quotient). That denominator is then reduced against each
+// part separately, with two gcds rather than a single common one, since
+// every fraction is kept in lowest terms on its own and a factor common to
+// all three would leave the parts unreduced.
+
+// Batches: an ha_comp_batch holds its real and imaginary parts as two
+// batches of fractions (see high-accuracy-fraction.h), so that the _batch
+// functions run over separate arrays of real and imaginary numerators and
+// denominators, with the word kernels of the fractions.
+
+
+struct ha_comp;
+struct ha_comp_batch;
+
+// ha_comp_create(real_nume, real_denom, ima_nume, ima_denom) returns a struct
+// ha_comp with the parameters given, or returns NULL if at least one of them
+// is invalid
+// notes: valid real_nume, real_denom, ima_nume, ima_denom satisfy:
+//          1. all of them are valid integers
+//          2. both denoms are non-zero
+//        if either one is invalid, error message(s) will be 
+//        printed
+// examples: 0 1 0 1=> 0
+//           1 2 0 2=> 1/2
+//           12 34 1 2=> 6/17+(1/2)i
+//           -1 2 -3 3=> -1/2-i
+//           1 0 1 1is invalid (returns NULL)
+// requires: real_nume, real_denom, ima_nume, ima_denom are not NULL
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(n * logn * logm) or O(m * logn *logm) 
+// where n = max(real_nume, ima_nume), m = max(real_denom, ima_denom) 
+struct ha_comp *ha_comp_create(const char *real_nume, const char *real_denom,
+                               const char *ima_nume, const char *ima_denom);
+
+// ha_comp_destroy(num) destroys num
+// effects: num is no longer valid
+// time: O(1)
+void ha_comp_destroy(struct ha_comp *num);
+
+// ha_comp_set(dst, num) sets dst to num
+// notes: dst may share the limbs of num, see ha_int_set
+// effects: modifies dst
+//          may allocate memory
+// time: O(log(n1) + log(n2)), O(1) if the limbs are shared
+void ha_comp_set(struct ha_comp *dst, const struct ha_comp *num);
+
+// ha_frac_print() prints num followed by an optional \n (if newline is true)
+// notes: if num is real, then print the real part only
+//        if num is not real, assume real = a and ima = b, then print a+bi if b
+// is an int; otherwise print a+(b)i
+// effects: prints output
+// time: O((n2) * log(n2) + log(n1))
+void ha_comp_print(const struct ha_comp *num, bool newline);
+
+// ha_comp_is_zero(num) returns true is num == 0; false otherwise
+// time: O(1)
+bool ha_comp_is_zero(const struct ha_comp *num);
+
+// ha_comp_is_zero(num) returns true is num == 1; false otherwise
+// time: O(1), or O(n2) if the reduction of num is deferred
+bool ha_comp_is_one(const struct ha_comp *num);
+
+// ha_comp_approx(num, real, ima) sets real and ima to the real and imaginary
+//   parts of num as doubles, as ha_frac_approx does
+// effects: modifies real and ima
+// time: O(1)
+void ha_comp_approx(const struct ha_comp *num, double *real, double *ima);
+
+// ha_comp_constant(k) gives the complex number k, shared by all threads
+// notes: as ha_int_constant, the constant must not be destroyed or written
+// requires: -HA_INT_CONSTANT_MAX <= k <= HA_INT_CONSTANT_MAX
+// time: O(1)
+const struct ha_comp *ha_comp_constant(int k);
+
+// ha_comp_add(n, m) gives n + m
+// effects: allocates memory (caller must call ha_comp_destroy)
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+struct ha_comp *ha_comp_add(const struct ha_comp *n, const struct ha_comp *m);
+
+// ha_comp_add_into(dst, n, m) sets dst to n + m
+// effects: modifies dst
+//          may allocate memory
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+void ha_comp_add_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m);
+
+// ha_comp_add(n, m) gives n - m
+// effects: allocates memory (caller must call ha_comp_destroy)
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+struct ha_comp *ha_comp_sub(const struct ha_comp *n, const struct ha_comp *m);
+
+// ha_comp_sub_into(dst, n, m) sets dst to n - m
+// effects: modifies dst
+//          may allocate memory
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+void ha_comp_sub_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m);
+
+// ha_comp_add(n, m) gives n * m
+// effects: allocates memory (caller must call ha_comp_destroy)
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+struct ha_comp *ha_comp_mult(const struct ha_comp *n, const struct ha_comp *m);
+
+// ha_comp_mult_into(dst, n, m) sets dst to n * m
+// effects: modifies dst
+//          may allocate memory
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+void ha_comp_mult_into(struct ha_comp *dst, const struct ha_comp *n,
+                       const struct ha_comp *m);
+
+// ha_comp_fma(acc, n, m) adds n * m to acc
+// effects: modifies acc
+//          may allocate memory
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+void ha_comp_fma(struct ha_comp *acc, const struct ha_comp *n,
+                 const struct ha_comp *m);
+
+// ha_comp_add(n, m) gives n / m
+// requires: m != 0
+// effects: allocates memory (caller must call ha_comp_destroy)
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+struct ha_comp *ha_comp_div(const struct ha_comp *n, const struct ha_comp *m);
+
+// ha_comp_div_into(dst, n, m) sets dst to n / m
+// requires: m != 0
+// effects: modifies dst
+//          may allocate memory
+// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
+void ha_comp_div_into(struct ha_comp *dst, const struct ha_comp *n,
+                      const struct ha_comp *m);
+
+// ha_comp_write(buf, num) appends num to buf, as in ha_comp_to_str
+// requires: buf is valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+void ha_comp_write(struct ha_buffer *buf, const struct ha_comp *num);
+
+// ha_comp_to_str(num) returns the cooresponding string of num
+// effects: allocates memory(caller must free)
+// time: O(log(n1) + log(n2))
+char *ha_comp_to_str(const struct ha_comp *num);
+
+// ha_comp_batch_create(count) creates a batch of count complex numbers, all
+//   0, in the current allocation context
+// requires: count > 0
+// effects: allocates memory (client must call ha_comp_batch_destroy)
+// time: O(count)
+struct ha_comp_batch *ha_comp_batch_create(int count);
+
+// ha_comp_batch_destroy(batch) destroys batch
+// requires: batch is valid (not NULL)
+// effects: batch is no longer valid
+// time: O(count)
+void ha_comp_batch_destroy(struct ha_comp_batch *batch);
+
+// ha_comp_batch_size(batch) gives the number of complex numbers of batch
+// requires: batch is valid (not NULL)
+// time: O(1)
+int ha_comp_batch_size(const struct ha_comp_batch *batch);
+
+// ha_comp_batch_get(batch, i, dst) sets dst to the number of batch at i
+// requires: batch is valid (not NULL)
+//           0 <= i < size of batch
+// effects: modifies dst
+//          may allocate memory
+// time: O(log(n1) + log(n2)), where n1, n2 are of the number at i
+void ha_comp_batch_get(const struct ha_comp_batch *batch, int i,
+                       struct ha_comp *dst);
+
+// ha_comp_batch_set(batch, i, num) sets the number of batch at i to num
+// requires: batch is valid (not NULL)
+//           0 <= i < size of batch
+// effects: modifies batch
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+void ha_comp_batch_set(struct ha_comp_batch *batch, int i,
+                       const struct ha_comp *num);
+
+// ha_comp_add_batch(dst, n, m) sets every number of dst to the sum of the
+//   numbers of n and m at the same position
+// notes: dst may be n or m
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: see ha_frac_add_batch
+void ha_comp_add_batch(struct ha_comp_batch *dst,
+                       const struct ha_comp_batch *n,
+                       const struct ha_comp_batch *m);
+
+// ha_comp_sub_batch(dst, n, m) sets every number of dst to the difference of
+//   the numbers of n and m at the same position
+// notes: dst may be n or m
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: see ha_frac_sub_batch
+void ha_comp_sub_batch(struct ha_comp_batch *dst,
+                       const struct ha_comp_batch *n,
+                       const struct ha_comp_batch *m);
+
+// ha_comp_mult_batch(dst, n, m) sets every number of dst to the product of
+//   the numbers of n and m at the same position
+// notes: dst may be n or m
+//        if the imaginary parts of n and m are all 0, only the real parts
+//          are multiplied
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: see ha_frac_mult_batch
+void ha_comp_mult_batch(struct ha_comp_batch *dst,
+                        const struct ha_comp_batch *n,
+                        const struct ha_comp_batch *m);
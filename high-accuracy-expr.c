@@ -0,0 +1,859 @@
+// This module provides lazy matrix expressions
+
+// For all program scope functions, see high-accuracy-expr.h for details
+
+// The following applies to all functions:
+// requires: all graph, expression and matrix parameters are valid (not NULL)
+// time: x is the number of expressions of the graph
+
+// Graph: the expressions of a graph are hash-consed: an operation is looked
+//   up by its operator and operands in the hash table of the graph before a
+//   node is made for it, so that equal expressions are one node. Nodes are
+//   never freed before their graph, so their addresses identify them.
+
+// Evaluation: an evaluation first counts the uses of every node reachable
+//   from the one evaluated, one per edge. A node used once is flattened into
+//   its parent, while a node used more than once (a common subexpression) is
+//   a unit of its own: it is computed once, and its value is kept until its
+//   last use is done. Units are put in normal form, a sum of terms with one
+//   coefficient and a chain of factors each; a factor is a matrix, a unit
+//   used more than once, or a sum inside a product.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-expr.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-matrix.h"
+
+enum op { OP_MATRIX, OP_ADD, OP_SUB, OP_MULT, OP_SCALE };
+
+struct ha_expr {
+  enum op op;
+  int id; // order of creation in the graph
+  int rows;
+  int cols;
+  double bits; // estimated bits of an entry, numerators and denominators
+  const struct ha_matrix *mat; // for OP_MATRIX
+  struct ha_expr *left; // operands, with only left for OP_SCALE
+  struct ha_expr *right;
+  struct ha_comp k; // for OP_SCALE, 0 otherwise
+  struct ha_expr *next; // next node of the graph
+  struct ha_expr *chain; // next node in the same bucket
+  int mark; // last evaluation that reached the node
+  int uses; // uses left in that evaluation
+  struct ha_matrix *value; // value in that evaluation, if computed
+};
+
+struct ha_expr_graph {
+  struct ha_expr *nodes; // newest first
+  int count; // number of nodes
+  struct ha_expr **buckets; // hash table of the nodes
+  int bucket_count; // a power of 2
+  int evals; // number of evaluations started
+};
+
+// a term of a normal form: coef times the product of its factors
+struct term {
+  struct ha_comp coef;
+  int sign; // 1 or -1 if coef is, 0 otherwise
+  int first; // the factors are factors[first..first + count) of the form
+  int count; // 0 once the term is dropped
+  struct ha_matrix *value; // the product of the factors, once computed
+  bool owned; // value belongs to the term, and may be overwritten
+};
+
+// a sum of terms; there is room for one term and one factor per edge of the
+//   graph
+struct form {
+  struct term *terms;
+  int term_count;
+  struct ha_expr **factors;
+  int factor_count;
+};
+
+// the state of an evaluation
+struct eval {
+  struct ha_matrix **spare; // intermediate matrices no longer in use
+  int spare_count;
+  int spare_cap;
+};
+
+// initial number of buckets of a graph
+#define FIRST_BUCKETS 16
+
+
+// max(a, b) finds the larger value between a and b
+static double max(double a, double b) {
+  return a >= b ? a : b;
+}
+
+// print_size_error(op, n, m) prints an error message in the form
+//   "Error: cannot op a RxC matrix and a RxC matrix"
+// effects: produces output
+// time: O(1)
+static void print_size_error(const char *op, const struct ha_expr *n,
+                             const struct ha_expr *m) {
+  assert(op);
+  assert(n);
+  assert(m);
+  printf("Error: cannot %s a %dx%d matrix and a %dx%d matrix\n", op, n->rows,
+         n->cols, m->rows, m->cols);
+}
+
+// log2_ceil(x) gives the smallest b with 2^b >= x
+// requires: x > 0
+// time: O(log(x))
+static int log2_ceil(int x) {
+  assert(x > 0);
+  int b = 0;
+  while ((1LL << b) < x) {
+    ++b;
+  }
+  return b;
+}
+
+// comp_bits(num) gives the bits of the larger part of num, numerator and
+//   denominator together
+// time: O(1)
+static double comp_bits(const struct ha_comp *num) {
+  assert(num);
+  const int real = ha_int_bit_length(&num->real.nume) +
+                   ha_int_bit_length(&num->real.denom);
+  const int ima = ha_int_bit_length(&num->ima.nume) +
+                  ha_int_bit_length(&num->ima.denom);
+  return real >= ima ? real : ima;
+}
+
+// matrix_bits(mat) gives the average of comp_bits over the entries of mat
+// time: O(r * c)
+static double matrix_bits(const struct ha_matrix *mat) {
+  assert(mat);
+  const int rows = ha_matrix_rows(mat);
+  const int cols = ha_matrix_cols(mat);
+  double total = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      total += comp_bits(ha_matrix_get(mat, i, j));
+    }
+  }
+  return max(total / ((double)rows * cols), 1);
+}
+
+// comp_eq(n, m) determines if n == m
+// time: O(e)
+static bool comp_eq(const struct ha_comp *n, const struct ha_comp *m) {
+  assert(n);
+  assert(m);
+  return !ha_frac_cmp(&n->real, &m->real) && !ha_frac_cmp(&n->ima, &m->ima);
+}
+
+// coef_sign(k) gives 1 or -1 if k is, and 0 otherwise
+// time: O(1)
+static int coef_sign(const struct ha_comp *k) {
+  assert(k);
+  if (ha_comp_is_one(k)) {
+    return 1;
+  }
+  return comp_eq(k, ha_comp_constant(-1)) ? -1 : 0;
+}
+
+// hash(op, mat, left, right) gives the hash of a node from its operator and
+//   operands (scalars are compared but not hashed)
+// time: O(1)
+static uint64_t hash(enum op op, const struct ha_matrix *mat,
+                     const struct ha_expr *left, const struct ha_expr *right) {
+  uint64_t h = op;
+  h = (h ^ (uintptr_t)mat) * 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (uintptr_t)left) * 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (uintptr_t)right) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 29);
+}
+
+// bucket(g, h) gives the bucket of g for the hash h
+// time: O(1)
+static struct ha_expr **bucket(struct ha_expr_graph *g, uint64_t h) {
+  assert(g);
+  return &g->buckets[h & (uint64_t)(g->bucket_count - 1)];
+}
+
+// rehash(g) doubles the number of buckets of g
+// effects: modifies g
+//          allocates memory
+// time: O(x)
+static void rehash(struct ha_expr_graph *g) {
+  assert(g);
+  ha_release(NULL, g->buckets);
+  g->bucket_count *= 2;
+  g->buckets = ha_alloc(NULL, g->bucket_count * sizeof(struct ha_expr *));
+  memset(g->buckets, 0, g->bucket_count * sizeof(struct ha_expr *));
+  for (struct ha_expr *n = g->nodes; n; n = n->next) {
+    struct ha_expr **b = bucket(g, hash(n->op, n->mat, n->left, n->right));
+    n->chain = *b;
+    *b = n;
+  }
+}
+
+// intern(g, op, mat, left, right, k) gives the node of g with the given
+//   operator and operands, making it if there is none
+// requires: mat is given for OP_MATRIX only, k for OP_SCALE only
+// effects: may modify g
+//          may allocate memory
+// time: O(1) on average, plus O(r * c) for a new OP_MATRIX node
+static const struct ha_expr *intern(struct ha_expr_graph *g, enum op op,
+                                    const struct ha_matrix *mat,
+                                    const struct ha_expr *left,
+                                    const struct ha_expr *right,
+                                    const struct ha_comp *k) {
+  assert(g);
+  const uint64_t h = hash(op, mat, left, right);
+  for (struct ha_expr *n = *bucket(g, h); n; n = n->chain) {
+    if (n->op == op && n->mat == mat && n->left == left &&
+        n->right == right && (!k || comp_eq(&n->k, k))) {
+      return n;
+    }
+  }
+
+  struct ha_expr *n = ha_alloc_node(NULL, sizeof(struct ha_expr));
+  n->op = op;
+  n->id = g->count;
+  n->mat = mat;
+  n->left = (struct ha_expr *)left;
+  n->right = (struct ha_expr *)right;
+  ha_comp_init(&n->k, NULL);
+  n->mark = 0;
+  n->uses = 0;
+  n->value = NULL;
+  // the bits of a result follow the growth of the numbers: a sum is about as
+  // big as its larger operand, a product as both together, plus the bits of
+  // the sums of the inner dimension
+  switch (op) {
+    case OP_MATRIX:
+      n->rows = ha_matrix_rows(mat);
+      n->cols = ha_matrix_cols(mat);
+      n->bits = matrix_bits(mat);
+      break;
+    case OP_ADD:
+    case OP_SUB:
+      n->rows = left->rows;
+      n->cols = left->cols;
+      n->bits = max(left->bits, right->bits) + 1;
+      break;
+    case OP_MULT:
+      n->rows = left->rows;
+      n->cols = right->cols;
+      n->bits = left->bits + right->bits + log2_ceil(left->cols);
+      break;
+    case OP_SCALE:
+      ha_comp_set(&n->k, k);
+      n->rows = left->rows;
+      n->cols = left->cols;
+      n->bits = left->bits + comp_bits(k);
+      break;
+  }
+  n->next = g->nodes;
+  g->nodes = n;
+  ++g->count;
+  struct ha_expr **b = bucket(g, h);
+  n->chain = *b;
+  *b = n;
+  if (g->count > g->bucket_count) {
+    rehash(g);
+  }
+  return n;
+}
+
+struct ha_expr_graph *ha_expr_graph_create(void) {
+  struct ha_expr_graph *g = ha_alloc(NULL, sizeof(struct ha_expr_graph));
+  g->nodes = NULL;
+  g->count = 0;
+  g->bucket_count = FIRST_BUCKETS;
+  g->buckets = ha_alloc(NULL, g->bucket_count * sizeof(struct ha_expr *));
+  memset(g->buckets, 0, g->bucket_count * sizeof(struct ha_expr *));
+  g->evals = 0;
+  return g;
+}
+
+void ha_expr_graph_destroy(struct ha_expr_graph *g) {
+  assert(g);
+  struct ha_expr *n = g->nodes;
+  while (n) {
+    struct ha_expr *next = n->next;
+    assert(!n->value);
+    ha_comp_clear(&n->k);
+    ha_release_node(NULL, n, sizeof(struct ha_expr));
+    n = next;
+  }
+  ha_release(NULL, g->buckets);
+  ha_release(NULL, g);
+}
+
+const struct ha_expr *ha_expr_matrix(struct ha_expr_graph *g,
+                                     const struct ha_matrix *mat) {
+  assert(g);
+  assert(mat);
+  return intern(g, OP_MATRIX, mat, NULL, NULL, NULL);
+}
+
+const struct ha_expr *ha_expr_add(struct ha_expr_graph *g,
+                                  const struct ha_expr *n,
+                                  const struct ha_expr *m) {
+  assert(g);
+  if (!n || !m) {
+    return NULL;
+  }
+  if (n->rows != m->rows || n->cols != m->cols) {
+    print_size_error("add", n, m);
+    return NULL;
+  }
+  // n + m is m + n
+  if (n->id > m->id) {
+    const struct ha_expr *temp = n;
+    n = m;
+    m = temp;
+  }
+  return intern(g, OP_ADD, NULL, n, m, NULL);
+}
+
+const struct ha_expr *ha_expr_sub(struct ha_expr_graph *g,
+                                  const struct ha_expr *n,
+                                  const struct ha_expr *m) {
+  assert(g);
+  if (!n || !m) {
+    return NULL;
+  }
+  if (n->rows != m->rows || n->cols != m->cols) {
+    print_size_error("subtract", n, m);
+    return NULL;
+  }
+  return intern(g, OP_SUB, NULL, n, m, NULL);
+}
+
+const struct ha_expr *ha_expr_mult(struct ha_expr_graph *g,
+                                   const struct ha_expr *n,
+                                   const struct ha_expr *m) {
+  assert(g);
+  if (!n || !m) {
+    return NULL;
+  }
+  if (n->cols != m->rows) {
+    print_size_error("multiply", n, m);
+    return NULL;
+  }
+  return intern(g, OP_MULT, NULL, n, m, NULL);
+}
+
+const struct ha_expr *ha_expr_scalar_mult(struct ha_expr_graph *g,
+                                          const struct ha_comp *k,
+                                          const struct ha_expr *n) {
+  assert(g);
+  assert(k);
+  if (!n) {
+    return NULL;
+  }
+  return intern(g, OP_SCALE, NULL, n, NULL, k);
+}
+
+int ha_expr_rows(const struct ha_expr *n) {
+  assert(n);
+  return n->rows;
+}
+
+int ha_expr_cols(const struct ha_expr *n) {
+  assert(n);
+  return n->cols;
+}
+
+
+// new_matrix(ev, rows, cols) gives a rows x cols matrix to write a result
+//   into: a spare one of ev if there is one of that size, or a new one
+// notes: the entries of a spare matrix are those of its last use
+// effects: may modify ev
+//          may allocate memory (client must call spare or ha_matrix_destroy)
+// time: O(s + rows * cols), where s is the number of spare matrices
+static struct ha_matrix *new_matrix(struct eval *ev, int rows, int cols) {
+  assert(ev);
+  for (int i = 0; i < ev->spare_count; ++i) {
+    struct ha_matrix *mat = ev->spare[i];
+    if (ha_matrix_rows(mat) == rows && ha_matrix_cols(mat) == cols) {
+      ev->spare[i] = ev->spare[--ev->spare_count];
+      return mat;
+    }
+  }
+  return ha_matrix_create(rows, cols);
+}
+
+// spare(ev, mat) keeps mat for later results of its size
+// effects: modifies ev
+//          may allocate memory
+// time: O(s), where s is the number of spare matrices
+static void spare(struct eval *ev, struct ha_matrix *mat) {
+  assert(ev);
+  assert(mat);
+  if (ev->spare_count == ev->spare_cap) {
+    ev->spare_cap = ev->spare_cap ? 2 * ev->spare_cap : 8;
+    struct ha_matrix **bigger =
+      ha_alloc(NULL, ev->spare_cap * sizeof(struct ha_matrix *));
+    if (ev->spare) {
+      memcpy(bigger, ev->spare, ev->spare_count * sizeof(struct ha_matrix *));
+      ha_release(NULL, ev->spare);
+    }
+    ev->spare = bigger;
+  }
+  ev->spare[ev->spare_count++] = mat;
+}
+
+// value_of(n) gives the value of n in the current evaluation
+// requires: n is a matrix, or its value is computed
+// time: O(1)
+static const struct ha_matrix *value_of(const struct ha_expr *n) {
+  assert(n);
+  assert(n->op == OP_MATRIX || n->value);
+  return n->op == OP_MATRIX ? n->mat : n->value;
+}
+
+// count_uses(n, mark) counts the uses of n and the nodes it depends on, one
+//   per edge, for the evaluation mark, and forgets their values
+// effects: modifies n and the nodes it depends on
+// time: O(x)
+static void count_uses(struct ha_expr *n, int mark) {
+  assert(n);
+  if (n->mark == mark) {
+    return;
+  }
+  n->mark = mark;
+  n->uses = 0;
+  n->value = NULL;
+  if (n->left) {
+    count_uses(n->left, mark);
+    ++n->left->uses;
+  }
+  if (n->right) {
+    count_uses(n->right, mark);
+    ++n->right->uses;
+  }
+}
+
+// consume(ev, n) marks one use of n as done, sparing its value after the last
+// effects: modifies n and ev
+//          may allocate memory
+// time: O(s), where s is the number of spare matrices
+static void consume(struct eval *ev, struct ha_expr *n) {
+  assert(ev);
+  assert(n);
+  assert(n->uses > 0);
+  --n->uses;
+  if (n->uses == 0 && n->value) {
+    spare(ev, n->value);
+    n->value = NULL;
+  }
+}
+
+// flattened(n, top) determines if n is flattened into the form being built,
+//   top being true for the unit the form is for
+// time: O(1)
+static bool flattened(const struct ha_expr *n, bool top) {
+  assert(n);
+  return n->op != OP_MATRIX && (top || n->uses == 1);
+}
+
+// add_factors(f, n, coef, top) appends the factors of the product n to the
+//   last term of f, and multiplies coef by its scalars
+// effects: modifies f and coef
+//          may allocate memory
+// time: O(x * e)
+static void add_factors(struct form *f, struct ha_expr *n,
+                        struct ha_comp *coef, bool top) {
+  assert(f);
+  assert(n);
+  assert(coef);
+  if (flattened(n, top) && n->op == OP_MULT) {
+    add_factors(f, n->left, coef, false);
+    add_factors(f, n->right, coef, false);
+  } else if (flattened(n, top) && n->op == OP_SCALE) {
+    ha_comp_mult_into(coef, coef, &n->k);
+    add_factors(f, n->left, coef, false);
+  } else {
+    f->factors[f->factor_count++] = n;
+  }
+}
+
+// add_terms(f, n, coef, top) appends the terms of coef * n to f
+// effects: modifies f
+//          may allocate memory
+// time: O(x * e)
+static void add_terms(struct form *f, struct ha_expr *n,
+                      const struct ha_comp *coef, bool top) {
+  assert(f);
+  assert(n);
+  assert(coef);
+  if (flattened(n, top) && n->op != OP_MULT) {
+    if (n->op == OP_SCALE) {
+      struct ha_comp scaled;
+      ha_comp_init(&scaled, NULL);
+      ha_comp_mult_into(&scaled, coef, &n->k);
+      add_terms(f, n->left, &scaled, false);
+      ha_comp_clear(&scaled);
+      return;
+    }
+    add_terms(f, n->left, coef, false);
+    if (n->op == OP_ADD) {
+      add_terms(f, n->right, coef, false);
+    } else {
+      struct ha_comp negated;
+      ha_comp_init(&negated, NULL);
+      ha_comp_sub_into(&negated, ha_comp_constant(0), coef);
+      add_terms(f, n->right, &negated, false);
+      ha_comp_clear(&negated);
+    }
+    return;
+  }
+  struct term *t = &f->terms[f->term_count++];
+  ha_comp_init(&t->coef, NULL);
+  ha_comp_set(&t->coef, coef);
+  t->first = f->factor_count;
+  t->value = NULL;
+  t->owned = false;
+  add_factors(f, n, &t->coef, top);
+  t->count = f->factor_count - t->first;
+}
+
+// same_factors(f, t, u) determines if the terms t and u of f have the same
+//   factors in the same order
+// time: O(x)
+static bool same_factors(const struct form *f, const struct term *t,
+                         const struct term *u) {
+  assert(f);
+  assert(t);
+  assert(u);
+  return t->count == u->count &&
+         !memcmp(&f->factors[t->first], &f->factors[u->first],
+                 t->count * sizeof(struct ha_expr *));
+}
+
+// drop_term(ev, f, t) drops the term t of f, consuming its factors
+// effects: modifies f and ev
+//          may allocate memory
+// time: O(x * s), where s is the number of spare matrices
+static void drop_term(struct eval *ev, struct form *f, struct term *t) {
+  assert(ev);
+  assert(f);
+  assert(t);
+  for (int i = 0; i < t->count; ++i) {
+    consume(ev, f->factors[t->first + i]);
+  }
+  t->count = 0;
+}
+
+// merge_terms(ev, f) adds up the coefficients of the terms of f with the
+//   same factors, and drops the terms whose coefficient is 0
+// effects: modifies f and ev
+//          may allocate memory
+// time: O(x^3 + x * e)
+static void merge_terms(struct eval *ev, struct form *f) {
+  assert(ev);
+  assert(f);
+  for (int i = 0; i < f->term_count; ++i) {
+    struct term *t = &f->terms[i];
+    for (int j = 0; j < i && t->count; ++j) {
+      struct term *u = &f->terms[j];
+      if (u->count && same_factors(f, t, u)) {
+        ha_comp_add_into(&u->coef, &u->coef, &t->coef);
+        drop_term(ev, f, t);
+      }
+    }
+  }
+  for (int i = 0; i < f->term_count; ++i) {
+    struct term *t = &f->terms[i];
+    if (t->count && ha_comp_is_zero(&t->coef)) {
+      drop_term(ev, f, t);
+    }
+    t->sign = coef_sign(&t->coef);
+  }
+}
+
+// entry_cost(x, y) gives the cost of multiplying an entry of x bits by one of
+//   y bits and adding the product to a sum, in limb operations
+// time: O(1)
+static double entry_cost(double x, double y) {
+  const double x_limbs = x / LIMB_BITS + 1;
+  const double y_limbs = y / LIMB_BITS + 1;
+  return x_limbs * y_limbs + x_limbs + y_limbs;
+}
+
+// mult_range(ev, factors, split, k, i, j, owned) gives the product of
+//   factors[i..j], multiplied in the order of split, and sets owned to
+//   whether the result is an intermediate matrix of ev
+// requires: split[i * k + j] is the last factor of the left half of the
+//             product of factors[i..j], for all i < j
+// effects: modifies ev and owned
+//          may allocate memory
+// time: the time of the products
+static struct ha_matrix *mult_range(struct eval *ev,
+                                    struct ha_expr *const *factors,
+                                    const int *split, int k, int i, int j,
+                                    bool *owned) {
+  assert(ev);
+  assert(factors);
+  assert(split);
+  assert(owned);
+  if (i == j) {
+    *owned = false;
+    return (struct ha_matrix *)value_of(factors[i]);
+  }
+  const int s = split[i * k + j];
+  bool left_owned;
+  bool right_owned;
+  struct ha_matrix *left =
+    mult_range(ev, factors, split, k, i, s, &left_owned);
+  struct ha_matrix *right =
+    mult_range(ev, factors, split, k, s + 1, j, &right_owned);
+  struct ha_matrix *product =
+    new_matrix(ev, ha_matrix_rows(left), ha_matrix_cols(right));
+  ha_matrix_mult_into(product, left, right);
+  if (left_owned) {
+    spare(ev, left);
+  }
+  if (right_owned) {
+    spare(ev, right);
+  }
+  *owned = true;
+  return product;
+}
+
+// mult_chain(ev, factors, k) gives the product of factors[0..k), multiplied
+//   in the order of least cost
+// notes: the order is found by the classic dynamic programming over the
+//          ranges of factors, with entry_cost of the estimated bits of the
+//          two halves for every multiplication of entries
+// requires: k >= 2, the values of the factors are computed
+// effects: modifies ev
+//          allocates memory (client must call spare or ha_matrix_destroy)
+// time: O(k^3) plus the time of the products
+static struct ha_matrix *mult_chain(struct eval *ev,
+                                    struct ha_expr *const *factors, int k) {
+  assert(ev);
+  assert(factors);
+  assert(k >= 2);
+  // dims[i] and dims[i + 1] are the numbers of rows and columns of factor i;
+  // bits[i * k + j] and cost[i * k + j] are those of the product of
+  // factors[i..j]
+  int *dims = ha_alloc(NULL, (k + 1) * sizeof(int));
+  int *split = ha_alloc(NULL, k * k * sizeof(int));
+  double *bits = ha_alloc(NULL, k * k * sizeof(double));
+  double *cost = ha_alloc(NULL, k * k * sizeof(double));
+  for (int i = 0; i < k; ++i) {
+    dims[i] = factors[i]->rows;
+    bits[i * k + i] = factors[i]->bits;
+    cost[i * k + i] = 0;
+  }
+  dims[k] = factors[k - 1]->cols;
+  for (int len = 2; len <= k; ++len) {
+    for (int i = 0; i + len <= k; ++i) {
+      const int j = i + len - 1;
+      bits[i * k + j] = bits[i * k + j - 1] + factors[j]->bits +
+                        log2_ceil(dims[j]);
+      cost[i * k + j] = -1;
+      for (int s = i; s < j; ++s) {
+        const double c = cost[i * k + s] + cost[(s + 1) * k + j] +
+                         (double)dims[i] * dims[s + 1] * dims[j + 1] *
+                         entry_cost(bits[i * k + s], bits[(s + 1) * k + j]);
+        if (cost[i * k + j] < 0 || c < cost[i * k + j]) {
+          cost[i * k + j] = c;
+          split[i * k + j] = s;
+        }
+      }
+    }
+  }
+  bool owned;
+  struct ha_matrix *product =
+    mult_range(ev, factors, split, k, 0, k - 1, &owned);
+  assert(owned);
+  ha_release(NULL, dims);
+  ha_release(NULL, split);
+  ha_release(NULL, bits);
+  ha_release(NULL, cost);
+  return product;
+}
+
+// combine(ev, f, rows, cols) gives the sum of the terms of f, whose values
+//   are computed, in one pass over the entries
+// notes: the first term whose value is owned is summed into, if there is
+//          one, and the others owned are spared (but stay marked owned)
+//        the entries are summed with deferred reduction, and reduced once at
+//          the end unless deferred reduction is on for the calling thread
+// effects: modifies ev and f
+//          allocates memory (client must call spare or ha_matrix_destroy)
+// time: O(rows * cols * t * e), where t is the number of terms of f
+static struct ha_matrix *combine(struct eval *ev, struct form *f, int rows,
+                                 int cols) {
+  assert(ev);
+  assert(f);
+  struct term *acc = NULL;
+  int live = 0;
+  for (int i = 0; i < f->term_count; ++i) {
+    struct term *t = &f->terms[i];
+    if (t->count) {
+      ++live;
+      if (!acc && t->owned) {
+        acc = t;
+      }
+    }
+  }
+  if (live == 1 && acc && acc->sign == 1) {
+    return acc->value;
+  }
+
+  struct ha_matrix *result = acc ? acc->value : new_matrix(ev, rows, cols);
+  const bool lazy = ha_frac_set_lazy(true);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      struct ha_comp *x = ha_matrix_at(result, i, j);
+      bool started = acc != NULL;
+      if (acc && acc->sign == -1) {
+        ha_comp_sub_into(x, ha_comp_constant(0), x);
+      } else if (acc && acc->sign == 0) {
+        ha_comp_mult_into(x, &acc->coef, x);
+      } else if (!live) {
+        ha_comp_set(x, ha_comp_constant(0));
+      }
+      for (int l = 0; l < f->term_count; ++l) {
+        const struct term *t = &f->terms[l];
+        if (!t->count || t == acc) {
+          continue;
+        }
+        const struct ha_comp *y = ha_matrix_get(t->value, i, j);
+        if (!started) {
+          if (t->sign == 1) {
+            ha_comp_set(x, y);
+          } else if (t->sign == -1) {
+            ha_comp_sub_into(x, ha_comp_constant(0), y);
+          } else {
+            ha_comp_mult_into(x, &t->coef, y);
+          }
+          started = true;
+        } else if (t->sign == 1) {
+          ha_comp_add_into(x, x, y);
+        } else if (t->sign == -1) {
+          ha_comp_sub_into(x, x, y);
+        } else {
+          ha_comp_fma(x, &t->coef, y);
+        }
+      }
+      if (!lazy) {
+        ha_frac_normalize(&x->real);
+        ha_frac_normalize(&x->ima);
+      }
+    }
+  }
+  ha_frac_set_lazy(lazy);
+
+  for (int l = 0; l < f->term_count; ++l) {
+    struct term *t = &f->terms[l];
+    if (t->count && t->owned && t != acc) {
+      spare(ev, t->value);
+    }
+  }
+  return result;
+}
+
+// eval_node(ev, g, n) computes the value of n, and of the units it depends
+//   on that are not computed yet
+// effects: modifies ev and the nodes n depends on
+//          allocates memory
+// time: the time of the operations of the normal form of n
+static void eval_node(struct eval *ev, const struct ha_expr_graph *g,
+                      struct ha_expr *n) {
+  assert(ev);
+  assert(g);
+  assert(n);
+  if (n->op == OP_MATRIX || n->value) {
+    return;
+  }
+  const int room = 2 * g->count + 1;
+  struct form f = {ha_alloc(NULL, room * sizeof(struct term)), 0,
+                   ha_alloc(NULL, room * sizeof(struct ha_expr *)), 0};
+  add_terms(&f, n, ha_comp_constant(1), true);
+  merge_terms(ev, &f);
+
+  // products first, so that a unit that is also a term on its own may be
+  // summed into once its other uses are done
+  for (int i = 0; i < f.term_count; ++i) {
+    struct term *t = &f.terms[i];
+    struct ha_expr **factors = &f.factors[t->first];
+    for (int j = 0; j < t->count; ++j) {
+      eval_node(ev, g, factors[j]);
+    }
+    if (t->count >= 2) {
+      t->value = mult_chain(ev, factors, t->count);
+      t->owned = true;
+      for (int j = 0; j < t->count; ++j) {
+        consume(ev, factors[j]);
+      }
+    }
+  }
+  for (int i = 0; i < f.term_count; ++i) {
+    struct term *t = &f.terms[i];
+    struct ha_expr *factor = f.factors[t->first];
+    if (t->count != 1) {
+      continue;
+    }
+    if (factor->op != OP_MATRIX && factor->uses == 1) {
+      // the last use of the unit: its value is taken over
+      t->value = factor->value;
+      t->owned = true;
+      factor->value = NULL;
+      factor->uses = 0;
+    } else {
+      t->value = (struct ha_matrix *)value_of(factor);
+    }
+  }
+
+  n->value = combine(ev, &f, n->rows, n->cols);
+  for (int i = 0; i < f.term_count; ++i) {
+    struct term *t = &f.terms[i];
+    if (t->count == 1 && !t->owned) {
+      consume(ev, f.factors[t->first]);
+    }
+    ha_comp_clear(&t->coef);
+  }
+  ha_release(NULL, f.terms);
+  ha_release(NULL, f.factors);
+}
+
+struct ha_matrix *ha_expr_eval(struct ha_expr_graph *g,
+                               const struct ha_expr *n) {
+  assert(g);
+  assert(n);
+  struct ha_expr *root = (struct ha_expr *)n;
+  if (root->op == OP_MATRIX) {
+    return ha_matrix_copy(root->mat);
+  }
+  const int mark = ++g->evals;
+  count_uses(root, mark);
+  struct eval ev = {NULL, 0, 0};
+  eval_node(&ev, g, root);
+  struct ha_matrix *result = root->value;
+  root->value = NULL;
+
+  // units whose terms all cancelled out may keep values they never gave up
+  for (struct ha_expr *node = g->nodes; node; node = node->next) {
+    if (node->mark == mark && node->value) {
+      ha_matrix_destroy(node->value);
+      node->value = NULL;
+    }
+  }
+  for (int i = 0; i < ev.spare_count; ++i) {
+    ha_matrix_destroy(ev.spare[i]);
+  }
+  if (ev.spare) {
+    ha_release(NULL, ev.spare);
+  }
+  return result;
+}
@@ -0,0 +1,121 @@
+#include "high-accuracy-complex.h"
+#include "high-accuracy-matrix.h"
+
+// This module provides lazy matrix expressions: an expression such as
+//   A * B + C * D - E is built as a graph first, and only computed when it is
+//   evaluated, as a whole
+
+// The following applies to all functions:
+// requires: all graph, matrix and number parameters are valid (not NULL)
+
+// Expression parameters may be NULL: a function given a NULL expression
+// returns NULL without printing anything, so that an expression with a size
+// error in it ends up NULL with a single error message.
+
+// Evaluation: ha_expr_eval puts the graph in a normal form before computing
+// anything:
+//   - sums, differences and multiples by scalars are flattened into linear
+//     combinations of terms, which are computed together in one pass over
+//     the entries, with deferred reduction (see ha_frac_set_lazy), instead
+//     of one matrix per operation; like terms are merged
+//   - products are flattened into chains, whose order of multiplication is
+//     chosen by dynamic programming over a cost model that counts the
+//     multiplications of entries and weighs each by the estimated sizes of
+//     its operands
+//   - common subexpressions are shared: building the same operation on the
+//     same operands twice gives the same expression, which is computed once
+//     per evaluation
+//   - intermediate matrices are released as soon as their last use is done,
+//     and reused for later results of the same size
+// Scalars are compared by value, and operands by identity: the same matrix
+// given twice is one expression, two equal matrices are two.
+
+// Graphs: the expressions live in their graph, and are destroyed with it. The
+// matrices of a graph are borrowed: they must not be destroyed or modified
+// until the graph is. A graph must only be used by one thread at a time.
+
+
+struct ha_expr_graph;
+struct ha_expr;
+
+
+// ha_expr_graph_create() creates an empty graph, on the heap
+// effects: allocates memory (client must call ha_expr_graph_destroy)
+// time: O(1)
+struct ha_expr_graph *ha_expr_graph_create(void);
+
+// ha_expr_graph_destroy(g) destroys g and its expressions, but not the
+//   matrices they borrow
+// effects: g and its expressions are no longer valid
+// time: O(x), where x is the number of expressions of g
+void ha_expr_graph_destroy(struct ha_expr_graph *g);
+
+// ha_expr_matrix(g, mat) gives the expression standing for mat
+// notes: mat is borrowed by g, see above
+// effects: may allocate memory
+// time: O(r * c), where r and c are the numbers of rows and columns of mat
+const struct ha_expr *ha_expr_matrix(struct ha_expr_graph *g,
+                                     const struct ha_matrix *mat);
+
+// ha_expr_add(g, n, m) gives the expression n + m, or returns NULL if the
+//   sizes of n and m differ
+// notes: if the sizes differ, an error message is printed
+// requires: n and m are NULL or expressions of g
+// effects: may allocate memory
+//          may produce output (error message)
+// time: O(1)
+const struct ha_expr *ha_expr_add(struct ha_expr_graph *g,
+                                  const struct ha_expr *n,
+                                  const struct ha_expr *m);
+
+// ha_expr_sub(g, n, m) gives the expression n - m, or returns NULL if the
+//   sizes of n and m differ
+// notes: if the sizes differ, an error message is printed
+// requires: n and m are NULL or expressions of g
+// effects: may allocate memory
+//          may produce output (error message)
+// time: O(1)
+const struct ha_expr *ha_expr_sub(struct ha_expr_graph *g,
+                                  const struct ha_expr *n,
+                                  const struct ha_expr *m);
+
+// ha_expr_mult(g, n, m) gives the expression n * m, or returns NULL if the
+//   number of columns of n is not the number of rows of m
+// notes: if the sizes do not match, an error message is printed
+// requires: n and m are NULL or expressions of g
+// effects: may allocate memory
+//          may produce output (error message)
+// time: O(1)
+const struct ha_expr *ha_expr_mult(struct ha_expr_graph *g,
+                                   const struct ha_expr *n,
+                                   const struct ha_expr *m);
+
+// ha_expr_scalar_mult(g, k, n) gives the expression k * n
+// notes: k is copied
+// requires: n is NULL or an expression of g
+// effects: may allocate memory
+// time: O(e), where e is the time of one ha_comp operation on k
+const struct ha_expr *ha_expr_scalar_mult(struct ha_expr_graph *g,
+                                          const struct ha_comp *k,
+                                          const struct ha_expr *n);
+
+// ha_expr_rows(n) gives the number of rows of the value of n
+// requires: n is valid (not NULL)
+// time: O(1)
+int ha_expr_rows(const struct ha_expr *n);
+
+// ha_expr_cols(n) gives the number of columns of the value of n
+// requires: n is valid (not NULL)
+// time: O(1)
+int ha_expr_cols(const struct ha_expr *n);
+
+// ha_expr_eval(g, n) computes the value of n, in the current allocation
+//   context
+// notes: products are computed with ha_matrix_mult_into, so they run on the
+//          current pool
+//        nothing is kept from one evaluation to the next
+// requires: n is an expression of g
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: the time of the operations of the normal form of n, see above
+struct ha_matrix *ha_expr_eval(struct ha_expr_graph *g,
+                               const struct ha_expr *n);
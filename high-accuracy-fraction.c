@@ -1,320 +1,1148 @@
-// This module provides basic calculations for arbitrarily large fractions
-
-// For all program scope functions, see high-accuracy-fraction.h for details
-
-// The following applies to all functions:
-// requires: all parameters are valid (not NULL)
-
-#include <assert.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <stdbool.h>
-#include "high-accuracy-fraction.h"
-#include "high-accuracy-integer.h"
-
-struct ha_frac {
-  bool nega;
-  struct ha_int *nume;
-  struct ha_int *denom;
-};
-
-// ha_int_cmp(n, m) returns 1 is n > m, 0 if n == m, -1 if n < m
-// time: O(logn + logm)
-static int ha_int_cmp(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  if (ha_int_gt(n, m)) {
-    return 1;
-  } else if (ha_int_eq(n, m)) {
-    return 0;
-  } else {
-    return -1;
-  }
-}
-
-// ha_int_sign(n) returns 1 if n is positive, -1 if n is negative, otherwise,
-// returns 0
-// time: O(logn)
-static int ha_int_sign(const struct ha_int *n) {
-  assert(n);
-  struct ha_int *zero = ha_int_create("0");
-  int sign = ha_int_cmp(n, zero);
-  ha_int_destroy(zero);
-  return sign;
-}
-
-// get_gcd(small, big) returns GCD of small and big
-// requires: small > 0
-//           big > 0
-// effects: allocates memory(caller must call ha_int_destroy)
-// time: O(n * logn * logm), where n = big, m = small
-static struct ha_int *get_gcd(struct ha_int *small, struct ha_int *big) {
-  assert(small);
-  assert(big);
-  assert(ha_int_sign(small) > 0);
-  assert(ha_int_sign(big) > 0);
-  struct ha_int *remain = ha_int_remainder(big, small);
-  if (ha_int_sign(remain) == 0) {
-    ha_int_destroy(remain);
-    return ha_int_copy(small);
-  } else {
-    struct ha_int *result = get_gcd(remain, small);
-    ha_int_destroy(remain);
-    return result;
-  }
-}
-
-// posi_copy(n) returns |n|
-// effects: allocates memory(caller must call ha_int_destroy)
-// time: O(logn)
-static struct ha_int *posi_copy(const struct ha_int *n) {
-  assert(n);
-  struct ha_int *cpy = NULL;
-  if (ha_int_sign(n) < 0) {
-    struct ha_int *zero = ha_int_create("0");
-    cpy = ha_int_sub(zero, n);
-    ha_int_destroy(zero);
-  } else {
-    cpy = ha_int_copy(n);
-  }
-  return cpy;
-}
-
-// ha_frac_reduc(nume, denom) returns reduction of nume/denom
-// requires: denom != 0
-// effects: allocates memory(caller must call ha_frac_destroy)
-// time: O(n * logn * logm), where n = nume, m = denom; or n = denom, m = nume
-static struct ha_frac *ha_frac_reduc(const struct ha_int *nume, 
-                                     const struct ha_int *denom) {
-  assert(nume);
-  assert(denom);
-  assert(ha_int_sign(denom));
-  struct ha_frac *result = malloc(sizeof(struct ha_frac));
-  int n_sign = ha_int_sign(nume);
-  int d_sign = ha_int_sign(denom);
-  if (n_sign == 0) {
-    result->nega = false;
-    result->nume = ha_int_create("0");
-    result->denom = ha_int_create("1");
-  } else {
-    if ((n_sign > 0 && d_sign > 0) || (n_sign < 0 && d_sign < 0)){
-      result->nega = false;
-    } else {
-      result->nega = true;
-    }
-    struct ha_int *n_cpy = posi_copy(nume);
-    struct ha_int *d_cpy = posi_copy(denom);
-    int cmp = ha_int_cmp(n_cpy, d_cpy);
-    if (cmp == 0) {
-      result->nume = ha_int_create("1");
-      result->denom = ha_int_create("1");
-    } else {
-      struct ha_int *gcd = NULL;
-      if (cmp == 1) {
-        gcd = get_gcd(d_cpy, n_cpy);
-      } else {
-        gcd = get_gcd(n_cpy, d_cpy);
-      }
-      result->nume = ha_int_quotient(n_cpy, gcd);
-      result->denom = ha_int_quotient(d_cpy, gcd);
-      ha_int_destroy(gcd);
-    }
-    ha_int_destroy(n_cpy);
-    ha_int_destroy(d_cpy);
-  }
-  return result;
-}
-
-struct ha_frac *ha_frac_create(const char *numerator, const char *denominator) {
-  struct ha_int *nume = ha_int_create(numerator);
-  struct ha_int *denom = ha_int_create(denominator);
-  if (nume == NULL || denom == NULL || ha_int_sign(denom) == 0) {
-    printf("ERROR: %s/%s is an invalid fraction\n", numerator, denominator);
-    ha_int_destroy(nume);
-    ha_int_destroy(denom);
-    return NULL;
-  } else {
-    struct ha_frac *result = ha_frac_reduc(nume, denom);
-    ha_int_destroy(nume);
-    ha_int_destroy(denom);
-    return result;
-  }
-}
-
-void ha_frac_destroy(struct ha_frac *num) {
-  assert(num);
-  ha_int_destroy(num->nume);
-  ha_int_destroy(num->denom);
-  free(num);
-}
-
-void ha_frac_print(const struct ha_frac *num, bool newline) {
-  assert(num);
-  char *num_str = ha_frac_to_str(num);
-  printf("%s", num_str);
-  free(num_str);
-  if (newline) {
-    printf("\n");
-  }
-}
-
-struct ha_frac *ha_frac_copy(const struct ha_frac *num) {
-  assert(num);
-  char *nume = ha_int_to_str(num->nume);
-  char *denom = ha_int_to_str(num->denom);
-  struct ha_frac *result = ha_frac_create(nume, denom);
-  free(nume);
-  free(denom);
-  result->nega = num->nega;
-  return result;
-}
-
-struct ha_frac *ha_frac_add(const struct ha_frac *n, const struct ha_frac *m) {
-  assert(n);
-  assert(m);
-  struct ha_int *new_n_nume = NULL;
-  struct ha_int *new_m_nume = NULL;
-  struct ha_int *new_denom = NULL;
-  int cmp = ha_int_cmp(n->denom, m->denom);
-  if (!cmp) {
-    new_n_nume = ha_int_copy(n->nume);
-    new_m_nume = ha_int_copy(m->nume);
-    new_denom = ha_int_copy(n->denom);
-  } else {
-    struct ha_int *gcd = NULL;
-    if (cmp > 0) {
-      gcd = get_gcd(m->denom, n->denom);
-    } else {
-      gcd = get_gcd(n->denom, m->denom);
-    }
-    struct ha_int *n_mult = ha_int_quotient(m->denom, gcd);
-    struct ha_int *m_mult = ha_int_quotient(n->denom, gcd);
-    ha_int_destroy(gcd);
-    new_n_nume = ha_int_mult(n_mult, n->nume);
-    new_m_nume = ha_int_mult(m_mult, m->nume);
-    new_denom = ha_int_mult(n_mult, n->denom);
-    ha_int_destroy(n_mult);
-    ha_int_destroy(m_mult);
-  }
-  struct ha_int *new_nume = NULL;
-  if ((n->nega && m->nega) || (!n->nega && !m->nega)) {
-    new_nume = ha_int_add(new_n_nume, new_m_nume);
-  } else if (n->nega) {
-    new_nume = ha_int_sub(new_m_nume, new_n_nume);
-  } else {
-    new_nume = ha_int_sub(new_n_nume, new_m_nume);
-  }
-  ha_int_destroy(new_n_nume);
-  ha_int_destroy(new_m_nume);
-  char *new_nume_str = ha_int_to_str(new_nume);
-  char *new_denom_str = ha_int_to_str(new_denom);
-  struct ha_frac *result = ha_frac_create(new_nume_str, new_denom_str);
-  free(new_nume_str);
-  free(new_denom_str);
-  if (n->nega && m->nega) {
-    result->nega = true;
-  }
-  ha_int_destroy(new_nume);
-  ha_int_destroy(new_denom);
-  return result;
-}
-
-struct ha_frac *ha_frac_sub(const struct ha_frac *n, const struct ha_frac *m) {
-  assert(n);
-  assert(m);
-  struct ha_frac *m_cpy = malloc(sizeof(struct ha_frac));
-  m_cpy->nume = ha_int_copy(m->nume);
-  m_cpy->denom = ha_int_copy(m->denom);
-  if (!m->nega) {
-    m_cpy->nega = true;
-  } else {
-    m_cpy->nega = false;
-  }
-  struct ha_frac *result = ha_frac_add(n, m_cpy);
-  ha_frac_destroy(m_cpy);
-  return result; 
-}
-
-struct ha_frac *ha_frac_mult(const struct ha_frac *n, const struct ha_frac *m) {
-  assert(n);
-  assert(m);
-  struct ha_int *new_nume = ha_int_mult(n->nume, m->nume);
-  struct ha_int *new_denom = ha_int_mult(n->denom, m->denom);
-  char *new_nume_str = ha_int_to_str(new_nume);
-  char *new_denom_str = ha_int_to_str(new_denom);
-  struct ha_frac *result = ha_frac_create(new_nume_str, new_denom_str);
-  ha_int_destroy(new_nume);
-  ha_int_destroy(new_denom);
-  free(new_nume_str);
-  free(new_denom_str);
-  if (n->nega == m->nega || ha_int_sign(n->nume) == 0 
-      || ha_int_sign(m->nume) == 0) {
-    result->nega = false;
-  } else {
-    result->nega = true;
-  }
-  return result;
-}
-
-struct ha_frac *ha_frac_div(const struct ha_frac *n, const struct ha_frac *m) {
-  assert(n);
-  assert(m);
-  assert(ha_int_sign(m->nume) != 0);
-  struct ha_frac *m_reci = malloc(sizeof(struct ha_frac)); 
-  m_reci->nume = ha_int_copy(m->denom);
-  m_reci->denom = ha_int_copy(m->nume);
-  m_reci->nega = m->nega;
-  struct ha_frac *result = ha_frac_mult(n, m_reci);
-  ha_frac_destroy(m_reci);
-  return result;
-}
-
-int ha_frac_cmp(const struct ha_frac *n, const struct ha_frac *m) {
-  assert(n);
-  assert(m);
-  struct ha_frac *n_sub_m = ha_frac_sub(n, m);
-  int sign = 1;
-  if (n_sub_m->nega) {
-    sign = -1;
-  } else if (!ha_int_sign(n_sub_m->nume)) {
-    sign = 0;
-  }
-  ha_frac_destroy(n_sub_m);
-  return sign;
-}
-
-bool ha_frac_is_frac(const struct ha_frac *num) {
-  struct ha_int *one = ha_int_create("1");
-  bool is_frac = !ha_int_eq(num->denom, one);
-  ha_int_destroy(one);
-  return is_frac;
-}
-
-char *ha_frac_to_str(const struct ha_frac *num) {
-  assert(num);
-  char *nume = ha_int_to_str(num->nume);
-  char *denom = ha_int_to_str(num->denom);
-  int nume_len = strlen(nume);
-  char *result;
-  if (num->nega) {
-    result = malloc((nume_len + 2) * sizeof(char));
-    result[0] = '-';
-    result[1] = '\0';
-  } else {
-    result = malloc((nume_len + 1) * sizeof(char));
-    result[0] = '\0';
-  }
-  strcat(result, nume);
-  if (strcmp(denom, "1")) {
-    int result_len = strlen(result);
-    result = realloc(result, (result_len + strlen(denom) + 2) * 
-                     sizeof(char));
-    result[result_len] = '/';
-    result[result_len + 1] = '\0';
-    strcat(result, denom);
-  }
-  free(nume);
-  free(denom);
-  return result;
-}
+// This module provides basic calculations for arbitrarily large fractions
+
+// For all program scope functions, see high-accuracy-fraction.h for details
+
+// The following applies to all functions:
+// requires: all parameters are valid (not NULL)
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-stats.h"
+
+// number of scratch integers the arithmetic below needs at the same time
+#define SCRATCH_NUM 6
+
+// per-thread scratch integers, created on first use and reused by every call
+// so that the arithmetic does not allocate once they are big enough; they
+// always live on the heap, since they outlast any arena
+static _Thread_local struct ha_int *scratch_ints[SCRATCH_NUM];
+
+// CONSTANT(k) is the initializer of the constant k of frac_constants
+#define CONSTANT(k) \
+  CONSTANT_FRAC(k, frac_constants[(k) + HA_INT_CONSTANT_MAX])
+
+// the constants of ha_frac_constant, from -HA_INT_CONSTANT_MAX on
+static const struct ha_frac frac_constants[2 * HA_INT_CONSTANT_MAX + 1] = {
+  CONSTANT_TABLE(CONSTANT)
+};
+
+// per-thread switch of the deferred reduction, see ha_frac_set_lazy
+static _Thread_local bool lazy;
+
+// denominator size from which a deferred result is reduced all the same, so
+// that the integers of a long sum do not keep growing (the numerator only
+// grows with it)
+#define LAZY_MAX_LIMBS (256 / LIMB_BITS)
+
+// release_scratch() destroys the scratch integers of the current thread, as
+//   its cleanup (see ha_alloc_on_trim)
+// time: O(SCRATCH_NUM)
+static void release_scratch(void) {
+  for (int i = 0; i < SCRATCH_NUM; ++i) {
+    if (scratch_ints[i]) {
+      ha_int_destroy(scratch_ints[i]);
+      scratch_ints[i] = NULL;
+    }
+  }
+}
+
+// scratch(i) gives the i-th scratch integer of the current thread
+// requires: 0 <= i < SCRATCH_NUM
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1)
+static struct ha_int *scratch(int i) {
+  assert(0 <= i && i < SCRATCH_NUM);
+  if (!scratch_ints[i]) {
+    ha_alloc_on_trim(release_scratch);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    scratch_ints[i] = ha_int_create("0");
+    ha_arena_use(arena);
+  }
+  return scratch_ints[i];
+}
+
+// one() gives the constant 1
+// time: O(1)
+static const struct ha_int *one(void) {
+  return ha_int_constant(1);
+}
+
+// is_one(n) determines if n == 1
+// time: O(1)
+static bool is_one(const struct ha_int *n) {
+  assert(n);
+  return ha_int_eq(n, one());
+}
+
+const struct ha_frac *ha_frac_constant(int k) {
+  assert(-HA_INT_CONSTANT_MAX <= k && k <= HA_INT_CONSTANT_MAX);
+  return &frac_constants[k + HA_INT_CONSTANT_MAX];
+}
+
+void ha_frac_init(struct ha_frac *num, struct ha_arena *arena) {
+  assert(num);
+  num->nega = false;
+  num->reduced = true;
+  ha_int_init(&num->nume, arena);
+  ha_int_init(&num->denom, arena);
+  ha_int_set(&num->denom, one());
+}
+
+void ha_frac_clear(struct ha_frac *num) {
+  assert(num);
+  ha_int_clear(&num->nume);
+  ha_int_clear(&num->denom);
+}
+
+// new_zero() returns a new ha_frac equal to 0 from the current allocation
+//   context
+// effects: allocates memory(caller must call ha_frac_destroy)
+// time: O(1)
+static struct ha_frac *new_zero(void) {
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_frac *result = ha_alloc_node(arena, sizeof(struct ha_frac));
+  ha_frac_init(result, arena);
+  return result;
+}
+
+// div_exact(dst, n, d) sets dst to n / d
+// requires: d divides n, d > 0
+// effects: modifies dst
+// time: O(logd * (logn - logd + 1))
+static void div_exact(struct ha_int *dst, const struct ha_int *n,
+                      const struct ha_int *d) {
+  assert(dst);
+  assert(n);
+  assert(d);
+  if (is_one(d)) {
+    ha_int_set(dst, n);
+  } else {
+    ha_int_divmod_into(dst, NULL, n, d);
+  }
+}
+
+// set_zero(num) sets num to 0
+// effects: modifies num
+// time: O(1)
+static void set_zero(struct ha_frac *num) {
+  assert(num);
+  ha_int_sub_into(&num->nume, &num->nume, &num->nume);
+  ha_int_set(&num->denom, one());
+  num->nega = false;
+  num->reduced = true;
+}
+
+bool ha_frac_set_lazy(bool enable) {
+  const bool previous = lazy;
+  lazy = enable;
+  return previous;
+}
+
+bool ha_frac_lazy(void) {
+  return lazy;
+}
+
+void ha_frac_normalize(struct ha_frac *num) {
+  assert(num);
+  if (num->reduced) {
+    return;
+  }
+  HA_STATS_COUNT(reduce);
+  struct ha_int *gcd = scratch(0);
+  ha_int_gcd_into(gcd, &num->nume, &num->denom);
+  div_exact(&num->nume, &num->nume, gcd);
+  div_exact(&num->denom, &num->denom, gcd);
+  num->reduced = true;
+}
+
+// settle(num) marks num as a result that may not be reduced, and reduces it
+//   unless the deferred reduction lets it stay so
+// notes: uses the scratch integer 0
+// effects: modifies num
+// time: O(log(n1) * log(n2))
+static void settle(struct ha_frac *num) {
+  assert(num);
+  num->reduced = is_one(&num->denom);
+  if (!lazy || num->denom.len > LAZY_MAX_LIMBS) {
+    ha_frac_normalize(num);
+  }
+}
+
+void ha_frac_set_quotient(struct ha_frac *dst, const struct ha_int *nume,
+                          const struct ha_int *denom) {
+  assert(dst);
+  assert(nume);
+  assert(denom);
+  assert(ha_int_sign(denom));
+  const int n_sign = ha_int_sign(nume);
+  const int d_sign = ha_int_sign(denom);
+  if (n_sign == 0) {
+    set_zero(dst);
+    return;
+  }
+  ha_int_set(&dst->nume, nume);
+  ha_int_set(&dst->denom, denom);
+  dst->nega = n_sign != d_sign;
+  if (n_sign < 0) {
+    ha_int_negate(&dst->nume);
+  }
+  if (d_sign < 0) {
+    ha_int_negate(&dst->denom);
+  }
+  settle(dst);
+}
+
+// ha_frac_reduc(nume, denom) returns reduction of nume/denom
+// requires: denom != 0
+// effects: allocates memory(caller must call ha_frac_destroy)
+// time: O(logn * logm), where n = nume, m = denom
+static struct ha_frac *ha_frac_reduc(const struct ha_int *nume,
+                                     const struct ha_int *denom) {
+  assert(nume);
+  assert(denom);
+  struct ha_frac *result = new_zero();
+  ha_frac_set_quotient(result, nume, denom);
+  return result;
+}
+
+struct ha_frac *ha_frac_create(const char *numerator, const char *denominator) {
+  struct ha_int *nume = ha_int_create(numerator);
+  struct ha_int *denom = ha_int_create(denominator);
+  if (nume == NULL || denom == NULL || ha_int_sign(denom) == 0) {
+    printf("ERROR: %s/%s is an invalid fraction\n", numerator, denominator);
+    if (nume) {
+      ha_int_destroy(nume);
+    }
+    if (denom) {
+      ha_int_destroy(denom);
+    }
+    return NULL;
+  } else {
+    struct ha_frac *result = ha_frac_reduc(nume, denom);
+    ha_int_destroy(nume);
+    ha_int_destroy(denom);
+    return result;
+  }
+}
+
+void ha_frac_destroy(struct ha_frac *num) {
+  assert(num);
+  struct ha_arena *arena = num->nume.arena;
+  ha_frac_clear(num);
+  ha_release_node(arena, num, sizeof(struct ha_frac));
+}
+
+void ha_frac_print(const struct ha_frac *num, bool newline) {
+  assert(num);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_frac_write(&buf, num);
+  if (newline) {
+    ha_buffer_putc(&buf, '\n');
+  }
+  ha_buffer_flush(&buf, stdout);
+  ha_buffer_free(&buf);
+}
+
+struct ha_frac *ha_frac_copy(const struct ha_frac *num) {
+  assert(num);
+  struct ha_frac *result = new_zero();
+  ha_frac_set(result, num);
+  return result;
+}
+
+void ha_frac_set(struct ha_frac *dst, const struct ha_frac *num) {
+  assert(dst);
+  assert(num);
+  ha_int_set(&dst->nume, &num->nume);
+  ha_int_set(&dst->denom, &num->denom);
+  dst->nega = num->nega;
+  dst->reduced = num->reduced;
+}
+
+void ha_frac_swap(struct ha_frac *n, struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  ha_int_swap(&n->nume, &m->nume);
+  ha_int_swap(&n->denom, &m->denom);
+  const bool nega = n->nega;
+  const bool reduced = n->reduced;
+  n->nega = m->nega;
+  n->reduced = m->reduced;
+  m->nega = nega;
+  m->reduced = reduced;
+}
+
+// store_sum(dst, nume, denom) sets dst to the fraction nume / denom with the
+//   sign of nume, and leaves the former integers of dst in nume and denom
+// notes: dst->reduced is left to the caller
+// requires: denom > 0
+// effects: modifies dst, nume and denom
+// time: O(1)
+static void store_sum(struct ha_frac *dst, struct ha_int *nume,
+                      struct ha_int *denom) {
+  assert(dst);
+  assert(nume);
+  assert(denom);
+  const int sign = ha_int_sign(nume);
+  if (sign < 0) {
+    ha_int_negate(nume);
+  }
+  ha_int_swap(&dst->nume, nume);
+  ha_int_swap(&dst->denom, denom);
+  dst->nega = sign < 0;
+  if (sign == 0) {
+    ha_int_set(&dst->denom, one());
+  }
+}
+
+// add_unreduced(dst, n, m, m_nega) sets dst to the same sum as add_signed
+//   without any gcd of the operands: (n1 * m2 + m1 * n2) / (n2 * m2), or
+//   (n1 + m1) / n2 if the denominators are equal, which only settle reduces
+// notes: dst may be n or m
+//        uses the scratch integers 0 to 3
+// effects: modifies dst
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+static void add_unreduced(struct ha_frac *dst, const struct ha_frac *n,
+                          const struct ha_frac *m, bool m_nega) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  struct ha_int *nume = scratch(1);
+  struct ha_int *term = scratch(2);
+  struct ha_int *denom = scratch(3);
+  if (ha_int_eq(&n->denom, &m->denom)) { // the common case in a long sum
+    ha_int_set(nume, &n->nume);
+    ha_int_set(term, &m->nume);
+    ha_int_set(denom, &n->denom);
+  } else {
+    ha_int_mult_into(nume, &n->nume, &m->denom);
+    ha_int_mult_into(term, &m->nume, &n->denom);
+    ha_int_mult_into(denom, &n->denom, &m->denom);
+  }
+  if (n->nega) {
+    ha_int_negate(nume);
+  }
+  if (m_nega) {
+    ha_int_negate(term);
+  }
+  ha_int_add_into(nume, nume, term);
+  store_sum(dst, nume, denom);
+  settle(dst);
+}
+
+// add_signed(dst, n, m, m_nega) sets dst to n + m if m_nega is m->nega, or
+//   to n - m otherwise
+// notes: dst may be n or m
+//        with deferred reduction, or if an operand is not reduced, the sum is
+//          left to add_unreduced
+//        uses the scratch integers 0 to 4
+// effects: modifies dst
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+static void add_signed(struct ha_frac *dst, const struct ha_frac *n,
+                       const struct ha_frac *m, bool m_nega) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  const bool n_nega = n->nega;
+  if (ha_int_sign(&m->nume) == 0) {
+    ha_frac_set(dst, n);
+    return;
+  } else if (ha_int_sign(&n->nume) == 0) {
+    ha_frac_set(dst, m);
+    dst->nega = m_nega;
+    return;
+  } else if (lazy || !n->reduced || !m->reduced) {
+    add_unreduced(dst, n, m, m_nega);
+    return;
+  }
+
+  // n1/n2 + m1/m2 with g = gcd(n2, m2) (Henrici): the sum is
+  // (n1 * (m2/g) + m1 * (n2/g)) / (n2/g * m2), and only the gcd of the new
+  // numerator and g can still be cancelled
+  struct ha_int *gcd = scratch(0);
+  struct ha_int *nume = scratch(1);
+  struct ha_int *term = scratch(2);
+  struct ha_int *denom = scratch(3);
+  struct ha_int *temp = scratch(4);
+  ha_int_gcd_into(gcd, &n->denom, &m->denom);
+  if (is_one(gcd)) { // the result is already reduced
+    ha_int_mult_into(nume, &n->nume, &m->denom);
+    ha_int_mult_into(term, &m->nume, &n->denom);
+    ha_int_mult_into(denom, &n->denom, &m->denom);
+  } else {
+    ha_int_divmod_into(denom, NULL, &n->denom, gcd); // n2/g
+    ha_int_divmod_into(temp, NULL, &m->denom, gcd); // m2/g
+    ha_int_mult_into(nume, &n->nume, temp);
+    ha_int_mult_into(term, &m->nume, denom);
+  }
+  if (n_nega) {
+    ha_int_negate(nume);
+  }
+  if (m_nega) {
+    ha_int_negate(term);
+  }
+  ha_int_add_into(nume, nume, term);
+  if (!is_one(gcd)) {
+    ha_int_gcd_into(gcd, nume, gcd);
+    div_exact(nume, nume, gcd);
+    div_exact(temp, &m->denom, gcd); // m2/gcd(nume, g)
+    ha_int_mult_into(denom, denom, temp);
+  }
+  store_sum(dst, nume, denom);
+  dst->reduced = true;
+}
+
+void ha_frac_add_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  add_signed(dst, n, m, m->nega);
+}
+
+void ha_frac_sub_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  add_signed(dst, n, m, !m->nega && ha_int_sign(&m->nume) != 0);
+}
+
+// mult_signed(dst, n, m, reciprocal) sets dst to n * m, or to n / m if
+//   reciprocal is true
+// requires: m is not 0 if reciprocal is true
+// notes: dst may be n or m
+//        with deferred reduction, or if an operand is not reduced, the parts
+//          are multiplied without cancelling and only settle reduces them
+//        uses the scratch integers 0 to 5
+// effects: modifies dst
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+static void mult_signed(struct ha_frac *dst, const struct ha_frac *n,
+                        const struct ha_frac *m, bool reciprocal) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  const struct ha_int *m_nume = reciprocal ? &m->denom : &m->nume;
+  const struct ha_int *m_denom = reciprocal ? &m->nume : &m->denom;
+  assert(ha_int_sign(m_denom) != 0);
+  const bool nega = n->nega != m->nega;
+  if (ha_int_sign(&n->nume) == 0 || ha_int_sign(m_nume) == 0) {
+    set_zero(dst);
+    return;
+  } else if (lazy || !n->reduced || !m->reduced) {
+    struct ha_int *nume = scratch(1);
+    struct ha_int *denom = scratch(2);
+    ha_int_mult_into(nume, &n->nume, m_nume);
+    ha_int_mult_into(denom, &n->denom, m_denom);
+    ha_int_swap(&dst->nume, nume);
+    ha_int_swap(&dst->denom, denom);
+    dst->nega = nega;
+    settle(dst);
+    return;
+  }
+
+  // cancel across before multiplying: the products of the reduced parts are
+  // coprime, so the result needs no further reduction
+  struct ha_int *gcd_1 = scratch(0); // gcd(n1, m2)
+  struct ha_int *gcd_2 = scratch(1); // gcd(m1, n2)
+  struct ha_int *nume = scratch(2);
+  struct ha_int *nume_2 = scratch(3);
+  struct ha_int *denom = scratch(4);
+  struct ha_int *denom_2 = scratch(5);
+  ha_int_gcd_into(gcd_1, &n->nume, m_denom);
+  ha_int_gcd_into(gcd_2, m_nume, &n->denom);
+  div_exact(nume, &n->nume, gcd_1);
+  div_exact(nume_2, m_nume, gcd_2);
+  div_exact(denom, &n->denom, gcd_2);
+  div_exact(denom_2, m_denom, gcd_1);
+  ha_int_mult_into(nume, nume, nume_2);
+  ha_int_mult_into(denom, denom, denom_2);
+  ha_int_swap(&dst->nume, nume);
+  ha_int_swap(&dst->denom, denom);
+  dst->nega = nega;
+  dst->reduced = true;
+}
+
+void ha_frac_mult_into(struct ha_frac *dst, const struct ha_frac *n,
+                       const struct ha_frac *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  mult_signed(dst, n, m, false);
+}
+
+void ha_frac_div_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  assert(ha_int_sign(&m->nume) != 0);
+  mult_signed(dst, n, m, true);
+}
+
+// per-thread scratch fraction holding the product in ha_frac_addmul and
+// ha_frac_submul, on the heap like the scratch integers
+static _Thread_local struct ha_frac *scratch_product;
+
+// release_product() destroys the scratch fraction of the current thread, as
+//   its cleanup (see ha_alloc_on_trim)
+// time: O(1)
+static void release_product(void) {
+  ha_frac_destroy(scratch_product);
+  scratch_product = NULL;
+}
+
+// product_scratch() gives the scratch fraction of the current thread
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1)
+static struct ha_frac *product_scratch(void) {
+  if (!scratch_product) {
+    ha_alloc_on_trim(release_product);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    scratch_product = ha_frac_create("0", "1");
+    ha_arena_use(arena);
+  }
+  return scratch_product;
+}
+
+void ha_frac_addmul(struct ha_frac *acc, const struct ha_frac *n,
+                    const struct ha_frac *m) {
+  assert(acc);
+  assert(n);
+  assert(m);
+  struct ha_frac *product = product_scratch();
+  mult_signed(product, n, m, false);
+  add_signed(acc, acc, product, product->nega);
+}
+
+void ha_frac_submul(struct ha_frac *acc, const struct ha_frac *n,
+                    const struct ha_frac *m) {
+  assert(acc);
+  assert(n);
+  assert(m);
+  struct ha_frac *product = product_scratch();
+  mult_signed(product, n, m, false);
+  add_signed(acc, acc, product,
+             !product->nega && ha_int_sign(&product->nume) != 0);
+}
+
+struct ha_frac *ha_frac_add(const struct ha_frac *n, const struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  struct ha_frac *result = new_zero();
+  ha_frac_add_into(result, n, m);
+  return result;
+}
+
+struct ha_frac *ha_frac_sub(const struct ha_frac *n, const struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  struct ha_frac *result = new_zero();
+  ha_frac_sub_into(result, n, m);
+  return result;
+}
+
+struct ha_frac *ha_frac_mult(const struct ha_frac *n, const struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  struct ha_frac *result = new_zero();
+  ha_frac_mult_into(result, n, m);
+  return result;
+}
+
+struct ha_frac *ha_frac_div(const struct ha_frac *n, const struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  assert(ha_int_sign(&m->nume) != 0);
+  struct ha_frac *result = new_zero();
+  ha_frac_div_into(result, n, m);
+  return result;
+}
+
+// Estimates: the estimate of an integer is its leading ESTIMATE_LIMBS limbs
+//   as a double d and the number of limbs e below them, so that it is
+//   d * 2^(e * LIMB_BITS) with 1 <= d < 2^(ESTIMATE_LIMBS * LIMB_BITS),
+//   which keeps integers of any size within the range of doubles. Each
+//   addition to d rounds once, and so does the conversion of each limb when
+//   limbs are wider than the 53 bits of a double (-DHA_INT_LIMB_BITS=64),
+//   so d is within 2 * ESTIMATE_LIMBS * 2^-53 of the leading limbs. The
+//   limbs left out weigh less than 2^-((ESTIMATE_LIMBS - 1) * LIMB_BITS) of
+//   d, and the quotient of two such doubles rounds once more, which keeps
+//   the estimate of a fraction within 2^-49 of it.
+
+// number of leading limbs an estimate is made of
+#define ESTIMATE_LIMBS 3
+
+// the value of one limb as a double, 2^LIMB_BITS
+#define LIMB_RADIX ((double)((ha_dlimb)1 << LIMB_BITS))
+
+// bound on the relative error of the estimate of a fraction, twice the one
+// above
+#define ESTIMATE_ERROR (1.0 / (1 << 24) / (1 << 24)) // 2^-48
+
+// estimate(num, exp) gives a double q and sets exp so that
+//   |num| = q * 2^(exp * LIMB_BITS), within a relative error of
+//   ESTIMATE_ERROR, where 2^-(ESTIMATE_LIMBS * LIMB_BITS) < q <
+//   2^(ESTIMATE_LIMBS * LIMB_BITS)
+// requires: num != 0
+// effects: modifies exp
+// time: O(1)
+static double estimate(const struct ha_frac *num, int *exp) {
+  assert(num);
+  assert(exp);
+  const struct ha_int *parts[2] = {&num->nume, &num->denom};
+  double d[2];
+  int e[2];
+  for (int k = 0; k < 2; ++k) {
+    const struct ha_int *n = parts[k];
+    assert(n->len > 0);
+    d[k] = 0;
+    int i = n->len - 1;
+    for (; i >= 0 && i >= n->len - ESTIMATE_LIMBS; --i) {
+      d[k] = d[k] * LIMB_RADIX + (double)n->limbs[i];
+    }
+    e[k] = i + 1;
+  }
+  *exp = e[0] - e[1];
+  return d[0] / d[1];
+}
+
+// scale(x, exp) gives x * 2^(exp * LIMB_BITS), infinity or 0 once out of the
+//   range of doubles
+// requires: x > 0
+// time: O(1), as x leaves the range of doubles within 2200 / LIMB_BITS steps
+static double scale(double x, int exp) {
+  for (; exp > 0 && x - x == 0; --exp) { // x - x is NaN once x is infinity
+    x *= LIMB_RADIX;
+  }
+  for (; exp < 0 && x > 0; ++exp) {
+    x /= LIMB_RADIX;
+  }
+  return x;
+}
+
+// cmp_estimates(n, m) compares |n| and |m| by their estimates: it returns 1
+//   if |n| > |m|, -1 if |n| < |m|, and 0 if the estimates are too close to
+//   tell
+// requires: n != 0, m != 0
+// time: O(1)
+static int cmp_estimates(const struct ha_frac *n, const struct ha_frac *m) {
+  int n_exp = 0;
+  int m_exp = 0;
+  double x = estimate(n, &n_exp);
+  double y = estimate(m, &m_exp);
+  // both are between 2^-(3 * LIMB_BITS) and 2^(3 * LIMB_BITS)
+  const int apart = 2 * ESTIMATE_LIMBS;
+  if (n_exp - m_exp >= apart) {
+    return 1;
+  } else if (m_exp - n_exp >= apart) {
+    return -1;
+  }
+  // bring both to the same scale, exactly (doubles go past 2^1000)
+  for (; n_exp > m_exp; --n_exp) {
+    x *= LIMB_RADIX;
+  }
+  for (; m_exp > n_exp; --m_exp) {
+    y *= LIMB_RADIX;
+  }
+  if (x > y * (1 + 2 * ESTIMATE_ERROR)) {
+    return 1;
+  } else if (y > x * (1 + 2 * ESTIMATE_ERROR)) {
+    return -1;
+  }
+  return 0;
+}
+
+int ha_frac_cmp(const struct ha_frac *n, const struct ha_frac *m) {
+  assert(n);
+  assert(m);
+  // 0 is never negative, so different signs decide at once
+  if (n->nega != m->nega) {
+    return n->nega ? -1 : 1;
+  }
+  const int polarity = n->nega ? -1 : 1;
+  const bool n_zero = n->nume.len == 0;
+  const bool m_zero = m->nume.len == 0;
+  if (n_zero || m_zero) {
+    return polarity * (!n_zero - !m_zero);
+  }
+
+  // the estimates settle all but the (nearly) equal fractions
+  const int estimated = cmp_estimates(n, m);
+  if (estimated) {
+    return polarity * estimated;
+  }
+  const struct ha_int *parts[4] = {&n->nume, &n->denom, &m->nume, &m->denom};
+  bool words = true;
+  for (int i = 0; i < 4; ++i) {
+    words = words && parts[i]->len == 1;
+  }
+  if (words) { // exact on double limbs
+    const ha_dlimb left = (ha_dlimb)n->nume.limbs[0] * m->denom.limbs[0];
+    const ha_dlimb right = (ha_dlimb)m->nume.limbs[0] * n->denom.limbs[0];
+    return polarity * ((left > right) - (left < right));
+  } else if (n->reduced && m->reduced && ha_int_eq(&n->nume, &m->nume) &&
+             ha_int_eq(&n->denom, &m->denom)) {
+    return 0;
+  }
+
+  // compare n1 * m2 with m1 * n2
+  HA_STATS_COUNT(compare_exact);
+  struct ha_int *left = scratch(0);
+  struct ha_int *right = scratch(1);
+  ha_int_mult_into(left, &n->nume, &m->denom);
+  ha_int_mult_into(right, &m->nume, &n->denom);
+  int sign = 0;
+  if (ha_int_gt(left, right)) {
+    sign = 1;
+  } else if (ha_int_gt(right, left)) {
+    sign = -1;
+  }
+  return polarity * sign;
+}
+
+double ha_frac_approx(const struct ha_frac *num) {
+  assert(num);
+  if (num->nume.len == 0) {
+    return 0;
+  }
+  int exp = 0;
+  const double q = estimate(num, &exp);
+  const double x = scale(q, exp);
+  return num->nega ? -x : x;
+}
+
+int ha_frac_sign(const struct ha_frac *num) {
+  assert(num);
+  if (ha_int_sign(&num->nume) == 0) {
+    return 0;
+  }
+  return num->nega ? -1 : 1;
+}
+
+bool ha_frac_is_one(const struct ha_frac *num) {
+  assert(num);
+  if (num->nega) {
+    return false;
+  }
+  if (num->reduced) {
+    return is_one(&num->nume) && is_one(&num->denom);
+  }
+  return ha_int_eq(&num->nume, &num->denom);
+}
+
+bool ha_frac_is_frac(const struct ha_frac *num) {
+  assert(num);
+  if (num->reduced) {
+    return !is_one(&num->denom);
+  }
+  struct ha_int *remainder = scratch(0);
+  ha_int_divmod_into(NULL, remainder, &num->nume, &num->denom);
+  return ha_int_sign(remainder) != 0;
+}
+
+void ha_frac_write(struct ha_buffer *buf, const struct ha_frac *num) {
+  assert(buf);
+  assert(num);
+  const struct ha_int *lowest_nume = &num->nume;
+  const struct ha_int *lowest_denom = &num->denom;
+  if (!num->reduced) { // written in lowest terms all the same
+    HA_STATS_COUNT(reduce);
+    struct ha_int *gcd = scratch(0);
+    ha_int_gcd_into(gcd, &num->nume, &num->denom);
+    div_exact(scratch(1), &num->nume, gcd);
+    div_exact(scratch(2), &num->denom, gcd);
+    lowest_nume = scratch(1);
+    lowest_denom = scratch(2);
+  }
+  if (num->nega) {
+    ha_buffer_putc(buf, '-');
+  }
+  ha_int_write(buf, lowest_nume);
+  if (!is_one(lowest_denom)) {
+    ha_buffer_putc(buf, '/');
+    ha_int_write(buf, lowest_denom);
+  }
+}
+
+char *ha_frac_to_str(const struct ha_frac *num) {
+  assert(num);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_frac_write(&buf, num);
+  return ha_buffer_release(&buf);
+}
+
+
+// Batches
+
+
+struct ha_frac_batch {
+  int count;
+  struct ha_arena *arena; // context of the struct, its arrays and integers
+  bool *nega; // the fields of struct ha_frac, one array each
+  bool *reduced;
+  struct ha_int *nume;
+  struct ha_int *denom;
+};
+
+// number of positions the word kernels work on at a time
+#define BATCH_CHUNK 256
+
+// bound (excluded) of the parts the word kernels take: the product of two
+// parts, and the sum of two such products, fit in an int64_t
+#define WORD_BOUND ((int64_t)1 << 31)
+
+// operations of the batch functions
+enum batch_op { BATCH_ADD, BATCH_SUB, BATCH_MULT };
+
+// per-thread scratch fractions of the positions that do not fit in words, on
+// the heap like the scratch integers
+static _Thread_local struct ha_frac *scratch_batch[3];
+
+// release_batch_scratch() destroys the scratch fractions of the batch
+//   functions of the current thread, as its cleanup (see ha_alloc_on_trim)
+// time: O(1)
+static void release_batch_scratch(void) {
+  for (int i = 0; i < 3; ++i) {
+    if (scratch_batch[i]) {
+      ha_frac_destroy(scratch_batch[i]);
+      scratch_batch[i] = NULL;
+    }
+  }
+}
+
+// batch_scratch(i) gives the i-th scratch fraction of the batch functions of
+//   the current thread
+// requires: 0 <= i < 3
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(1)
+static struct ha_frac *batch_scratch(int i) {
+  assert(0 <= i && i < 3);
+  if (!scratch_batch[i]) {
+    ha_alloc_on_trim(release_batch_scratch);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    scratch_batch[i] = ha_frac_create("0", "1");
+    ha_arena_use(arena);
+  }
+  return scratch_batch[i];
+}
+
+struct ha_frac_batch *ha_frac_batch_create(int count) {
+  assert(count > 0);
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_frac_batch *batch = ha_alloc(arena, sizeof(struct ha_frac_batch));
+  batch->count = count;
+  batch->arena = arena;
+  batch->nega = ha_alloc(arena, count * sizeof(bool));
+  batch->reduced = ha_alloc(arena, count * sizeof(bool));
+  batch->nume = ha_alloc(arena, count * sizeof(struct ha_int));
+  batch->denom = ha_alloc(arena, count * sizeof(struct ha_int));
+  for (int i = 0; i < count; ++i) {
+    batch->nega[i] = false;
+    batch->reduced[i] = true;
+    ha_int_init(&batch->nume[i], arena);
+    ha_int_init(&batch->denom[i], arena);
+    ha_int_set_word(&batch->denom[i], 1);
+  }
+  return batch;
+}
+
+void ha_frac_batch_destroy(struct ha_frac_batch *batch) {
+  assert(batch);
+  for (int i = 0; i < batch->count; ++i) {
+    ha_int_clear(&batch->nume[i]);
+    ha_int_clear(&batch->denom[i]);
+  }
+  ha_release(batch->arena, batch->nega);
+  ha_release(batch->arena, batch->reduced);
+  ha_release(batch->arena, batch->nume);
+  ha_release(batch->arena, batch->denom);
+  ha_release(batch->arena, batch);
+}
+
+int ha_frac_batch_size(const struct ha_frac_batch *batch) {
+  assert(batch);
+  return batch->count;
+}
+
+bool ha_frac_batch_is_zero(const struct ha_frac_batch *batch) {
+  assert(batch);
+  for (int i = 0; i < batch->count; ++i) {
+    if (batch->nume[i].len != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ha_frac_batch_get(const struct ha_frac_batch *batch, int i,
+                       struct ha_frac *dst) {
+  assert(batch);
+  assert(0 <= i && i < batch->count);
+  assert(dst);
+  ha_int_set(&dst->nume, &batch->nume[i]);
+  ha_int_set(&dst->denom, &batch->denom[i]);
+  dst->nega = batch->nega[i];
+  dst->reduced = batch->reduced[i];
+}
+
+void ha_frac_batch_set(struct ha_frac_batch *batch, int i,
+                       const struct ha_frac *num) {
+  assert(batch);
+  assert(0 <= i && i < batch->count);
+  assert(num);
+  ha_int_set(&batch->nume[i], &num->nume);
+  ha_int_set(&batch->denom[i], &num->denom);
+  batch->nega[i] = num->nega;
+  batch->reduced[i] = num->reduced;
+}
+
+// get_word(n, x) sets x to n and returns true if n < WORD_BOUND, and returns
+//   false otherwise
+// requires: n >= 0
+// effects: may modify x
+// time: O(1)
+static bool get_word(const struct ha_int *n, int64_t *x) {
+  assert(n);
+  assert(x);
+  if (n->len == 0) {
+    *x = 0;
+    return true;
+  } else if (n->len == 1 && n->limbs[0] < WORD_BOUND) {
+    *x = (int64_t)n->limbs[0];
+    return true;
+  }
+  return false;
+}
+
+// load_words(batch, i, nume, denom) sets nume and denom to the signed
+//   numerator and the denominator of the fraction of batch at i, and returns
+//   true if they both fit in words (see get_word)
+// effects: may modify nume and denom
+// time: O(1)
+static bool load_words(const struct ha_frac_batch *batch, int i,
+                       int64_t *nume, int64_t *denom) {
+  assert(batch);
+  if (!get_word(&batch->nume[i], nume) || !get_word(&batch->denom[i], denom)) {
+    return false;
+  }
+  if (batch->nega[i]) {
+    *nume = -*nume;
+  }
+  return true;
+}
+
+// word_gcd(u, v) gives gcd(u, v) with Euclid's algorithm on machine words
+// time: O(1)
+static uint64_t word_gcd(uint64_t u, uint64_t v) {
+  while (v) {
+    const uint64_t r = u % v;
+    u = v;
+    v = r;
+  }
+  return u;
+}
+
+// what is left to reduce a result of the word kernels, see store_words
+enum word_reduction {
+  WORD_LAZY, // nothing, the reduction is deferred
+  WORD_REDUCED, // nothing, the parts were cancelled beforehand
+  WORD_COMMON, // the gcd of the numerator and the common factor g
+  WORD_FULL // the gcd of the numerator and the denominator
+};
+
+// store_words(batch, i, nume, denom, reduction, g) sets the fraction of batch
+//   at i to nume / denom, reduced as reduction says
+// requires: denom > 0
+// effects: modifies batch
+// time: O(1)
+static void store_words(struct ha_frac_batch *batch, int i, int64_t nume,
+                        int64_t denom, enum word_reduction reduction,
+                        int64_t g) {
+  assert(batch);
+  assert(denom > 0);
+  uint64_t magnitude = nume < 0 ? -(uint64_t)nume : (uint64_t)nume;
+  uint64_t positive = (uint64_t)denom;
+  if (magnitude == 0) {
+    positive = 1;
+  } else if (reduction == WORD_COMMON || reduction == WORD_FULL) {
+    const uint64_t gcd = word_gcd(reduction == WORD_COMMON ? (uint64_t)g :
+                                  positive, magnitude);
+    magnitude /= gcd;
+    positive /= gcd;
+  }
+  ha_int_set_word(&batch->nume[i], magnitude);
+  ha_int_set_word(&batch->denom[i], positive);
+  batch->nega[i] = nume < 0;
+  batch->reduced[i] = reduction != WORD_LAZY || positive == 1;
+}
+
+// batch_one(dst, n, m, i, op) applies op to the fractions of n and m at i,
+//   with the scalar functions, and puts the result in dst at i
+// notes: uses the scratch fractions of the batch functions
+// effects: modifies dst
+//          may allocate memory
+// time: the time of the scalar function
+static void batch_one(struct ha_frac_batch *dst, const struct ha_frac_batch *n,
+                      const struct ha_frac_batch *m, int i, enum batch_op op) {
+  struct ha_frac *x = batch_scratch(0);
+  struct ha_frac *y = batch_scratch(1);
+  struct ha_frac *result = batch_scratch(2);
+  ha_frac_batch_get(n, i, x);
+  ha_frac_batch_get(m, i, y);
+  if (op == BATCH_ADD) {
+    ha_frac_add_into(result, x, y);
+  } else if (op == BATCH_SUB) {
+    ha_frac_sub_into(result, x, y);
+  } else {
+    ha_frac_mult_into(result, x, y);
+  }
+  ha_int_swap(&dst->nume[i], &result->nume);
+  ha_int_swap(&dst->denom[i], &result->denom);
+  dst->nega[i] = result->nega;
+  dst->reduced[i] = result->reduced;
+}
+
+// prepare_words(n1, n2, m1, m2, g, op, reduced) cancels what can be cancelled
+//   of the operands n1/n2 and m1/m2 of op before the word kernel, as the
+//   scalar functions do, and returns what is left to reduce the result; for
+//   a sum, g is set to the common factor of n2 and m2 that the kernel divides
+//   out of the denominator (1 for a product)
+// notes: reduced tells if both operands are reduced, which the cancellation
+//          needs; otherwise the result is reduced as a whole
+// requires: |n1|, n2, |m1|, m2 < WORD_BOUND, n2, m2 > 0
+// effects: may modify n1, n2, m1, m2 and g
+// time: O(1)
+static enum word_reduction prepare_words(int64_t *n1, int64_t *n2,
+                                         int64_t *m1, int64_t *m2, int64_t *g,
+                                         enum batch_op op, bool reduced) {
+  *g = 1;
+  if (op != BATCH_MULT) {
+    if (lazy) { // equal denominators are kept, as in add_unreduced
+      *g = *n2 == *m2 ? *n2 : 1;
+      return WORD_LAZY;
+    } else if (!reduced) {
+      return WORD_FULL;
+    }
+    // Henrici, as in add_signed: only gcd(nume, g) can still be cancelled
+    *g = (int64_t)word_gcd((uint64_t)*n2, (uint64_t)*m2);
+    return *g == 1 ? WORD_REDUCED : WORD_COMMON;
+  } else if (lazy) {
+    return WORD_LAZY;
+  } else if (!reduced) {
+    return WORD_FULL;
+  }
+  // cancel across, as in mult_signed
+  const int64_t gcd_1 = (int64_t)word_gcd(*n1 < 0 ? -*n1 : *n1, *m2);
+  const int64_t gcd_2 = (int64_t)word_gcd(*m1 < 0 ? -*m1 : *m1, *n2);
+  if (gcd_1 > 1) {
+    *n1 /= gcd_1;
+    *m2 /= gcd_1;
+  }
+  if (gcd_2 > 1) {
+    *m1 /= gcd_2;
+    *n2 /= gcd_2;
+  }
+  return WORD_REDUCED;
+}
+
+// run_batch(dst, n, m, op) applies op to all the positions of n and m, see
+//   ha_frac_add_batch
+// notes: the positions are taken a chunk at a time: their parts are loaded
+//          into word arrays and cancelled, the word kernel runs over the
+//          whole chunk without a branch (positions that do not fit compute
+//          0 / 1), and the results are reduced and stored back
+// effects: modifies dst
+//          may allocate memory
+// time: see ha_frac_add_batch
+static void run_batch(struct ha_frac_batch *dst, const struct ha_frac_batch *n,
+                      const struct ha_frac_batch *m, enum batch_op op) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  assert(n->count == dst->count && m->count == dst->count);
+  int64_t n1[BATCH_CHUNK];
+  int64_t n2[BATCH_CHUNK];
+  int64_t m1[BATCH_CHUNK];
+  int64_t m2[BATCH_CHUNK];
+  int64_t g[BATCH_CHUNK];
+  int64_t r1[BATCH_CHUNK];
+  int64_t r2[BATCH_CHUNK];
+  bool fits[BATCH_CHUNK];
+  enum word_reduction reduction[BATCH_CHUNK];
+  for (int start = 0; start < dst->count; start += BATCH_CHUNK) {
+    const int len = dst->count - start < BATCH_CHUNK ? dst->count - start :
+                    BATCH_CHUNK;
+    for (int k = 0; k < len; ++k) {
+      const int i = start + k;
+      fits[k] = load_words(n, i, &n1[k], &n2[k]) &&
+                load_words(m, i, &m1[k], &m2[k]);
+      if (fits[k]) {
+        reduction[k] = prepare_words(&n1[k], &n2[k], &m1[k], &m2[k], &g[k],
+                                     op, n->reduced[i] && m->reduced[i]);
+      } else {
+        n1[k] = m1[k] = 0;
+        n2[k] = m2[k] = g[k] = 1;
+      }
+    }
+    if (op == BATCH_MULT) {
+      for (int k = 0; k < len; ++k) {
+        r1[k] = n1[k] * m1[k];
+        r2[k] = n2[k] * m2[k];
+      }
+    } else {
+      // n1/n2 + m1/m2 = (n1 * (m2/g) + m1 * (n2/g)) / (n2 * (m2/g))
+      const int64_t sign = op == BATCH_SUB ? -1 : 1;
+      for (int k = 0; k < len; ++k) {
+        const int64_t n_factor = n2[k] / g[k];
+        const int64_t m_factor = m2[k] / g[k];
+        r1[k] = n1[k] * m_factor + sign * m1[k] * n_factor;
+        r2[k] = n2[k] * m_factor;
+      }
+    }
+    for (int k = 0; k < len; ++k) {
+      if (fits[k]) {
+        store_words(dst, start + k, r1[k], r2[k], reduction[k], g[k]);
+      } else {
+        batch_one(dst, n, m, start + k, op);
+      }
+    }
+  }
+}
+
+void ha_frac_add_batch(struct ha_frac_batch *dst,
+                       const struct ha_frac_batch *n,
+                       const struct ha_frac_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  run_batch(dst, n, m, BATCH_ADD);
+}
+
+void ha_frac_sub_batch(struct ha_frac_batch *dst,
+                       const struct ha_frac_batch *n,
+                       const struct ha_frac_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  run_batch(dst, n, m, BATCH_SUB);
+}
+
+void ha_frac_mult_batch(struct ha_frac_batch *dst,
+                        const struct ha_frac_batch *n,
+                        const struct ha_frac_batch *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  run_batch(dst, n, m, BATCH_MULT);
+}
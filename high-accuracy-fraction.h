@@ -1,88 +1,316 @@
-#include <stdbool.h>
-#include "high-accuracy-integer.h"
-
-// This module provides basic calculations for arbitrarily large fractions
-
-// The following applies to all functions:
-// requires: all number parameters are valid (not NULL)
-// time: if parameter type is ha_int, (n) (m) is the number (so number of 
-// digits is logn); otherwise, 
-// (n1), (n2) are numerator and denominator of number a coorespondingly, if not 
-// specified (so numbers of digits are logn, logm), if there are 2 numbers,
-// n1, n2 are nume and denom of the first number paremeter, m1, m2 are nume and
-// denom of the second
-
-
-struct ha_frac;
-
-
-// ha_frac_create(numerator, denominator) creates an ha_frac with the numerator
-//   and the denominator given, or returns NULL if at least one of them is 
-//   invalid
-// notes: valid numerators and denominators satisfy:
-//          1. both of them are valid integers
-//          2. denominator is non-zero
-//        if either numerator or denominator is invalid, an error message 
-//          will be printed
-// examples: 0 1 => 0
-//           1 2 => 1/2
-//           12 34 => 6/17
-//           -1 2 => -1/2
-//           1 0 is invalid (returns NULL)
-// effects: may allocate memory (client must call ha_frac_destroy)
-//          may produce output (error message)
-// time: O(n * logn * logm), where n is numerator, m is denominator; 
-//       or n is denominator, m is numerator
-struct ha_frac *ha_frac_create(const char *numerator, const char *denominator);
-
-// ha_frac_destroy(num) destroys num
-// effects: num is no longer valid
-// time: O(1)
-void ha_frac_destroy(struct ha_frac *num);
-
-// ha_frac_print() prints the ha_frac followed by an optional \n (if newline is
-//   true)
-// notes: if num is an integer, then print "numerator" only
-//        if num is a fraction, then print "numerator/denominator"
-// effects: prints output
-// time: O(log(n1) + log(n2))
-void ha_frac_print(const struct ha_frac *num, bool newline);
-
-// ha_frac_copy(num) returns a copy of num
-// effects: allocates memory(caller must call ha_frac_destroy)
-// time:O(n1 * logn1 * logn2)
-struct ha_frac *ha_frac_copy(const struct ha_frac *num);
-
-// ha_frac_add(n, m) gives n + m
-// effects: allocates memory (caller must free)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_frac *ha_frac_add(const struct ha_frac *n, const struct ha_frac *m);
-
-// ha_frac_sub(n, m) gives n - m
-// effects: allocates memory (caller must free)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_frac *ha_frac_sub(const struct ha_frac *n, const struct ha_frac *m);
-
-// ha_frac_mult(n, m) gives n * m
-// effects: allocates memory (caller must free)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_frac *ha_frac_mult(const struct ha_frac *n, const struct ha_frac *m);
-
-// ha_frac_div(n, m) gives n / m
-// requires: m is not zero
-// effects: allocates memory (caller must free)
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-struct ha_frac *ha_frac_div(const struct ha_frac *n, const struct ha_frac *m);
-
-// ha_frac_cmp(n, m) returns 1 if n > m, 0 if n == m, -1 if n < m
-// time: O((n2) * log(n2) * log(m2)) or O((m2) * log(m2) * log(n2))
-int ha_frac_cmp(const struct ha_frac *n, const struct ha_frac *m);
-
-// ha_frac_is_frac(num) returns false if num is an integer, true otherwise
-// time: O(log(n2))
-bool ha_frac_is_frac(const struct ha_frac *num);
-
-// ha_frac_to_str(num) returns the cooresponding string of num
-// effects: allocates memory(caller must free)
-// time: O(log(n1) + log(n2))
-char *ha_frac_to_str(const struct ha_frac *num);
+#include <stdbool.h>
+#include "high-accuracy-integer.h"
+
+// This module provides basic calculations for arbitrarily large fractions
+
+// The following applies to all functions:
+// requires: all number parameters are valid (not NULL)
+// time: if parameter type is ha_int, (n) (m) is the number (so number of 
+// digits is logn); otherwise, 
+// (n1), (n2) are numerator and denominator of number a coorespondingly, if not 
+// specified (so numbers of digits are logn, logm), if there are 2 numbers,
+// n1, n2 are nume and denom of the first number paremeter, m1, m2 are nume and
+// denom of the second
+
+// Functions ending in _into (and ha_frac_addmul, ha_frac_submul) write their
+// result into an existing ha_frac instead of allocating a new one. The
+// destination may be one of the operands, and its storage is reused whenever
+// it is big enough.
+
+// Results are reduced to lowest terms unless deferred reduction is turned on
+// with ha_frac_set_lazy. Comparisons, ha_frac_is_frac and the string
+// functions give the same answers either way.
+
+// Batches: an ha_frac_batch holds a fixed number of fractions in
+// structure-of-arrays form, with the numerators, the denominators and the
+// signs in three separate arrays. The functions ending in _batch apply one
+// operation to every position of their batches in a single pass: the
+// fractions whose parts all fit in 31 bits are computed on machine words, in
+// loops the compiler can vectorize, and only the others go through the
+// functions above. The results are the same as with those functions, one
+// position at a time.
+
+// Estimates: a fraction can be estimated in constant time by a double made
+// of the leading limbs of its numerator and denominator, within a relative
+// error of 2^-48. ha_frac_cmp decides from the estimates whenever they are
+// further apart than that, and multiplies the parts out only for fractions
+// that are equal or nearly so. ha_frac_approx gives the estimate itself.
+
+
+struct ha_frac;
+struct ha_frac_batch;
+
+
+// ha_frac_create(numerator, denominator) creates an ha_frac with the numerator
+//   and the denominator given, or returns NULL if at least one of them is 
+//   invalid
+// notes: valid numerators and denominators satisfy:
+//          1. both of them are valid integers
+//          2. denominator is non-zero
+//        if either numerator or denominator is invalid, an error message 
+//          will be printed
+// examples: 0 1 => 0
+//           1 2 => 1/2
+//           12 34 => 6/17
+//           -1 2 => -1/2
+//           1 0 is invalid (returns NULL)
+// effects: may allocate memory (client must call ha_frac_destroy)
+//          may produce output (error message)
+// time: O(logn * logm), where n is numerator, m is denominator
+struct ha_frac *ha_frac_create(const char *numerator, const char *denominator);
+
+// ha_frac_destroy(num) destroys num
+// effects: num is no longer valid
+// time: O(1)
+void ha_frac_destroy(struct ha_frac *num);
+
+// ha_frac_print() prints the ha_frac followed by an optional \n (if newline is
+//   true)
+// notes: if num is an integer, then print "numerator" only
+//        if num is a fraction, then print "numerator/denominator"
+// effects: prints output
+// time: O(log(n1) + log(n2))
+void ha_frac_print(const struct ha_frac *num, bool newline);
+
+// ha_frac_copy(num) returns a copy of num
+// notes: the copy shares the limbs of num as ha_int_set does
+// effects: allocates memory(caller must call ha_frac_destroy)
+// time: O(1) if the limbs are shared, O(log(n1) + log(n2)) otherwise
+struct ha_frac *ha_frac_copy(const struct ha_frac *num);
+
+// ha_frac_set(dst, num) sets dst to num
+// notes: dst may share the limbs of num, see ha_int_set
+// effects: modifies dst
+//          may allocate memory
+// time: O(log(n1) + log(n2)), O(1) if the limbs are shared
+void ha_frac_set(struct ha_frac *dst, const struct ha_frac *num);
+
+// ha_frac_swap(n, m) exchanges the values of n and m
+// effects: modifies n and m
+// time: O(1)
+void ha_frac_swap(struct ha_frac *n, struct ha_frac *m);
+
+// ha_frac_set_quotient(dst, nume, denom) sets dst to the reduction of
+//   nume/denom
+// notes: the reduction is skipped with deferred reduction, see
+//          ha_frac_set_lazy
+// requires: denom != 0
+//           nume and denom are not part of dst
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn * logm), where n = nume, m = denom
+void ha_frac_set_quotient(struct ha_frac *dst, const struct ha_int *nume,
+                          const struct ha_int *denom);
+
+// ha_frac_set_lazy(enable) turns the deferred reduction of the calling thread
+//   on (enable is true) or off, and returns the previous setting
+// notes: with deferred reduction, the arithmetic functions (and
+//          ha_frac_create and ha_frac_set_quotient) skip the gcds and leave
+//          their results unreduced, so that a sum of products only needs to
+//          be reduced once at the end; sums of fractions with the same
+//          denominator keep that denominator
+//        a result is reduced all the same once its denominator grows past
+//          about 75 decimal digits
+//        numbers created with and without it can be mixed freely; an
+//          unreduced operand makes the result unreduced too, which is then
+//          reduced if deferred reduction is off
+// effects: changes the representation of later results (not their values)
+// time: O(1)
+bool ha_frac_set_lazy(bool enable);
+
+// ha_frac_lazy() determines if deferred reduction is on for the calling
+//   thread, see ha_frac_set_lazy
+// time: O(1)
+bool ha_frac_lazy(void);
+
+// ha_frac_normalize(num) reduces num to lowest terms
+// effects: modifies num
+// time: O(1) if num is reduced, O(log(n1) * log(n2)) otherwise
+void ha_frac_normalize(struct ha_frac *num);
+
+// ha_frac_add(n, m) gives n + m
+// effects: allocates memory (caller must free)
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+struct ha_frac *ha_frac_add(const struct ha_frac *n, const struct ha_frac *m);
+
+// ha_frac_add_into(dst, n, m) sets dst to n + m
+// effects: modifies dst
+//          may allocate memory
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+void ha_frac_add_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m);
+
+// ha_frac_sub(n, m) gives n - m
+// effects: allocates memory (caller must free)
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+struct ha_frac *ha_frac_sub(const struct ha_frac *n, const struct ha_frac *m);
+
+// ha_frac_sub_into(dst, n, m) sets dst to n - m
+// effects: modifies dst
+//          may allocate memory
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+void ha_frac_sub_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m);
+
+// ha_frac_mult(n, m) gives n * m
+// effects: allocates memory (caller must free)
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+struct ha_frac *ha_frac_mult(const struct ha_frac *n, const struct ha_frac *m);
+
+// ha_frac_mult_into(dst, n, m) sets dst to n * m
+// effects: modifies dst
+//          may allocate memory
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+void ha_frac_mult_into(struct ha_frac *dst, const struct ha_frac *n,
+                       const struct ha_frac *m);
+
+// ha_frac_addmul(acc, n, m) adds n * m to acc
+// effects: modifies acc
+//          may allocate memory
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)) +
+//       (log(a1) + log(a2)) * (log(n2) + log(m2))), where a1, a2 are the
+//       numerator and denominator of acc
+void ha_frac_addmul(struct ha_frac *acc, const struct ha_frac *n,
+                    const struct ha_frac *m);
+
+// ha_frac_submul(acc, n, m) subtracts n * m from acc
+// effects: modifies acc
+//          may allocate memory
+// time: same as ha_frac_addmul
+void ha_frac_submul(struct ha_frac *acc, const struct ha_frac *n,
+                    const struct ha_frac *m);
+
+// ha_frac_div(n, m) gives n / m
+// requires: m is not zero
+// effects: allocates memory (caller must free)
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+struct ha_frac *ha_frac_div(const struct ha_frac *n, const struct ha_frac *m);
+
+// ha_frac_div_into(dst, n, m) sets dst to n / m
+// requires: m is not zero
+// effects: modifies dst
+//          may allocate memory
+// time: O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+void ha_frac_div_into(struct ha_frac *dst, const struct ha_frac *n,
+                      const struct ha_frac *m);
+
+// ha_frac_cmp(n, m) returns 1 if n > m, 0 if n == m, -1 if n < m
+// notes: the result is exact, though it mostly comes from the estimates (see
+//          above)
+// time: O(1) if n and m differ by more than 2^-48 relatively, or all their
+//       parts fit in a limb; otherwise
+//       O((log(n1) + log(n2)) * (log(m1) + log(m2)))
+int ha_frac_cmp(const struct ha_frac *n, const struct ha_frac *m);
+
+// ha_frac_approx(num) gives num as a double, within a relative error of 2^-48
+// notes: values beyond the range of doubles give +-infinity or +-0
+// time: O(1)
+double ha_frac_approx(const struct ha_frac *num);
+
+// ha_frac_sign(num) returns 1 if num is positive, -1 if num is negative,
+//   otherwise, returns 0
+// time: O(1)
+int ha_frac_sign(const struct ha_frac *num);
+
+// ha_frac_is_one(num) determines if num == 1
+// time: O(1), or O(n2) if the reduction of num is deferred
+bool ha_frac_is_one(const struct ha_frac *num);
+
+// ha_frac_constant(k) gives the fraction k, shared by all threads
+// notes: as ha_int_constant, the constant must not be destroyed or written
+// requires: -HA_INT_CONSTANT_MAX <= k <= HA_INT_CONSTANT_MAX
+// time: O(1)
+const struct ha_frac *ha_frac_constant(int k);
+
+// ha_frac_is_frac(num) returns false if num is an integer, true otherwise
+// time: O(1)
+bool ha_frac_is_frac(const struct ha_frac *num);
+
+// ha_frac_write(buf, num) appends num to buf, in lowest terms and as in
+//   ha_frac_to_str
+// requires: buf is valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O(log(n1) + log(n2))
+void ha_frac_write(struct ha_buffer *buf, const struct ha_frac *num);
+
+// ha_frac_to_str(num) returns the cooresponding string of num
+// effects: allocates memory(caller must free)
+// time: O(log(n1) + log(n2))
+char *ha_frac_to_str(const struct ha_frac *num);
+
+// ha_frac_batch_create(count) creates a batch of count fractions, all 0, in
+//   the current allocation context
+// requires: count > 0
+// effects: allocates memory (client must call ha_frac_batch_destroy)
+// time: O(count)
+struct ha_frac_batch *ha_frac_batch_create(int count);
+
+// ha_frac_batch_destroy(batch) destroys batch
+// requires: batch is valid (not NULL)
+// effects: batch is no longer valid
+// time: O(count)
+void ha_frac_batch_destroy(struct ha_frac_batch *batch);
+
+// ha_frac_batch_size(batch) gives the number of fractions of batch
+// requires: batch is valid (not NULL)
+// time: O(1)
+int ha_frac_batch_size(const struct ha_frac_batch *batch);
+
+// ha_frac_batch_is_zero(batch) determines if all the fractions of batch are 0
+// requires: batch is valid (not NULL)
+// time: O(count)
+bool ha_frac_batch_is_zero(const struct ha_frac_batch *batch);
+
+// ha_frac_batch_get(batch, i, dst) sets dst to the fraction of batch at i
+// requires: batch is valid (not NULL)
+//           0 <= i < size of batch
+// effects: modifies dst
+//          may allocate memory
+// time: O(log(n1) + log(n2)), where n1, n2 are the parts of the fraction
+//       at i, O(1) if the limbs are shared (see ha_int_set)
+void ha_frac_batch_get(const struct ha_frac_batch *batch, int i,
+                       struct ha_frac *dst);
+
+// ha_frac_batch_set(batch, i, num) sets the fraction of batch at i to num
+// requires: batch is valid (not NULL)
+//           0 <= i < size of batch
+// effects: modifies batch
+//          may allocate memory
+// time: O(log(n1) + log(n2)), O(1) if the limbs are shared
+void ha_frac_batch_set(struct ha_frac_batch *batch, int i,
+                       const struct ha_frac *num);
+
+// ha_frac_add_batch(dst, n, m) sets every fraction of dst to the sum of the
+//   fractions of n and m at the same position
+// notes: dst may be n or m
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: O(count) for the fractions with parts of 31 bits, the time of
+//       ha_frac_add_into for each of the others
+void ha_frac_add_batch(struct ha_frac_batch *dst,
+                       const struct ha_frac_batch *n,
+                       const struct ha_frac_batch *m);
+
+// ha_frac_sub_batch(dst, n, m) sets every fraction of dst to the difference
+//   of the fractions of n and m at the same position
+// notes: dst may be n or m
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: same as ha_frac_add_batch, with ha_frac_sub_into
+void ha_frac_sub_batch(struct ha_frac_batch *dst,
+                       const struct ha_frac_batch *n,
+                       const struct ha_frac_batch *m);
+
+// ha_frac_mult_batch(dst, n, m) sets every fraction of dst to the product of
+//   the fractions of n and m at the same position
+// notes: dst may be n or m
+// requires: dst, n and m are valid (not NULL) and have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: same as ha_frac_add_batch, with ha_frac_mult_into
+void ha_frac_mult_batch(struct ha_frac_batch *dst,
+                        const struct ha_frac_batch *n,
+                        const struct ha_frac_batch *m);
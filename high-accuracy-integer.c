@@ -1,545 +1,1958 @@
-// This module provides basic calculations for arbitrarily large integers
-
-// For all program scope functions, see high-accuracy-integer.h for details
-
-// The following applies to all functions:
-// requires: all number parameters are valid (not NULL)
-// time: (n) is the number (so number of digits is logn)
-
-#include <assert.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include "high-accuracy-integer.h"
-
-
-struct ha_int {
-  bool sign; // true for positive and 0, false for negative
-  char *digits; // stored in a reverse order for convenience
-};
-
-
-// print_invalid_integer(s) prints an error message in the form 
-//   "Error: s is an invalid integer"
-// requires: s is a valid string (not NULL)
-// effects: produces output
-// time: O(logn)
-static void print_invalid_integer(const char *s) {
-  assert(s);
-  printf("Error: %s is an invalid integer\n", s);
-}
-
-struct ha_int *ha_int_create(const char *s) {
-  assert(s);
-  const int s_len = strlen(s);
-  struct ha_int *integer = malloc(sizeof(struct ha_int));
-  integer->sign = true;
-
-  // situations where s is an invalid integer
-  if (s_len == 0) { // s is an empty string
-    print_invalid_integer(s);
-    free(integer);
-    return NULL;
-  }
-  int s_idx = 0; // current index of s
-  int digit_num = s_len; // number of digits in s
-  if (s[0] == '-') { // s is negative
-    if (s_len == 1 || s[1] < '1' || s[1] > '9') {
-      print_invalid_integer(s);
-      free(integer);
-      return NULL;
-    }
-    integer->sign = false;
-    ++s_idx;
-    --digit_num;
-  }
-  if (s[0] == '0' && s_len > 1) { // successive 0s ahead
-    print_invalid_integer(s);
-    free(integer);
-    return NULL;
-  }
-  for (int i = s_idx; i < s_len; ++i) {
-    if (s[i] < '0' || s[i] > '9') { // s has other invalid chars
-      print_invalid_integer(s);
-      free(integer);
-      return NULL;
-    }
-  }
-
-  // s is a valid integer
-  integer->digits = malloc((digit_num + 1) * sizeof(char));
-  for (int j = digit_num - 1; j >= 0; --j) {
-    integer->digits[j] = s[s_idx];
-    ++s_idx;
-  }
-  integer->digits[digit_num] = '\0';
-  return integer;
-}
-
-void ha_int_destroy(struct ha_int *integer) {
-  assert(integer);
-  free(integer->digits);
-  free(integer);
-}
-
-void ha_int_print(const struct ha_int *integer, bool newline) {
-  assert(integer);
-  if (!integer->sign) { // negative
-    printf("-");
-  }
-
-  const int len = strlen(integer->digits);
-  for (int i = len - 1; i >= 0 ; --i) {
-    printf("%c", integer->digits[i]);
-  }
-
-  if (newline) {
-    printf("\n");
-  }
-}
-
-struct ha_int *ha_int_copy(const struct ha_int *n) {
-  assert(n);
-  struct ha_int *new_int = malloc(sizeof(struct ha_int));
-  new_int->sign = n->sign;
-  const int n_len = strlen(n->digits);
-  new_int->digits = malloc((n_len + 1) * sizeof(char));
-  strcpy(new_int->digits, n->digits);
-  return new_int;
-}
-
-bool ha_int_eq(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-
-  // different signs
-  if (n->sign != m->sign) {
-    return false;
-  }
-
-  // different length
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-  if (n_len != m_len) {
-    return false;
-  }
-
-  // same sign and length
-  for (int i = n_len - 1; i >= 0; --i) {
-    if (n->digits[i] != m->digits[i]) { // different digits
-      return false;
-    }
-  }
-
-  return true;
-}
-
-// abs_gt(n, m) determines if |n| > |m|
-// time: O(logn + logm)
-static bool abs_gt(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-
-  if (n_len > m_len) { // n has more digits
-    return true;
-  } else if (n_len < m_len) { // n has less digits
-    return false;
-  } else { // same number of digits
-    for (int i = n_len - 1; i >= 0; --i) {
-      if (n->digits[i] > m->digits[i]) {
-        return true;
-      } else if (n->digits[i] < m->digits[i]) {
-        return false;
-      }
-    }
-  }
-  // n == m
-  return false;
-}
-
-bool ha_int_gt(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-
-  // n and m have different signs
-  if (n->sign && !m->sign) { // n is +ve/0, m is -ve
-    return true;
-  } else if (!n->sign && m->sign) { // n is -ve, m is +ve/0
-    return false;
-  }
-
-  // n and m have same signs
-  if (n->sign) { // positive or 0
-    return abs_gt(n, m);
-  } else { // negative
-    return abs_gt(m, n);
-  }
-}
-
-// max(a, b) finds the bigger value between a and b
-static int max(int a, int b) {
-  if (a >= b) {
-    return a;
-  } else {
-    return b;
-  }
-}
-
-// get_digit(s, len, pos) gets the real digit s[pos] represents, returning 0
-//   if pos >= len
-// requires: s is a valid integer string (not NULL)
-//           len > 0
-//           pos >= 0
-// time: O(1)
-static int get_digit(const char *s, int len, int pos) {
-  assert(s);
-  assert(len > 0);
-  assert(pos >= 0);
-  if (pos >= len) {
-    return 0;
-  }
-  else {
-    return s[pos] - '0';
-  }
-}
-
-// remove_leading_zeros(num) deletes invalid leading zeros in num
-// note: modified num should be a valid integer
-// effects: may modify num
-// time: O(logn)
-static char *remove_leading_zeros(char *num) {
-  assert(num);
-  int len = strlen(num);
-  while (num[len - 1] == '0' && len > 1) {
-    --len;
-  }
-  num = realloc(num, (len + 1) * sizeof(char));
-  num[len] = '\0';
-  return num;
-}
-
-// init_new_int(n, len) initializes n so that all the char are '0'
-// requires: len >= 0
-// effects: modifies num
-// time: O(logn)
-static void init_new_int(struct ha_int *n, int len) {
-  assert(n);
-  assert(len >= 0);
-  for (int i = 0; i < len; ++i) {
-    n->digits[i] = '0';
-  }
-  n->digits[len] = '\0';
-}
-
-// abs_add(n, m) gives |n| + |m|
-// effects: allocates memory (caller must free)
-// time: O(logn + logm)
-static struct ha_int *abs_add(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-  struct ha_int *new_int = malloc(sizeof(struct ha_int));
-  new_int->sign = true;
-  int new_int_len = max(n_len, m_len) + 1; // maximum length of new_int
-  new_int->digits = malloc((new_int_len + 1) * sizeof(char));
-  init_new_int(new_int, new_int_len);
-
-  // add each digit
-  int carry = 0;
-  for (int j = 0; j < new_int_len; ++j) {
-    const int sum = carry + get_digit(m->digits, m_len, j) +
-      get_digit(n->digits, n_len, j);
-    new_int->digits[j] = sum % 10 + '0';
-    carry = sum / 10;
-  }
-
-  new_int->digits = remove_leading_zeros(new_int->digits);
-  return new_int;
-}
-
-// abs_big_sub_small(n, m) gives max(|m|, |n|) - min(|m|, |n|)
-// effects: allocates memory (caller must free)
-// time: O(logn + logm)
-static struct ha_int *abs_big_sub_small(const struct ha_int *n, 
-                                        const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-  struct ha_int *new_int = malloc(sizeof(struct ha_int));
-  new_int->sign = true;
-  int new_int_len = max(n_len, m_len); // maximum length of new_int
-  new_int->digits = malloc((new_int_len + 1) * sizeof(char));
-  init_new_int(new_int, new_int_len);
-
-  // find max(|m|, |n|) and min(|m|, |n|)
-  char *big = malloc((new_int_len + 1) * sizeof(char));
-  int big_len = 0;
-  char *small = malloc((new_int_len + 1) * sizeof(char));
-  int small_len = 0;
-  if (abs_gt(n, m)) { // |n| > |m|
-    strcpy(big, n->digits);
-    big_len = n_len;
-    strcpy(small, m->digits);
-    small_len = m_len;
-  } else { // |n| <= |m|
-    strcpy(big, m->digits);
-    big_len = m_len;
-    strcpy(small, n->digits);
-    small_len = n_len;
-  }
-
-  // big - small for each digit
-  int carry = 0;
-  for (int i = 0; i < new_int_len; ++i) {
-    int sub = carry + get_digit(big, big_len, i) - 
-      get_digit(small, small_len, i);
-    if (sub < 0) {
-      sub += 10;
-      carry = -1;
-    } else {
-      carry = 0;
-    }
-    new_int->digits[i] = sub % 10 + '0';
-  }
-
-  new_int->digits = remove_leading_zeros(new_int->digits);
-  free(big);
-  free(small);
-  return new_int;
-}
-
-struct ha_int *ha_int_add(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  if (n->sign == m->sign) { // n and m have same signs
-    struct ha_int *new_int = abs_add(n, m);
-    new_int->sign = n->sign;
-    return new_int;
-  } else { // n and m have different signs
-    struct ha_int *new_int = abs_big_sub_small(n, m);
-    if (abs_gt(n, m)) { // |n| > |m|
-      // when n >= 0 and m < 0, sign is true
-      // when n < 0 and m >= 0, sign is false
-      if (!n->sign) {
-        new_int->sign = false;
-      }
-    } else if (abs_gt(m, n)) { // |n| < |m|
-      // when n >= 0 and m < 0, sign is false
-      if (n->sign) {
-        new_int->sign = false;
-      }
-      // when n < 0 and m >= 0, sign is true
-    }
-    return new_int;
-  }
-}
-
-struct ha_int *ha_int_sub(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  if (n->sign != m->sign) { // n and m have different signs
-    struct ha_int *new_int = abs_add(n, m);
-    new_int->sign = n->sign;
-    return new_int;
-  } else { // n and m have same signs
-    struct ha_int *new_int = abs_big_sub_small(n, m);
-    if (abs_gt(n, m)) { // |n| > |m|
-      // when n,m >= 0 sign is true
-      // when n,m < 0 sign is false
-      if (!n->sign) {
-        new_int->sign = false;
-      }
-    } else if (abs_gt(m, n)) { // |n| < |m|
-      // when n,m >= 0 sign is false
-      if (n->sign) {
-        new_int->sign = false;
-      }
-      // when n,m < 0, sign is true
-    }
-    return new_int;
-  }
-}
-
-// is_zero(n) determines if n is zero
-// requires: n is a valid integer [not asserted]
-// time: O(logn)
-static bool is_zero(const struct ha_int *n) {
-  assert(n);
-  const int len = strlen(n->digits);
-  return len == 1 && n->digits[0] == '0';
-}
-
-// mult_div_sign(n, m) determines the sign for n * m and n / m
-// note: returning true means positive or 0, false means negative
-// time: O(logn + logm)
-static bool mult_div_sign(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  if (is_zero(n) || is_zero(m)) {
-    return true;
-  } else {
-    if (n->sign == m->sign) { // same sign
-      return true;
-    } else { // different signs
-      return false;
-    }
-  }
-}
-
-struct ha_int *ha_int_mult(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-  struct ha_int *new_int = malloc(sizeof(struct ha_int));
-  new_int->sign = mult_div_sign(n, m);
-  int new_int_len = n_len + m_len; // maximum length of new_int
-  new_int->digits = malloc((new_int_len + 1) * sizeof(char));
-  init_new_int(new_int, new_int_len);
-
-  // multiply each digit and add
-  int carry = 0;
-  for (int i = 0; i < n_len; ++i) {
-    for (int j = 0; j < m_len; ++j) {
-      const int mult = 
-        get_digit(n->digits, n_len, i) * get_digit(m->digits, m_len, j) + 
-        get_digit(new_int->digits, new_int_len, i + j) + carry;
-      new_int->digits[i + j] = mult % 10 + '0';
-      carry = mult / 10;
-    }
-    new_int->digits[m_len + i] = carry + '0';
-    carry = 0;
-  }
-  new_int->digits = remove_leading_zeros(new_int->digits);
-  return new_int;
-}
-
-struct ha_int *ha_int_quotient(const struct ha_int *n, const struct ha_int *m) {
-  assert(n);
-  assert(m);
-
-  // if m == 0, print error message
-  if (is_zero(m)) {
-    printf("Error: divisor cannot be zero");
-    return NULL;
-  }
-
-  const int n_len = strlen(n->digits);
-  const int m_len = strlen(m->digits);
-  struct ha_int *new_int = malloc(sizeof(struct ha_int));
-  int new_int_len = n_len; // maximum length of new_int
-
-  // n / m == 0 if |n| < |m|
-  if (abs_gt(m, n)) {
-    new_int->sign = true;
-    new_int->digits = malloc(2 * sizeof(char));
-    new_int->digits[0] = '0';
-    new_int->digits[1] = '\0';
-  } else { // |n| >= |m|
-    new_int->sign = mult_div_sign(n, m);
-    new_int->digits = malloc((new_int_len + 1) * sizeof(char));
-    init_new_int(new_int, new_int_len);
-  }
-
-  // initialize the dividend that can be modified
-  // set dividend positive for convenience
-  struct ha_int *dividend = ha_int_copy(n);
-  dividend->sign = true;
-  int dividend_len = strlen(dividend->digits);
-
-  // divide and minus
-  int idx = 0;
-  for (int i = m_len; i <= n_len; ++i) {
-    const int len_differ = dividend_len - m_len;
-
-    // give divisor enough zeroes
-    // example: for 30 / 2, we adjust 2 to 20, so that the first digit got is
-    //          30 / 20 = 1
-    // 10^? that divisor multiplied with
-    char *ten_to_power = malloc((len_differ + 2) * sizeof(char));
-    ten_to_power[0] = '1';
-    for (int j = 1; j <= len_differ; ++j) {
-      ten_to_power[j] = '0';
-    }
-    ten_to_power[len_differ + 1] = '\0';
-    struct ha_int *multiplier = ha_int_create(ten_to_power);
-    free(ten_to_power);
-
-    // set modified_divisor positive for convenience
-    struct ha_int *modified_divisor = ha_int_mult(m, multiplier);
-    modified_divisor->sign = true;
-    ha_int_destroy(multiplier);
-
-    // dividend minus modified_divisor for as many times as possible
-    int quotient = 0;
-    bool divisor_is_bigger = abs_gt(modified_divisor, dividend);
-    struct ha_int *new_dividend = NULL;
-    while (!divisor_is_bigger) {
-      new_dividend = ha_int_sub(dividend, modified_divisor);
-      ha_int_destroy(dividend);
-      dividend = new_dividend;
-      ++quotient;
-      divisor_is_bigger = abs_gt(modified_divisor, dividend); // for efficiency
-    }
-    new_int->digits[idx] = quotient + '0';
-    ++idx;
-    --dividend_len;
-    ha_int_destroy(modified_divisor);
-  }
-  ha_int_destroy(dividend);
-
-  // modify the new_int->digits (before, it is reversed)
-  for (int k = 0; k < idx / 2; ++k) {
-    const char temp = new_int->digits[k];
-    new_int->digits[k] = new_int->digits[idx - 1 - k];
-    new_int->digits[idx - 1 - k] = temp;
-  }
-  new_int->digits = remove_leading_zeros(new_int->digits);
-  return new_int;
-}
-
-struct ha_int *ha_int_remainder(const struct ha_int *n, 
-                                const struct ha_int *m) {
-  assert(n);
-  assert(m);
-
-  // if m == 0, print error message
-  if (is_zero(m)) {
-    printf("Error: divisor cannot be zero");
-    return NULL;
-  }
-  
-  struct ha_int *quotient = ha_int_quotient(n, m);
-  struct ha_int *mult = ha_int_mult(m, quotient); // m * quotient
-  struct ha_int *new_int = ha_int_sub(n, mult);
-  ha_int_destroy(quotient);
-  ha_int_destroy(mult);
-  return new_int;
-}
-
-char *ha_int_to_str(const struct ha_int *n) {
-  assert(n);
-  int len = strlen(n->digits);
-  if (!n->sign) { // negative
-    ++len;
-  }
-  char *num = malloc((len + 1) * sizeof(char));
-  
-  int front_idx = 0;
-  if (!n->sign) {
-    num[0] = '-';
-    ++front_idx;
-  }
-  
-  int digit = strlen(n->digits) - 1; // current index of n->digits
-  for (int i = front_idx; i < len; ++i) {
-    num[i] = n->digits[digit];
-    --digit;
-  }
-  num[len] = '\0';
-  return num;
-}
+// This module provides basic calculations for arbitrarily large integers
+
+// For all program scope functions, see high-accuracy-integer.h for details
+
+// The following applies to all functions:
+// requires: all number parameters are valid (not NULL)
+// time: (n) is the number (so number of limbs is logn)
+
+// Representation: the magnitude is kept as an array of machine-word limbs in
+//   little-endian order (limbs[0] is the least significant) with a cached
+//   length, and the sign is kept separately. Decimal text only appears at
+//   the boundary (ha_int_create, ha_int_write, ha_int_to_str and
+//   ha_int_print).
+// Engine option: limbs are 32 bits by default; compile with
+//   -DHA_INT_LIMB_BITS=64 to use 64-bit limbs (requires unsigned __int128)
+// Small values: magnitudes of up to INLINE_LIMBS limbs live inside the struct
+//   itself with no separate limb buffer, and arithmetic on them runs on
+//   native double-limb integers; results that do not fit are promoted to a
+//   heap buffer
+// Memory: a value takes its struct and limbs from the allocation context
+//   current when it is created and keeps growing in it (see
+//   high-accuracy-alloc.h); buffers that only live during one call always
+//   come from the heap
+// Sharing: limb arrays are reference counted, so ha_int_copy and ha_int_set
+//   hand the limbs of a large heap value to the copy instead of duplicating
+//   them. Limbs held by several integers are never written: a function that
+//   writes a result into one of them gives the result a new array (or the
+//   inline storage) and drops its reference, so the others keep the old
+//   value. Values in arenas never share, since an arena is freed as a whole.
+
+#include <assert.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-limbs.h"
+#include "high-accuracy-stats.h"
+
+_Static_assert(HA_INT_CONSTANT_MAX == 16,
+               "CONSTANT_TABLE is written out for 16");
+
+// CONSTANT(k) is the initializer of the constant k of int_constants
+#define CONSTANT(k) \
+  CONSTANT_INT((k) >= 0, (k) >= 0 ? (k) : -(k), \
+               int_constants[(k) + HA_INT_CONSTANT_MAX])
+
+// the constants of ha_int_constant, from -HA_INT_CONSTANT_MAX on
+static const struct ha_int int_constants[2 * HA_INT_CONSTANT_MAX + 1] = {
+  CONSTANT_TABLE(CONSTANT)
+};
+
+
+// print_invalid_integer(s) prints an error message in the form
+//   "Error: s is an invalid integer"
+// requires: s is a valid string (not NULL)
+// effects: produces output
+// time: O(logn)
+static void print_invalid_integer(const char *s) {
+  assert(s);
+  printf("Error: %s is an invalid integer\n", s);
+}
+
+// max(a, b) finds the bigger value between a and b
+static int max(int a, int b) {
+  if (a >= b) {
+    return a;
+  } else {
+    return b;
+  }
+}
+
+void ha_int_init(struct ha_int *n, struct ha_arena *arena) {
+  assert(n);
+  n->sign = true;
+  n->len = 0;
+  n->cap = INLINE_LIMBS;
+  n->limbs = n->small;
+  n->arena = arena;
+}
+
+// the limb arrays of integers (see Sharing above); a block in an arena is
+//   only ever held by one integer
+struct block {
+  atomic_int refs; // number of integers holding the limbs
+  ha_limb limbs[];
+};
+
+// block_of(limbs) gives the block holding limbs
+// requires: limbs came from alloc_limbs
+// time: O(1)
+static struct block *block_of(const ha_limb *limbs) {
+  return (struct block *)((char *)limbs - offsetof(struct block, limbs));
+}
+
+// alloc_limbs(arena, cap) returns the limbs of a new block with room for cap
+//   limbs from arena (NULL for the heap), held once
+// requires: cap > 0
+// effects: allocates memory (client must call release_limbs)
+// time: O(1)
+static ha_limb *alloc_limbs(struct ha_arena *arena, int cap) {
+  assert(cap > 0);
+  struct block *b =
+    ha_alloc(arena, sizeof(struct block) + cap * sizeof(ha_limb));
+  atomic_init(&b->refs, 1);
+  HA_STATS_LIMBS(arena ? 0 : cap);
+  return b->limbs;
+}
+
+// release_limbs(arena, limbs, cap) drops a reference to the block of cap
+//   limbs at limbs from arena, freeing it if it was the last one
+// effects: limbs may no longer be valid
+// time: O(1)
+static void release_limbs(struct ha_arena *arena, ha_limb *limbs, int cap) {
+  assert(limbs);
+  (void)cap; // only counted
+  if (arena) { // freed with its arena
+    return;
+  }
+  struct block *b = block_of(limbs);
+  if (atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1) {
+    HA_STATS_LIMBS(-cap);
+    ha_release(NULL, b);
+  }
+}
+
+// owns_block(n) determines if the limbs of n are a block
+// time: O(1)
+static bool owns_block(const struct ha_int *n) {
+  assert(n);
+  return n->limbs != n->small && n->cap > 0;
+}
+
+// room(n) gives the number of limbs that can be written into the limbs of n:
+//   0 if they are borrowed or shared with another integer
+// time: O(1)
+static int room(const struct ha_int *n) {
+  assert(n);
+  if (owns_block(n) &&
+      atomic_load_explicit(&block_of(n->limbs)->refs,
+                           memory_order_acquire) > 1) {
+    return 0;
+  }
+  return n->cap;
+}
+
+// free_limbs(n) drops the reference of n to its limbs unless they are the
+//   inline ones or are borrowed
+// effects: the limbs of n are no longer valid
+// time: O(1)
+static void free_limbs(struct ha_int *n) {
+  assert(n);
+  if (owns_block(n)) {
+    release_limbs(n->arena, n->limbs, n->cap);
+  }
+}
+
+void ha_int_clear(struct ha_int *n) {
+  assert(n);
+  free_limbs(n);
+}
+
+// alloc_int(cap) returns a new ha_int equal to 0 with room for cap limbs in
+//   the current allocation context
+// notes: no limb buffer is allocated if cap <= INLINE_LIMBS
+// requires: cap >= 0
+// effects: allocates memory (client must call ha_int_destroy)
+// time: O(1)
+static struct ha_int *alloc_int(int cap) {
+  assert(cap >= 0);
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_int *integer = ha_alloc_node(arena, sizeof(struct ha_int));
+  ha_int_init(integer, arena);
+  if (cap > INLINE_LIMBS) {
+    integer->cap = cap;
+    integer->limbs = alloc_limbs(arena, cap);
+  }
+  return integer;
+}
+
+// get_dlimb(limbs, len) gives the value of limbs[0..len)
+// requires: 0 <= len <= 2
+// time: O(1)
+static ha_dlimb get_dlimb(const ha_limb *limbs, int len) {
+  assert(0 <= len && len <= 2);
+  ha_dlimb x = 0;
+  for (int i = len - 1; i >= 0; --i) {
+    x = (x << LIMB_BITS) | limbs[i];
+  }
+  return x;
+}
+
+// set_small(dst, x, sign) sets dst to x with the given sign (true for
+//   positive) using its inline or current storage
+// effects: modifies dst
+// time: O(1)
+static void set_small(struct ha_int *dst, ha_dlimb x, bool sign) {
+  assert(dst);
+  if (room(dst) < INLINE_LIMBS) { // borrowed or shared limbs aren't written
+    free_limbs(dst);
+    dst->limbs = dst->small;
+    dst->cap = INLINE_LIMBS;
+  }
+  assert(dst->cap >= 2);
+  dst->limbs[0] = (ha_limb)x;
+  dst->limbs[1] = (ha_limb)(x >> LIMB_BITS);
+  dst->len = 2;
+  dst->sign = sign;
+  while (dst->len > 0 && dst->limbs[dst->len - 1] == 0) {
+    --dst->len;
+  }
+  if (dst->len == 0) {
+    dst->sign = true;
+  }
+}
+
+void ha_int_set_word(struct ha_int *n, uint64_t x) {
+  assert(n);
+  set_small(n, x, true);
+}
+
+// remove_leading_zeros(n) drops the zero limbs at the top of n, so that n->len
+//   is the real length of n (a zero is always non-negative)
+// effects: may modify n
+// time: O(logn)
+static void remove_leading_zeros(struct ha_int *n) {
+  assert(n);
+  while (n->len > 0 && n->limbs[n->len - 1] == 0) {
+    --n->len;
+  }
+  if (n->len == 0) {
+    n->sign = true;
+  }
+}
+
+// mag_cmp(a, an, b, bn) returns 1 if a > b, 0 if a == b, -1 if a < b, where a
+//   and b are magnitudes with no leading zero limbs
+// time: O(an + bn)
+static int mag_cmp(const ha_limb *a, int an, const ha_limb *b, int bn) {
+  if (an != bn) {
+    return an > bn ? 1 : -1;
+  }
+  for (int i = an - 1; i >= 0; --i) {
+    if (a[i] != b[i]) {
+      return a[i] > b[i] ? 1 : -1;
+    }
+  }
+  return 0;
+}
+
+// whether the limb loops may use vector kernels, see ha_int_set_simd
+static bool simd = true;
+
+// operand sizes (in limbs) from which the limb loops call the kernels of
+//   high-accuracy-limbs.h; shorter loops are not worth the indirect call
+#define KERNEL_MIN_LIMBS 16
+
+// kernels() gives the limb kernels to use
+// time: O(1)
+static const struct ha_limb_kernels *kernels(void) {
+  return ha_limb_kernels(simd);
+}
+
+// mag_add(r, a, an, b, bn) sets r[0..an) to the low an limbs of a + b and
+//   returns the carry out
+// requires: an >= bn >= 0
+//           r may be the same array as a or b
+// time: O(an)
+static ha_limb mag_add(ha_limb *r, const ha_limb *a, int an,
+                       const ha_limb *b, int bn) {
+  assert(an >= bn && bn >= 0);
+  ha_limb carry = 0;
+  int i = 0;
+  if (bn >= KERNEL_MIN_LIMBS) {
+    carry = kernels()->add_n(r, a, b, bn);
+    i = bn;
+  }
+  for (; i < bn; ++i) {
+    const ha_dlimb sum = (ha_dlimb)a[i] + b[i] + carry;
+    r[i] = (ha_limb)sum;
+    carry = (ha_limb)(sum >> LIMB_BITS);
+  }
+  for (; i < an; ++i) {
+    const ha_limb sum = a[i] + carry;
+    carry = sum < carry;
+    r[i] = sum;
+  }
+  return carry;
+}
+
+// mag_sub(r, a, an, b, bn) sets r[0..an) to the low an limbs of a - b and
+//   returns the borrow out (0 when a >= b)
+// requires: an >= bn >= 0
+//           r may be the same array as a or b
+// time: O(an)
+static ha_limb mag_sub(ha_limb *r, const ha_limb *a, int an,
+                       const ha_limb *b, int bn) {
+  assert(an >= bn && bn >= 0);
+  ha_limb borrow = 0;
+  int i = 0;
+  if (bn >= KERNEL_MIN_LIMBS) {
+    borrow = kernels()->sub_n(r, a, b, bn);
+    i = bn;
+  }
+  for (; i < bn; ++i) {
+    const ha_limb ai = a[i];
+    const ha_limb diff = ai - b[i] - borrow;
+    borrow = (ai < b[i]) || (ai - b[i] < borrow);
+    r[i] = diff;
+  }
+  for (; i < an; ++i) {
+    const ha_limb ai = a[i];
+    r[i] = ai - borrow;
+    borrow = ai < borrow;
+  }
+  return borrow;
+}
+
+// mag_mul_1(r, a, an, b) sets r[0..an) to the low an limbs of a * b and
+//   returns the high limb
+// requires: r may be the same array as a
+// time: O(an)
+static ha_limb mag_mul_1(ha_limb *r, const ha_limb *a, int an, ha_limb b) {
+  if (an >= KERNEL_MIN_LIMBS) {
+    return kernels()->mul_1(r, a, an, b);
+  }
+  ha_limb carry = 0;
+  for (int i = 0; i < an; ++i) {
+    const ha_dlimb prod = (ha_dlimb)a[i] * b + carry;
+    r[i] = (ha_limb)prod;
+    carry = (ha_limb)(prod >> LIMB_BITS);
+  }
+  return carry;
+}
+
+// mag_addmul_1(r, a, an, b) adds a * b to r[0..an) and returns the carry out
+// time: O(an)
+static ha_limb mag_addmul_1(ha_limb *r, const ha_limb *a, int an, ha_limb b) {
+  if (an >= KERNEL_MIN_LIMBS) {
+    return kernels()->addmul_1(r, a, an, b);
+  }
+  ha_limb carry = 0;
+  for (int i = 0; i < an; ++i) {
+    const ha_dlimb prod = (ha_dlimb)a[i] * b + r[i] + carry;
+    r[i] = (ha_limb)prod;
+    carry = (ha_limb)(prod >> LIMB_BITS);
+  }
+  return carry;
+}
+
+// mag_divmod_1(q, a, an, d) sets q[0..an) to a / d and returns a % d
+// requires: d != 0
+//           q may be the same array as a
+// time: O(an)
+static ha_limb mag_divmod_1(ha_limb *q, const ha_limb *a, int an, ha_limb d) {
+  assert(d);
+  ha_dlimb rem = 0;
+  for (int i = an - 1; i >= 0; --i) {
+    const ha_dlimb cur = (rem << LIMB_BITS) | a[i];
+    q[i] = (ha_limb)(cur / d);
+    rem = cur % d;
+  }
+  return (ha_limb)rem;
+}
+
+// feed_digits(n, digits, digit_num) sets n to the integer written with the
+//   digit_num decimal digits at digits
+// requires: n->len == 0, n has room for one limb per LIMB_DEC_DIGITS digits
+//           digits[0..digit_num) are decimal digits
+// effects: modifies n (the sign is left to the caller)
+// time: O(digit_num^2)
+static void feed_digits(struct ha_int *n, const char *digits, int digit_num) {
+  assert(n);
+  assert(digits);
+  assert(n->len == 0);
+  // feed the digits in chunks: n = n * 10^chunk_len + chunk
+  // the first chunk is short so that the others are full
+  int chunk_len = digit_num % LIMB_DEC_DIGITS;
+  if (chunk_len == 0) {
+    chunk_len = LIMB_DEC_DIGITS;
+  }
+  int idx = 0;
+  while (idx < digit_num) {
+    ha_limb chunk = 0;
+    ha_limb scale = 1;
+    for (int j = 0; j < chunk_len; ++j) {
+      chunk = chunk * 10 + (digits[idx] - '0');
+      scale *= 10;
+      ++idx;
+    }
+    ha_limb carry = mag_mul_1(n->limbs, n->limbs, n->len, scale);
+    carry += mag_add(n->limbs, n->limbs, n->len, &chunk, n->len > 0 ? 1 : 0);
+    if (n->len == 0) {
+      n->limbs[0] = chunk;
+      n->len = 1;
+    } else if (carry) {
+      n->limbs[n->len] = carry;
+      ++n->len;
+    }
+    chunk_len = LIMB_DEC_DIGITS;
+  }
+}
+
+struct ha_int *ha_int_create(const char *s) {
+  assert(s);
+  const int s_len = strlen(s);
+  bool sign = true;
+
+  // situations where s is an invalid integer
+  if (s_len == 0) { // s is an empty string
+    print_invalid_integer(s);
+    return NULL;
+  }
+  int s_idx = 0; // current index of s
+  int digit_num = s_len; // number of digits in s
+  if (s[0] == '-') { // s is negative
+    if (s_len == 1 || s[1] < '1' || s[1] > '9') {
+      print_invalid_integer(s);
+      return NULL;
+    }
+    sign = false;
+    ++s_idx;
+    --digit_num;
+  }
+  if (s[0] == '0' && s_len > 1) { // successive 0s ahead
+    print_invalid_integer(s);
+    return NULL;
+  }
+  for (int i = s_idx; i < s_len; ++i) {
+    if (s[i] < '0' || s[i] > '9') { // s has other invalid chars
+      print_invalid_integer(s);
+      return NULL;
+    }
+  }
+
+  // s is a valid integer
+  // every LIMB_DEC_DIGITS decimal digits fit in one limb
+  struct ha_int *integer =
+    alloc_int((digit_num + LIMB_DEC_DIGITS - 1) / LIMB_DEC_DIGITS);
+  feed_digits(integer, s + s_idx, digit_num);
+  integer->sign = sign;
+  remove_leading_zeros(integer);
+  return integer;
+}
+
+void ha_int_destroy(struct ha_int *integer) {
+  assert(integer);
+  free_limbs(integer);
+  ha_release_node(integer->arena, integer, sizeof(struct ha_int));
+}
+
+void ha_int_print(const struct ha_int *integer, bool newline) {
+  assert(integer);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_int_write(&buf, integer);
+  if (newline) {
+    ha_buffer_putc(&buf, '\n');
+  }
+  ha_buffer_flush(&buf, stdout);
+  ha_buffer_free(&buf);
+}
+
+struct ha_int *ha_int_copy(const struct ha_int *n) {
+  assert(n);
+  struct ha_int *new_int = alloc_int(0);
+  ha_int_set(new_int, n);
+  return new_int;
+}
+
+const struct ha_int *ha_int_constant(int k) {
+  assert(-HA_INT_CONSTANT_MAX <= k && k <= HA_INT_CONSTANT_MAX);
+  return &int_constants[k + HA_INT_CONSTANT_MAX];
+}
+
+bool ha_int_eq(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+
+  // different signs
+  if (n->sign != m->sign) {
+    return false;
+  }
+
+  // same sign
+  return mag_cmp(n->limbs, n->len, m->limbs, m->len) == 0;
+}
+
+// abs_gt(n, m) determines if |n| > |m|
+// time: O(logn + logm)
+static bool abs_gt(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  return mag_cmp(n->limbs, n->len, m->limbs, m->len) > 0;
+}
+
+bool ha_int_gt(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+
+  // n and m have different signs
+  if (n->sign && !m->sign) { // n is +ve/0, m is -ve
+    return true;
+  } else if (!n->sign && m->sign) { // n is -ve, m is +ve/0
+    return false;
+  }
+
+  // n and m have same signs
+  if (n->sign) { // positive or 0
+    return abs_gt(n, m);
+  } else { // negative
+    return abs_gt(m, n);
+  }
+}
+
+// target_limbs(dst, cap, shared) gives the array a new value of dst with up to
+//   cap limbs is written into: the limbs of dst if they are big enough and
+//   are not shared with an operand (or another integer), or a new array from
+//   the context of dst otherwise
+// notes: the array must be handed back with set_limbs
+// effects: may allocate memory
+// time: O(1)
+static ha_limb *target_limbs(struct ha_int *dst, int cap, bool shared) {
+  assert(dst);
+  if (!shared && room(dst) >= cap) {
+    return dst->limbs;
+  }
+  return alloc_limbs(dst->arena, max(cap, 1));
+}
+
+// reserve_limbs(n, cap) makes room for cap limbs in n, keeping its value
+// effects: may allocate memory from the context of n
+// time: O(logn)
+static void reserve_limbs(struct ha_int *n, int cap) {
+  assert(n);
+  if (room(n) >= cap) {
+    return;
+  }
+  cap = max(cap, max(n->len, 1));
+  ha_limb *limbs = alloc_limbs(n->arena, cap);
+  memcpy(limbs, n->limbs, n->len * sizeof(ha_limb));
+  free_limbs(n);
+  n->limbs = limbs;
+  n->cap = cap;
+}
+
+// set_limbs(dst, limbs, cap, len, sign) makes limbs[0..len) with the given
+//   sign the new value of dst, where limbs came from target_limbs(dst, cap, _)
+// effects: modifies dst
+//          may free the old limbs of dst
+// time: O(len)
+static void set_limbs(struct ha_int *dst, ha_limb *limbs, int cap, int len,
+                      bool sign) {
+  assert(dst);
+  assert(limbs);
+  const bool fresh = limbs != dst->limbs;
+  if (fresh) {
+    free_limbs(dst);
+    dst->limbs = limbs;
+    dst->cap = max(cap, 1);
+  }
+  dst->len = len;
+  dst->sign = sign;
+  remove_leading_zeros(dst);
+  if (fresh && dst->len <= INLINE_LIMBS) {
+    // a small result goes back inline instead of keeping the new array
+    memcpy(dst->small, dst->limbs, dst->len * sizeof(ha_limb));
+    release_limbs(dst->arena, dst->limbs, dst->cap);
+    dst->limbs = dst->small;
+    dst->cap = INLINE_LIMBS;
+  }
+}
+
+// add_signed(dst, n, m, m_len, m_sign) sets dst to n + m, where m is the
+//   magnitude m[0..m_len) with the sign m_sign (true for positive)
+// notes: dst may be n, and m may be the limbs of dst
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn + m_len)
+static void add_signed(struct ha_int *dst, const struct ha_int *n,
+                       const ha_limb *m, int m_len, bool m_sign) {
+  assert(dst);
+  assert(n);
+  if (n->len <= INLINE_LIMBS && m_len <= INLINE_LIMBS) { // native fast path
+    const ha_dlimb a = get_dlimb(n->limbs, n->len);
+    const ha_dlimb b = get_dlimb(m, m_len);
+    if (n->sign != m_sign) {
+      set_small(dst, a >= b ? a - b : b - a, a >= b ? n->sign : m_sign);
+      return;
+    } else if (a + b >= a) { // no overflow
+      set_small(dst, a + b, m_sign);
+      return;
+    }
+  }
+
+  const ha_limb *big = n->limbs;
+  int big_len = n->len;
+  bool big_sign = n->sign;
+  const ha_limb *small = m;
+  int small_len = m_len;
+  bool small_sign = m_sign;
+  if (mag_cmp(big, big_len, small, small_len) < 0) { // |n| < |m|
+    big = m;
+    big_len = m_len;
+    big_sign = m_sign;
+    small = n->limbs;
+    small_len = n->len;
+    small_sign = n->sign;
+  }
+
+  // mag_add and mag_sub allow the result to overwrite an operand, so the
+  // limbs of dst can be reused even if they hold n or m
+  const int cap = big_len + 1;
+  ha_limb *limbs = target_limbs(dst, cap, false);
+  if (big_sign == small_sign) { // same signs: add the magnitudes
+    limbs[big_len] = mag_add(limbs, big, big_len, small, small_len);
+    set_limbs(dst, limbs, cap, big_len + 1, big_sign);
+  } else { // different signs: the bigger magnitude decides the sign
+    mag_sub(limbs, big, big_len, small, small_len);
+    set_limbs(dst, limbs, cap, big_len, big_sign);
+  }
+}
+
+void ha_int_add_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  add_signed(dst, n, m->limbs, m->len, m->sign);
+}
+
+void ha_int_sub_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  add_signed(dst, n, m->limbs, m->len, !m->sign);
+}
+
+struct ha_int *ha_int_add(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *new_int = alloc_int(max(n->len, m->len) + 1);
+  ha_int_add_into(new_int, n, m);
+  return new_int;
+}
+
+struct ha_int *ha_int_sub(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *new_int = alloc_int(max(n->len, m->len) + 1);
+  ha_int_sub_into(new_int, n, m);
+  return new_int;
+}
+
+void ha_int_set(struct ha_int *dst, const struct ha_int *n) {
+  assert(dst);
+  assert(n);
+  if (dst == n) {
+    return;
+  }
+  if (!dst->arena && !n->arena && owns_block(n) && n->len > INLINE_LIMBS &&
+      room(dst) < n->len) {
+    // dst would need a new array anyway, so it shares the one of n
+    free_limbs(dst);
+    atomic_fetch_add_explicit(&block_of(n->limbs)->refs, 1,
+                              memory_order_relaxed);
+    dst->limbs = n->limbs;
+    dst->cap = n->cap;
+    dst->len = n->len;
+    dst->sign = n->sign;
+    return;
+  }
+  ha_limb *limbs = target_limbs(dst, n->len, false);
+  memcpy(limbs, n->limbs, n->len * sizeof(ha_limb));
+  set_limbs(dst, limbs, n->len, n->len, n->sign);
+}
+
+void ha_int_set_digits(struct ha_int *dst, const char *digits, int len,
+                       bool negative) {
+  assert(dst);
+  assert(digits);
+  assert(len > 0);
+  dst->len = 0;
+  reserve_limbs(dst, (len + LIMB_DEC_DIGITS - 1) / LIMB_DEC_DIGITS);
+  feed_digits(dst, digits, len);
+  dst->sign = !negative;
+  remove_leading_zeros(dst);
+}
+
+void ha_int_set_bytes(struct ha_int *dst, const unsigned char *bytes,
+                      size_t len, bool negative) {
+  assert(dst);
+  assert(bytes || len == 0);
+  const int limb_bytes = LIMB_BITS / 8;
+  const int cap = (len + limb_bytes - 1) / limb_bytes;
+  ha_limb *limbs = target_limbs(dst, cap, false);
+  memset(limbs, 0, cap * sizeof(ha_limb));
+  for (size_t i = 0; i < len; ++i) {
+    limbs[i / limb_bytes] |= (ha_limb)bytes[i] << (i % limb_bytes * 8);
+  }
+  set_limbs(dst, limbs, cap, cap, !negative);
+}
+
+void ha_int_swap(struct ha_int *n, struct ha_int *m) {
+  assert(n);
+  assert(m);
+  if (n->arena != m->arena) {
+    // storage must stay in its context, so the limbs are exchanged instead
+    reserve_limbs(n, m->len);
+    reserve_limbs(m, n->len);
+    struct ha_int *shorter = n->len <= m->len ? n : m;
+    struct ha_int *longer = n->len <= m->len ? m : n;
+    for (int i = 0; i < shorter->len; ++i) {
+      const ha_limb limb = n->limbs[i];
+      n->limbs[i] = m->limbs[i];
+      m->limbs[i] = limb;
+    }
+    memcpy(shorter->limbs + shorter->len, longer->limbs + shorter->len,
+           (longer->len - shorter->len) * sizeof(ha_limb));
+    const int len = n->len;
+    const bool sign = n->sign;
+    n->len = m->len;
+    n->sign = m->sign;
+    m->len = len;
+    m->sign = sign;
+    return;
+  }
+  // inline limbs move with the struct, so their pointers must follow
+  const bool n_inline = n->limbs == n->small;
+  const bool m_inline = m->limbs == m->small;
+  const struct ha_int temp = *n;
+  *n = *m;
+  *m = temp;
+  if (m_inline) {
+    n->limbs = n->small;
+  }
+  if (n_inline) {
+    m->limbs = m->small;
+  }
+}
+
+void ha_int_negate(struct ha_int *n) {
+  assert(n);
+  n->sign = !n->sign;
+  remove_leading_zeros(n);
+}
+
+int ha_int_sign(const struct ha_int *n) {
+  assert(n);
+  if (n->len == 0) {
+    return 0;
+  }
+  return n->sign ? 1 : -1;
+}
+
+int ha_int_bit_length(const struct ha_int *n) {
+  assert(n);
+  if (n->len == 0) {
+    return 0;
+  }
+  int bits = (n->len - 1) * LIMB_BITS;
+  for (ha_limb top = n->limbs[n->len - 1]; top; top >>= 1) {
+    ++bits;
+  }
+  return bits;
+}
+
+uint64_t ha_int_mod_word(const struct ha_int *n, uint64_t m) {
+  assert(n);
+  assert(m > 0);
+  uint64_t r = 0;
+  for (int i = n->len - 1; i >= 0; --i) {
+#if LIMB_BITS == 64
+    r = (((ha_dlimb)r << LIMB_BITS) | n->limbs[i]) % m;
+#elif defined(__SIZEOF_INT128__)
+    r = (((unsigned __int128)r << LIMB_BITS) | n->limbs[i]) % m;
+#else
+    assert(m <= UINT32_MAX);
+    r = ((r << LIMB_BITS) | n->limbs[i]) % m;
+#endif
+  }
+  return n->sign || r == 0 ? r : m - r;
+}
+
+// is_zero(n) determines if n is zero
+// time: O(1)
+static bool is_zero(const struct ha_int *n) {
+  assert(n);
+  return n->len == 0;
+}
+
+// mult_div_sign(n, m) determines the sign for n * m and n / m
+// note: returning true means positive or 0, false means negative
+// time: O(1)
+static bool mult_div_sign(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  if (is_zero(n) || is_zero(m)) {
+    return true;
+  } else {
+    if (n->sign == m->sign) { // same sign
+      return true;
+    } else { // different signs
+      return false;
+    }
+  }
+}
+
+// operand sizes (in limbs) at which multiplication switches to Karatsuba and
+//   to Toom-3, see ha_int_set_mult_thresholds
+// notes: the defaults come from running the mult workload of benchmark.c
+static int karatsuba_threshold = 36;
+static int toom3_threshold = 480;
+
+// the smallest thresholds that still guarantee the recursion shrinks
+#define KARATSUBA_MIN_THRESHOLD 4
+#define TOOM3_MIN_THRESHOLD 9
+
+// digits_to_limbs(digits) gives the number of limbs of a digits-digit integer
+// time: O(1)
+static int digits_to_limbs(int digits) {
+  // log2(10) < 3.3220
+  const long long bits = (long long)digits * 33220 / 10000 + 1;
+  const long long limbs = (bits + LIMB_BITS - 1) / LIMB_BITS;
+  return limbs > INT_MAX ? INT_MAX : (int)limbs;
+}
+
+// limbs_to_digits(limbs) is the inverse of digits_to_limbs
+// time: O(1)
+static int limbs_to_digits(int limbs) {
+  if (limbs == INT_MAX) {
+    return INT_MAX;
+  }
+  const long long digits = (long long)limbs * LIMB_BITS * 10000 / 33220;
+  return digits > INT_MAX ? INT_MAX : (int)digits;
+}
+
+void ha_int_set_mult_thresholds(int karatsuba, int toom3) {
+  assert(karatsuba > 0);
+  assert(toom3 > 0);
+  karatsuba_threshold = max(digits_to_limbs(karatsuba),
+                            KARATSUBA_MIN_THRESHOLD);
+  toom3_threshold = max(max(digits_to_limbs(toom3), TOOM3_MIN_THRESHOLD),
+                        karatsuba_threshold);
+}
+
+void ha_int_get_mult_thresholds(int *karatsuba, int *toom3) {
+  assert(karatsuba);
+  assert(toom3);
+  *karatsuba = limbs_to_digits(karatsuba_threshold);
+  *toom3 = limbs_to_digits(toom3_threshold);
+}
+
+void ha_int_set_simd(bool enabled) {
+  simd = enabled;
+}
+
+const char *ha_int_simd(void) {
+  return kernels()->name;
+}
+
+// limb_view(limbs, len) returns a non-negative ha_int that borrows
+//   limbs[0..len) without copying them
+// notes: the view must not be destroyed or modified
+// time: O(len)
+static struct ha_int limb_view(const ha_limb *limbs, int len) {
+  struct ha_int view = {true, len, 0, (ha_limb *)limbs, NULL, {0}};
+  remove_leading_zeros(&view);
+  return view;
+}
+
+// div_exact_small(n, d) divides n by d in place
+// requires: d divides n, d != 0
+// effects: modifies n
+// time: O(logn)
+static void div_exact_small(struct ha_int *n, ha_limb d) {
+  assert(n);
+  const ha_limb remainder = mag_divmod_1(n->limbs, n->limbs, n->len, d);
+  assert(remainder == 0);
+  (void)remainder;
+  remove_leading_zeros(n);
+}
+
+// replace(old, new_int) destroys old and returns new_int
+// effects: old is no longer valid
+// time: O(1)
+static struct ha_int *replace(struct ha_int *old, struct ha_int *new_int) {
+  ha_int_destroy(old);
+  return new_int;
+}
+
+static void mag_mul(ha_limb *r, const ha_limb *a, int an,
+                    const ha_limb *b, int bn);
+
+// mag_mul_basecase(r, a, an, b, bn) sets r[0..an+bn) to a * b with the
+//   schoolbook method
+// requires: r does not overlap a or b
+// time: O(an * bn)
+static void mag_mul_basecase(ha_limb *r, const ha_limb *a, int an,
+                             const ha_limb *b, int bn) {
+  memset(r, 0, (an + bn) * sizeof(ha_limb));
+  for (int i = 0; i < bn; ++i) {
+    r[an + i] = mag_addmul_1(r + i, a, an, b[i]);
+  }
+}
+
+// mag_mul_unbalanced(r, a, an, b, bn) sets r[0..an+bn) to a * b by
+//   multiplying b with bn-limb slices of a
+// requires: an >= bn > 0
+//           r does not overlap a or b
+// time: O(an / bn * M(bn)), where M is the cost of a balanced multiplication
+static void mag_mul_unbalanced(ha_limb *r, const ha_limb *a, int an,
+                               const ha_limb *b, int bn) {
+  assert(an >= bn && bn > 0);
+  ha_limb *slice = ha_alloc(NULL, 2 * bn * sizeof(ha_limb));
+  memset(r, 0, (an + bn) * sizeof(ha_limb));
+  for (int offset = 0; offset < an; offset += bn) {
+    const int slice_len = an - offset < bn ? an - offset : bn;
+    mag_mul(slice, b, bn, a + offset, slice_len);
+    mag_add(r + offset, r + offset, an + bn - offset, slice, bn + slice_len);
+  }
+  ha_release(NULL, slice);
+}
+
+// mag_mul_karatsuba(r, a, an, b, bn) sets r[0..an+bn) to a * b with
+//   a = a1 * B^h + a0, b = b1 * B^h + b0 and
+//   a * b = z2 * B^2h + ((a0 + a1)(b0 + b1) - z2 - z0) * B^h + z0,
+//   where z2 = a1 * b1 and z0 = a0 * b0
+// requires: an >= bn > (an + 1) / 2
+//           r does not overlap a or b
+// time: O(an^1.585)
+static void mag_mul_karatsuba(ha_limb *r, const ha_limb *a, int an,
+                              const ha_limb *b, int bn) {
+  const int h = (an + 1) / 2;
+  assert(an >= bn && bn > h);
+  const ha_limb *a0 = a;
+  const ha_limb *a1 = a + h;
+  const ha_limb *b0 = b;
+  const ha_limb *b1 = b + h;
+  ha_limb *sum_a = ha_alloc(NULL, (h + 1) * sizeof(ha_limb));
+  ha_limb *sum_b = ha_alloc(NULL, (h + 1) * sizeof(ha_limb));
+  ha_limb *z1 = ha_alloc(NULL, (2 * h + 2) * sizeof(ha_limb));
+
+  sum_a[h] = mag_add(sum_a, a0, h, a1, an - h);
+  sum_b[h] = mag_add(sum_b, b0, h, b1, bn - h);
+  mag_mul(z1, sum_a, h + 1, sum_b, h + 1);
+  mag_mul(r, a0, h, b0, h); // z0
+  mag_mul(r + 2 * h, a1, an - h, b1, bn - h); // z2
+  mag_sub(z1, z1, 2 * h + 2, r, 2 * h);
+  mag_sub(z1, z1, 2 * h + 2, r + 2 * h, an + bn - 2 * h);
+
+  int z1_len = 2 * h + 2;
+  while (z1_len > 0 && z1[z1_len - 1] == 0) {
+    --z1_len;
+  }
+  mag_add(r + h, r + h, an + bn - h, z1, z1_len);
+  ha_release(NULL, sum_a);
+  ha_release(NULL, sum_b);
+  ha_release(NULL, z1);
+}
+
+// mag_mul_toom3(r, a, an, b, bn) sets r[0..an+bn) to a * b by splitting both
+//   into 3 parts, evaluating at 0, 1, -1, -2 and infinity, and interpolating
+// requires: an >= bn > 2 * ((an + 2) / 3)
+//           r does not overlap a or b
+// time: O(an^1.465)
+static void mag_mul_toom3(ha_limb *r, const ha_limb *a, int an,
+                          const ha_limb *b, int bn) {
+  const int k = (an + 2) / 3;
+  assert(an >= bn && bn > 2 * k);
+  const struct ha_int a0 = limb_view(a, k);
+  const struct ha_int a1 = limb_view(a + k, k);
+  const struct ha_int a2 = limb_view(a + 2 * k, an - 2 * k);
+  const struct ha_int b0 = limb_view(b, k);
+  const struct ha_int b1 = limb_view(b + k, k);
+  const struct ha_int b2 = limb_view(b + 2 * k, bn - 2 * k);
+
+  // the temporaries below are heap values even when an arena is in use,
+  // since they are freed straight away
+  struct ha_arena *arena = ha_arena_use(NULL);
+
+  // evaluation: p(x) = a2 * x^2 + a1 * x + a0, and q(x) likewise
+  struct ha_int *p = ha_int_add(&a0, &a2);
+  struct ha_int *p1 = ha_int_add(p, &a1);
+  struct ha_int *pm1 = ha_int_sub(p, &a1);
+  struct ha_int *pm2 = ha_int_add(pm1, &a2);
+  pm2 = replace(pm2, ha_int_add(pm2, pm2));
+  pm2 = replace(pm2, ha_int_sub(pm2, &a0));
+  ha_int_destroy(p);
+  struct ha_int *q = ha_int_add(&b0, &b2);
+  struct ha_int *q1 = ha_int_add(q, &b1);
+  struct ha_int *qm1 = ha_int_sub(q, &b1);
+  struct ha_int *qm2 = ha_int_add(qm1, &b2);
+  qm2 = replace(qm2, ha_int_add(qm2, qm2));
+  qm2 = replace(qm2, ha_int_sub(qm2, &b0));
+  ha_int_destroy(q);
+
+  // pointwise products
+  struct ha_int *r0 = ha_int_mult(&a0, &b0);
+  struct ha_int *r1 = ha_int_mult(p1, q1);
+  struct ha_int *rm1 = ha_int_mult(pm1, qm1);
+  struct ha_int *r2 = ha_int_mult(pm2, qm2); // holds r(-2) for now
+  struct ha_int *r4 = ha_int_mult(&a2, &b2);
+  ha_int_destroy(p1);
+  ha_int_destroy(pm1);
+  ha_int_destroy(pm2);
+  ha_int_destroy(q1);
+  ha_int_destroy(qm1);
+  ha_int_destroy(qm2);
+
+  // interpolation
+  struct ha_int *r3 = ha_int_sub(r2, r1);
+  div_exact_small(r3, 3);
+  r1 = replace(r1, ha_int_sub(r1, rm1));
+  div_exact_small(r1, 2);
+  r2 = replace(r2, ha_int_sub(rm1, r0));
+  r3 = replace(r3, ha_int_sub(r2, r3));
+  div_exact_small(r3, 2);
+  struct ha_int *r4_twice = ha_int_add(r4, r4);
+  r3 = replace(r3, ha_int_add(r3, r4_twice));
+  ha_int_destroy(r4_twice);
+  r2 = replace(r2, ha_int_add(r2, r1));
+  r2 = replace(r2, ha_int_sub(r2, r4));
+  r1 = replace(r1, ha_int_sub(r1, r3));
+  ha_int_destroy(rm1);
+
+  // recomposition: r0 + r1 * B^k + r2 * B^2k + r3 * B^3k + r4 * B^4k
+  const struct ha_int *coefficients[5] = {r0, r1, r2, r3, r4};
+  memset(r, 0, (an + bn) * sizeof(ha_limb));
+  for (int i = 0; i < 5; ++i) {
+    const struct ha_int *c = coefficients[i];
+    assert(c->sign);
+    mag_add(r + i * k, r + i * k, an + bn - i * k, c->limbs, c->len);
+  }
+  ha_int_destroy(r0);
+  ha_int_destroy(r1);
+  ha_int_destroy(r2);
+  ha_int_destroy(r3);
+  ha_int_destroy(r4);
+  ha_arena_use(arena);
+}
+
+// mag_mul(r, a, an, b, bn) sets r[0..an+bn) to a * b, choosing schoolbook,
+//   Karatsuba or Toom-3 by the size of the shorter operand
+// requires: r does not overlap a or b
+// time: O(an * bn) at worst
+static void mag_mul(ha_limb *r, const ha_limb *a, int an,
+                    const ha_limb *b, int bn) {
+  if (an < bn) { // make a the longer one
+    const ha_limb *temp = a;
+    a = b;
+    b = temp;
+    const int temp_len = an;
+    an = bn;
+    bn = temp_len;
+  }
+
+  if (bn < karatsuba_threshold) {
+    mag_mul_basecase(r, a, an, b, bn);
+  } else if (bn <= (an + 1) / 2) {
+    mag_mul_unbalanced(r, a, an, b, bn);
+  } else if (bn >= toom3_threshold && bn > 2 * ((an + 2) / 3)) {
+    mag_mul_toom3(r, a, an, b, bn);
+  } else {
+    mag_mul_karatsuba(r, a, an, b, bn);
+  }
+}
+
+void ha_int_mult_into(struct ha_int *dst, const struct ha_int *n,
+                      const struct ha_int *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  HA_STATS_MULT(n->len < m->len ? n->len : m->len);
+  if (n->len <= 1 && m->len <= 1) { // native fast path
+    set_small(dst, get_dlimb(n->limbs, n->len) * get_dlimb(m->limbs, m->len),
+              mult_div_sign(n, m));
+    return;
+  }
+
+  // mag_mul cannot write over its operands
+  const int cap = n->len + m->len;
+  ha_limb *limbs = target_limbs(dst, cap, dst == n || dst == m);
+  mag_mul(limbs, n->limbs, n->len, m->limbs, m->len);
+  set_limbs(dst, limbs, cap, cap, mult_div_sign(n, m));
+}
+
+struct ha_int *ha_int_mult(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *new_int = alloc_int(n->len + m->len);
+  ha_int_mult_into(new_int, n, m);
+  return new_int;
+}
+
+// size of the product buffer ha_int_addmul keeps on the stack
+#define ADDMUL_STACK_LIMBS 32
+
+void ha_int_addmul(struct ha_int *acc, const struct ha_int *n,
+                   const struct ha_int *m) {
+  assert(acc);
+  assert(n);
+  assert(m);
+  HA_STATS_MULT(n->len < m->len ? n->len : m->len);
+  const int len = n->len + m->len;
+  ha_limb stack_product[ADDMUL_STACK_LIMBS];
+  ha_limb *product = stack_product;
+  if (len > ADDMUL_STACK_LIMBS) {
+    product = ha_alloc(NULL, len * sizeof(ha_limb));
+  }
+  mag_mul(product, n->limbs, n->len, m->limbs, m->len);
+  int product_len = len;
+  while (product_len > 0 && product[product_len - 1] == 0) {
+    --product_len;
+  }
+  add_signed(acc, acc, product, product_len, mult_div_sign(n, m));
+  if (product != stack_product) {
+    ha_release(NULL, product);
+  }
+}
+
+// leading_zero_bits(x) gives the number of leading zero bits of x
+// requires: x != 0
+// time: O(1)
+static int leading_zero_bits(ha_limb x) {
+  assert(x);
+  int bits = 0;
+  for (int shift = LIMB_BITS / 2; shift > 0; shift /= 2) {
+    if (x >> (LIMB_BITS - shift) == 0) {
+      x <<= shift;
+      bits += shift;
+    }
+  }
+  return bits;
+}
+
+// mag_lshift(r, a, an, shift) sets r[0..an) to the low an limbs of
+//   a * 2^shift and returns the bits shifted out
+// requires: 0 <= shift < LIMB_BITS
+//           r may be the same array as a
+// time: O(an)
+static ha_limb mag_lshift(ha_limb *r, const ha_limb *a, int an, int shift) {
+  assert(0 <= shift && shift < LIMB_BITS);
+  if (shift == 0) {
+    memmove(r, a, an * sizeof(ha_limb));
+    return 0;
+  }
+  ha_limb out = 0;
+  for (int i = an - 1; i >= 0; --i) {
+    const ha_limb ai = a[i];
+    if (i == an - 1) {
+      out = ai >> (LIMB_BITS - shift);
+    }
+    r[i] = (ai << shift) | (i > 0 ? a[i - 1] >> (LIMB_BITS - shift) : 0);
+  }
+  return out;
+}
+
+// mag_rshift(r, a, an, shift) sets r[0..an) to a / 2^shift
+// requires: 0 <= shift < LIMB_BITS
+//           r may be the same array as a
+// time: O(an)
+static void mag_rshift(ha_limb *r, const ha_limb *a, int an, int shift) {
+  assert(0 <= shift && shift < LIMB_BITS);
+  if (shift == 0) {
+    memmove(r, a, an * sizeof(ha_limb));
+    return;
+  }
+  for (int i = 0; i < an; ++i) {
+    r[i] = (a[i] >> shift) |
+      (i + 1 < an ? a[i + 1] << (LIMB_BITS - shift) : 0);
+  }
+}
+
+// mag_submul_1(r, a, an, b) subtracts a * b from r[0..an) and returns the
+//   borrow out
+// time: O(an)
+static ha_limb mag_submul_1(ha_limb *r, const ha_limb *a, int an, ha_limb b) {
+  ha_limb borrow = 0;
+  for (int i = 0; i < an; ++i) {
+    const ha_dlimb prod = (ha_dlimb)a[i] * b + borrow;
+    const ha_limb low = (ha_limb)prod;
+    ha_limb high = (ha_limb)(prod >> LIMB_BITS);
+    const ha_limb ri = r[i];
+    r[i] = ri - low;
+    high += ri < low;
+    borrow = high;
+  }
+  return borrow;
+}
+
+// mag_divmod_knuth(q, u, un, v, vn) divides u by v with Knuth's Algorithm D
+//   (TAOCP vol. 2, 4.3.1), setting q[0..un-vn] to the quotient and leaving
+//   the remainder in u[0..vn)
+// requires: un >= vn >= 2
+//           the top limb of v has its highest bit set (v is normalized)
+//           u has un + 1 limbs, the top one being 0 or the bits shifted out
+//           when u was normalized
+// effects: modifies u and q
+// time: O(vn * (un - vn + 1))
+static void mag_divmod_knuth(ha_limb *q, ha_limb *u, int un,
+                             const ha_limb *v, int vn) {
+  assert(un >= vn && vn >= 2);
+  const ha_limb v_top = v[vn - 1];
+  const ha_limb v_next = v[vn - 2];
+  for (int j = un - vn; j >= 0; --j) {
+    // estimate the quotient limb from the top two limbs of the dividend and
+    // the top limb of the divisor, then refine it with the next limb; the
+    // estimate is then at most one too large
+    const ha_dlimb top = ((ha_dlimb)u[j + vn] << LIMB_BITS) | u[j + vn - 1];
+    ha_dlimb q_hat = top / v_top;
+    ha_dlimb r_hat = top % v_top;
+    while ((q_hat >> LIMB_BITS) ||
+           q_hat * v_next > ((r_hat << LIMB_BITS) | u[j + vn - 2])) {
+      --q_hat;
+      r_hat += v_top;
+      if (r_hat >> LIMB_BITS) {
+        break;
+      }
+    }
+
+    // subtract q_hat * v, adding v back if q_hat was one too large
+    const ha_limb borrow = mag_submul_1(u + j, v, vn, (ha_limb)q_hat);
+    const ha_limb u_top = u[j + vn];
+    u[j + vn] = u_top - borrow;
+    if (u_top < borrow) {
+      --q_hat;
+      u[j + vn] += mag_add(u + j, u + j, vn, v, vn);
+    }
+    q[j] = (ha_limb)q_hat;
+  }
+}
+
+// abs_divmod_into(quotient, remainder, n, m) sets quotient to |n| / |m| and
+//   remainder to |n| % |m|
+// notes: either quotient or remainder may be NULL if it is not needed
+//        quotient and remainder may be n or m, but not each other
+// requires: m is not 0
+// effects: modifies quotient and remainder
+//          may allocate memory
+// time: O(logm * (logn - logm + 1))
+static void abs_divmod_into(struct ha_int *quotient, struct ha_int *remainder,
+                            const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  assert(!is_zero(m));
+  assert(!quotient || quotient != remainder);
+  HA_STATS_COUNT(divmod);
+  const int n_len = n->len;
+  const int m_len = m->len;
+
+  if (n_len <= INLINE_LIMBS && m_len <= INLINE_LIMBS) { // native fast path
+    const ha_dlimb a = get_dlimb(n->limbs, n_len);
+    const ha_dlimb b = get_dlimb(m->limbs, m_len);
+    if (quotient) {
+      set_small(quotient, a / b, true);
+    }
+    if (remainder) {
+      set_small(remainder, a % b, true);
+    }
+    return;
+  }
+  if (n_len < m_len) { // |n| < |m|
+    if (remainder) {
+      ha_int_set(remainder, n);
+      remainder->sign = true;
+    }
+    if (quotient) {
+      quotient->len = 0;
+      quotient->sign = true;
+    }
+    return;
+  }
+
+  // results are written to new arrays whenever they would overwrite n or m,
+  // and only handed to quotient and remainder at the end
+  const int q_cap = n_len - m_len + 1;
+  ha_limb *q = quotient
+    ? target_limbs(quotient, q_cap, quotient == n || quotient == m)
+    : ha_alloc(NULL, q_cap * sizeof(ha_limb));
+  const int r_cap = m_len == 1 ? 1 : n_len + 1;
+  ha_limb *r = remainder
+    ? target_limbs(remainder, r_cap, remainder == n || remainder == m)
+    : ha_alloc(NULL, r_cap * sizeof(ha_limb));
+
+  if (m_len == 1) { // single-limb divisor
+    r[0] = mag_divmod_1(q, n->limbs, n_len, m->limbs[0]);
+  } else {
+    // normalize so that the top bit of the divisor is set; the dividend is
+    // shifted into r, where the remainder is left
+    const int shift = leading_zero_bits(m->limbs[m_len - 1]);
+    ha_limb *v = m->limbs;
+    if (shift) {
+      v = ha_alloc(NULL, m_len * sizeof(ha_limb));
+      mag_lshift(v, m->limbs, m_len, shift);
+    }
+    r[n_len] = mag_lshift(r, n->limbs, n_len, shift);
+    mag_divmod_knuth(q, r, n_len, v, m_len);
+    mag_rshift(r, r, m_len, shift);
+    if (v != m->limbs) {
+      ha_release(NULL, v);
+    }
+  }
+
+  if (quotient) {
+    set_limbs(quotient, q, q_cap, q_cap, true);
+  } else {
+    ha_release(NULL, q);
+  }
+  if (remainder) {
+    set_limbs(remainder, r, r_cap, m_len, true);
+  } else {
+    ha_release(NULL, r);
+  }
+}
+
+// abs_divmod(n, m, quotient, remainder) sets *quotient to |n| / |m| and
+//   *remainder to |n| % |m|
+// notes: either quotient or remainder may be NULL if it is not needed
+// requires: m is not 0
+// effects: allocates memory (caller must call ha_int_destroy on the results)
+// time: O(logm * (logn - logm + 1))
+static void abs_divmod(const struct ha_int *n, const struct ha_int *m,
+                       struct ha_int **quotient, struct ha_int **remainder) {
+  assert(n);
+  assert(m);
+  struct ha_int *q = quotient ? alloc_int(max(n->len - m->len + 1, 1)) : NULL;
+  struct ha_int *r = remainder ? alloc_int(n->len + 1) : NULL;
+  abs_divmod_into(q, r, n, m);
+  if (quotient) {
+    *quotient = q;
+  }
+  if (remainder) {
+    *remainder = r;
+  }
+}
+
+void ha_int_divmod_into(struct ha_int *quotient, struct ha_int *remainder,
+                        const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  assert(!is_zero(m));
+  // the signs of n and m are needed after quotient or remainder overwrites
+  // them
+  const bool quotient_sign = mult_div_sign(n, m);
+  const bool remainder_sign = n->sign;
+  abs_divmod_into(quotient, remainder, n, m);
+  if (quotient) {
+    quotient->sign = quotient_sign;
+    remove_leading_zeros(quotient);
+  }
+  if (remainder) {
+    remainder->sign = remainder_sign;
+    remove_leading_zeros(remainder);
+  }
+}
+
+void ha_int_divmod(const struct ha_int *n, const struct ha_int *m,
+                   struct ha_int **quotient, struct ha_int **remainder) {
+  assert(n);
+  assert(m);
+
+  // if m == 0, print error message
+  if (is_zero(m)) {
+    printf("Error: divisor cannot be zero");
+    if (quotient) {
+      *quotient = NULL;
+    }
+    if (remainder) {
+      *remainder = NULL;
+    }
+    return;
+  }
+
+  // n = m * quotient + remainder, so the remainder takes the sign of n
+  struct ha_int *q = quotient ? alloc_int(max(n->len - m->len + 1, 1)) : NULL;
+  struct ha_int *r = remainder ? alloc_int(n->len + 1) : NULL;
+  ha_int_divmod_into(q, r, n, m);
+  if (quotient) {
+    *quotient = q;
+  }
+  if (remainder) {
+    *remainder = r;
+  }
+}
+
+struct ha_int *ha_int_quotient(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *quotient = NULL;
+  ha_int_divmod(n, m, &quotient, NULL);
+  return quotient;
+}
+
+struct ha_int *ha_int_remainder(const struct ha_int *n,
+                                const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *remainder = NULL;
+  ha_int_divmod(n, m, NULL, &remainder);
+  return remainder;
+}
+
+// lin_comb(r, u, v, len, a, b) sets r[0..len] to a * u + b * v
+// requires: a >= 0 >= b or b > 0 >= a
+//           |a|, |b| fit in a limb
+//           a * u + b * v >= 0
+//           u and v have len limbs (zero-padded), r has len + 1 limbs
+//           r does not overlap u or v
+// time: O(len)
+static void lin_comb(ha_limb *r, const ha_limb *u, const ha_limb *v, int len,
+                     ha_sdlimb a, ha_sdlimb b) {
+  const ha_limb *pos = u;
+  const ha_limb *neg = v;
+  ha_limb pos_factor = (ha_limb)a;
+  ha_limb neg_factor = (ha_limb)-b;
+  if (b > 0) {
+    pos = v;
+    neg = u;
+    pos_factor = (ha_limb)b;
+    neg_factor = (ha_limb)-a;
+  }
+  r[len] = mag_mul_1(r, pos, len, pos_factor);
+  const ha_limb borrow = mag_submul_1(r, neg, len, neg_factor);
+  assert(r[len] >= borrow);
+  r[len] -= borrow;
+}
+
+// limb_gcd(u, v) gives gcd(u, v) with Euclid's algorithm on machine words
+// time: O(1)
+static ha_dlimb limb_gcd(ha_dlimb u, ha_dlimb v) {
+  while (v) {
+    const ha_dlimb r = u % v;
+    u = v;
+    v = r;
+  }
+  return u;
+}
+
+void ha_int_gcd_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  HA_STATS_COUNT(gcd);
+  if (abs_gt(m, n)) { // make |n| >= |m|
+    const struct ha_int *temp = n;
+    n = m;
+    m = temp;
+  }
+  if (is_zero(m)) {
+    ha_int_set(dst, n);
+    dst->sign = true;
+    return;
+  }
+  if (n->len <= 2) { // both fit in machine words
+    set_small(dst, limb_gcd(get_dlimb(n->limbs, n->len),
+                            get_dlimb(m->limbs, m->len)), true);
+    return;
+  }
+
+  // u and v hold the pair being reduced (u >= v), zero-padded to u_len limbs;
+  // next_u and next_v receive the next pair
+  // the arrays are blocks, since the remainders of Euclid's steps are
+  // written into them as integers
+  const int cap = n->len + 1;
+  ha_limb *arrays[4];
+  for (int i = 0; i < 4; ++i) {
+    arrays[i] = alloc_limbs(NULL, cap);
+    memset(arrays[i], 0, cap * sizeof(ha_limb));
+  }
+  ha_limb *u = arrays[0];
+  ha_limb *v = arrays[1];
+  ha_limb *next_u = arrays[2];
+  ha_limb *next_v = arrays[3];
+  memcpy(u, n->limbs, n->len * sizeof(ha_limb));
+  memcpy(v, m->limbs, m->len * sizeof(ha_limb));
+  int u_len = n->len;
+  int v_len = m->len;
+
+  // Lehmer's algorithm (TAOCP vol. 2, 4.5.2, Algorithm L): run Euclid on the
+  // leading limb of u and v as long as the quotients are certain, and apply
+  // the collected steps to the full numbers at once
+  while (v_len > 2) {
+    const int shift = leading_zero_bits(u[u_len - 1]);
+    ha_limb u_top = u[u_len - 1] << shift;
+    ha_limb v_top = v[u_len - 1] << shift;
+    if (shift) {
+      u_top |= u[u_len - 2] >> (LIMB_BITS - shift);
+      v_top |= v[u_len - 2] >> (LIMB_BITS - shift);
+    }
+    ha_sdlimb x = u_top;
+    ha_sdlimb y = v_top;
+    ha_sdlimb a = 1;
+    ha_sdlimb b = 0;
+    ha_sdlimb c = 0;
+    ha_sdlimb d = 1;
+    while (y + c > 0 && y + d > 0 && x + a >= 0 && x + b >= 0) {
+      const ha_sdlimb q = (x + a) / (y + c);
+      if (q != (x + b) / (y + d)) {
+        break;
+      }
+      ha_sdlimb temp = a - q * c;
+      a = c;
+      c = temp;
+      temp = b - q * d;
+      b = d;
+      d = temp;
+      temp = x - q * y;
+      x = y;
+      y = temp;
+    }
+
+    if (b == 0) {
+      // the leading limbs say nothing (usually a big quotient), so do one
+      // full step of Euclid: (u, v) = (v, u mod v)
+      // the remainder is left in next_u, with its top limbs below v_len zero
+      const struct ha_int u_view = limb_view(u, u_len);
+      const struct ha_int v_view = limb_view(v, v_len);
+      struct ha_int remainder = {true, 0, cap, next_u, NULL, {0}};
+      abs_divmod_into(NULL, &remainder, &u_view, &v_view);
+      next_u = u;
+      u = v;
+      v = remainder.limbs;
+      u_len = v_len;
+      v_len = remainder.len;
+    } else {
+      lin_comb(next_u, u, v, u_len, a, b);
+      lin_comb(next_v, u, v, u_len, c, d);
+      ha_limb *temp = u;
+      u = next_u;
+      next_u = temp;
+      temp = v;
+      v = next_v;
+      next_v = temp;
+      while (u_len > 0 && u[u_len - 1] == 0) {
+        --u_len;
+      }
+      v_len = u_len;
+      while (v_len > 0 && v[v_len - 1] == 0) {
+        --v_len;
+      }
+    }
+  }
+
+  // v fits in two limbs: reduce u by v once and finish on machine words
+  if (v_len == 0) {
+    const struct ha_int u_view = limb_view(u, u_len);
+    ha_int_set(dst, &u_view);
+  } else {
+    const struct ha_int u_view = limb_view(u, u_len);
+    const struct ha_int v_view = limb_view(v, v_len);
+    struct ha_int remainder = {true, 0, cap, next_u, NULL, {0}};
+    abs_divmod_into(NULL, &remainder, &u_view, &v_view);
+    set_small(dst, limb_gcd(get_dlimb(v, v_len),
+                            get_dlimb(remainder.limbs, remainder.len)), true);
+  }
+  for (int i = 0; i < 4; ++i) {
+    release_limbs(NULL, arrays[i], cap);
+  }
+}
+
+struct ha_int *ha_int_gcd(const struct ha_int *n, const struct ha_int *m) {
+  assert(n);
+  assert(m);
+  struct ha_int *gcd = alloc_int(2);
+  ha_int_gcd_into(gcd, n, m);
+  return gcd;
+}
+
+struct ha_int *ha_int_gcdext(const struct ha_int *n, const struct ha_int *m,
+                             struct ha_int **s, struct ha_int **t) {
+  assert(n);
+  assert(m);
+  assert(s);
+  assert(t);
+  HA_STATS_COUNT(gcd);
+
+  // iterative extended Euclid on |n| and |m|, keeping only the coefficients
+  // of |n|: old_s * |n| = old_r (mod |m|)
+  struct ha_int *old_r = ha_int_copy(n);
+  old_r->sign = true;
+  struct ha_int *r = ha_int_copy(m);
+  r->sign = true;
+  struct ha_int *old_s = ha_int_copy(ha_int_constant(1));
+  struct ha_int *cur_s = alloc_int(1);
+  while (!is_zero(r)) {
+    struct ha_int *quotient = NULL;
+    struct ha_int *remainder = NULL;
+    abs_divmod(old_r, r, &quotient, &remainder);
+    ha_int_destroy(old_r);
+    old_r = r;
+    r = remainder;
+    struct ha_int *product = ha_int_mult(quotient, cur_s);
+    struct ha_int *next_s = ha_int_sub(old_s, product);
+    ha_int_destroy(product);
+    ha_int_destroy(quotient);
+    ha_int_destroy(old_s);
+    old_s = cur_s;
+    cur_s = next_s;
+  }
+  ha_int_destroy(r);
+  ha_int_destroy(cur_s);
+
+  // |m| * t = gcd - |n| * s
+  struct ha_int *cur_t = NULL;
+  if (is_zero(m)) {
+    cur_t = alloc_int(1);
+  } else {
+    const struct ha_int n_abs = limb_view(n->limbs, n->len);
+    const struct ha_int m_abs = limb_view(m->limbs, m->len);
+    struct ha_int *product = ha_int_mult(old_s, &n_abs);
+    struct ha_int *diff = ha_int_sub(old_r, product);
+    ha_int_destroy(product);
+    cur_t = ha_int_quotient(diff, &m_abs);
+    ha_int_destroy(diff);
+  }
+
+  // s * n + t * m = gcd
+  if (!n->sign) {
+    old_s->sign = !old_s->sign;
+    remove_leading_zeros(old_s);
+  }
+  if (!m->sign) {
+    cur_t->sign = !cur_t->sign;
+    remove_leading_zeros(cur_t);
+  }
+  *s = old_s;
+  *t = cur_t;
+  return old_r;
+}
+
+// Decimal output: numbers of up to DEC_SMALL_LIMBS limbs are converted by
+//   repeated division by LIMB_DEC_BASE. Larger ones are split around the
+//   powers 10^(LIMB_DEC_DIGITS * 2^j), and both halves are converted
+//   recursively. Each split is a Barrett division by a cached power with
+//   its cached reciprocal, computed by Newton's iteration, so the
+//   conversion costs O(M(k) * log(k)) for k limbs instead of O(k^2).
+
+// size in limbs up to which numbers are converted by repeated division
+#define DEC_SMALL_LIMBS 24
+
+// size in limbs up to which reciprocals are computed by long division
+#define RECIP_SMALL_LIMBS 24
+
+// number of cached powers of 10; the last one would have about
+// 2^(DEC_LEVELS - 1) limbs
+#define DEC_LEVELS 32
+
+// per-thread powers 10^(LIMB_DEC_DIGITS * 2^j) and their reciprocals (see
+// recip_into), computed on first use and kept on the heap until the thread
+// trims or exits
+static _Thread_local struct ha_int *dec_pows[DEC_LEVELS];
+static _Thread_local struct ha_int *dec_recips[DEC_LEVELS];
+
+// release_dec_pows() destroys the powers of 10 of the current thread and
+//   their reciprocals, as its cleanup (see ha_alloc_on_trim)
+// time: O(DEC_LEVELS)
+static void release_dec_pows(void) {
+  for (int j = 0; j < DEC_LEVELS; ++j) {
+    if (dec_pows[j]) {
+      ha_int_destroy(dec_pows[j]);
+      dec_pows[j] = NULL;
+    }
+    if (dec_recips[j]) {
+      ha_int_destroy(dec_recips[j]);
+      dec_recips[j] = NULL;
+    }
+  }
+}
+
+// shift_limbs(dst, n, k) sets dst to n * B^k if k >= 0, or to n / B^-k
+//   rounded toward 0 otherwise, where B = 2^LIMB_BITS
+// notes: dst may be n
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn + k)
+static void shift_limbs(struct ha_int *dst, const struct ha_int *n, int k) {
+  assert(dst);
+  assert(n);
+  const int len = n->len + k;
+  if (n->len == 0 || len <= 0) {
+    dst->len = 0;
+    dst->sign = true;
+    return;
+  }
+  const bool sign = n->sign;
+  ha_limb *limbs = target_limbs(dst, len, dst == n);
+  if (k >= 0) {
+    memcpy(limbs + k, n->limbs, n->len * sizeof(ha_limb));
+    memset(limbs, 0, k * sizeof(ha_limb));
+  } else {
+    memcpy(limbs, n->limbs - k, len * sizeof(ha_limb));
+  }
+  set_limbs(dst, limbs, len, len, sign);
+}
+
+// set_power(dst, k) sets dst to B^k, where B = 2^LIMB_BITS
+// requires: k >= 0
+// effects: modifies dst
+//          may allocate memory
+// time: O(k)
+static void set_power(struct ha_int *dst, int k) {
+  assert(dst);
+  assert(k >= 0);
+  ha_limb *limbs = target_limbs(dst, k + 1, false);
+  memset(limbs, 0, k * sizeof(ha_limb));
+  limbs[k] = 1;
+  set_limbs(dst, limbs, k + 1, k + 1, true);
+}
+
+// recip_into(dst, d) sets dst to B^(2k) / d rounded down, where B =
+//   2^LIMB_BITS and k is the number of limbs of d
+// notes: the reciprocal of the upper half of d is refined by one Newton
+//          step x + x * (B^(2k) - d * x) / B^(2k), and the result is then
+//          corrected to the exact value
+// requires: d > 0, dst is not d
+// effects: modifies dst
+//          may allocate memory
+// time: O(M(k)), where M(k) is the time of multiplying two k-limb numbers
+static void recip_into(struct ha_int *dst, const struct ha_int *d) {
+  assert(dst);
+  assert(d);
+  assert(d->sign && d->len > 0);
+  assert(dst != d);
+  const int k = d->len;
+  struct ha_int power;
+  ha_int_init(&power, NULL);
+  set_power(&power, 2 * k);
+  if (k <= RECIP_SMALL_LIMBS) {
+    abs_divmod_into(dst, NULL, &power, d);
+    ha_int_clear(&power);
+    return;
+  }
+
+  const int low = k - (k + 1) / 2; // limbs of d left out of the first guess
+  struct ha_int x;
+  struct ha_int t;
+  struct ha_int one;
+  ha_int_init(&x, NULL);
+  ha_int_init(&t, NULL);
+  ha_int_init(&one, NULL);
+  set_small(&one, 1, true);
+  shift_limbs(&t, d, -low);
+  recip_into(&x, &t);
+  shift_limbs(&x, &x, low);
+  ha_int_mult_into(&t, d, &x);
+  ha_int_sub_into(&t, &power, &t);
+  ha_int_mult_into(&t, &x, &t);
+  shift_limbs(&t, &t, -2 * k);
+  ha_int_add_into(&x, &x, &t);
+
+  // B^(2k) - d * x is now a small multiple of d (a few limbs more than d if
+  // the top limb of d is small), so the error of x is one short division
+  ha_int_mult_into(&t, d, &x);
+  ha_int_sub_into(&t, &power, &t);
+  ha_int_divmod_into(&power, &t, &t, d);
+  ha_int_add_into(&x, &x, &power);
+  if (!t.sign) { // the quotient was rounded toward 0
+    ha_int_sub_into(&x, &x, &one);
+  }
+  ha_int_swap(dst, &x);
+  ha_int_clear(&power);
+  ha_int_clear(&x);
+  ha_int_clear(&t);
+  ha_int_clear(&one);
+}
+
+// dec_pow(j) gives 10^(LIMB_DEC_DIGITS * 2^j)
+// requires: 0 <= j < DEC_LEVELS
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(M(k)), where k is the number of limbs of the result, on first use
+static const struct ha_int *dec_pow(int j) {
+  assert(0 <= j && j < DEC_LEVELS);
+  if (!dec_pows[j]) {
+    ha_alloc_on_trim(release_dec_pows);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    dec_pows[j] = alloc_int(j == 0 ? 1 : 2 * dec_pow(j - 1)->len);
+    if (j == 0) {
+      set_small(dec_pows[j], LIMB_DEC_BASE, true);
+    } else {
+      ha_int_mult_into(dec_pows[j], dec_pow(j - 1), dec_pow(j - 1));
+    }
+    ha_arena_use(arena);
+  }
+  return dec_pows[j];
+}
+
+// dec_recip(j) gives the reciprocal of dec_pow(j) as computed by recip_into
+// requires: 0 <= j < DEC_LEVELS
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(M(k)), where k is the number of limbs of dec_pow(j), on first use
+static const struct ha_int *dec_recip(int j) {
+  assert(0 <= j && j < DEC_LEVELS);
+  if (!dec_recips[j]) {
+    ha_alloc_on_trim(release_dec_pows);
+    struct ha_arena *arena = ha_arena_use(NULL);
+    dec_recips[j] = alloc_int(dec_pow(j)->len + 2);
+    recip_into(dec_recips[j], dec_pow(j));
+    ha_arena_use(arena);
+  }
+  return dec_recips[j];
+}
+
+// write_dec_small(buf, n, pad) appends the decimal digits of |n| to buf,
+//   with leading zeros up to pad digits
+// requires: |n| < 10^pad if pad > 0
+// effects: modifies buf
+//          may allocate memory
+// time: O((logn)^2)
+static void write_dec_small(struct ha_buffer *buf, const struct ha_int *n,
+                            int pad) {
+  assert(buf);
+  assert(n);
+
+  // split |n| into chunks of LIMB_DEC_DIGITS decimal digits, the least
+  // significant chunk first
+  ha_limb *chunks = ha_alloc(NULL, (n->len + 1) * 2 * sizeof(ha_limb));
+  int chunk_num = 0;
+  ha_limb *temp = ha_alloc(NULL, max(n->len, 1) * sizeof(ha_limb));
+  memcpy(temp, n->limbs, n->len * sizeof(ha_limb));
+  int temp_len = n->len;
+  while (temp_len > 0) {
+    chunks[chunk_num] = mag_divmod_1(temp, temp, temp_len, LIMB_DEC_BASE);
+    ++chunk_num;
+    while (temp_len > 0 && temp[temp_len - 1] == 0) {
+      --temp_len;
+    }
+  }
+  ha_release(NULL, temp);
+  if (chunk_num == 0) { // n is 0
+    chunks[0] = 0;
+    chunk_num = 1;
+  }
+
+  // the most significant chunk is written without leading zeros, which are
+  // then added in front up to pad
+  char top[LIMB_DEC_DIGITS + 1];
+  int top_len = 0;
+  ha_limb top_chunk = chunks[chunk_num - 1];
+  do {
+    top[top_len] = top_chunk % 10 + '0';
+    ++top_len;
+    top_chunk /= 10;
+  } while (top_chunk);
+  const int len = top_len + (chunk_num - 1) * LIMB_DEC_DIGITS;
+  const int zeros = pad > len ? pad - len : 0;
+  char *num = ha_buffer_reserve(buf, zeros + len);
+  memset(num, '0', zeros);
+  int idx = zeros;
+  for (int i = top_len - 1; i >= 0; --i) {
+    num[idx] = top[i];
+    ++idx;
+  }
+  for (int i = chunk_num - 2; i >= 0; --i) {
+    ha_limb chunk = chunks[i];
+    for (int j = LIMB_DEC_DIGITS - 1; j >= 0; --j) {
+      num[idx + j] = chunk % 10 + '0';
+      chunk /= 10;
+    }
+    idx += LIMB_DEC_DIGITS;
+  }
+  buf->len += idx;
+  ha_release(NULL, chunks);
+}
+
+// write_dec(buf, n, pad, level) appends the decimal digits of n to buf,
+//   with leading zeros up to pad digits
+// notes: |n| = q * dec_pow(j) + r is written as q and then as r padded to the
+//          digits of dec_pow(j), where j is the level at which q > 0
+// requires: 0 <= n < dec_pow(level)^2
+//           n < 10^pad if pad > 0
+// effects: modifies buf
+//          may allocate memory
+// time: O(M(k) * log(k)), where k = logn
+static void write_dec(struct ha_buffer *buf, const struct ha_int *n, int pad,
+                      int level) {
+  assert(buf);
+  assert(n);
+  if (n->len <= DEC_SMALL_LIMBS) {
+    write_dec_small(buf, n, pad);
+    return;
+  }
+  const struct ha_int *d = dec_pow(level);
+  while (mag_cmp(n->limbs, n->len, d->limbs, d->len) < 0) {
+    assert(level > 0);
+    --level;
+    d = dec_pow(level);
+  }
+
+  // Barrett division: with mu = B^(2k) / d, the quotient is at most 2 more
+  // than (n / B^(k-1)) * mu / B^(k+1), since n < d^2 < B^(2k)
+  const int k = d->len;
+  struct ha_int q;
+  struct ha_int r;
+  struct ha_int one;
+  ha_int_init(&q, NULL);
+  ha_int_init(&r, NULL);
+  ha_int_init(&one, NULL);
+  set_small(&one, 1, true);
+  shift_limbs(&q, n, 1 - k);
+  ha_int_mult_into(&q, &q, dec_recip(level));
+  shift_limbs(&q, &q, -(k + 1));
+  ha_int_mult_into(&r, &q, d);
+  ha_int_sub_into(&r, n, &r);
+  while (!ha_int_gt(d, &r)) {
+    ha_int_add_into(&q, &q, &one);
+    ha_int_sub_into(&r, &r, d);
+  }
+  const int low_digits = LIMB_DEC_DIGITS << level;
+  write_dec(buf, &q, pad > 0 ? pad - low_digits : 0, level);
+  write_dec(buf, &r, low_digits, level);
+  ha_int_clear(&q);
+  ha_int_clear(&r);
+  ha_int_clear(&one);
+}
+
+void ha_int_write(struct ha_buffer *buf, const struct ha_int *n) {
+  assert(buf);
+  assert(n);
+  if (n->len <= DEC_SMALL_LIMBS) {
+    if (!n->sign) { // negative
+      ha_buffer_putc(buf, '-');
+    }
+    write_dec_small(buf, n, 0);
+    return;
+  }
+  struct ha_int abs;
+  ha_int_init(&abs, NULL);
+  ha_int_set(&abs, n);
+  if (!abs.sign) {
+    ha_buffer_putc(buf, '-');
+    abs.sign = true;
+  }
+  // the smallest level whose power squared is above |n|
+  int level = 0;
+  while (mag_cmp(abs.limbs, abs.len, dec_pow(level + 1)->limbs,
+                 dec_pow(level + 1)->len) >= 0) {
+    ++level;
+  }
+  write_dec(buf, &abs, 0, level);
+  ha_int_clear(&abs);
+}
+
+char *ha_int_to_str(const struct ha_int *n) {
+  assert(n);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_int_write(&buf, n);
+  return ha_buffer_release(&buf);
+}
@@ -4,7 +4,17 @@
 // requires: all number parameters are valid (not NULL)
 // time: (n), (m) are the numbers (so numbers of digits are logn, logm)
 
+// Functions ending in _into (and ha_int_addmul) write their result into an
+// existing ha_int instead of allocating a new one. The destination may be
+// one of the operands, and its storage is reused whenever it is big enough.
+
+// New values take their storage from the allocation context of the calling
+// thread, see high-accuracy-alloc.h.
+
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "high-accuracy-buffer.h"
 
 
 struct ha_int;
@@ -34,6 +44,29 @@ struct ha_int;
 // time: O(logn)
 struct ha_int *ha_int_create(const char *s);
 
+// ha_int_set_digits(dst, digits, len, negative) sets dst to the integer
+//   written with the len decimal digits at digits, negated if negative is true
+// notes: digits need not be followed by '\0', and are not checked: this is
+//          for parsers that validate their input as they scan it
+// requires: len > 0, digits[0..len) are decimal digits
+// effects: modifies dst
+//          may allocate memory
+// time: O(len^2)
+void ha_int_set_digits(struct ha_int *dst, const char *digits, int len,
+                       bool negative);
+
+// ha_int_set_bytes(dst, bytes, len, negative) sets dst to the integer whose
+//   magnitude is given by the len bytes at bytes, least significant first,
+//   negated if negative is true
+// notes: this is the byte order of the limbs in the binary format, see
+//          high-accuracy-binary.h
+// requires: bytes is valid (not NULL) if len > 0
+// effects: modifies dst
+//          may allocate memory
+// time: O(len)
+void ha_int_set_bytes(struct ha_int *dst, const unsigned char *bytes,
+                      size_t len, bool negative);
+
 // ha_int_destroy(num) destroys num
 // effects: num is no longer valid
 // time: O(1)
@@ -50,29 +83,157 @@ void ha_int_print(const struct ha_int *integer, bool newline);
 // time: O(logn + logm)
 struct ha_int *ha_int_add(const struct ha_int *n, const struct ha_int *m);
 
+// ha_int_add_into(dst, n, m) sets dst to n + m
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn + logm)
+void ha_int_add_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m);
+
 // ha_int_sub(n, m) gives n - m
 // effects: allocates memory (caller must free)
 // time: O(logn + logm)
 struct ha_int *ha_int_sub(const struct ha_int *n, const struct ha_int *m);
 
+// ha_int_sub_into(dst, n, m) sets dst to n - m
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn + logm)
+void ha_int_sub_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m);
+
 // ha_int_mult(n, m) gives n * m
+// notes: large operands are multiplied with the Karatsuba or the Toom-3
+//          method, see ha_int_set_mult_thresholds
 // effects: allocates memory (caller must free)
-// time: O(logn * logm)
+// time: O(logn * logm) for small operands, O(k^1.465) at best for large ones,
+//       where k = max(logn, logm)
 struct ha_int *ha_int_mult(const struct ha_int *n, const struct ha_int *m);
 
+// ha_int_mult_into(dst, n, m) sets dst to n * m
+// effects: modifies dst
+//          may allocate memory
+// time: same as ha_int_mult
+void ha_int_mult_into(struct ha_int *dst, const struct ha_int *n,
+                      const struct ha_int *m);
+
+// ha_int_addmul(acc, n, m) adds n * m to acc
+// effects: modifies acc
+//          may allocate memory
+// time: same as ha_int_mult
+void ha_int_addmul(struct ha_int *acc, const struct ha_int *n,
+                   const struct ha_int *m);
+
+// ha_int_set_mult_thresholds(karatsuba, toom3) sets the operand sizes (in
+//   decimal digits of the shorter operand) from which ha_int_mult uses the
+//   Karatsuba method and the Toom-3 method instead of the schoolbook method
+// notes: thresholds are rounded to whole limbs and clamped to the smallest
+//          sizes the methods support; toom3 is never below karatsuba
+//        suitable values for a machine are measured by the mult workload of
+//          benchmark.c
+// notes: the thresholds are shared by all threads
+// requires: karatsuba > 0, toom3 > 0
+//           no other thread is multiplying
+// effects: changes the behaviour of later multiplications (not the results)
+// time: O(1)
+void ha_int_set_mult_thresholds(int karatsuba, int toom3);
+
+// ha_int_get_mult_thresholds(karatsuba, toom3) stores the current thresholds
+//   (in decimal digits) in *karatsuba and *toom3
+// requires: karatsuba, toom3 are not NULL
+// effects: modifies *karatsuba and *toom3
+// time: O(1)
+void ha_int_get_mult_thresholds(int *karatsuba, int *toom3);
+
+// ha_int_set_simd(enabled) sets whether the innermost limb loops (addition,
+//   subtraction and multiplication by one limb) may use the vector
+//   instructions of the processor, which is the default
+// notes: the vector kernels are chosen when the program runs, and fall back
+//          to the portable loops on processors without them
+//        the setting is shared by all threads
+// requires: no other thread is calculating
+// effects: changes the behaviour of later calculations (not the results)
+// time: O(1)
+void ha_int_set_simd(bool enabled);
+
+// ha_int_simd() gives the name of the limb kernels in use: "scalar", "avx2",
+//   "avx512" or "neon"
+// time: O(1)
+const char *ha_int_simd(void);
+
 // ha_int_quotient(n, m) gives quotient when n / m, or NULL if m is 0
 // note: if m is 0, an error message will be printed
+//       the quotient is rounded toward 0
 // effects: allocates memory (caller must free)
-// time: O(logn * logm)
+// time: O(logm * (logn - logm + 1))
 struct ha_int *ha_int_quotient(const struct ha_int *n, const struct ha_int *m);
 
 // ha_int_remainder(n, m) gives remainder when n / m, or NULL if m is 0
 // notes: if m is 0, an error message will be printed
 //        n = m * quotient + remainder
 // effects: allocates memory (caller must free)
-// time: O(logn * logm)
+// time: O(logm * (logn - logm + 1))
 struct ha_int *ha_int_remainder(const struct ha_int *n, const struct ha_int *m);
 
+// ha_int_divmod(n, m, quotient, remainder) stores the quotient and the
+//   remainder of n / m in *quotient and *remainder with a single division,
+//   or stores NULL in both if m is 0
+// notes: if m is 0, an error message will be printed
+//        same results as ha_int_quotient and ha_int_remainder
+//        either quotient or remainder may be NULL if it is not needed
+// effects: may allocate memory (caller must free *quotient and *remainder)
+//          modifies *quotient and *remainder
+// time: O(logm * (logn - logm + 1))
+void ha_int_divmod(const struct ha_int *n, const struct ha_int *m,
+                   struct ha_int **quotient, struct ha_int **remainder);
+
+// ha_int_divmod_into(quotient, remainder, n, m) sets quotient and remainder
+//   to the quotient and the remainder of n / m
+// notes: same results as ha_int_divmod
+//        either quotient or remainder may be NULL if it is not needed
+//        quotient and remainder may be n or m, but not each other
+// requires: m is not 0
+// effects: modifies quotient and remainder
+//          may allocate memory
+// time: O(logm * (logn - logm + 1))
+void ha_int_divmod_into(struct ha_int *quotient, struct ha_int *remainder,
+                        const struct ha_int *n, const struct ha_int *m);
+
+// ha_int_gcd(n, m) gives the greatest common divisor of |n| and |m|
+// notes: the result is never negative, and gcd(0, 0) is 0
+// effects: allocates memory (caller must free)
+// time: O(logn * logm)
+struct ha_int *ha_int_gcd(const struct ha_int *n, const struct ha_int *m);
+
+// ha_int_gcd_into(dst, n, m) sets dst to the greatest common divisor of |n|
+//   and |m|
+// effects: modifies dst
+//          may allocate memory
+// time: O(logn * logm)
+void ha_int_gcd_into(struct ha_int *dst, const struct ha_int *n,
+                     const struct ha_int *m);
+
+// ha_int_gcdext(n, m, s, t) gives g, the greatest common divisor of |n| and
+//   |m|, and stores in *s and *t integers such that s * n + t * m = g
+// notes: g is never negative; if m is 0, *t is 0
+// requires: s, t are not NULL
+// effects: allocates memory (caller must free the result, *s and *t)
+//          modifies *s and *t
+// time: O(logn * logm)
+struct ha_int *ha_int_gcdext(const struct ha_int *n, const struct ha_int *m,
+                             struct ha_int **s, struct ha_int **t);
+
+// largest magnitude of the shared constants of ha_int_constant
+#define HA_INT_CONSTANT_MAX 16
+
+// ha_int_constant(k) gives the integer k, shared by all threads
+// notes: the constant never changes and must not be destroyed or written;
+//          it can be read by any function, and copied with ha_int_copy or
+//          ha_int_set
+// requires: -HA_INT_CONSTANT_MAX <= k <= HA_INT_CONSTANT_MAX
+// time: O(1)
+const struct ha_int *ha_int_constant(int k);
+
 // ha_int_eq(n, m) determines if n == m
 // time: O(logn + logm)
 bool ha_int_eq(const struct ha_int *n, const struct ha_int *m);
@@ -82,11 +243,57 @@ bool ha_int_eq(const struct ha_int *n, const struct ha_int *m);
 bool ha_int_gt(const struct ha_int *n, const struct ha_int *m);
 
 // ha_int_copy(n) returns a new ha_int, equal to n
+// notes: the copy shares the limbs of n as ha_int_set does
 // effects: allocates memory (client must call ha_int_destroy)
-// time: O(logn)
+// time: O(1) if the limbs are shared, O(logn) otherwise
 struct ha_int *ha_int_copy(const struct ha_int *n);
 
+// ha_int_set(dst, n) sets dst to n
+// notes: if neither dst nor n is in an arena and n is too big for the limbs
+//          of dst, dst shares the limbs of n instead of copying them; the
+//          first one written afterwards then gets limbs of its own
+// effects: modifies dst
+//          may allocate memory
+// time: O(1) if the limbs are shared, O(logn) otherwise
+void ha_int_set(struct ha_int *dst, const struct ha_int *n);
+
+// ha_int_swap(n, m) exchanges the values of n and m
+// effects: modifies n and m
+// time: O(1)
+void ha_int_swap(struct ha_int *n, struct ha_int *m);
+
+// ha_int_negate(n) sets n to -n
+// effects: modifies n
+// time: O(1)
+void ha_int_negate(struct ha_int *n);
+
+// ha_int_sign(n) returns 1 if n is positive, -1 if n is negative, otherwise,
+//   returns 0
+// time: O(1)
+int ha_int_sign(const struct ha_int *n);
+
+// ha_int_bit_length(n) gives the number of bits of |n|, 0 for 0
+// time: O(1)
+int ha_int_bit_length(const struct ha_int *n);
+
+// ha_int_mod_word(n, m) gives n mod m, between 0 and m - 1 (also for negative
+//   n)
+// requires: m > 0 (m < 2^32 on systems without 128-bit integers)
+// time: O(logn)
+uint64_t ha_int_mod_word(const struct ha_int *n, uint64_t m);
+
+// ha_int_write(buf, n) appends the decimal digits of n to buf
+// notes: large numbers are converted by divide and conquer, in
+//          O(M(k) * log(k)) where k = logn and M(k) is the time of
+//          ha_int_mult on k-digit operands
+// requires: buf is valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O((logn)^2) for small numbers, O(M(k) * log(k)) for large ones
+void ha_int_write(struct ha_buffer *buf, const struct ha_int *n);
+
 // ha_int_to_str(n) gives the corresponding string of n
+// notes: written as in ha_int_write
 // effects: allocates memory (caller must free)
-// time: O(logn)
+// time: as ha_int_write
 char *ha_int_to_str(const struct ha_int *n);
@@ -0,0 +1,139 @@
+// This header gives the layouts of the number structs to the high-accuracy
+//   modules, so that numbers can be embedded in each other and in matrices
+//   instead of being allocated one by one
+
+// It is private to the modules: clients only see the opaque structs of the
+//   public headers.
+
+// Embedded numbers: a number that lives inside another struct is set up with
+//   the _init function of its type and torn down with the _clear function,
+//   never with _create or _destroy. Small integers point into themselves
+//   (limbs == small), so a struct holding numbers must never be moved with
+//   memcpy or realloc; use the _swap functions instead.
+
+#ifndef HIGH_ACCURACY_LAYOUT_H
+#define HIGH_ACCURACY_LAYOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "high-accuracy-alloc.h"
+
+#ifndef HA_INT_LIMB_BITS
+#define HA_INT_LIMB_BITS 32
+#endif
+
+#if HA_INT_LIMB_BITS == 64
+typedef uint64_t ha_limb;
+typedef unsigned __int128 ha_dlimb;
+typedef __int128 ha_sdlimb;
+#define LIMB_DEC_DIGITS 19 // decimal digits that always fit in one limb
+#define LIMB_DEC_BASE 10000000000000000000ULL // 10^LIMB_DEC_DIGITS
+#elif HA_INT_LIMB_BITS == 32
+typedef uint32_t ha_limb;
+typedef uint64_t ha_dlimb;
+typedef int64_t ha_sdlimb;
+#define LIMB_DEC_DIGITS 9
+#define LIMB_DEC_BASE 1000000000U
+#else
+#error "HA_INT_LIMB_BITS must be 32 or 64"
+#endif
+
+#define LIMB_BITS HA_INT_LIMB_BITS
+
+// number of limbs stored inside struct ha_int (one double limb)
+#define INLINE_LIMBS 2
+
+
+struct ha_int {
+  bool sign; // true for positive and 0, false for negative
+  int len; // number of limbs in use, 0 for the number 0
+  int cap; // number of limbs allocated, 0 if the limbs are borrowed (they
+           // belong to someone else, such as a mapped file, and are never
+           // written or freed: see high-accuracy-binary.h)
+  ha_limb *limbs; // magnitude, least significant limb first; points to
+                  // small when cap == INLINE_LIMBS, and otherwise into a
+                  // reference-counted block that may be shared with other
+                  // integers (see high-accuracy-integer.c)
+  struct ha_arena *arena; // context of the struct and limbs, NULL for heap
+  ha_limb small[INLINE_LIMBS]; // storage for small magnitudes
+};
+
+// the context of a fraction or complex number is the one of its integers
+struct ha_frac {
+  bool nega; // true for negative (0 is never negative)
+  bool reduced; // true if gcd(nume, denom) == 1 is known, see ha_frac_set_lazy
+  struct ha_int nume; // never negative
+  struct ha_int denom; // always positive
+};
+
+struct ha_comp {
+  struct ha_frac real;
+  struct ha_frac ima;
+};
+
+// Constants: the shared constants of the number modules (see
+//   ha_int_constant) are static tables with one entry per value, listed by
+//   CONSTANT_TABLE, that are never written; their limbs point into
+//   themselves like those of any small integer. The tables are written out
+//   for HA_INT_CONSTANT_MAX == 16.
+
+// CONSTANT_TABLE(C) lists C(k) for every constant k, separated by commas
+#define CONSTANT_TABLE(C) \
+  C(-16), C(-15), C(-14), C(-13), C(-12), C(-11), C(-10), C(-9), C(-8), \
+  C(-7), C(-6), C(-5), C(-4), C(-3), C(-2), C(-1), C(0), C(1), C(2), C(3), \
+  C(4), C(5), C(6), C(7), C(8), C(9), C(10), C(11), C(12), C(13), C(14), \
+  C(15), C(16)
+
+// CONSTANT_INT(positive, magnitude, self) is the initializer of the constant
+//   integer self with the given sign (true for positive and 0) and magnitude
+#define CONSTANT_INT(positive, magnitude, self) \
+  {.sign = (positive), .len = (magnitude) != 0, .cap = INLINE_LIMBS, \
+   .limbs = (ha_limb *)(self).small, .arena = NULL, .small = {(magnitude)}}
+
+// CONSTANT_FRAC(k, self) is the initializer of the constant fraction self
+//   equal to the integer k
+#define CONSTANT_FRAC(k, self) \
+  {.nega = (k) < 0, .reduced = true, \
+   .nume = CONSTANT_INT(true, (k) >= 0 ? (k) : -(k), (self).nume), \
+   .denom = CONSTANT_INT(true, 1, (self).denom)}
+
+
+// ha_int_init(n, arena) sets up the embedded integer n as 0 with its limbs
+//   coming from arena (NULL for the heap)
+// effects: n is valid (client must call ha_int_clear)
+// time: O(1)
+void ha_int_init(struct ha_int *n, struct ha_arena *arena);
+
+// ha_int_clear(n) frees the limbs of the embedded integer n
+// effects: n is no longer valid
+// time: O(1)
+void ha_int_clear(struct ha_int *n);
+
+// ha_int_set_word(n, x) sets the embedded integer n to x
+// effects: modifies n
+// time: O(1)
+void ha_int_set_word(struct ha_int *n, uint64_t x);
+
+// ha_frac_init(num, arena) sets up the embedded fraction num as 0 with its
+//   integers in arena (NULL for the heap)
+// effects: num is valid (client must call ha_frac_clear)
+// time: O(1)
+void ha_frac_init(struct ha_frac *num, struct ha_arena *arena);
+
+// ha_frac_clear(num) frees the integers of the embedded fraction num
+// effects: num is no longer valid
+// time: O(1)
+void ha_frac_clear(struct ha_frac *num);
+
+// ha_comp_init(num, arena) sets up the embedded complex number num as 0 with
+//   its fractions in arena (NULL for the heap)
+// effects: num is valid (client must call ha_comp_clear)
+// time: O(1)
+void ha_comp_init(struct ha_comp *num, struct ha_arena *arena);
+
+// ha_comp_clear(num) frees the fractions of the embedded complex number num
+// effects: num is no longer valid
+// time: O(1)
+void ha_comp_clear(struct ha_comp *num);
+
+#endif
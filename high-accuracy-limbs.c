@@ -0,0 +1,529 @@
+// This module provides the vector versions of the innermost limb loops
+
+// For all program scope functions, see high-accuracy-limbs.h for details
+
+// Dispatch: the vector kernels are compiled for their instruction sets with
+//   target attributes, so the rest of the program stays portable, and are
+//   only called after the processor has been checked for them. On x86-64,
+//   AVX-512 is preferred to AVX2; 64-bit limbs only get vector additions and
+//   subtractions, since neither has a 64 x 64-bit vector multiplication
+//   (AVX-512 IFMA multiplies 52-bit halves, which would change the
+//   representation). On 64-bit ARM, NEON is always there, and computes the
+//   products of 32-bit limbs two at a time.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "high-accuracy-layout.h"
+#include "high-accuracy-limbs.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON) && LIMB_BITS == 32
+#define HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+
+// the kernels the processor supports, set once for the whole process
+static const struct ha_limb_kernels *detected;
+#ifdef HAVE_PTHREADS
+static pthread_once_t detected_once = PTHREAD_ONCE_INIT;
+#endif
+
+
+// The scalar loops take the carry into their lowest limb, so the vector
+// kernels finish their last partial vector with them.
+
+// add_nc(r, a, b, n, carry) sets r[0..n) to the low n limbs of
+//   a + b + carry and returns the carry out
+// requires: carry <= 1
+// time: O(n)
+static ha_limb add_nc(ha_limb *r, const ha_limb *a, const ha_limb *b, int n,
+                      ha_limb carry) {
+  for (int i = 0; i < n; ++i) {
+    const ha_dlimb sum = (ha_dlimb)a[i] + b[i] + carry;
+    r[i] = (ha_limb)sum;
+    carry = (ha_limb)(sum >> LIMB_BITS);
+  }
+  return carry;
+}
+
+// sub_nc(r, a, b, n, borrow) sets r[0..n) to the low n limbs of
+//   a - b - borrow and returns the borrow out
+// requires: borrow <= 1
+// time: O(n)
+static ha_limb sub_nc(ha_limb *r, const ha_limb *a, const ha_limb *b, int n,
+                      ha_limb borrow) {
+  for (int i = 0; i < n; ++i) {
+    const ha_limb ai = a[i];
+    const ha_limb diff = ai - b[i] - borrow;
+    borrow = (ai < b[i]) || (ai - b[i] < borrow);
+    r[i] = diff;
+  }
+  return borrow;
+}
+
+// mul_1c(r, a, n, b, carry) sets r[0..n) to the low n limbs of
+//   a * b + carry and returns the high limb
+// time: O(n)
+static ha_limb mul_1c(ha_limb *r, const ha_limb *a, int n, ha_limb b,
+                      ha_limb carry) {
+  for (int i = 0; i < n; ++i) {
+    const ha_dlimb prod = (ha_dlimb)a[i] * b + carry;
+    r[i] = (ha_limb)prod;
+    carry = (ha_limb)(prod >> LIMB_BITS);
+  }
+  return carry;
+}
+
+// addmul_1c(r, a, n, b, carry) adds a * b + carry to r[0..n) and returns
+//   the carry out
+// time: O(n)
+static ha_limb addmul_1c(ha_limb *r, const ha_limb *a, int n, ha_limb b,
+                         ha_limb carry) {
+  for (int i = 0; i < n; ++i) {
+    const ha_dlimb prod = (ha_dlimb)a[i] * b + r[i] + carry;
+    r[i] = (ha_limb)prod;
+    carry = (ha_limb)(prod >> LIMB_BITS);
+  }
+  return carry;
+}
+
+// add_n_scalar(r, a, b, n): see add_n in high-accuracy-limbs.h
+static ha_limb add_n_scalar(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                            int n) {
+  return add_nc(r, a, b, n, 0);
+}
+
+// sub_n_scalar(r, a, b, n): see sub_n in high-accuracy-limbs.h
+static ha_limb sub_n_scalar(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                            int n) {
+  return sub_nc(r, a, b, n, 0);
+}
+
+// mul_1_scalar(r, a, n, b): see mul_1 in high-accuracy-limbs.h
+static ha_limb mul_1_scalar(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return mul_1c(r, a, n, b, 0);
+}
+
+// addmul_1_scalar(r, a, n, b): see addmul_1 in high-accuracy-limbs.h
+static ha_limb addmul_1_scalar(ha_limb *r, const ha_limb *a, int n,
+                               ha_limb b) {
+  return addmul_1c(r, a, n, b, 0);
+}
+
+static const struct ha_limb_kernels scalar_kernels = {
+  "scalar", add_n_scalar, sub_n_scalar, mul_1_scalar, addmul_1_scalar
+};
+
+// lane_carries(generate, propagate, carry_in) gives the carries into the
+//   lanes of a vector, one bit per lane, given which lanes generate a carry
+//   and which propagate one; the bit above the last lane is the carry out
+// notes: a lane never both generates and propagates
+// time: O(1)
+static unsigned lane_carries(unsigned generate, unsigned propagate,
+                             unsigned carry_in) {
+  return (((generate << 1) | carry_in) + propagate) ^ propagate;
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+#if LIMB_BITS == 32
+#define AVX2_LANES 8
+#define AVX512_LANES 16
+#else
+#define AVX2_LANES 4
+#define AVX512_LANES 8
+#endif
+
+// avx2_lane_mask(lanes) turns a mask with one bit per lane into a vector
+//   with all the bits of those lanes set
+// time: O(1)
+__attribute__((target("avx2")))
+static __m256i avx2_lane_mask(unsigned lanes) {
+#if LIMB_BITS == 32
+  const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256i spread = _mm256_and_si256(_mm256_set1_epi32(lanes), bits);
+  return _mm256_cmpeq_epi32(spread, bits);
+#else
+  const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+  const __m256i spread = _mm256_and_si256(_mm256_set1_epi64x(lanes), bits);
+  return _mm256_cmpeq_epi64(spread, bits);
+#endif
+}
+
+// avx2_below(x, y) gives the lanes of x that are below those of y (unsigned),
+//   one bit per lane
+// time: O(1)
+__attribute__((target("avx2")))
+static unsigned avx2_below(__m256i x, __m256i y) {
+#if LIMB_BITS == 32
+  const __m256i top = _mm256_set1_epi32(INT32_MIN);
+  const __m256i gt = _mm256_cmpgt_epi32(_mm256_xor_si256(y, top),
+                                        _mm256_xor_si256(x, top));
+  return _mm256_movemask_ps(_mm256_castsi256_ps(gt));
+#else
+  const __m256i top = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i gt = _mm256_cmpgt_epi64(_mm256_xor_si256(y, top),
+                                        _mm256_xor_si256(x, top));
+  return _mm256_movemask_pd(_mm256_castsi256_pd(gt));
+#endif
+}
+
+// avx2_equal(x, y) gives the lanes where x and y are equal, one bit per lane
+// time: O(1)
+__attribute__((target("avx2")))
+static unsigned avx2_equal(__m256i x, __m256i y) {
+#if LIMB_BITS == 32
+  const __m256i eq = _mm256_cmpeq_epi32(x, y);
+  return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+#else
+  const __m256i eq = _mm256_cmpeq_epi64(x, y);
+  return _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+#endif
+}
+
+// add_n_avx2(r, a, b, n): see add_n in high-accuracy-limbs.h
+__attribute__((target("avx2")))
+static ha_limb add_n_avx2(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                          int n) {
+  const __m256i ones = _mm256_set1_epi8(-1);
+  unsigned carry = 0;
+  int i = 0;
+  for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+    const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+#if LIMB_BITS == 32
+    __m256i sum = _mm256_add_epi32(x, y);
+#else
+    __m256i sum = _mm256_add_epi64(x, y);
+#endif
+    const unsigned carries = lane_carries(avx2_below(sum, x),
+                                          avx2_equal(sum, ones), carry);
+    carry = carries >> AVX2_LANES;
+    // adding a carry is subtracting all ones
+#if LIMB_BITS == 32
+    sum = _mm256_sub_epi32(sum, avx2_lane_mask(carries));
+#else
+    sum = _mm256_sub_epi64(sum, avx2_lane_mask(carries));
+#endif
+    _mm256_storeu_si256((__m256i *)(r + i), sum);
+  }
+  return add_nc(r + i, a + i, b + i, n - i, carry);
+}
+
+// sub_n_avx2(r, a, b, n): see sub_n in high-accuracy-limbs.h
+__attribute__((target("avx2")))
+static ha_limb sub_n_avx2(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                          int n) {
+  unsigned borrow = 0;
+  int i = 0;
+  for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+    const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+#if LIMB_BITS == 32
+    __m256i diff = _mm256_sub_epi32(x, y);
+#else
+    __m256i diff = _mm256_sub_epi64(x, y);
+#endif
+    // a lane borrows if x < y, and passes a borrow on if x == y
+    const unsigned borrows = lane_carries(avx2_below(x, y),
+                                          avx2_equal(x, y), borrow);
+    borrow = borrows >> AVX2_LANES;
+#if LIMB_BITS == 32
+    diff = _mm256_add_epi32(diff, avx2_lane_mask(borrows));
+#else
+    diff = _mm256_add_epi64(diff, avx2_lane_mask(borrows));
+#endif
+    _mm256_storeu_si256((__m256i *)(r + i), diff);
+  }
+  return sub_nc(r + i, a + i, b + i, n - i, borrow);
+}
+
+#if LIMB_BITS == 32
+// muladd_avx2(r, a, n, b, add) sets r[0..n) to the low n limbs of a * b, plus
+//   r if add is true, and returns the high limb
+// notes: the 64-bit products of the even and the odd limbs are split into
+//          their low and high halves; the high halves move up one lane, and
+//          adding them to the low halves is an addition with carries
+// requires: r does not overlap a if add is true
+// time: O(n)
+__attribute__((target("avx2")))
+static ha_limb muladd_avx2(ha_limb *r, const ha_limb *a, int n, ha_limb b,
+                           bool add) {
+  const __m256i ones = _mm256_set1_epi8(-1);
+  const __m256i factor = _mm256_set1_epi32(b);
+  const __m256i low_halves = _mm256_set1_epi64x(UINT32_MAX);
+  const __m256i up = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+  ha_limb carry = 0; // the limb carried into the next vector
+  int i = 0;
+  for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+    const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i even = _mm256_mul_epu32(x, factor);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), factor);
+    if (add) { // a[i] * b + r[i] < 2^64, so the sums fit
+      const __m256i y = _mm256_loadu_si256((const __m256i *)(r + i));
+      even = _mm256_add_epi64(even, _mm256_and_si256(y, low_halves));
+      odd = _mm256_add_epi64(odd, _mm256_srli_epi64(y, 32));
+    }
+    const __m256i low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32),
+                                           0xaa);
+    __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+    high = _mm256_permutevar8x32_epi32(high, up);
+    // the top high half moves to lane 0; it and the carry of the lanes make
+    // up the carry out of the vector, which always fits in a limb
+    const ha_limb top = _mm_cvtsi128_si32(_mm256_castsi256_si128(high));
+    high = _mm256_blend_epi32(high, _mm256_set1_epi32(carry), 1);
+    __m256i sum = _mm256_add_epi32(low, high);
+    const unsigned carries = lane_carries(avx2_below(sum, low),
+                                          avx2_equal(sum, ones), 0);
+    sum = _mm256_sub_epi32(sum, avx2_lane_mask(carries));
+    _mm256_storeu_si256((__m256i *)(r + i), sum);
+    carry = top + (carries >> AVX2_LANES);
+  }
+  return add ? addmul_1c(r + i, a + i, n - i, b, carry)
+             : mul_1c(r + i, a + i, n - i, b, carry);
+}
+
+// mul_1_avx2(r, a, n, b): see mul_1 in high-accuracy-limbs.h
+static ha_limb mul_1_avx2(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return muladd_avx2(r, a, n, b, false);
+}
+
+// addmul_1_avx2(r, a, n, b): see addmul_1 in high-accuracy-limbs.h
+static ha_limb addmul_1_avx2(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return muladd_avx2(r, a, n, b, true);
+}
+#else
+#define mul_1_avx2 mul_1_scalar
+#define addmul_1_avx2 addmul_1_scalar
+#endif
+
+// With AVX-512, comparisons give their lane masks directly, and the carries
+// are added under a mask.
+
+// add_n_avx512(r, a, b, n): see add_n in high-accuracy-limbs.h
+__attribute__((target("avx512f")))
+static ha_limb add_n_avx512(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                            int n) {
+  const __m512i ones = _mm512_set1_epi32(-1);
+  unsigned carry = 0;
+  int i = 0;
+  for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+    const __m512i x = _mm512_loadu_si512(a + i);
+    const __m512i y = _mm512_loadu_si512(b + i);
+#if LIMB_BITS == 32
+    __m512i sum = _mm512_add_epi32(x, y);
+    const unsigned carries = lane_carries(_mm512_cmplt_epu32_mask(sum, x),
+                                          _mm512_cmpeq_epi32_mask(sum, ones),
+                                          carry);
+    sum = _mm512_mask_sub_epi32(sum, (__mmask16)carries, sum, ones);
+#else
+    __m512i sum = _mm512_add_epi64(x, y);
+    const unsigned carries = lane_carries(_mm512_cmplt_epu64_mask(sum, x),
+                                          _mm512_cmpeq_epi64_mask(sum, ones),
+                                          carry);
+    sum = _mm512_mask_sub_epi64(sum, (__mmask8)carries, sum, ones);
+#endif
+    carry = carries >> AVX512_LANES;
+    _mm512_storeu_si512(r + i, sum);
+  }
+  return add_nc(r + i, a + i, b + i, n - i, carry);
+}
+
+// sub_n_avx512(r, a, b, n): see sub_n in high-accuracy-limbs.h
+__attribute__((target("avx512f")))
+static ha_limb sub_n_avx512(ha_limb *r, const ha_limb *a, const ha_limb *b,
+                            int n) {
+  const __m512i ones = _mm512_set1_epi32(-1);
+  unsigned borrow = 0;
+  int i = 0;
+  for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+    const __m512i x = _mm512_loadu_si512(a + i);
+    const __m512i y = _mm512_loadu_si512(b + i);
+#if LIMB_BITS == 32
+    __m512i diff = _mm512_sub_epi32(x, y);
+    const unsigned borrows = lane_carries(_mm512_cmplt_epu32_mask(x, y),
+                                          _mm512_cmpeq_epi32_mask(x, y),
+                                          borrow);
+    diff = _mm512_mask_add_epi32(diff, (__mmask16)borrows, diff, ones);
+#else
+    __m512i diff = _mm512_sub_epi64(x, y);
+    const unsigned borrows = lane_carries(_mm512_cmplt_epu64_mask(x, y),
+                                          _mm512_cmpeq_epi64_mask(x, y),
+                                          borrow);
+    diff = _mm512_mask_add_epi64(diff, (__mmask8)borrows, diff, ones);
+#endif
+    borrow = borrows >> AVX512_LANES;
+    _mm512_storeu_si512(r + i, diff);
+  }
+  return sub_nc(r + i, a + i, b + i, n - i, borrow);
+}
+
+#if LIMB_BITS == 32
+// muladd_avx512(r, a, n, b, add): as muladd_avx2, with 16 limbs at a time
+__attribute__((target("avx512f")))
+static ha_limb muladd_avx512(ha_limb *r, const ha_limb *a, int n, ha_limb b,
+                             bool add) {
+  const __m512i ones = _mm512_set1_epi32(-1);
+  const __m512i factor = _mm512_set1_epi32(b);
+  const __m512i low_halves = _mm512_set1_epi64(UINT32_MAX);
+  const __m512i up = _mm512_setr_epi32(15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                       11, 12, 13, 14);
+  ha_limb carry = 0;
+  int i = 0;
+  for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+    const __m512i x = _mm512_loadu_si512(a + i);
+    __m512i even = _mm512_mul_epu32(x, factor);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), factor);
+    if (add) {
+      const __m512i y = _mm512_loadu_si512(r + i);
+      even = _mm512_add_epi64(even, _mm512_and_si512(y, low_halves));
+      odd = _mm512_add_epi64(odd, _mm512_srli_epi64(y, 32));
+    }
+    const __m512i low = _mm512_mask_blend_epi32(0xaaaa, even,
+                                                _mm512_slli_epi64(odd, 32));
+    __m512i high = _mm512_mask_blend_epi32(0xaaaa, _mm512_srli_epi64(even, 32),
+                                           odd);
+    high = _mm512_permutexvar_epi32(up, high);
+    const ha_limb top = _mm_cvtsi128_si32(_mm512_castsi512_si128(high));
+    high = _mm512_mask_set1_epi32(high, 1, carry);
+    __m512i sum = _mm512_add_epi32(low, high);
+    const unsigned carries = lane_carries(_mm512_cmplt_epu32_mask(sum, low),
+                                          _mm512_cmpeq_epi32_mask(sum, ones),
+                                          0);
+    sum = _mm512_mask_sub_epi32(sum, (__mmask16)carries, sum, ones);
+    _mm512_storeu_si512(r + i, sum);
+    carry = top + (carries >> AVX512_LANES);
+  }
+  return add ? addmul_1c(r + i, a + i, n - i, b, carry)
+             : mul_1c(r + i, a + i, n - i, b, carry);
+}
+
+// mul_1_avx512(r, a, n, b): see mul_1 in high-accuracy-limbs.h
+static ha_limb mul_1_avx512(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return muladd_avx512(r, a, n, b, false);
+}
+
+// addmul_1_avx512(r, a, n, b): see addmul_1 in high-accuracy-limbs.h
+static ha_limb addmul_1_avx512(ha_limb *r, const ha_limb *a, int n,
+                               ha_limb b) {
+  return muladd_avx512(r, a, n, b, true);
+}
+#else
+#define mul_1_avx512 mul_1_scalar
+#define addmul_1_avx512 addmul_1_scalar
+#endif
+
+static const struct ha_limb_kernels avx2_kernels = {
+  "avx2", add_n_avx2, sub_n_avx2, mul_1_avx2, addmul_1_avx2
+};
+
+static const struct ha_limb_kernels avx512_kernels = {
+  "avx512", add_n_avx512, sub_n_avx512, mul_1_avx512, addmul_1_avx512
+};
+
+#endif
+
+
+#ifdef HAVE_NEON_KERNELS
+
+// muladd_neon(r, a, n, b, add) sets r[0..n) to the low n limbs of a * b, plus
+//   r if add is true, and returns the high limb
+// notes: the products of four limbs are computed two at a time, and their
+//          carries are then chained limb by limb
+// requires: r does not overlap a if add is true
+// time: O(n)
+static ha_limb muladd_neon(ha_limb *r, const ha_limb *a, int n, ha_limb b,
+                           bool add) {
+  const uint32x2_t factor = vdup_n_u32(b);
+  ha_limb carry = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const uint32x4_t x = vld1q_u32(a + i);
+    uint64x2_t low = vmull_u32(vget_low_u32(x), factor);
+    uint64x2_t high = vmull_u32(vget_high_u32(x), factor);
+    if (add) {
+      const uint32x4_t y = vld1q_u32(r + i);
+      low = vaddw_u32(low, vget_low_u32(y));
+      high = vaddw_u32(high, vget_high_u32(y));
+    }
+    uint64_t prods[4];
+    vst1q_u64(prods, low);
+    vst1q_u64(prods + 2, high);
+    for (int j = 0; j < 4; ++j) {
+      const uint64_t prod = prods[j] + carry;
+      r[i + j] = (ha_limb)prod;
+      carry = (ha_limb)(prod >> 32);
+    }
+  }
+  return add ? addmul_1c(r + i, a + i, n - i, b, carry)
+             : mul_1c(r + i, a + i, n - i, b, carry);
+}
+
+// mul_1_neon(r, a, n, b): see mul_1 in high-accuracy-limbs.h
+static ha_limb mul_1_neon(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return muladd_neon(r, a, n, b, false);
+}
+
+// addmul_1_neon(r, a, n, b): see addmul_1 in high-accuracy-limbs.h
+static ha_limb addmul_1_neon(ha_limb *r, const ha_limb *a, int n, ha_limb b) {
+  return muladd_neon(r, a, n, b, true);
+}
+
+// NEON has no lane masks to move into a register, so the additions stay
+// scalar
+static const struct ha_limb_kernels neon_kernels = {
+  "neon", add_n_scalar, sub_n_scalar, mul_1_neon, addmul_1_neon
+};
+
+#endif
+
+
+// detect() gives the fastest kernels the processor supports
+// time: O(1)
+static const struct ha_limb_kernels *detect(void) {
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return &avx512_kernels;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_kernels;
+  }
+#endif
+#ifdef HAVE_NEON_KERNELS
+  return &neon_kernels;
+#endif
+  return &scalar_kernels;
+}
+
+// set_detected() sets detected, once per process
+// time: O(1)
+static void set_detected(void) {
+  detected = detect();
+}
+
+const struct ha_limb_kernels *ha_limb_kernels(bool simd) {
+  if (!simd) {
+    return &scalar_kernels;
+  }
+#ifdef HAVE_PTHREADS
+  pthread_once(&detected_once, set_detected);
+#else
+  if (!detected) { // without threads, there is a single caller
+    set_detected();
+  }
+#endif
+  return detected;
+}
@@ -0,0 +1,48 @@
+// This header gives the high-accuracy modules the vector versions of their
+//   innermost limb loops, picked for the processor the program runs on
+
+// It is private to the modules, like high-accuracy-layout.h.
+
+// Kernels: every set of kernels computes the same results as the portable
+//   loops of high-accuracy-integer.c. The vector sets resolve the carries of
+//   a whole vector of limbs at once: a limb generates a carry if its sum
+//   overflows and propagates one if its sum is all ones, so the carries into
+//   all the lanes come out of one addition of the two lane masks. The
+//   products of mul_1 and addmul_1 are computed a vector at a time, and the
+//   carries between their halves are resolved in the same way.
+
+#ifndef HIGH_ACCURACY_LIMBS_H
+#define HIGH_ACCURACY_LIMBS_H
+
+#include <stdbool.h>
+#include "high-accuracy-layout.h"
+
+
+// For all kernels:
+// requires: n >= 0
+//           r may be the same array as a or b, but no other overlap
+// time: O(n)
+struct ha_limb_kernels {
+  const char *name; // "scalar", "avx2", "avx512" or "neon"
+  // add_n(r, a, b, n) sets r[0..n) to the low n limbs of a + b and returns
+  //   the carry out
+  ha_limb (*add_n)(ha_limb *r, const ha_limb *a, const ha_limb *b, int n);
+  // sub_n(r, a, b, n) sets r[0..n) to the low n limbs of a - b and returns
+  //   the borrow out
+  ha_limb (*sub_n)(ha_limb *r, const ha_limb *a, const ha_limb *b, int n);
+  // mul_1(r, a, n, b) sets r[0..n) to the low n limbs of a * b and returns
+  //   the high limb
+  ha_limb (*mul_1)(ha_limb *r, const ha_limb *a, int n, ha_limb b);
+  // addmul_1(r, a, n, b) adds a * b to r[0..n) and returns the carry out
+  // requires: r does not overlap a
+  ha_limb (*addmul_1)(ha_limb *r, const ha_limb *a, int n, ha_limb b);
+};
+
+
+// ha_limb_kernels(simd) gives the fastest kernels the processor supports if
+//   simd is true, and the portable ones otherwise
+// notes: the processor is checked once per process, by the first call
+// time: O(1)
+const struct ha_limb_kernels *ha_limb_kernels(bool simd);
+
+#endif
@@ -0,0 +1,2273 @@
+// This module provides dense matrices of arbitrarily large complex numbers
+
+// For all program scope functions, see high-accuracy-matrix.h for details
+
+// The following applies to all functions:
+// requires: all matrix parameters are valid (not NULL)
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-matrix.h"
+#include "high-accuracy-pool.h"
+
+struct ha_matrix {
+  int rows;
+  int cols;
+  struct ha_arena *arena; // context of the matrix and its entries
+  struct ha_comp entries[]; // row-major, rows * cols of them
+};
+
+// a multiplication split over the threads of a pool, in tiles of MULT_TILE x
+// MULT_TILE entries of dst
+struct mult_job {
+  struct ha_matrix *dst;
+  const struct ha_matrix *n;
+  const struct ha_matrix *m;
+  int tile_cols; // number of tiles per row of tiles
+  bool lazy; // deferred reduction of the calling thread, see ha_frac_lazy
+};
+
+// size of the tiles of a multiplication, and of the blocks of the inner
+// dimension each tile is accumulated over
+#define MULT_TILE 8
+
+// size of the square products from which a Strassen-Winograd step is taken
+static int strassen_threshold = 64;
+
+
+// zero() gives the constant 0
+// time: O(1)
+static const struct ha_comp *zero(void) {
+  return ha_comp_constant(0);
+}
+
+// min(a, b) finds the smaller value between a and b
+static int min(int a, int b) {
+  return a <= b ? a : b;
+}
+
+// entry(mat, row, col) gives the entry of mat at row and col
+// time: O(1)
+static struct ha_comp *entry(const struct ha_matrix *mat, int row, int col) {
+  assert(mat);
+  assert(0 <= row && row < mat->rows);
+  assert(0 <= col && col < mat->cols);
+  return (struct ha_comp *)&mat->entries[row * mat->cols + col];
+}
+
+// same_size(n, m) determines if n and m have the same numbers of rows and
+//   columns
+// time: O(1)
+static bool same_size(const struct ha_matrix *n, const struct ha_matrix *m) {
+  assert(n);
+  assert(m);
+  return n->rows == m->rows && n->cols == m->cols;
+}
+
+// print_size_error(op, n, m) prints an error message in the form
+//   "Error: cannot op a RxC matrix and a RxC matrix"
+// effects: produces output
+// time: O(1)
+static void print_size_error(const char *op, const struct ha_matrix *n,
+                             const struct ha_matrix *m) {
+  assert(op);
+  assert(n);
+  assert(m);
+  printf("Error: cannot %s a %dx%d matrix and a %dx%d matrix\n", op, n->rows,
+         n->cols, m->rows, m->cols);
+}
+
+struct ha_matrix *ha_matrix_create(int rows, int cols) {
+  assert(rows > 0);
+  assert(cols > 0);
+  // the entries are indexed by int everywhere else
+  assert(rows <= INT_MAX / cols);
+  struct ha_arena *arena = ha_arena_current();
+  const size_t size = (size_t)rows * cols;
+  struct ha_matrix *mat = ha_alloc(arena, sizeof(struct ha_matrix) +
+                                   size * sizeof(struct ha_comp));
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->arena = arena;
+  for (size_t i = 0; i < size; ++i) {
+    ha_comp_init(&mat->entries[i], arena);
+  }
+  return mat;
+}
+
+struct ha_matrix *ha_matrix_identity(int n) {
+  assert(n > 0);
+  struct ha_matrix *mat = ha_matrix_create(n, n);
+  for (int i = 0; i < n; ++i) {
+    ha_comp_set(entry(mat, i, i), ha_comp_constant(1));
+  }
+  return mat;
+}
+
+void ha_matrix_destroy(struct ha_matrix *mat) {
+  assert(mat);
+  const int size = mat->rows * mat->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_comp_clear(&mat->entries[i]);
+  }
+  ha_release(mat->arena, mat);
+}
+
+struct ha_matrix *ha_matrix_copy(const struct ha_matrix *mat) {
+  assert(mat);
+  struct ha_matrix *result = ha_matrix_create(mat->rows, mat->cols);
+  const int size = mat->rows * mat->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_comp_set(&result->entries[i], &mat->entries[i]);
+  }
+  return result;
+}
+
+int ha_matrix_rows(const struct ha_matrix *mat) {
+  assert(mat);
+  return mat->rows;
+}
+
+int ha_matrix_cols(const struct ha_matrix *mat) {
+  assert(mat);
+  return mat->cols;
+}
+
+struct ha_comp *ha_matrix_at(struct ha_matrix *mat, int row, int col) {
+  assert(mat);
+  return entry(mat, row, col);
+}
+
+const struct ha_comp *ha_matrix_get(const struct ha_matrix *mat, int row,
+                                    int col) {
+  assert(mat);
+  return entry(mat, row, col);
+}
+
+void ha_matrix_set(struct ha_matrix *mat, int row, int col,
+                   const struct ha_comp *num) {
+  assert(mat);
+  assert(num);
+  ha_comp_set(entry(mat, row, col), num);
+}
+
+bool ha_matrix_eq(const struct ha_matrix *n, const struct ha_matrix *m) {
+  assert(n);
+  assert(m);
+  if (!same_size(n, m)) {
+    return false;
+  }
+  const int size = n->rows * n->cols;
+  for (int i = 0; i < size; ++i) {
+    const struct ha_comp *a = &n->entries[i];
+    const struct ha_comp *b = &m->entries[i];
+    if (ha_frac_cmp(&a->real, &b->real) || ha_frac_cmp(&a->ima, &b->ima)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ha_matrix_write(struct ha_buffer *buf, const struct ha_matrix *mat) {
+  assert(buf);
+  assert(mat);
+  for (int i = 0; i < mat->rows; ++i) {
+    for (int j = 0; j < mat->cols; ++j) {
+      if (j > 0) {
+        ha_buffer_putc(buf, ' ');
+      }
+      ha_comp_write(buf, entry(mat, i, j));
+    }
+    ha_buffer_putc(buf, '\n');
+  }
+}
+
+void ha_matrix_print(const struct ha_matrix *mat) {
+  assert(mat);
+  struct ha_buffer buf;
+  ha_buffer_init(&buf);
+  ha_matrix_write(&buf, mat);
+  ha_buffer_flush(&buf, stdout);
+  ha_buffer_free(&buf);
+}
+
+void ha_matrix_add_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                        const struct ha_matrix *m) {
+  assert(dst);
+  assert(same_size(dst, n) && same_size(n, m));
+  const int size = n->rows * n->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_comp_add_into(&dst->entries[i], &n->entries[i], &m->entries[i]);
+  }
+}
+
+struct ha_matrix *ha_matrix_add(const struct ha_matrix *n,
+                                const struct ha_matrix *m) {
+  assert(n);
+  assert(m);
+  if (!same_size(n, m)) {
+    print_size_error("add", n, m);
+    return NULL;
+  }
+  struct ha_matrix *result = ha_matrix_create(n->rows, n->cols);
+  ha_matrix_add_into(result, n, m);
+  return result;
+}
+
+void ha_matrix_sub_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                        const struct ha_matrix *m) {
+  assert(dst);
+  assert(same_size(dst, n) && same_size(n, m));
+  const int size = n->rows * n->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_comp_sub_into(&dst->entries[i], &n->entries[i], &m->entries[i]);
+  }
+}
+
+struct ha_matrix *ha_matrix_sub(const struct ha_matrix *n,
+                                const struct ha_matrix *m) {
+  assert(n);
+  assert(m);
+  if (!same_size(n, m)) {
+    print_size_error("subtract", n, m);
+    return NULL;
+  }
+  struct ha_matrix *result = ha_matrix_create(n->rows, n->cols);
+  ha_matrix_sub_into(result, n, m);
+  return result;
+}
+
+void ha_matrix_scalar_mult_into(struct ha_matrix *dst, const struct ha_comp *k,
+                                const struct ha_matrix *mat) {
+  assert(dst);
+  assert(k);
+  assert(same_size(dst, mat));
+  // k may be an entry that is about to be overwritten
+  struct ha_comp *factor = ha_comp_add(k, zero());
+  const int size = mat->rows * mat->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_comp_mult_into(&dst->entries[i], factor, &mat->entries[i]);
+  }
+  ha_comp_destroy(factor);
+}
+
+struct ha_matrix *ha_matrix_scalar_mult(const struct ha_comp *k,
+                                        const struct ha_matrix *mat) {
+  assert(k);
+  assert(mat);
+  struct ha_matrix *result = ha_matrix_create(mat->rows, mat->cols);
+  ha_matrix_scalar_mult_into(result, k, mat);
+  return result;
+}
+
+// mult_block(dst, n, m, rows, cols) sets the entries of dst in the given rows
+//   and columns, the ranges [rows[0], rows[1]) and [cols[0], cols[1]), to
+//   those of n * m
+// requires: the sizes are as in ha_matrix_mult_into
+// effects: modifies dst
+//          may allocate memory
+// time: O(rn * c * cn * e), where rn and cn are the numbers of rows and
+//       columns in the block
+static void mult_block(struct ha_matrix *dst, const struct ha_matrix *n,
+                       const struct ha_matrix *m, const int rows[2],
+                       const int cols[2]) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  for (int i = rows[0]; i < rows[1]; ++i) {
+    struct ha_comp *dst_row = entry(dst, i, 0);
+    for (int j = cols[0]; j < cols[1]; ++j) {
+      ha_comp_set(&dst_row[j], zero());
+    }
+  }
+  // the entries of the block are the accumulators: the inner dimension is
+  // taken MULT_TILE at a time, so that the rows of m in use stay in the cache
+  // while every row of the block is updated; within a step the order is
+  // i-k-j, each n[i][k] being applied to a row of m, and zero entries of n
+  // are skipped
+  for (int k_first = 0; k_first < n->cols; k_first += MULT_TILE) {
+    const int k_last = min(k_first + MULT_TILE, n->cols);
+    for (int i = rows[0]; i < rows[1]; ++i) {
+      struct ha_comp *dst_row = entry(dst, i, 0);
+      for (int k = k_first; k < k_last; ++k) {
+        const struct ha_comp *factor = entry(n, i, k);
+        if (ha_comp_is_zero(factor)) {
+          continue;
+        }
+        const struct ha_comp *m_row = entry(m, k, 0);
+        for (int j = cols[0]; j < cols[1]; ++j) {
+          ha_comp_fma(&dst_row[j], factor, &m_row[j]);
+        }
+      }
+    }
+  }
+}
+
+// mult_task(ctx, task) computes the task-th tile of a parallel multiplication,
+//   where ctx is its mult_job
+// effects: modifies the destination of the job
+//          may allocate memory
+// time: O(MULT_TILE^2 * c * e)
+static void mult_task(void *ctx, int task) {
+  const struct mult_job *job = ctx;
+  const int row = task / job->tile_cols * MULT_TILE;
+  const int col = task % job->tile_cols * MULT_TILE;
+  const int rows[2] = {row, min(row + MULT_TILE, job->dst->rows)};
+  const int cols[2] = {col, min(col + MULT_TILE, job->dst->cols)};
+  const bool lazy = ha_frac_set_lazy(job->lazy);
+  mult_block(job->dst, job->n, job->m, rows, cols);
+  ha_frac_set_lazy(lazy);
+}
+
+// mult_tiled(dst, n, m) sets dst to n * m tile by tile, in parallel on the
+//   current pool if there is one
+// requires: the sizes are as in ha_matrix_mult_into
+// effects: modifies dst
+//          may allocate memory
+// time: O(r * c * cm * e), where cm is the number of columns of m
+static void mult_tiled(struct ha_matrix *dst, const struct ha_matrix *n,
+                       const struct ha_matrix *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  struct ha_pool *pool = ha_pool_current();
+  const int tile_rows = (dst->rows + MULT_TILE - 1) / MULT_TILE;
+  const int tile_cols = (dst->cols + MULT_TILE - 1) / MULT_TILE;
+  if (!pool || ha_pool_threads(pool) == 1 || tile_rows * tile_cols == 1) {
+    for (int row = 0; row < dst->rows; row += MULT_TILE) {
+      for (int col = 0; col < dst->cols; col += MULT_TILE) {
+        const int rows[2] = {row, min(row + MULT_TILE, dst->rows)};
+        const int cols[2] = {col, min(col + MULT_TILE, dst->cols)};
+        mult_block(dst, n, m, rows, cols);
+      }
+    }
+    return;
+  }
+  // the storage of an arena must only grow from the thread using it, so
+  // its entries are computed on the heap and moved in afterwards
+  struct ha_matrix *out = dst;
+  if (dst->arena) {
+    struct ha_arena *arena = ha_arena_use(NULL);
+    out = ha_matrix_create(dst->rows, dst->cols);
+    ha_arena_use(arena);
+  }
+  struct mult_job job = {out, n, m, tile_cols, ha_frac_lazy()};
+  ha_pool_run(pool, tile_rows * tile_cols, mult_task, &job);
+  if (out != dst) {
+    const int size = dst->rows * dst->cols;
+    for (int i = 0; i < size; ++i) {
+      ha_frac_swap(&dst->entries[i].real, &out->entries[i].real);
+      ha_frac_swap(&dst->entries[i].ima, &out->entries[i].ima);
+    }
+    ha_matrix_destroy(out);
+  }
+}
+
+// copy_block(dst, src, row, col) sets dst to the block of src with its top
+//   left entry at row and col, leaving the entries of dst that fall outside
+//   of src as they are
+// effects: modifies dst
+//          may allocate memory
+// time: O(rd * cd * e), where rd and cd are the numbers of rows and columns
+//       of dst
+static void copy_block(struct ha_matrix *dst, const struct ha_matrix *src,
+                       int row, int col) {
+  assert(dst);
+  assert(src);
+  const int rows = min(dst->rows, src->rows - row);
+  const int cols = min(dst->cols, src->cols - col);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      ha_comp_set(entry(dst, i, j), entry(src, row + i, col + j));
+    }
+  }
+}
+
+// move_block(dst, src, row, col) moves the entries of src into the block of
+//   dst with its top left entry at row and col, dropping those that fall
+//   outside of dst
+// effects: modifies dst and src (whose entries become unspecified)
+// time: O(rs * cs), where rs and cs are the numbers of rows and columns of
+//       src
+static void move_block(struct ha_matrix *dst, struct ha_matrix *src, int row,
+                       int col) {
+  assert(dst);
+  assert(src);
+  const int rows = min(src->rows, dst->rows - row);
+  const int cols = min(src->cols, dst->cols - col);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      struct ha_comp *x = entry(dst, row + i, col + j);
+      struct ha_comp *y = entry(src, i, j);
+      ha_frac_swap(&x->real, &y->real);
+      ha_frac_swap(&x->ima, &y->ima);
+    }
+  }
+}
+
+// strassen(dst, n, m) sets dst to n * m with one Strassen-Winograd step: the
+//   product of the 2 x 2 block matrices takes 7 products of blocks and 15
+//   sums instead of 8 products, and the products recurse through
+//   ha_matrix_mult_into
+// notes: an odd size is padded with a row and a column of zeros, which the
+//          products skip; the blocks and intermediate results live on the
+//          heap, 17 blocks of a quarter of dst at a time
+// requires: n, m and dst are square of the same size, at least 2
+//           dst is neither n nor m
+// effects: modifies dst
+//          may allocate memory
+// time: O(7 * M(r / 2) + r^2 * e), where M(k) is the time of a k x k product
+static void strassen(struct ha_matrix *dst, const struct ha_matrix *n,
+                     const struct ha_matrix *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  assert(dst->rows >= 2);
+  const int h = (dst->rows + 1) / 2;
+  struct ha_arena *arena = ha_arena_use(NULL);
+  // a[0..3] and b[0..3] are the blocks 11, 12, 21 and 22 of n and m
+  struct ha_matrix *a[4];
+  struct ha_matrix *b[4];
+  for (int i = 0; i < 4; ++i) {
+    a[i] = ha_matrix_create(h, h);
+    b[i] = ha_matrix_create(h, h);
+    copy_block(a[i], n, i / 2 * h, i % 2 * h);
+    copy_block(b[i], m, i / 2 * h, i % 2 * h);
+  }
+  struct ha_matrix *s = ha_matrix_create(h, h);
+  struct ha_matrix *t = ha_matrix_create(h, h);
+  struct ha_matrix *p[7];
+  for (int i = 0; i < 7; ++i) {
+    p[i] = ha_matrix_create(h, h);
+  }
+
+  // the schedule of Winograd's variant, with p[i] standing for P(i + 1)
+  ha_matrix_add_into(s, a[2], a[3]); // S1 = A21 + A22
+  ha_matrix_sub_into(t, b[1], b[0]); // T1 = B12 - B11
+  ha_matrix_mult_into(p[4], s, t); // P5 = S1 * T1
+  ha_matrix_sub_into(s, s, a[0]); // S2 = S1 - A11
+  ha_matrix_sub_into(t, b[3], t); // T2 = B22 - T1
+  ha_matrix_mult_into(p[5], s, t); // P6 = S2 * T2
+  ha_matrix_sub_into(s, a[1], s); // S4 = A12 - S2
+  ha_matrix_mult_into(p[2], s, b[3]); // P3 = S4 * B22
+  ha_matrix_sub_into(t, t, b[2]); // T4 = T2 - B21
+  ha_matrix_mult_into(p[3], a[3], t); // P4 = A22 * T4
+  ha_matrix_sub_into(s, a[0], a[2]); // S3 = A11 - A21
+  ha_matrix_sub_into(t, b[3], b[1]); // T3 = B22 - B12
+  ha_matrix_mult_into(p[6], s, t); // P7 = S3 * T3
+  ha_matrix_mult_into(p[0], a[0], b[0]); // P1 = A11 * B11
+  ha_matrix_mult_into(p[1], a[1], b[2]); // P2 = A12 * B21
+  ha_matrix_add_into(p[1], p[0], p[1]); // C11 = P1 + P2
+  ha_matrix_add_into(p[5], p[0], p[5]); // U2 = P1 + P6
+  ha_matrix_add_into(p[6], p[5], p[6]); // U3 = U2 + P7
+  ha_matrix_add_into(p[5], p[5], p[4]); // U4 = U2 + P5
+  ha_matrix_add_into(p[4], p[6], p[4]); // C22 = U3 + P5
+  ha_matrix_add_into(p[2], p[5], p[2]); // C12 = U4 + P3
+  ha_matrix_sub_into(p[3], p[6], p[3]); // C21 = U3 - P4
+
+  move_block(dst, p[1], 0, 0);
+  move_block(dst, p[2], 0, h);
+  move_block(dst, p[3], h, 0);
+  move_block(dst, p[4], h, h);
+  for (int i = 0; i < 4; ++i) {
+    ha_matrix_destroy(a[i]);
+    ha_matrix_destroy(b[i]);
+  }
+  ha_matrix_destroy(s);
+  ha_matrix_destroy(t);
+  for (int i = 0; i < 7; ++i) {
+    ha_matrix_destroy(p[i]);
+  }
+  ha_arena_use(arena);
+}
+
+void ha_matrix_set_strassen_threshold(int size) {
+  assert(size > 0);
+  strassen_threshold = size < 2 ? 2 : size;
+}
+
+int ha_matrix_strassen_threshold(void) {
+  return strassen_threshold;
+}
+
+void ha_matrix_mult_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                         const struct ha_matrix *m) {
+  assert(dst);
+  assert(n);
+  assert(m);
+  assert(n->cols == m->rows);
+  assert(dst->rows == n->rows && dst->cols == m->cols);
+  assert(dst != n && dst != m);
+  const int size = dst->rows;
+  if (size >= strassen_threshold && dst->cols == size && n->cols == size) {
+    strassen(dst, n, m);
+  } else {
+    mult_tiled(dst, n, m);
+  }
+}
+
+struct ha_matrix *ha_matrix_mult(const struct ha_matrix *n,
+                                 const struct ha_matrix *m) {
+  assert(n);
+  assert(m);
+  if (n->cols != m->rows) {
+    print_size_error("multiply", n, m);
+    return NULL;
+  }
+  struct ha_matrix *result = ha_matrix_create(n->rows, m->cols);
+  ha_matrix_mult_into(result, n, m);
+  return result;
+}
+
+
+
+// Elimination: determinant, rank and RREF use Bareiss fraction-free
+//   elimination. Every row is first scaled by the lcm of its denominators so
+//   that the entries become Gaussian integers p + qi; each elimination step
+//   then divides exactly by the previous pivot, so the entries stay minors of
+//   the scaled matrix and their sizes stay polynomial. Fractions only come
+//   back in the final results.
+
+// an entry p + qi of an elimination matrix, with p and q integers
+struct gauss_int {
+  struct ha_int re;
+  struct ha_int im;
+};
+
+struct int_matrix {
+  int rows;
+  int cols;
+  struct gauss_int *entries; // row-major
+};
+
+// an elimination step: the rows from first on (but the pivot row) are
+// updated with the pivot at rank and col
+struct step_job {
+  struct int_matrix *a;
+  int rank;
+  int col;
+  const struct gauss_int *prev; // the previous pivot, NULL for the first one
+  int first;
+};
+
+// number of scratch integers the elimination needs at the same time
+#define WORK_NUM 4
+
+
+// int_entry(a, row, col) gives the entry of a at row and col
+// time: O(1)
+static struct gauss_int *int_entry(const struct int_matrix *a, int row,
+                                   int col) {
+  assert(a);
+  assert(0 <= row && row < a->rows);
+  assert(0 <= col && col < a->cols);
+  return &a->entries[row * a->cols + col];
+}
+
+// gauss_is_zero(x) determines if x == 0
+// time: O(1)
+static bool gauss_is_zero(const struct gauss_int *x) {
+  assert(x);
+  return ha_int_sign(&x->re) == 0 && ha_int_sign(&x->im) == 0;
+}
+
+// work_init(t) sets up the WORK_NUM scratch integers t
+// effects: t is valid (client must call work_clear)
+// time: O(1)
+static void work_init(struct ha_int *t) {
+  assert(t);
+  for (int i = 0; i < WORK_NUM; ++i) {
+    ha_int_init(&t[i], NULL);
+  }
+}
+
+// work_clear(t) frees the WORK_NUM scratch integers t
+// effects: t is no longer valid
+// time: O(1)
+static void work_clear(struct ha_int *t) {
+  assert(t);
+  for (int i = 0; i < WORK_NUM; ++i) {
+    ha_int_clear(&t[i]);
+  }
+}
+
+// scale_frac(dst, num, scale, t) sets dst to num * scale
+// requires: the denominator of num divides scale
+//           t points at WORK_NUM scratch integers
+// effects: modifies dst and t
+// time: O(logs * (n2)), where s is scale
+static void scale_frac(struct ha_int *dst, const struct ha_frac *num,
+                       const struct ha_int *scale, struct ha_int *t) {
+  assert(dst);
+  assert(num);
+  assert(scale);
+  assert(t);
+  ha_int_divmod_into(&t[0], NULL, scale, &num->denom);
+  ha_int_mult_into(dst, &num->nume, &t[0]);
+  if (num->nega) {
+    ha_int_negate(dst);
+  }
+}
+
+// lcm_into(dst, n, t) sets dst to lcm(dst, n)
+// requires: dst > 0, n > 0
+//           t points at WORK_NUM scratch integers
+// effects: modifies dst and t
+// time: O(logdst * logn)
+static void lcm_into(struct ha_int *dst, const struct ha_int *n,
+                     struct ha_int *t) {
+  assert(dst);
+  assert(n);
+  assert(t);
+  ha_int_gcd_into(&t[0], dst, n);
+  ha_int_divmod_into(&t[1], NULL, n, &t[0]);
+  ha_int_mult_into(dst, dst, &t[1]);
+}
+
+// new_int_matrix(rows, cols) gives a rows x cols elimination matrix of zeros,
+//   on the heap
+// effects: allocates memory (client must call free_int_matrix)
+// time: O(rows * cols)
+static struct int_matrix new_int_matrix(int rows, int cols) {
+  struct int_matrix a = {rows, cols, NULL};
+  const size_t size = (size_t)rows * cols;
+  a.entries = ha_alloc(NULL, size * sizeof(struct gauss_int));
+  for (size_t i = 0; i < size; ++i) {
+    ha_int_init(&a.entries[i].re, NULL);
+    ha_int_init(&a.entries[i].im, NULL);
+  }
+  return a;
+}
+
+// row_lcm(dst, mat, i, t) sets dst to the lcm of the denominators of the row
+//   i of mat
+// requires: t points at WORK_NUM scratch integers, of which only the last may
+//           be dst
+// effects: modifies dst and t
+// time: O(c * e)
+static void row_lcm(struct ha_int *dst, const struct ha_matrix *mat, int i,
+                    struct ha_int *t) {
+  assert(dst);
+  assert(mat);
+  assert(t);
+  const struct ha_comp *row = entry(mat, i, 0);
+  ha_int_set(dst, &row[0].real.denom);
+  for (int j = 0; j < mat->cols; ++j) {
+    lcm_into(dst, &row[j].real.denom, t);
+    lcm_into(dst, &row[j].ima.denom, t);
+  }
+}
+
+// to_int_matrix(mat, scale_product, t) gives mat with every row scaled by the
+//   lcm of its denominators, and multiplies scale_product by those lcms if it
+//   is not NULL
+// requires: t points at WORK_NUM scratch integers
+// effects: allocates memory (client must call free_int_matrix)
+//          modifies scale_product and t
+// time: O(r * c * e)
+static struct int_matrix to_int_matrix(const struct ha_matrix *mat,
+                                       struct ha_int *scale_product,
+                                       struct ha_int *t) {
+  assert(mat);
+  assert(t);
+  struct int_matrix a = new_int_matrix(mat->rows, mat->cols);
+  struct ha_int *scale = &t[WORK_NUM - 1];
+  for (int i = 0; i < a.rows; ++i) {
+    const struct ha_comp *row = entry(mat, i, 0);
+    row_lcm(scale, mat, i, t);
+    for (int j = 0; j < a.cols; ++j) {
+      struct gauss_int *x = int_entry(&a, i, j);
+      scale_frac(&x->re, &row[j].real, scale, t);
+      scale_frac(&x->im, &row[j].ima, scale, t);
+    }
+    if (scale_product) {
+      ha_int_mult_into(scale_product, scale_product, scale);
+    }
+  }
+  return a;
+}
+
+// free_int_matrix(a) frees the entries of a
+// effects: a is no longer valid
+// time: O(r * c)
+static void free_int_matrix(struct int_matrix *a) {
+  assert(a);
+  const int size = a->rows * a->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_int_clear(&a->entries[i].re);
+    ha_int_clear(&a->entries[i].im);
+  }
+  ha_release(NULL, a->entries);
+}
+
+// swap_rows(a, i, k) exchanges the rows i and k of a
+// effects: modifies a
+// time: O(c)
+static void swap_rows(struct int_matrix *a, int i, int k) {
+  assert(a);
+  for (int j = 0; j < a->cols; ++j) {
+    struct gauss_int *x = int_entry(a, i, j);
+    struct gauss_int *y = int_entry(a, k, j);
+    ha_int_swap(&x->re, &y->re);
+    ha_int_swap(&x->im, &y->im);
+  }
+}
+
+// cross_into(x, p, b, c, t) sets x to p * x - b * c
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies x and t
+// time: O(e)
+static void cross_into(struct gauss_int *x, const struct gauss_int *p,
+                       const struct gauss_int *b, const struct gauss_int *c,
+                       struct ha_int *t) {
+  assert(x);
+  assert(p);
+  assert(b);
+  assert(c);
+  assert(t);
+  // real part: pr * xr - pi * xi - br * cr + bi * ci
+  ha_int_mult_into(&t[0], &p->re, &x->re);
+  ha_int_mult_into(&t[2], &p->im, &x->im);
+  ha_int_sub_into(&t[0], &t[0], &t[2]);
+  ha_int_mult_into(&t[2], &b->re, &c->re);
+  ha_int_sub_into(&t[0], &t[0], &t[2]);
+  ha_int_addmul(&t[0], &b->im, &c->im);
+  // imaginary part: pr * xi + pi * xr - br * ci - bi * cr
+  ha_int_mult_into(&t[1], &p->re, &x->im);
+  ha_int_addmul(&t[1], &p->im, &x->re);
+  ha_int_mult_into(&t[2], &b->re, &c->im);
+  ha_int_sub_into(&t[1], &t[1], &t[2]);
+  ha_int_mult_into(&t[2], &b->im, &c->re);
+  ha_int_sub_into(&t[1], &t[1], &t[2]);
+  ha_int_swap(&x->re, &t[0]);
+  ha_int_swap(&x->im, &t[1]);
+}
+
+// div_exact_into(x, d, t) sets x to x / d
+// requires: d != 0 divides x in the Gaussian integers
+//           t points at WORK_NUM scratch integers
+// effects: modifies x and t
+// time: O(e)
+static void div_exact_into(struct gauss_int *x, const struct gauss_int *d,
+                           struct ha_int *t) {
+  assert(x);
+  assert(d);
+  assert(t);
+  if (ha_int_sign(&d->im) == 0) { // real divisor
+    ha_int_divmod_into(&x->re, NULL, &x->re, &d->re);
+    ha_int_divmod_into(&x->im, NULL, &x->im, &d->re);
+    return;
+  }
+  // x / d = x * conj(d) / |d|^2
+  ha_int_mult_into(&t[3], &d->re, &d->re);
+  ha_int_addmul(&t[3], &d->im, &d->im);
+  ha_int_mult_into(&t[0], &x->re, &d->re);
+  ha_int_addmul(&t[0], &x->im, &d->im);
+  ha_int_mult_into(&t[1], &x->im, &d->re);
+  ha_int_mult_into(&t[2], &x->re, &d->im);
+  ha_int_sub_into(&t[1], &t[1], &t[2]);
+  ha_int_divmod_into(&x->re, NULL, &t[0], &t[3]);
+  ha_int_divmod_into(&x->im, NULL, &t[1], &t[3]);
+}
+
+// update_row(job, i, t) applies the elimination step job to the row i
+// notes: a[i][j] = (p * a[i][j] - a[i][col] * a[rank][j]) / prev, where p is
+//          the pivot; left of col, the pivot row is 0, so only rows above (in
+//          Gauss-Jordan form) change there, by the factor p / prev
+//        the pivot row itself is left as it is
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies the row i of the matrix of job, and t
+// time: O(c * e)
+static void update_row(const struct step_job *job, int i, struct ha_int *t) {
+  assert(job);
+  assert(t);
+  struct int_matrix *a = job->a;
+  if (i == job->rank) {
+    return;
+  }
+  const struct gauss_int *p = int_entry(a, job->rank, job->col);
+  struct gauss_int *b = int_entry(a, i, job->col);
+  for (int j = i < job->rank ? 0 : job->col + 1; j < a->cols; ++j) {
+    if (j == job->col) {
+      continue;
+    }
+    struct gauss_int *x = int_entry(a, i, j);
+    cross_into(x, p, b, int_entry(a, job->rank, j), t);
+    if (job->prev) {
+      div_exact_into(x, job->prev, t);
+    }
+  }
+  ha_int_sub_into(&b->re, &b->re, &b->re);
+  ha_int_sub_into(&b->im, &b->im, &b->im);
+}
+
+// step_task(ctx, task) updates the task-th row of a parallel elimination
+//   step, where ctx is its step_job
+// effects: modifies the row of the matrix of the job
+// time: O(c * e)
+static void step_task(void *ctx, int task) {
+  const struct step_job *job = ctx;
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  update_row(job, job->first + task, t);
+  work_clear(t);
+}
+
+// bareiss(a, jordan, pivot_cols, swaps, t) brings a into fraction-free row
+//   echelon form, or also clears the entries above the pivots if jordan is
+//   true, and gives the rank of a
+// notes: pivot_cols[k] is set to the column of the k-th pivot, whose row is k
+//        *swaps is set to the number of row exchanges
+//        without jordan, the last pivot of a square matrix of full rank is
+//          its determinant
+//        with jordan, every pivot ends up equal to the last one
+// requires: pivot_cols has room for min(r, c) columns
+//           t points at WORK_NUM scratch integers
+// effects: modifies a, pivot_cols, *swaps and t
+// time: O(r * c * min(r, c) * e)
+static int bareiss(struct int_matrix *a, bool jordan, int *pivot_cols,
+                   int *swaps, struct ha_int *t) {
+  assert(a);
+  assert(pivot_cols);
+  assert(swaps);
+  assert(t);
+  *swaps = 0;
+  struct gauss_int prev; // the previous pivot, which every update divides by
+  ha_int_init(&prev.re, NULL);
+  ha_int_init(&prev.im, NULL);
+  int rank = 0;
+  for (int col = 0; col < a->cols && rank < a->rows; ++col) {
+    int pivot = rank;
+    while (pivot < a->rows && gauss_is_zero(int_entry(a, pivot, col))) {
+      ++pivot;
+    }
+    if (pivot == a->rows) { // no pivot in this column
+      continue;
+    }
+    if (pivot != rank) {
+      swap_rows(a, pivot, rank);
+      ++*swaps;
+    }
+    // the rows are independent of each other, so they are updated by the
+    // threads of the current pool if there is one
+    struct step_job job = {a, rank, col, rank > 0 ? &prev : NULL,
+                           jordan ? 0 : rank + 1};
+    const int updated = a->rows - job.first;
+    struct ha_pool *pool = ha_pool_current();
+    if (pool && ha_pool_threads(pool) > 1 && updated > 1) {
+      ha_pool_run(pool, updated, step_task, &job);
+    } else {
+      for (int i = job.first; i < a->rows; ++i) {
+        update_row(&job, i, t);
+      }
+    }
+    const struct gauss_int *p = int_entry(a, rank, col);
+    ha_int_set(&prev.re, &p->re);
+    ha_int_set(&prev.im, &p->im);
+    pivot_cols[rank] = col;
+    ++rank;
+  }
+  ha_int_clear(&prev.re);
+  ha_int_clear(&prev.im);
+  return rank;
+}
+
+// set_ratio(dst, x, d, t) sets dst to x / d
+// requires: d != 0
+//           t points at WORK_NUM scratch integers
+// effects: modifies dst and t
+// time: O(e)
+static void set_ratio(struct ha_comp *dst, const struct gauss_int *x,
+                      const struct gauss_int *d, struct ha_int *t) {
+  assert(dst);
+  assert(x);
+  assert(d);
+  assert(t);
+  if (ha_int_sign(&d->im) == 0) { // real divisor
+    ha_frac_set_quotient(&dst->real, &x->re, &d->re);
+    ha_frac_set_quotient(&dst->ima, &x->im, &d->re);
+    return;
+  }
+  // x / d = x * conj(d) / |d|^2
+  ha_int_mult_into(&t[3], &d->re, &d->re);
+  ha_int_addmul(&t[3], &d->im, &d->im);
+  ha_int_mult_into(&t[0], &x->re, &d->re);
+  ha_int_addmul(&t[0], &x->im, &d->im);
+  ha_int_mult_into(&t[1], &x->im, &d->re);
+  ha_int_mult_into(&t[2], &x->re, &d->im);
+  ha_int_sub_into(&t[1], &t[1], &t[2]);
+  ha_frac_set_quotient(&dst->real, &t[0], &t[3]);
+  ha_frac_set_quotient(&dst->ima, &t[1], &t[3]);
+}
+
+// int_det(a, scale, t) gives det(a) / scale
+// requires: a is square
+//           scale is real and not 0
+//           t points at WORK_NUM scratch integers
+// effects: modifies a, scale and t
+//          allocates memory (client must call ha_comp_destroy)
+// time: O(r^3 * e)
+static struct ha_comp *int_det(struct int_matrix *a, struct gauss_int *scale,
+                               struct ha_int *t) {
+  assert(a);
+  assert(a->rows == a->cols);
+  assert(scale);
+  assert(t);
+  int *pivot_cols = ha_alloc(NULL, a->rows * sizeof(int));
+  int swaps = 0;
+  const int rank = bareiss(a, false, pivot_cols, &swaps, t);
+  struct ha_comp *det = ha_comp_create("0", "1", "0", "1");
+  if (rank == a->rows) {
+    if (swaps % 2) {
+      ha_int_negate(&scale->re);
+    }
+    set_ratio(det, int_entry(a, rank - 1, rank - 1), scale, t);
+  }
+  ha_release(NULL, pivot_cols);
+  return det;
+}
+
+struct ha_comp *ha_matrix_det(const struct ha_matrix *mat) {
+  assert(mat);
+  if (mat->rows != mat->cols) {
+    printf("Error: cannot take the determinant of a %dx%d matrix\n",
+           mat->rows, mat->cols);
+    return NULL;
+  }
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct gauss_int scale; // det(mat) = det(a) / scale
+  ha_int_init(&scale.re, NULL);
+  ha_int_init(&scale.im, NULL);
+  ha_int_set(&scale.re, ha_int_constant(1));
+  struct int_matrix a = to_int_matrix(mat, &scale.re, t);
+  struct ha_comp *det = int_det(&a, &scale, t);
+  free_int_matrix(&a);
+  ha_int_clear(&scale.re);
+  ha_int_clear(&scale.im);
+  work_clear(t);
+  return det;
+}
+
+int ha_matrix_rank(const struct ha_matrix *mat) {
+  assert(mat);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct int_matrix a = to_int_matrix(mat, NULL, t);
+  int *pivot_cols = ha_alloc(NULL, mat->rows * sizeof(int));
+  int swaps = 0;
+  const int rank = bareiss(&a, false, pivot_cols, &swaps, t);
+  ha_release(NULL, pivot_cols);
+  free_int_matrix(&a);
+  work_clear(t);
+  return rank;
+}
+
+struct ha_matrix *ha_matrix_rref(const struct ha_matrix *mat) {
+  assert(mat);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct int_matrix a = to_int_matrix(mat, NULL, t);
+  int *pivot_cols = ha_alloc(NULL, mat->rows * sizeof(int));
+  int swaps = 0;
+  const int rank = bareiss(&a, true, pivot_cols, &swaps, t);
+  // every row of a is its row of the RREF times its pivot
+  struct ha_matrix *result = ha_matrix_create(mat->rows, mat->cols);
+  for (int i = 0; i < rank; ++i) {
+    const struct gauss_int *p = int_entry(&a, i, pivot_cols[i]);
+    for (int j = pivot_cols[i]; j < a.cols; ++j) {
+      set_ratio(entry(result, i, j), int_entry(&a, i, j), p, t);
+    }
+  }
+  ha_release(NULL, pivot_cols);
+  free_int_matrix(&a);
+  work_clear(t);
+  return result;
+}
+
+// check_system(a, b) determines if a x = b is a system that can be solved for
+//   x, and prints an error message if it is not
+// effects: may produce output (error message)
+// time: O(1)
+static bool check_system(const struct ha_matrix *a, const struct ha_matrix *b) {
+  assert(a);
+  assert(b);
+  if (a->rows != a->cols) {
+    printf("Error: cannot solve a system with a %dx%d matrix\n", a->rows,
+           a->cols);
+    return false;
+  }
+  if (b->rows != a->rows) {
+    print_size_error("solve", a, b);
+    return false;
+  }
+  return true;
+}
+
+// augment(a, b) gives the matrix [a | b], on the heap
+// requires: a and b have the same number of rows
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * (c + cb) * e), where cb is the number of columns of b
+static struct ha_matrix *augment(const struct ha_matrix *a,
+                                 const struct ha_matrix *b) {
+  assert(a);
+  assert(b);
+  assert(a->rows == b->rows);
+  struct ha_arena *arena = ha_arena_use(NULL);
+  struct ha_matrix *aug = ha_matrix_create(a->rows, a->cols + b->cols);
+  ha_arena_use(arena);
+  for (int i = 0; i < a->rows; ++i) {
+    for (int j = 0; j < a->cols; ++j) {
+      ha_comp_set(entry(aug, i, j), entry(a, i, j));
+    }
+    for (int j = 0; j < b->cols; ++j) {
+      ha_comp_set(entry(aug, i, a->cols + j), entry(b, i, j));
+    }
+  }
+  return aug;
+}
+
+struct ha_matrix *ha_matrix_solve(const struct ha_matrix *a,
+                                  const struct ha_matrix *b) {
+  assert(a);
+  assert(b);
+  if (!check_system(a, b)) {
+    return NULL;
+  }
+  const int n = a->rows;
+  struct ha_matrix *aug = augment(a, b);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct int_matrix s = to_int_matrix(aug, NULL, t);
+  ha_matrix_destroy(aug);
+  int *pivot_cols = ha_alloc(NULL, n * sizeof(int));
+  int swaps = 0;
+  const int rank = bareiss(&s, true, pivot_cols, &swaps, t);
+  struct ha_matrix *result = NULL;
+  // a is invertible if and only if its columns hold all the pivots
+  if (rank == n && pivot_cols[n - 1] == n - 1) {
+    result = ha_matrix_create(n, b->cols);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < b->cols; ++j) {
+        set_ratio(entry(result, i, j), int_entry(&s, i, n + j),
+                  int_entry(&s, i, i), t);
+      }
+    }
+  } else {
+    printf("Error: the matrix is singular\n");
+  }
+  ha_release(NULL, pivot_cols);
+  free_int_matrix(&s);
+  work_clear(t);
+  return result;
+}
+
+struct ha_matrix *ha_matrix_inverse(const struct ha_matrix *mat) {
+  assert(mat);
+  if (mat->rows != mat->cols) {
+    printf("Error: cannot invert a %dx%d matrix\n", mat->rows, mat->cols);
+    return NULL;
+  }
+  struct ha_arena *arena = ha_arena_use(NULL);
+  struct ha_matrix *identity = ha_matrix_identity(mat->rows);
+  ha_arena_use(arena);
+  struct ha_matrix *result = ha_matrix_solve(mat, identity);
+  ha_matrix_destroy(identity);
+  return result;
+}
+
+
+// Multi-modular engine: the matrix is scaled to Gaussian integers as for
+//   the elimination above, and then reduced modulo word-sized primes p = 1
+//   (mod 4). Every such p has a square root w of -1, and sending i to w and
+//   to -w turns the system into two systems of integers mod p, which are
+//   solved by plain Gauss-Jordan elimination with machine arithmetic
+//   (Montgomery multiplication where 128-bit products are available). The
+//   determinant D and the numerators D * x of the solution come back from
+//   their residues by the Chinese Remainder Theorem, once the product of
+//   the primes is more than twice their Hadamard bound, so the results are
+//   exact without any check. A prime that divides D (in either half) says
+//   nothing about D * x and is skipped; x = (D * x) / D at the end. The
+//   primes of a batch are independent, and run as tasks of the current pool.
+
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 mod_wide;
+#define PRIME_START ((1ULL << 62) - 3) // the largest candidate, 1 mod 4
+#define PRIME_MIN_BITS 61 // every prime used is above 2^PRIME_MIN_BITS
+#else
+typedef uint64_t mod_wide;
+#define PRIME_START ((1ULL << 31) - 3)
+#define PRIME_MIN_BITS 30
+#endif
+
+struct prime {
+  uint64_t p;
+  uint64_t w; // a square root of -1 mod p
+  uint64_t inv; // -1 / p mod 2^64, for Montgomery multiplication
+  uint64_t r2; // 2^128 mod p, for Montgomery multiplication
+};
+
+// a batch of primes of the multi-modular engine
+struct modular_job {
+  const struct int_matrix *a; // [A | B], scaled to Gaussian integers
+  int n; // number of rows of A, and of columns
+  bool real; // no entry has an imaginary part
+  const struct prime *primes; // the primes of the batch
+  uint64_t *det; // per prime: the real and imaginary parts of D mod p
+  uint64_t *num; // per prime: the real and imaginary parts of the entries
+                 // of D * x mod p (row-major), NULL without B
+  bool *good; // per prime: D is a unit in both halves mod p
+};
+
+// per-thread primes, found on first use and kept on the heap until the
+// thread trims or exits
+static _Thread_local struct prime *prime_cache;
+static _Thread_local int prime_num;
+
+
+// mul_mod(a, b, p) gives a * b mod p
+// requires: a, b < p
+// time: O(1)
+static uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t p) {
+  return (mod_wide)a * b % p;
+}
+
+// pow_mod(a, e, p) gives a^e mod p
+// requires: a < p
+// time: O(log(e))
+static uint64_t pow_mod(uint64_t a, uint64_t e, uint64_t p) {
+  uint64_t result = 1 % p;
+  while (e) {
+    if (e & 1) {
+      result = mul_mod(result, a, p);
+    }
+    a = mul_mod(a, a, p);
+    e >>= 1;
+  }
+  return result;
+}
+
+// is_prime(n) determines if the odd number n > 40 is prime
+// notes: checks small factors, then runs Miller-Rabin with the first 12
+//          primes as bases, which is exact below 3 * 10^24
+// time: O(log(n))
+static bool is_prime(uint64_t n) {
+  static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  const int base_num = sizeof(bases) / sizeof(bases[0]);
+  for (int i = 0; i < base_num; ++i) {
+    if (n % bases[i] == 0) {
+      return false;
+    }
+  }
+  uint64_t d = n - 1;
+  int s = 0;
+  while (d % 2 == 0) {
+    d /= 2;
+    ++s;
+  }
+  for (int i = 0; i < base_num; ++i) {
+    uint64_t x = pow_mod(bases[i], d, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    int j = 1;
+    for (; j < s; ++j) {
+      x = mul_mod(x, x, n);
+      if (x == n - 1) {
+        break;
+      }
+    }
+    if (j == s) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// make_prime(q, p) sets up q for the prime p = 1 (mod 4)
+// effects: modifies q
+// time: O(log(p))
+static void make_prime(struct prime *q, uint64_t p) {
+  assert(q);
+  q->p = p;
+  // a^((p - 1) / 4) is a square root of -1 for any non-residue a
+  q->w = 0;
+  for (uint64_t a = 2; !q->w; ++a) {
+    const uint64_t w = pow_mod(a, (p - 1) / 4, p);
+    if (mul_mod(w, w, p) == p - 1) {
+      q->w = w;
+    }
+  }
+  uint64_t x = p; // p * p = 1 mod 8, and each step doubles the correct bits
+  for (int i = 0; i < 5; ++i) {
+    x *= 2 - p * x;
+  }
+  q->inv = -x;
+  const uint64_t r = -p % p; // 2^64 mod p
+  q->r2 = mul_mod(r, r, p);
+}
+
+// release_primes() frees the primes of the current thread, as its cleanup
+//   (see ha_alloc_on_trim)
+// time: O(1)
+static void release_primes(void) {
+  free(prime_cache);
+  prime_cache = NULL;
+  prime_num = 0;
+}
+
+// get_primes(count) gives the first count primes of the engine, the largest
+//   primes p = 1 (mod 4) that are below PRIME_START
+// effects: may allocate memory (kept until the thread trims or exits)
+// time: O(count * log(PRIME_START)^2) on first use
+static const struct prime *get_primes(int count) {
+  assert(count > 0);
+  if (count > prime_num) {
+    ha_alloc_on_trim(release_primes);
+    prime_cache = realloc(prime_cache, count * sizeof(struct prime));
+    uint64_t p = prime_num ? prime_cache[prime_num - 1].p - 4 : PRIME_START;
+    for (; prime_num < count; p -= 4) {
+      if (is_prime(p)) {
+        make_prime(&prime_cache[prime_num], p);
+        ++prime_num;
+      }
+    }
+  }
+  return prime_cache;
+}
+
+// mont_mul(a, b, q) gives a * b / 2^64 mod p, the Montgomery product, or
+//   a * b mod p without 128-bit integers
+// requires: a, b < p
+// time: O(1)
+static uint64_t mont_mul(uint64_t a, uint64_t b, const struct prime *q) {
+#ifdef __SIZEOF_INT128__
+  const mod_wide t = (mod_wide)a * b;
+  const uint64_t m = (uint64_t)t * q->inv;
+  // t + m * p is a multiple of 2^64 below 2^127, since p < 2^62
+  const uint64_t u = (t + (mod_wide)m * q->p) >> 64;
+  return u >= q->p ? u - q->p : u;
+#else
+  return a * b % q->p;
+#endif
+}
+
+// to_mont(a, q) gives a in the form used by mont_mul
+// requires: a < p
+// time: O(1)
+static uint64_t to_mont(uint64_t a, const struct prime *q) {
+#ifdef __SIZEOF_INT128__
+  return mont_mul(a, q->r2, q);
+#else
+  (void)q;
+  return a;
+#endif
+}
+
+// from_mont(a, q) is the inverse of to_mont
+// requires: a < p
+// time: O(1)
+static uint64_t from_mont(uint64_t a, const struct prime *q) {
+#ifdef __SIZEOF_INT128__
+  return mont_mul(a, 1, q);
+#else
+  (void)q;
+  return a;
+#endif
+}
+
+// mont_inv(a, q) gives 1 / a in the form used by mont_mul, for a in that form
+// requires: 0 < a < p
+// time: O(log(p))
+static uint64_t mont_inv(uint64_t a, const struct prime *q) {
+  uint64_t result = to_mont(1, q);
+  for (uint64_t e = q->p - 2; e; e >>= 1) {
+    if (e & 1) {
+      result = mont_mul(result, a, q);
+    }
+    a = mont_mul(a, a, q);
+  }
+  return result;
+}
+
+// mod_eliminate(m, n, cols, q, jordan) brings the first n columns of the
+//   n x cols matrix m of residues (in the form used by mont_mul) to the
+//   identity if they are invertible, and gives their determinant mod p, or
+//   0 if they are not
+// notes: without jordan, only the entries below the pivots are cleared
+// effects: modifies m
+// time: O(n^2 * cols)
+static uint64_t mod_eliminate(uint64_t *m, int n, int cols,
+                              const struct prime *q, bool jordan) {
+  assert(m);
+  const uint64_t p = q->p;
+  uint64_t det = to_mont(1, q);
+  for (int c = 0; c < n; ++c) {
+    int pivot = c;
+    while (pivot < n && m[pivot * cols + c] == 0) {
+      ++pivot;
+    }
+    if (pivot == n) {
+      return 0;
+    }
+    if (pivot != c) {
+      for (int j = c; j < cols; ++j) {
+        const uint64_t x = m[pivot * cols + j];
+        m[pivot * cols + j] = m[c * cols + j];
+        m[c * cols + j] = x;
+      }
+      det = p - det;
+    }
+    uint64_t *row = &m[c * cols];
+    det = mont_mul(det, row[c], q);
+    const uint64_t inv = mont_inv(row[c], q);
+    for (int j = c; j < cols; ++j) {
+      row[j] = mont_mul(row[j], inv, q);
+    }
+    for (int i = jordan ? 0 : c + 1; i < n; ++i) {
+      uint64_t *other = &m[i * cols];
+      const uint64_t f = other[c];
+      if (i == c || f == 0) {
+        continue;
+      }
+      for (int j = c; j < cols; ++j) {
+        const uint64_t x = mont_mul(f, row[j], q);
+        other[j] = other[j] >= x ? other[j] - x : other[j] + p - x;
+      }
+    }
+  }
+  return det;
+}
+
+// modular_task(ctx, task) computes the residues of the task-th prime of a
+//   batch, where ctx is its modular_job
+// effects: modifies the residues of the prime in the job
+// time: O(n^2 * cols), where cols is the number of columns of [A | B]
+static void modular_task(void *ctx, int task) {
+  const struct modular_job *job = ctx;
+  const struct prime *q = &job->primes[task];
+  const uint64_t p = q->p;
+  const int n = job->n;
+  const int cols = job->a->cols;
+  const int k = cols - n;
+  uint64_t *m = ha_alloc(NULL, (size_t)n * cols * sizeof(uint64_t));
+  uint64_t d[2] = {0, 0}; // D mod p with i sent to w and to -w
+  uint64_t *y[2] = {NULL, NULL}; // D * x likewise
+  for (int half = 0; half < (job->real ? 1 : 2); ++half) {
+    const uint64_t w = half == 0 ? q->w : p - q->w;
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        const struct gauss_int *x = int_entry(job->a, i, j);
+        uint64_t r = ha_int_mod_word(&x->re, p);
+        if (!job->real) {
+          r = (r + mul_mod(w, ha_int_mod_word(&x->im, p), p)) % p;
+        }
+        m[i * cols + j] = to_mont(r, q);
+      }
+    }
+    d[half] = mod_eliminate(m, n, cols, q, k > 0);
+    if (k > 0 && d[half]) {
+      y[half] = ha_alloc(NULL, (size_t)n * k * sizeof(uint64_t));
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < k; ++j) {
+          y[half][i * k + j] = from_mont(mont_mul(d[half], m[i * cols + n + j],
+                                                  q), q);
+        }
+      }
+    }
+    d[half] = from_mont(d[half], q);
+  }
+  ha_release(NULL, m);
+
+  // back from the halves: re = (h0 + h1) / 2, im = (h0 - h1) / (2w)
+  const uint64_t half_inv = (p + 1) / 2;
+  const uint64_t w2_inv = pow_mod(mul_mod(2, q->w, p), p - 2, p);
+  uint64_t *det = &job->det[2 * task];
+  if (job->real) {
+    det[0] = d[0];
+    det[1] = 0;
+  } else {
+    det[0] = mul_mod((d[0] + d[1]) % p, half_inv, p);
+    det[1] = mul_mod((d[0] + p - d[1]) % p, w2_inv, p);
+  }
+  if (k > 0) {
+    job->good[task] = y[0] && (job->real || y[1]);
+    uint64_t *num = &job->num[(size_t)2 * n * k * task];
+    for (int i = 0; job->good[task] && i < n * k; ++i) {
+      if (job->real) {
+        num[2 * i] = y[0][i];
+        num[2 * i + 1] = 0;
+      } else {
+        num[2 * i] = mul_mod((y[0][i] + y[1][i]) % p, half_inv, p);
+        num[2 * i + 1] = mul_mod((y[0][i] + p - y[1][i]) % p, w2_inv, p);
+      }
+    }
+  }
+  if (y[0]) {
+    ha_release(NULL, y[0]);
+  }
+  if (y[1]) {
+    ha_release(NULL, y[1]);
+  }
+}
+
+// set_word(dst, x) sets dst to x
+// effects: modifies dst
+// time: O(1)
+static void set_word(struct ha_int *dst, uint64_t x) {
+  assert(dst);
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = (unsigned char)(x >> (8 * i));
+  }
+  ha_int_set_bytes(dst, bytes, 8, false);
+}
+
+// crt_step(x, r, modulus, q, scale, t) sets x to the number mod modulus * p
+//   that is x mod modulus and r mod p, where scale = 1 / modulus mod p
+// requires: 0 <= x < modulus
+//           t points at WORK_NUM scratch integers
+// effects: modifies x and t
+// time: O(log(modulus))
+static void crt_step(struct ha_int *x, uint64_t r, const struct ha_int *modulus,
+                     const struct prime *q, uint64_t scale, struct ha_int *t) {
+  assert(x);
+  assert(modulus);
+  assert(t);
+  const uint64_t p = q->p;
+  const uint64_t diff = (r + p - ha_int_mod_word(x, p)) % p;
+  set_word(&t[0], mul_mod(diff, scale, p));
+  ha_int_addmul(x, modulus, &t[0]);
+}
+
+// to_symmetric(x, modulus, t) turns the residue 0 <= x < modulus into the one
+//   of smallest absolute value
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies x and t
+// time: O(log(modulus))
+static void to_symmetric(struct ha_int *x, const struct ha_int *modulus,
+                         struct ha_int *t) {
+  assert(x);
+  assert(modulus);
+  assert(t);
+  ha_int_add_into(&t[0], x, x);
+  if (ha_int_gt(&t[0], modulus)) {
+    ha_int_sub_into(x, x, modulus);
+  }
+}
+
+// hadamard_bits(a, n, t) gives a b with |D| < 2^b and |(D * x)[i][j]| < 2^b,
+//   where D = det(A) and x solves A x = B for a = [A | B]
+// notes: D is bounded by the product of the row norms of A, and D * x[i][j]
+//          (Cramer's rule) by the product of the column norms of A with the
+//          column i replaced by the column j of B
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies t
+// time: O(r * c * e)
+static int hadamard_bits(const struct int_matrix *a, int n, struct ha_int *t) {
+  assert(a);
+  assert(t);
+  // norms as sums of half bit lengths, rounded up, plus one for each sum
+  long long rows = 0;
+  long long cols = 0;
+  long long min_col = -1;
+  long long max_rhs = 0;
+  for (int i = 0; i < n; ++i) {
+    ha_int_sub_into(&t[1], &t[1], &t[1]);
+    for (int j = 0; j < n; ++j) {
+      const struct gauss_int *x = int_entry(a, i, j);
+      ha_int_addmul(&t[1], &x->re, &x->re);
+      ha_int_addmul(&t[1], &x->im, &x->im);
+    }
+    rows += (ha_int_bit_length(&t[1]) + 1) / 2;
+  }
+  for (int j = 0; j < a->cols; ++j) {
+    ha_int_sub_into(&t[1], &t[1], &t[1]);
+    for (int i = 0; i < n; ++i) {
+      const struct gauss_int *x = int_entry(a, i, j);
+      ha_int_addmul(&t[1], &x->re, &x->re);
+      ha_int_addmul(&t[1], &x->im, &x->im);
+    }
+    const long long bits = (ha_int_bit_length(&t[1]) + 1) / 2;
+    if (j < n) {
+      cols += bits;
+      min_col = min_col < 0 || bits < min_col ? bits : min_col;
+    } else if (bits > max_rhs) {
+      max_rhs = bits;
+    }
+  }
+  long long bits = rows < cols ? rows : cols;
+  if (a->cols > n && cols - min_col + max_rhs > bits) {
+    bits = cols - min_col + max_rhs;
+  }
+  return (int)bits + 1;
+}
+
+// modular_solve(a, n, det, num, t) computes D = det(A) and, if a has more
+//   than n columns, the numerators D * x of the solution of A x = B, for
+//   a = [A | B]
+// returns: false if B is given and A is singular (num is then not set)
+// requires: num has room for n * (c - n) Gaussian integers if c > n, which
+//             are valid
+//           t points at WORK_NUM scratch integers
+// effects: modifies det, num and t
+//          may allocate memory
+// time: O(P * (n^2 * c + r * c * e)), for P primes of about 62 bits, where
+//       P is about twice hadamard_bits divided by 62
+static bool modular_solve(const struct int_matrix *a, int n,
+                          struct gauss_int *det, struct gauss_int *num,
+                          struct ha_int *t) {
+  assert(a);
+  assert(det);
+  assert(t);
+  const int k = a->cols - n;
+  bool real = true;
+  for (int i = 0; real && i < n * a->cols; ++i) {
+    real = ha_int_sign(&a->entries[i].im) == 0;
+  }
+  const int bits = hadamard_bits(a, n, t) + 1; // both signs
+  struct ha_int modulus;
+  ha_int_init(&modulus, NULL);
+  ha_int_set(&modulus, ha_int_constant(1));
+  ha_int_sub_into(&det->re, &det->re, &det->re);
+  ha_int_sub_into(&det->im, &det->im, &det->im);
+  for (int i = 0; i < n * k; ++i) {
+    ha_int_sub_into(&num[i].re, &num[i].re, &num[i].re);
+    ha_int_sub_into(&num[i].im, &num[i].im, &num[i].im);
+  }
+  // primes that divide D (in a half): a nonzero D has |D|^2 < 2^(2 * bits)
+  long long bad_bits = 0;
+  int used = 0;
+  bool singular = false;
+  while (ha_int_bit_length(&modulus) <= bits && !singular) {
+    const int batch = (bits - ha_int_bit_length(&modulus)) / PRIME_MIN_BITS +
+                      1;
+    const struct prime *primes = get_primes(used + batch) + used;
+    struct modular_job job = {a, n, real, primes, NULL, NULL, NULL};
+    job.det = ha_alloc(NULL, (size_t)2 * batch * sizeof(uint64_t));
+    if (k > 0) {
+      job.num = ha_alloc(NULL, (size_t)2 * n * k * batch * sizeof(uint64_t));
+      job.good = ha_alloc(NULL, batch * sizeof(bool));
+    }
+    struct ha_pool *pool = ha_pool_current();
+    if (pool && ha_pool_threads(pool) > 1 && batch > 1) {
+      ha_pool_run(pool, batch, modular_task, &job);
+    } else {
+      for (int i = 0; i < batch; ++i) {
+        modular_task(&job, i);
+      }
+    }
+    for (int i = 0; i < batch; ++i) {
+      const struct prime *q = &primes[i];
+      if (k > 0 && !job.good[i]) {
+        bad_bits += PRIME_MIN_BITS;
+        singular = bad_bits > 2LL * bits;
+        continue;
+      }
+      const uint64_t scale = pow_mod(ha_int_mod_word(&modulus, q->p),
+                                     q->p - 2, q->p);
+      crt_step(&det->re, job.det[2 * i], &modulus, q, scale, t);
+      crt_step(&det->im, job.det[2 * i + 1], &modulus, q, scale, t);
+      for (int j = 0; k > 0 && j < n * k; ++j) {
+        const uint64_t *r = &job.num[(size_t)2 * (n * k * i + j)];
+        crt_step(&num[j].re, r[0], &modulus, q, scale, t);
+        crt_step(&num[j].im, r[1], &modulus, q, scale, t);
+      }
+      set_word(&t[1], q->p);
+      ha_int_mult_into(&modulus, &modulus, &t[1]);
+    }
+    ha_release(NULL, job.det);
+    if (k > 0) {
+      ha_release(NULL, job.num);
+      ha_release(NULL, job.good);
+    }
+    used += batch;
+  }
+  if (!singular) {
+    to_symmetric(&det->re, &modulus, t);
+    to_symmetric(&det->im, &modulus, t);
+    for (int j = 0; j < n * k; ++j) {
+      to_symmetric(&num[j].re, &modulus, t);
+      to_symmetric(&num[j].im, &modulus, t);
+    }
+  }
+  ha_int_clear(&modulus);
+  return !singular;
+}
+
+struct ha_comp *ha_matrix_det_modular(const struct ha_matrix *mat) {
+  assert(mat);
+  if (mat->rows != mat->cols) {
+    printf("Error: cannot take the determinant of a %dx%d matrix\n",
+           mat->rows, mat->cols);
+    return NULL;
+  }
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct gauss_int scale; // det(mat) = det(a) / scale
+  ha_int_init(&scale.re, NULL);
+  ha_int_init(&scale.im, NULL);
+  ha_int_set(&scale.re, ha_int_constant(1));
+  struct int_matrix a = to_int_matrix(mat, &scale.re, t);
+  struct gauss_int det;
+  ha_int_init(&det.re, NULL);
+  ha_int_init(&det.im, NULL);
+  modular_solve(&a, mat->rows, &det, NULL, t);
+  struct ha_comp *result = ha_comp_create("0", "1", "0", "1");
+  set_ratio(result, &det, &scale, t);
+  ha_int_clear(&det.re);
+  ha_int_clear(&det.im);
+  free_int_matrix(&a);
+  ha_int_clear(&scale.re);
+  ha_int_clear(&scale.im);
+  work_clear(t);
+  return result;
+}
+
+struct ha_matrix *ha_matrix_solve_modular(const struct ha_matrix *a,
+                                          const struct ha_matrix *b) {
+  assert(a);
+  assert(b);
+  if (!check_system(a, b)) {
+    return NULL;
+  }
+  const int n = a->rows;
+  const int k = b->cols;
+  struct ha_matrix *aug = augment(a, b);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct int_matrix s = to_int_matrix(aug, NULL, t);
+  ha_matrix_destroy(aug);
+  struct gauss_int det;
+  ha_int_init(&det.re, NULL);
+  ha_int_init(&det.im, NULL);
+  struct gauss_int *num = ha_alloc(NULL, (size_t)n * k *
+                                   sizeof(struct gauss_int));
+  for (int i = 0; i < n * k; ++i) {
+    ha_int_init(&num[i].re, NULL);
+    ha_int_init(&num[i].im, NULL);
+  }
+  struct ha_matrix *result = NULL;
+  if (modular_solve(&s, n, &det, num, t)) {
+    result = ha_matrix_create(n, k);
+    for (int i = 0; i < n * k; ++i) {
+      set_ratio(&result->entries[i], &num[i], &det, t);
+    }
+  } else {
+    printf("Error: the matrix is singular\n");
+  }
+  for (int i = 0; i < n * k; ++i) {
+    ha_int_clear(&num[i].re);
+    ha_int_clear(&num[i].im);
+  }
+  ha_release(NULL, num);
+  ha_int_clear(&det.re);
+  ha_int_clear(&det.im);
+  free_int_matrix(&s);
+  work_clear(t);
+  return result;
+}
+
+
+// Row form: the numerators of the entries are Gaussian integers over one
+//   positive denominator per row, and every row is kept in lowest terms
+//   (its denominator and the parts of its numerators have no common
+//   factor). Products of row forms only use integer arithmetic: the rows of
+//   m are brought to the lcm E of their denominators, so that the row i of
+//   n * m is the row i of the product of the numerators over d_i * E, and
+//   one run of gcds over the row puts it back in lowest terms.
+
+struct ha_row_matrix {
+  struct int_matrix num; // numerators, the row i over denoms[i]
+  struct ha_int *denoms; // one per row, positive
+};
+
+// a product of row forms split over the threads of a pool, by rows of dst
+struct row_mult_job {
+  struct ha_row_matrix *dst;
+  const struct int_matrix *n;
+  const struct int_matrix *m; // numerators of m over a single denominator
+};
+
+
+// copy_int_matrix(a) gives a copy of a, on the heap
+// effects: allocates memory (client must call free_int_matrix)
+// time: O(r * c * e)
+static struct int_matrix copy_int_matrix(const struct int_matrix *a) {
+  assert(a);
+  struct int_matrix copy = new_int_matrix(a->rows, a->cols);
+  const int size = a->rows * a->cols;
+  for (int i = 0; i < size; ++i) {
+    ha_int_set(&copy.entries[i].re, &a->entries[i].re);
+    ha_int_set(&copy.entries[i].im, &a->entries[i].im);
+  }
+  return copy;
+}
+
+// new_row_matrix(rows, cols) gives a rows x cols row form with zero
+//   numerators and unset denominators, on the heap
+// effects: allocates memory (client must call ha_row_matrix_destroy)
+// time: O(rows * cols)
+static struct ha_row_matrix *new_row_matrix(int rows, int cols) {
+  struct ha_row_matrix *rm = ha_alloc(NULL, sizeof(struct ha_row_matrix));
+  rm->num = new_int_matrix(rows, cols);
+  rm->denoms = ha_alloc(NULL, rows * sizeof(struct ha_int));
+  for (int i = 0; i < rows; ++i) {
+    ha_int_init(&rm->denoms[i], NULL);
+  }
+  return rm;
+}
+
+// is_unit(n) determines if n == 1, for n > 0
+// time: O(1)
+static bool is_unit(const struct ha_int *n) {
+  assert(n);
+  return ha_int_bit_length(n) == 1;
+}
+
+// reduce_row(rm, i, t) brings the row i of rm to lowest terms
+// notes: the gcds stop as soon as they reach 1, so a row already in lowest
+//          terms usually costs a few of them
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies rm and t
+// time: O(c * e)
+static void reduce_row(struct ha_row_matrix *rm, int i, struct ha_int *t) {
+  assert(rm);
+  assert(t);
+  struct ha_int *g = &t[1];
+  ha_int_set(g, &rm->denoms[i]);
+  for (int j = 0; j < rm->num.cols && !is_unit(g); ++j) {
+    const struct gauss_int *x = int_entry(&rm->num, i, j);
+    ha_int_gcd_into(&t[0], g, &x->re);
+    ha_int_gcd_into(g, &t[0], &x->im);
+  }
+  if (is_unit(g)) {
+    return;
+  }
+  for (int j = 0; j < rm->num.cols; ++j) {
+    struct gauss_int *x = int_entry(&rm->num, i, j);
+    ha_int_divmod_into(&x->re, NULL, &x->re, g);
+    ha_int_divmod_into(&x->im, NULL, &x->im, g);
+  }
+  ha_int_divmod_into(&rm->denoms[i], NULL, &rm->denoms[i], g);
+}
+
+// gauss_addmul(x, a, b, t) adds a * b to x
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies x and t
+// time: O(e)
+static void gauss_addmul(struct gauss_int *x, const struct gauss_int *a,
+                         const struct gauss_int *b, struct ha_int *t) {
+  assert(x);
+  assert(a);
+  assert(b);
+  assert(t);
+  // the imaginary parts are often 0, and only the products they take part
+  // in are skipped
+  const bool a_real = ha_int_sign(&a->im) == 0;
+  const bool b_real = ha_int_sign(&b->im) == 0;
+  ha_int_addmul(&x->re, &a->re, &b->re);
+  if (!a_real && !b_real) {
+    ha_int_mult_into(&t[0], &a->im, &b->im);
+    ha_int_sub_into(&x->re, &x->re, &t[0]);
+  }
+  if (!b_real) {
+    ha_int_addmul(&x->im, &a->re, &b->im);
+  }
+  if (!a_real) {
+    ha_int_addmul(&x->im, &a->im, &b->re);
+  }
+}
+
+// row_mult(job, i, t) computes the row i of a product of row forms, whose
+//   denominator is already set
+// requires: t points at WORK_NUM scratch integers
+// effects: modifies the row i of the destination of job, and t
+// time: O(c * cm * e), where cm is the number of columns of m
+static void row_mult(const struct row_mult_job *job, int i, struct ha_int *t) {
+  assert(job);
+  assert(t);
+  const struct int_matrix *m = job->m;
+  for (int k = 0; k < job->n->cols; ++k) {
+    const struct gauss_int *factor = int_entry(job->n, i, k);
+    if (gauss_is_zero(factor)) {
+      continue;
+    }
+    for (int j = 0; j < m->cols; ++j) {
+      gauss_addmul(int_entry(&job->dst->num, i, j), factor,
+                   int_entry(m, k, j), t);
+    }
+  }
+  reduce_row(job->dst, i, t);
+}
+
+// row_mult_task(ctx, task) computes the task-th row of a parallel product of
+//   row forms, where ctx is its row_mult_job
+// effects: modifies the row of the destination of the job
+// time: O(c * cm * e), where cm is the number of columns of m
+static void row_mult_task(void *ctx, int task) {
+  const struct row_mult_job *job = ctx;
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  row_mult(job, task, t);
+  work_clear(t);
+}
+
+struct ha_row_matrix *ha_row_matrix_create(const struct ha_matrix *mat) {
+  assert(mat);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct ha_row_matrix *rm = new_row_matrix(mat->rows, mat->cols);
+  for (int i = 0; i < mat->rows; ++i) {
+    const struct ha_comp *row = entry(mat, i, 0);
+    row_lcm(&rm->denoms[i], mat, i, t);
+    for (int j = 0; j < mat->cols; ++j) {
+      struct gauss_int *x = int_entry(&rm->num, i, j);
+      scale_frac(&x->re, &row[j].real, &rm->denoms[i], t);
+      scale_frac(&x->im, &row[j].ima, &rm->denoms[i], t);
+    }
+    // already in lowest terms unless the fractions were not
+    reduce_row(rm, i, t);
+  }
+  work_clear(t);
+  return rm;
+}
+
+void ha_row_matrix_destroy(struct ha_row_matrix *rm) {
+  assert(rm);
+  free_int_matrix(&rm->num);
+  for (int i = 0; i < rm->num.rows; ++i) {
+    ha_int_clear(&rm->denoms[i]);
+  }
+  ha_release(NULL, rm->denoms);
+  ha_release(NULL, rm);
+}
+
+int ha_row_matrix_rows(const struct ha_row_matrix *rm) {
+  assert(rm);
+  return rm->num.rows;
+}
+
+int ha_row_matrix_cols(const struct ha_row_matrix *rm) {
+  assert(rm);
+  return rm->num.cols;
+}
+
+struct ha_matrix *ha_row_matrix_to_matrix(const struct ha_row_matrix *rm) {
+  assert(rm);
+  struct ha_matrix *mat = ha_matrix_create(rm->num.rows, rm->num.cols);
+  for (int i = 0; i < rm->num.rows; ++i) {
+    for (int j = 0; j < rm->num.cols; ++j) {
+      const struct gauss_int *x = int_entry(&rm->num, i, j);
+      struct ha_comp *dst = entry(mat, i, j);
+      ha_frac_set_quotient(&dst->real, &x->re, &rm->denoms[i]);
+      ha_frac_set_quotient(&dst->ima, &x->im, &rm->denoms[i]);
+    }
+  }
+  return mat;
+}
+
+struct ha_row_matrix *ha_row_matrix_mult(const struct ha_row_matrix *n,
+                                         const struct ha_row_matrix *m) {
+  assert(n);
+  assert(m);
+  if (n->num.cols != m->num.rows) {
+    printf("Error: cannot multiply a %dx%d matrix and a %dx%d matrix\n",
+           n->num.rows, n->num.cols, m->num.rows, m->num.cols);
+    return NULL;
+  }
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  // the rows of m over their common denominator, copied only if they are
+  // not all over the same one already
+  struct ha_int common;
+  ha_int_init(&common, NULL);
+  ha_int_set(&common, &m->denoms[0]);
+  bool same = true;
+  for (int k = 1; k < m->num.rows; ++k) {
+    same = same && ha_int_eq(&m->denoms[k], &common);
+    lcm_into(&common, &m->denoms[k], t);
+  }
+  struct int_matrix scaled = {0, 0, NULL};
+  if (!same) {
+    scaled = new_int_matrix(m->num.rows, m->num.cols);
+    for (int k = 0; k < m->num.rows; ++k) {
+      ha_int_divmod_into(&t[3], NULL, &common, &m->denoms[k]);
+      for (int j = 0; j < m->num.cols; ++j) {
+        const struct gauss_int *x = int_entry(&m->num, k, j);
+        struct gauss_int *y = int_entry(&scaled, k, j);
+        ha_int_mult_into(&y->re, &x->re, &t[3]);
+        ha_int_mult_into(&y->im, &x->im, &t[3]);
+      }
+    }
+  }
+
+  struct ha_row_matrix *dst = new_row_matrix(n->num.rows, m->num.cols);
+  for (int i = 0; i < n->num.rows; ++i) {
+    ha_int_mult_into(&dst->denoms[i], &n->denoms[i], &common);
+  }
+  // the rows are independent of each other, so they are computed by the
+  // threads of the current pool if there is one
+  struct row_mult_job job = {dst, &n->num, same ? &m->num : &scaled};
+  struct ha_pool *pool = ha_pool_current();
+  if (pool && ha_pool_threads(pool) > 1 && dst->num.rows > 1) {
+    ha_pool_run(pool, dst->num.rows, row_mult_task, &job);
+  } else {
+    for (int i = 0; i < dst->num.rows; ++i) {
+      row_mult(&job, i, t);
+    }
+  }
+  if (!same) {
+    free_int_matrix(&scaled);
+  }
+  ha_int_clear(&common);
+  work_clear(t);
+  return dst;
+}
+
+struct ha_comp *ha_row_matrix_det(const struct ha_row_matrix *rm) {
+  assert(rm);
+  if (rm->num.rows != rm->num.cols) {
+    printf("Error: cannot take the determinant of a %dx%d matrix\n",
+           rm->num.rows, rm->num.cols);
+    return NULL;
+  }
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct gauss_int scale; // det(rm) = det(a) / scale
+  ha_int_init(&scale.re, NULL);
+  ha_int_init(&scale.im, NULL);
+  ha_int_set(&scale.re, &rm->denoms[0]);
+  for (int i = 1; i < rm->num.rows; ++i) {
+    ha_int_mult_into(&scale.re, &scale.re, &rm->denoms[i]);
+  }
+  struct int_matrix a = copy_int_matrix(&rm->num);
+  struct ha_comp *det = int_det(&a, &scale, t);
+  free_int_matrix(&a);
+  ha_int_clear(&scale.re);
+  ha_int_clear(&scale.im);
+  work_clear(t);
+  return det;
+}
+
+int ha_row_matrix_rank(const struct ha_row_matrix *rm) {
+  assert(rm);
+  struct ha_int t[WORK_NUM];
+  work_init(t);
+  struct int_matrix a = copy_int_matrix(&rm->num);
+  int *pivot_cols = ha_alloc(NULL, a.rows * sizeof(int));
+  int swaps = 0;
+  const int rank = bareiss(&a, false, pivot_cols, &swaps, t);
+  ha_release(NULL, pivot_cols);
+  free_int_matrix(&a);
+  work_clear(t);
+  return rank;
+}
+
+
+// Factorization: for A' = A + u * v^T, with w = A^-1 * u, z^T = v^T * A^-1
+//   and s = 1 + v^T * w, det(A') = det(A) * s (the matrix determinant lemma)
+//   and, if s != 0, A'^-1 = A^-1 - w * z^T / s (Sherman-Morrison). The dot
+//   products of w, z and s are summed with deferred reduction, as the
+//   entries of a product.
+
+struct ha_matrix_factor {
+  struct ha_matrix *mat; // the current matrix
+  struct ha_matrix *inverse; // its inverse, NULL if it is singular
+  struct ha_comp det;
+};
+
+
+// new_vector(n) gives n zeros, on the heap
+// effects: allocates memory (client must call free_vector)
+// time: O(n)
+static struct ha_comp *new_vector(int n) {
+  struct ha_comp *v = ha_alloc(NULL, n * sizeof(struct ha_comp));
+  for (int i = 0; i < n; ++i) {
+    ha_comp_init(&v[i], NULL);
+  }
+  return v;
+}
+
+// free_vector(v, n) frees the vector v of n numbers
+// effects: v is no longer valid
+// time: O(n)
+static void free_vector(struct ha_comp *v, int n) {
+  assert(v);
+  for (int i = 0; i < n; ++i) {
+    ha_comp_clear(&v[i]);
+  }
+  ha_release(NULL, v);
+}
+
+// refactor(f) computes the determinant of the matrix of f, and its inverse
+//   if it is invertible, from scratch
+// effects: modifies f
+//          allocates memory
+// time: O(r^3 * e)
+static void refactor(struct ha_matrix_factor *f) {
+  assert(f);
+  struct ha_arena *arena = ha_arena_use(NULL);
+  struct ha_comp *det = ha_matrix_det(f->mat);
+  ha_comp_set(&f->det, det);
+  ha_comp_destroy(det);
+  if (f->inverse) {
+    ha_matrix_destroy(f->inverse);
+  }
+  f->inverse = ha_comp_is_zero(&f->det) ? NULL : ha_matrix_inverse(f->mat);
+  ha_arena_use(arena);
+}
+
+// rank_one(f, u, v) adds u * v^T to the matrix of f, where u and v are r
+//   numbers each
+// effects: modifies f
+//          may allocate memory
+// time: O(r^2 * e), or O(r^3 * e) if the matrix of f is singular
+static void rank_one(struct ha_matrix_factor *f,
+                     const struct ha_comp *const *u,
+                     const struct ha_comp *const *v) {
+  assert(f);
+  assert(u);
+  assert(v);
+  const int n = f->mat->rows;
+  for (int i = 0; i < n; ++i) {
+    if (ha_comp_is_zero(u[i])) {
+      continue;
+    }
+    for (int j = 0; j < n; ++j) {
+      if (!ha_comp_is_zero(v[j])) {
+        ha_comp_fma(entry(f->mat, i, j), u[i], v[j]);
+      }
+    }
+  }
+  if (!f->inverse) {
+    refactor(f);
+    return;
+  }
+
+  const struct ha_matrix *inv = f->inverse;
+  struct ha_comp *w = new_vector(n);
+  struct ha_comp *z = new_vector(n);
+  struct ha_comp s;
+  ha_comp_init(&s, NULL);
+  ha_comp_set(&s, ha_comp_constant(1));
+  const bool lazy = ha_frac_set_lazy(true);
+  for (int k = 0; k < n; ++k) {
+    if (ha_comp_is_zero(u[k])) {
+      continue;
+    }
+    for (int i = 0; i < n; ++i) {
+      ha_comp_fma(&w[i], entry(inv, i, k), u[k]);
+    }
+  }
+  for (int k = 0; k < n; ++k) {
+    if (ha_comp_is_zero(v[k])) {
+      continue;
+    }
+    const struct ha_comp *inv_row = entry(inv, k, 0);
+    for (int j = 0; j < n; ++j) {
+      ha_comp_fma(&z[j], v[k], &inv_row[j]);
+    }
+    ha_comp_fma(&s, v[k], &w[k]);
+  }
+  ha_frac_set_lazy(lazy);
+  if (!lazy) {
+    for (int i = 0; i < n; ++i) {
+      ha_frac_normalize(&w[i].real);
+      ha_frac_normalize(&w[i].ima);
+      ha_frac_normalize(&z[i].real);
+      ha_frac_normalize(&z[i].ima);
+    }
+    ha_frac_normalize(&s.real);
+    ha_frac_normalize(&s.ima);
+  }
+
+  ha_comp_mult_into(&f->det, &f->det, &s);
+  if (ha_comp_is_zero(&s)) {
+    ha_matrix_destroy(f->inverse);
+    f->inverse = NULL;
+  } else {
+    for (int i = 0; i < n; ++i) {
+      if (ha_comp_is_zero(&w[i])) {
+        continue;
+      }
+      // w[i] becomes -w[i] / s, the factor of z^T in the row i
+      ha_comp_div_into(&w[i], &w[i], &s);
+      ha_comp_sub_into(&w[i], zero(), &w[i]);
+      struct ha_comp *inv_row = entry(f->inverse, i, 0);
+      for (int j = 0; j < n; ++j) {
+        if (!ha_comp_is_zero(&z[j])) {
+          ha_comp_fma(&inv_row[j], &w[i], &z[j]);
+        }
+      }
+    }
+  }
+  free_vector(w, n);
+  free_vector(z, n);
+  ha_comp_clear(&s);
+}
+
+// is_column(f, u) determines if u is a column of the size of the matrix of
+//   f
+// time: O(1)
+static bool is_column(const struct ha_matrix_factor *f,
+                      const struct ha_matrix *u) {
+  assert(f);
+  assert(u);
+  return u->rows == f->mat->rows && u->cols == 1;
+}
+
+// update(f, u, v, sign) adds sign * u * v^T to the matrix of f, or returns
+//   false if u and v are not columns of its size
+// requires: sign is 1 or -1
+// effects: modifies f
+//          may allocate memory
+//          may produce output (error message)
+// time: O(r^2 * e), or O(r^3 * e) if the matrix of f is singular
+static bool update(struct ha_matrix_factor *f, const struct ha_matrix *u,
+                   const struct ha_matrix *v, int sign) {
+  assert(f);
+  assert(u);
+  assert(v);
+  assert(sign == 1 || sign == -1);
+  const int n = f->mat->rows;
+  if (!is_column(f, u) || !is_column(f, v)) {
+    printf("Error: cannot update a %dx%d matrix with a %dx%d and a %dx%d "
+           "matrix\n", n, n, u->rows, u->cols, v->rows, v->cols);
+    return false;
+  }
+  const struct ha_comp **u_entries = ha_alloc(NULL, n * sizeof(void *));
+  const struct ha_comp **v_entries = ha_alloc(NULL, n * sizeof(void *));
+  struct ha_comp *negated = sign == -1 ? new_vector(n) : NULL;
+  for (int i = 0; i < n; ++i) {
+    u_entries[i] = entry(u, i, 0);
+    v_entries[i] = entry(v, i, 0);
+    if (negated) {
+      ha_comp_sub_into(&negated[i], zero(), u_entries[i]);
+      u_entries[i] = &negated[i];
+    }
+  }
+  rank_one(f, u_entries, v_entries);
+  if (negated) {
+    free_vector(negated, n);
+  }
+  ha_release(NULL, u_entries);
+  ha_release(NULL, v_entries);
+  return true;
+}
+
+struct ha_matrix_factor *ha_matrix_factor_create(const struct ha_matrix *mat) {
+  assert(mat);
+  if (mat->rows != mat->cols) {
+    printf("Error: cannot factor a %dx%d matrix\n", mat->rows, mat->cols);
+    return NULL;
+  }
+  struct ha_matrix_factor *f = ha_alloc(NULL, sizeof(struct ha_matrix_factor));
+  struct ha_arena *arena = ha_arena_use(NULL);
+  f->mat = ha_matrix_copy(mat);
+  ha_arena_use(arena);
+  f->inverse = NULL;
+  ha_comp_init(&f->det, NULL);
+  refactor(f);
+  return f;
+}
+
+void ha_matrix_factor_destroy(struct ha_matrix_factor *f) {
+  assert(f);
+  ha_matrix_destroy(f->mat);
+  if (f->inverse) {
+    ha_matrix_destroy(f->inverse);
+  }
+  ha_comp_clear(&f->det);
+  ha_release(NULL, f);
+}
+
+const struct ha_matrix *ha_matrix_factor_matrix(
+  const struct ha_matrix_factor *f) {
+  assert(f);
+  return f->mat;
+}
+
+struct ha_comp *ha_matrix_factor_det(const struct ha_matrix_factor *f) {
+  assert(f);
+  return ha_comp_add(&f->det, zero());
+}
+
+struct ha_matrix *ha_matrix_factor_inverse(const struct ha_matrix_factor *f) {
+  assert(f);
+  if (!f->inverse) {
+    printf("Error: the matrix is singular\n");
+    return NULL;
+  }
+  return ha_matrix_copy(f->inverse);
+}
+
+bool ha_matrix_factor_update(struct ha_matrix_factor *f,
+                             const struct ha_matrix *u,
+                             const struct ha_matrix *v) {
+  return update(f, u, v, 1);
+}
+
+bool ha_matrix_factor_downdate(struct ha_matrix_factor *f,
+                               const struct ha_matrix *u,
+                               const struct ha_matrix *v) {
+  return update(f, u, v, -1);
+}
+
+bool ha_matrix_factor_set_row(struct ha_matrix_factor *f, int row,
+                              const struct ha_matrix *values) {
+  assert(f);
+  assert(values);
+  const int n = f->mat->rows;
+  assert(0 <= row && row < n);
+  if (values->rows != 1 || values->cols != n) {
+    printf("Error: cannot replace a row of a %dx%d matrix with a %dx%d "
+           "matrix\n", n, n, values->rows, values->cols);
+    return false;
+  }
+  // u is the unit column at row, and v the change of the row
+  const struct ha_comp **u = ha_alloc(NULL, n * sizeof(void *));
+  const struct ha_comp **v = ha_alloc(NULL, n * sizeof(void *));
+  struct ha_comp *change = new_vector(n);
+  for (int i = 0; i < n; ++i) {
+    u[i] = ha_comp_constant(i == row);
+    ha_comp_sub_into(&change[i], entry(values, 0, i), entry(f->mat, row, i));
+    v[i] = &change[i];
+  }
+  rank_one(f, u, v);
+  free_vector(change, n);
+  ha_release(NULL, u);
+  ha_release(NULL, v);
+  return true;
+}
+
+void ha_matrix_factor_set(struct ha_matrix_factor *f, int row, int col,
+                          const struct ha_comp *num) {
+  assert(f);
+  assert(num);
+  const int n = f->mat->rows;
+  assert(0 <= row && row < n);
+  assert(0 <= col && col < n);
+  const struct ha_comp **u = ha_alloc(NULL, n * sizeof(void *));
+  const struct ha_comp **v = ha_alloc(NULL, n * sizeof(void *));
+  struct ha_comp change;
+  ha_comp_init(&change, NULL);
+  ha_comp_sub_into(&change, num, entry(f->mat, row, col));
+  for (int i = 0; i < n; ++i) {
+    u[i] = ha_comp_constant(i == row);
+    v[i] = i == col ? &change : zero();
+  }
+  rank_one(f, u, v);
+  ha_comp_clear(&change);
+  ha_release(NULL, u);
+  ha_release(NULL, v);
+}
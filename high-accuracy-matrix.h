@@ -0,0 +1,435 @@
+#include <stdbool.h>
+#include "high-accuracy-complex.h"
+
+// This module provides dense matrices of arbitrarily large complex numbers
+
+// The following applies to all functions:
+// requires: all matrix parameters are valid (not NULL)
+// time: r and c are the numbers of rows and columns of the matrix parameter
+// (of the first one if there are several), and e is the time of one
+// ha_comp operation on the entries involved
+
+// Storage: the entries are kept in row-major order in one contiguous block,
+// together with the matrix itself, and small numbers sit inside the entries,
+// so sweeping a row touches consecutive memory.
+
+// Entries are owned by the matrix: the ha_comp given by ha_matrix_at can be
+// read and written with the ha_comp functions (the _into ones included), but
+// must not be destroyed.
+
+// Functions ending in _into write their result into an existing matrix of
+// the right size instead of allocating a new one.
+
+// Threads: multiplication and the elimination functions (determinant, rank
+// and RREF) split their work over the current pool of the calling thread, if
+// it has one (see high-accuracy-pool.h): a product by tiles of its entries,
+// and every elimination step by rows.
+
+
+struct ha_matrix;
+
+
+// ha_matrix_create(rows, cols) creates a rows x cols matrix of zeros
+// requires: rows > 0, cols > 0, rows * cols <= INT_MAX
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(rows * cols)
+struct ha_matrix *ha_matrix_create(int rows, int cols);
+
+// ha_matrix_identity(n) creates the n x n identity matrix
+// requires: n > 0
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(n^2)
+struct ha_matrix *ha_matrix_identity(int n);
+
+// ha_matrix_destroy(mat) destroys mat and its entries
+// effects: mat is no longer valid
+// time: O(r * c)
+void ha_matrix_destroy(struct ha_matrix *mat);
+
+// ha_matrix_copy(mat) returns a copy of mat
+// notes: the large entries of the copy share their limbs with those of mat
+//          (see ha_int_set), so copying them costs O(1) each
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * c * e)
+struct ha_matrix *ha_matrix_copy(const struct ha_matrix *mat);
+
+// ha_matrix_rows(mat) gives the number of rows of mat
+// time: O(1)
+int ha_matrix_rows(const struct ha_matrix *mat);
+
+// ha_matrix_cols(mat) gives the number of columns of mat
+// time: O(1)
+int ha_matrix_cols(const struct ha_matrix *mat);
+
+// ha_matrix_at(mat, row, col) gives the entry of mat at row and col (both
+//   counted from 0)
+// requires: 0 <= row < r, 0 <= col < c
+// time: O(1)
+struct ha_comp *ha_matrix_at(struct ha_matrix *mat, int row, int col);
+
+// ha_matrix_get(mat, row, col) gives the entry of mat at row and col for
+//   reading
+// requires: 0 <= row < r, 0 <= col < c
+// time: O(1)
+const struct ha_comp *ha_matrix_get(const struct ha_matrix *mat, int row,
+                                    int col);
+
+// ha_matrix_set(mat, row, col, num) sets the entry of mat at row and col to
+//   num
+// requires: 0 <= row < r, 0 <= col < c
+// effects: modifies mat
+//          may allocate memory
+// time: O(e)
+void ha_matrix_set(struct ha_matrix *mat, int row, int col,
+                   const struct ha_comp *num);
+
+// ha_matrix_eq(n, m) determines if n and m have the same size and entries
+// time: O(r * c * e)
+bool ha_matrix_eq(const struct ha_matrix *n, const struct ha_matrix *m);
+
+// ha_matrix_write(buf, mat) appends mat to buf, one row per line with the
+//   entries separated by spaces
+// requires: buf is valid (not NULL)
+// effects: modifies buf
+//          may allocate memory
+// time: O(r * c * e)
+void ha_matrix_write(struct ha_buffer *buf, const struct ha_matrix *mat);
+
+// ha_matrix_print(mat) prints mat, one row per line with the entries
+//   separated by spaces
+// notes: the whole matrix is formatted first and written at once
+// effects: prints output
+// time: O(r * c * e)
+void ha_matrix_print(const struct ha_matrix *mat);
+
+// ha_matrix_add(n, m) gives n + m, or returns NULL if the sizes of n and m
+//   differ
+// notes: if the sizes differ, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c * e)
+struct ha_matrix *ha_matrix_add(const struct ha_matrix *n,
+                                const struct ha_matrix *m);
+
+// ha_matrix_add_into(dst, n, m) sets dst to n + m
+// notes: dst may be n or m
+// requires: dst, n and m have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: O(r * c * e)
+void ha_matrix_add_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                        const struct ha_matrix *m);
+
+// ha_matrix_sub(n, m) gives n - m, or returns NULL if the sizes of n and m
+//   differ
+// notes: if the sizes differ, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c * e)
+struct ha_matrix *ha_matrix_sub(const struct ha_matrix *n,
+                                const struct ha_matrix *m);
+
+// ha_matrix_sub_into(dst, n, m) sets dst to n - m
+// notes: dst may be n or m
+// requires: dst, n and m have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: O(r * c * e)
+void ha_matrix_sub_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                        const struct ha_matrix *m);
+
+// ha_matrix_scalar_mult(k, mat) gives k * mat
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * c * e)
+struct ha_matrix *ha_matrix_scalar_mult(const struct ha_comp *k,
+                                        const struct ha_matrix *mat);
+
+// ha_matrix_scalar_mult_into(dst, k, mat) sets dst to k * mat
+// notes: dst may be mat, and k may be an entry of mat
+// requires: dst and mat have the same size
+// effects: modifies dst
+//          may allocate memory
+// time: O(r * c * e)
+void ha_matrix_scalar_mult_into(struct ha_matrix *dst, const struct ha_comp *k,
+                                const struct ha_matrix *mat);
+
+// ha_matrix_mult(n, m) gives n * m, or returns NULL if the number of columns
+//   of n is not the number of rows of m
+// notes: if the sizes do not match, an error message is printed
+//        large square products use the Strassen-Winograd method, see
+//          ha_matrix_set_strassen_threshold
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c * cm * e), where cm is the number of columns of m, or
+//       O(r^2.81 * e) for large square matrices
+struct ha_matrix *ha_matrix_mult(const struct ha_matrix *n,
+                                 const struct ha_matrix *m);
+
+// ha_matrix_mult_into(dst, n, m) sets dst to n * m
+// notes: dst is computed by tiles, each accumulated in place over blocks of
+//          the rows of m; the tiles are computed in parallel on the current
+//          pool
+//        large square products are split into 7 products of half the size
+//          instead of 8, recursively (the Strassen-Winograd method)
+// requires: c is the number of rows of m
+//           dst has the rows of n and the columns of m
+//           dst is neither n nor m
+// effects: modifies dst
+//          may allocate memory
+// time: same as ha_matrix_mult
+void ha_matrix_mult_into(struct ha_matrix *dst, const struct ha_matrix *n,
+                         const struct ha_matrix *m);
+
+// ha_matrix_set_strassen_threshold(size) sets the size of the square products
+//   from which ha_matrix_mult takes a Strassen-Winograd step instead of
+//   computing the product tile by tile
+// notes: the method saves multiplications of entries at the price of more
+//          additions, so it pays off sooner for bigger entries; suitable
+//          values are measured by the strassen workload of benchmark.c
+//        sizes below 2 are taken as 2, and INT_MAX turns the method off
+//        the threshold is shared by all threads
+// requires: size > 0
+//           no other thread is multiplying
+// effects: changes the behaviour of later multiplications (not the results)
+// time: O(1)
+void ha_matrix_set_strassen_threshold(int size);
+
+// ha_matrix_strassen_threshold() gives the current threshold of
+//   ha_matrix_set_strassen_threshold
+// time: O(1)
+int ha_matrix_strassen_threshold(void);
+
+// ha_matrix_det(mat) gives the determinant of mat, or returns NULL if mat is
+//   not square
+// notes: uses Bareiss fraction-free elimination on mat with its rows scaled
+//          to Gaussian integers, with the rows of each step updated in
+//          parallel on the current pool
+//        if mat is not square, an error message is printed
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(r^3 * e)
+struct ha_comp *ha_matrix_det(const struct ha_matrix *mat);
+
+// ha_matrix_rank(mat) gives the rank of mat
+// notes: uses Bareiss fraction-free elimination
+// time: O(r * c * min(r, c) * e)
+int ha_matrix_rank(const struct ha_matrix *mat);
+
+// ha_matrix_rref(mat) gives the reduced row echelon form of mat
+// notes: uses fraction-free Gauss-Jordan elimination, and divides by the
+//          pivots only once at the end
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * c * min(r, c) * e)
+struct ha_matrix *ha_matrix_rref(const struct ha_matrix *mat);
+
+// ha_matrix_solve(a, b) gives the x with a * x = b, or returns NULL if a is
+//   not square, has not the rows of b, or is singular
+// notes: uses fraction-free Gauss-Jordan elimination on [a | b], and divides
+//          by the pivot only once at the end
+//        if there is no unique solution, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r^2 * (r + cb) * e), where cb is the number of columns of b
+struct ha_matrix *ha_matrix_solve(const struct ha_matrix *a,
+                                  const struct ha_matrix *b);
+
+// ha_matrix_inverse(mat) gives the inverse of mat, or returns NULL if mat is
+//   not square or is singular
+// notes: solves mat * x = I as ha_matrix_solve
+//        if there is no inverse, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r^3 * e)
+struct ha_matrix *ha_matrix_inverse(const struct ha_matrix *mat);
+
+// ha_matrix_det_modular(mat) gives the determinant of mat as ha_matrix_det,
+//   or returns NULL if mat is not square
+// notes: computes the determinant modulo enough word-sized primes for the
+//          Hadamard bound, with machine arithmetic, and puts it together by
+//          the Chinese Remainder Theorem; the primes are handled in parallel
+//          on the current pool
+//        much faster than ha_matrix_det for large matrices with large
+//          entries, whose intermediate minors grow large
+//        if mat is not square, an error message is printed
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(r^3 * P + r^2 * P * e), where P is the number of primes, about
+//       r * b / 60 for entries of b bits
+struct ha_comp *ha_matrix_det_modular(const struct ha_matrix *mat);
+
+// ha_matrix_solve_modular(a, b) gives the x with a * x = b as
+//   ha_matrix_solve, or returns NULL if there is none
+// notes: computes det(a) and det(a) * x modulo word-sized primes as
+//          ha_matrix_det_modular, skipping the primes that divide det(a)
+//        if there is no unique solution, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r^2 * (r + cb) * P + r * cb * P * e), where cb is the number of
+//       columns of b and P is the number of primes, about r * b / 60 for
+//       entries of b bits
+struct ha_matrix *ha_matrix_solve_modular(const struct ha_matrix *a,
+                                          const struct ha_matrix *b);
+
+
+// Row form: struct ha_row_matrix keeps a matrix of fractions as Gaussian
+//   integer numerators over one denominator per row, in lowest terms. A
+//   row whose entries share a denominator, as in most inputs, takes half
+//   the memory of its ha_comp entries, and products of row forms are
+//   computed with integer arithmetic only, with a single run of gcds per
+//   row of the result, where ha_matrix_mult reduces a fraction at every
+//   step. Chains of products of rational matrices are best done in row
+//   form, converting once at each end.
+// Row forms live on the heap, whatever the allocation context.
+
+struct ha_row_matrix;
+
+
+// ha_row_matrix_create(mat) gives mat in row form
+// effects: allocates memory (client must call ha_row_matrix_destroy)
+// time: O(r * c * e)
+struct ha_row_matrix *ha_row_matrix_create(const struct ha_matrix *mat);
+
+// ha_row_matrix_destroy(rm) destroys rm
+// effects: rm is no longer valid
+// time: O(r * c)
+void ha_row_matrix_destroy(struct ha_row_matrix *rm);
+
+// ha_row_matrix_rows(rm) gives the number of rows of rm
+// time: O(1)
+int ha_row_matrix_rows(const struct ha_row_matrix *rm);
+
+// ha_row_matrix_cols(rm) gives the number of columns of rm
+// time: O(1)
+int ha_row_matrix_cols(const struct ha_row_matrix *rm);
+
+// ha_row_matrix_to_matrix(rm) gives the matrix of fractions rm stands for
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * c * e)
+struct ha_matrix *ha_row_matrix_to_matrix(const struct ha_row_matrix *rm);
+
+// ha_row_matrix_mult(n, m) gives n * m in row form, or returns NULL if the
+//   number of columns of n is not the number of rows of m
+// notes: the rows of the result are computed in parallel on the current
+//          pool
+//        if the sizes do not match, an error message is printed
+// effects: may allocate memory (client must call ha_row_matrix_destroy)
+//          may produce output (error message)
+// time: O(r * c * cm * e), where cm is the number of columns of m
+struct ha_row_matrix *ha_row_matrix_mult(const struct ha_row_matrix *n,
+                                         const struct ha_row_matrix *m);
+
+// ha_row_matrix_det(rm) gives the determinant of rm as ha_matrix_det, or
+//   returns NULL if rm is not square
+// notes: the numerators are eliminated as they are, with no scaling
+//        if rm is not square, an error message is printed
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(r^3 * e)
+struct ha_comp *ha_row_matrix_det(const struct ha_row_matrix *rm);
+
+// ha_row_matrix_rank(rm) gives the rank of rm
+// notes: uses Bareiss fraction-free elimination on the numerators
+// time: O(r * c * min(r, c) * e)
+int ha_row_matrix_rank(const struct ha_row_matrix *rm);
+
+
+// Factorizations: struct ha_matrix_factor keeps a square matrix together
+//   with its determinant and, if it is invertible, its exact inverse, so
+//   that editing the matrix updates both in O(n^2) operations on entries
+//   instead of a new elimination in O(n^3). An edit is a rank-1 update
+//   A + u * v^T, handled by the matrix determinant lemma and the
+//   Sherman-Morrison formula; replacing a row or an entry is a rank-1 update
+//   whose u has a single 1. An edit that makes the matrix singular drops the
+//   inverse, and the edits of a singular matrix take a full elimination
+//   each, until it is invertible again.
+// Factorizations live on the heap, whatever the allocation context.
+
+struct ha_matrix_factor;
+
+
+// ha_matrix_factor_create(mat) gives the factorization of mat, or returns
+//   NULL if mat is not square
+// notes: mat is copied
+//        if mat is not square, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_factor_destroy)
+//          may produce output (error message)
+// time: O(r^3 * e)
+struct ha_matrix_factor *ha_matrix_factor_create(const struct ha_matrix *mat);
+
+// ha_matrix_factor_destroy(f) destroys f
+// requires: f is valid (not NULL)
+// effects: f is no longer valid
+// time: O(r^2), where r is the size of the matrix of f
+void ha_matrix_factor_destroy(struct ha_matrix_factor *f);
+
+// ha_matrix_factor_matrix(f) gives the current matrix of f
+// notes: the matrix belongs to f, and changes with it
+// requires: f is valid (not NULL)
+// time: O(1)
+const struct ha_matrix *ha_matrix_factor_matrix(
+  const struct ha_matrix_factor *f);
+
+// ha_matrix_factor_det(f) gives the determinant of the matrix of f
+// requires: f is valid (not NULL)
+// effects: allocates memory (client must call ha_comp_destroy)
+// time: O(e)
+struct ha_comp *ha_matrix_factor_det(const struct ha_matrix_factor *f);
+
+// ha_matrix_factor_inverse(f) gives the inverse of the matrix of f, or
+//   returns NULL if it is singular
+// notes: if there is no inverse, an error message is printed
+// requires: f is valid (not NULL)
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(r^2), where r is the size of the matrix of f, since the copy
+//       shares the limbs of the entries (see ha_matrix_copy)
+struct ha_matrix *ha_matrix_factor_inverse(const struct ha_matrix_factor *f);
+
+// ha_matrix_factor_update(f, u, v) adds u * v^T to the matrix of f, or
+//   returns false if u and v are not columns of its size
+// notes: if the sizes do not match, an error message is printed
+// requires: f is valid (not NULL)
+// effects: modifies f
+//          may allocate memory
+//          may produce output (error message)
+// time: O(r^2 * e), where r is the size of the matrix of f, or O(r^3 * e) if
+//       the matrix was singular
+bool ha_matrix_factor_update(struct ha_matrix_factor *f,
+                             const struct ha_matrix *u,
+                             const struct ha_matrix *v);
+
+// ha_matrix_factor_downdate(f, u, v) subtracts u * v^T from the matrix of f,
+//   undoing ha_matrix_factor_update(f, u, v), or returns false if u and v are
+//   not columns of its size
+// notes: if the sizes do not match, an error message is printed
+// requires: f is valid (not NULL)
+// effects: modifies f
+//          may allocate memory
+//          may produce output (error message)
+// time: same as ha_matrix_factor_update
+bool ha_matrix_factor_downdate(struct ha_matrix_factor *f,
+                               const struct ha_matrix *u,
+                               const struct ha_matrix *v);
+
+// ha_matrix_factor_set_row(f, row, values) replaces the row of the matrix of
+//   f at row (counted from 0) by values, or returns false if values is not a
+//   row of its size
+// notes: if the sizes do not match, an error message is printed
+// requires: f is valid (not NULL), 0 <= row < r, where r is the size of the
+//             matrix of f
+// effects: modifies f
+//          may allocate memory
+//          may produce output (error message)
+// time: same as ha_matrix_factor_update
+bool ha_matrix_factor_set_row(struct ha_matrix_factor *f, int row,
+                              const struct ha_matrix *values);
+
+// ha_matrix_factor_set(f, row, col, num) sets the entry of the matrix of f at
+//   row and col to num
+// requires: f is valid (not NULL), 0 <= row < r, 0 <= col < r, where r is
+//             the size of the matrix of f
+// effects: modifies f
+//          may allocate memory
+// time: same as ha_matrix_factor_update
+void ha_matrix_factor_set(struct ha_matrix_factor *f, int row, int col,
+                          const struct ha_comp *num);
@@ -0,0 +1,277 @@
+// This module provides the thread pools the high-accuracy modules spread
+//   their work over
+
+// For all program scope functions, see high-accuracy-pool.h for details
+
+// Scheduling: a run hands every thread a contiguous range of the tasks, in
+//   its deque. The deques are short arrays guarded by their own mutex: the
+//   tasks are whole bignum operations, far longer than a lock, so a
+//   lock-free deque would not pay off. A run ends once every deque is empty
+//   and every thread has finished its last task.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-pool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+
+struct deque {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+  int *tasks;
+  int cap; // number of tasks there is room for
+  int front; // next task to steal
+  int back; // one past the next task of the owner
+};
+
+struct ha_pool {
+  int threads; // the calling thread included
+  struct deque *deques; // one per thread, the calling thread's first
+  void (*run)(void *ctx, int task); // the tasks of the current run
+  void *ctx;
+#ifdef HAVE_PTHREADS
+  pthread_t *workers; // threads - 1 of them
+  pthread_mutex_t lock; // guards generation, busy and stop
+  pthread_cond_t start; // a run has started, or the pool is stopping
+  pthread_cond_t done; // busy has dropped to 0
+  pthread_mutex_t run_lock; // held for a whole run
+  int generation; // number of runs started
+  int busy; // workers still taking part in the current run
+  bool stop;
+#endif
+};
+
+// arguments of a worker thread
+struct worker {
+  struct ha_pool *pool;
+  int index; // index of its deque
+};
+
+
+static _Thread_local struct ha_pool *current;
+
+
+// take(pool, index, task) takes the next task of the thread with the given
+//   index, from its own deque or else from another one
+// returns: false if every deque is empty
+// effects: modifies the deques and *task
+// time: O(threads)
+static bool take(struct ha_pool *pool, int index, int *task) {
+  assert(pool);
+  assert(task);
+  for (int i = 0; i < pool->threads; ++i) {
+    const bool own = i == 0;
+    struct deque *d = &pool->deques[(index + i) % pool->threads];
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&d->lock);
+#endif
+    const bool found = d->front < d->back;
+    if (found) {
+      *task = own ? d->tasks[--d->back] : d->tasks[d->front++];
+    }
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&d->lock);
+#endif
+    if (found) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// work(pool, index) runs tasks on the thread with the given index until there
+//   are none left
+// effects: whatever the tasks do
+// time: O(number of tasks run) times the time of one task
+static void work(struct ha_pool *pool, int index) {
+  assert(pool);
+  int task = 0;
+  while (take(pool, index, &task)) {
+    pool->run(pool->ctx, task);
+  }
+}
+
+#ifdef HAVE_PTHREADS
+// worker_main(arg) is the loop of a worker thread: it waits for a run, takes
+//   part in it, and starts over until the pool stops
+// effects: whatever the tasks do
+static void *worker_main(void *arg) {
+  struct worker *worker = arg;
+  struct ha_pool *pool = worker->pool;
+  const int index = worker->index;
+  free(worker);
+  pthread_mutex_lock(&pool->lock);
+  int seen = 0; // the pool is created before any run
+  while (true) {
+    while (!pool->stop && pool->generation == seen) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (pool->stop) {
+      break;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+    work(pool, index);
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->busy == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  ha_alloc_trim();
+  return NULL;
+}
+#endif
+
+struct ha_pool *ha_pool_create(int threads) {
+  assert(threads > 0);
+  struct ha_pool *pool = malloc(sizeof(struct ha_pool));
+#ifndef HAVE_PTHREADS
+  threads = 1;
+#endif
+  pool->threads = threads;
+  pool->deques = malloc(threads * sizeof(struct deque));
+  for (int i = 0; i < threads; ++i) {
+    struct deque *d = &pool->deques[i];
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&d->lock, NULL);
+#endif
+    d->tasks = NULL;
+    d->cap = 0;
+    d->front = 0;
+    d->back = 0;
+  }
+  pool->run = NULL;
+  pool->ctx = NULL;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pthread_mutex_init(&pool->run_lock, NULL);
+  pool->generation = 0;
+  pool->busy = 0;
+  pool->stop = false;
+  pool->workers = malloc((threads - 1) * sizeof(pthread_t));
+  for (int i = 1; i < threads; ++i) {
+    struct worker *worker = malloc(sizeof(struct worker));
+    worker->pool = pool;
+    worker->index = i;
+    if (pthread_create(&pool->workers[i - 1], NULL, worker_main, worker)) {
+      // no more threads: the ones started so far do the work
+      free(worker);
+      for (int j = i; j < threads; ++j) {
+        pthread_mutex_destroy(&pool->deques[j].lock);
+      }
+      pool->threads = i;
+      break;
+    }
+  }
+#endif
+  return pool;
+}
+
+void ha_pool_destroy(struct ha_pool *pool) {
+  assert(pool);
+  assert(pool != current);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 1; i < pool->threads; ++i) {
+    pthread_join(pool->workers[i - 1], NULL);
+  }
+  free(pool->workers);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  pthread_mutex_destroy(&pool->run_lock);
+#endif
+  for (int i = 0; i < pool->threads; ++i) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->deques[i].lock);
+#endif
+    free(pool->deques[i].tasks);
+  }
+  free(pool->deques);
+  free(pool);
+}
+
+int ha_pool_threads(const struct ha_pool *pool) {
+  assert(pool);
+  return pool->threads;
+}
+
+void ha_pool_run(struct ha_pool *pool, int tasks,
+                 void (*run)(void *ctx, int task), void *ctx) {
+  assert(pool);
+  assert(tasks >= 0);
+  assert(run);
+  if (tasks == 0) {
+    return;
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&pool->run_lock);
+#endif
+  // the workers are all idle, so the deques can be filled without locks
+  for (int i = 0; i < pool->threads; ++i) {
+    struct deque *d = &pool->deques[i];
+    const int first = (long long)tasks * i / pool->threads;
+    const int last = (long long)tasks * (i + 1) / pool->threads;
+    if (d->cap < last - first) {
+      d->cap = last - first;
+      d->tasks = realloc(d->tasks, d->cap * sizeof(int));
+    }
+    // the owner takes from the back, so the range is stored backwards to
+    // run in increasing order
+    for (int task = first; task < last; ++task) {
+      d->tasks[last - 1 - task] = task;
+    }
+    d->front = 0;
+    d->back = last - first;
+  }
+  pool->run = run;
+  pool->ctx = ctx;
+
+  struct ha_arena *arena = ha_arena_use(NULL);
+  struct ha_pool *previous = ha_pool_use(NULL);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&pool->lock);
+  ++pool->generation;
+  pool->busy = pool->threads - 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+#endif
+  work(pool, 0);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&pool->lock);
+  while (pool->busy > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+#endif
+  ha_pool_use(previous);
+  ha_arena_use(arena);
+  pool->run = NULL;
+  pool->ctx = NULL;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&pool->run_lock);
+#endif
+}
+
+struct ha_pool *ha_pool_use(struct ha_pool *pool) {
+  struct ha_pool *previous = current;
+  current = pool;
+  return previous;
+}
+
+struct ha_pool *ha_pool_current(void) {
+  return current;
+}
@@ -0,0 +1,82 @@
+// This module provides the thread pools the high-accuracy modules spread
+//   their work over
+
+// A pool runs a batch of independent tasks on its threads, the calling
+// thread included. Each thread has a deque of tasks: it takes tasks from the
+// back of its own deque, and once that is empty it steals them from the
+// front of the deques of the others, so a thread whose tasks turned out to
+// involve small numbers helps with the bigger ones.
+
+// Pool context: like the allocation context (see high-accuracy-alloc.h),
+//   every thread has a current pool, which the matrix operations split their
+//   work over. It is NULL by default, meaning that everything runs on the
+//   calling thread:
+//   struct ha_pool *pool = ha_pool_create(8);
+//   struct ha_pool *previous = ha_pool_use(pool);
+//   ... matrix operations here use 8 threads ...
+//   ha_pool_use(previous);
+//   ha_pool_destroy(pool);
+
+// Threads: numbers never share state behind the back of their users, since
+//   the scratch values and caches of the number modules belong to the
+//   thread that uses them. Different threads may thus work on different
+//   numbers at the same time, and read the same numbers at the same time.
+//   An arena serves one thread at a time, so a number in an arena must only
+//   be changed by the thread using that arena. Error messages are printed
+//   with a single call each, so the messages of different threads never
+//   interleave. A thread gives its caches back as it exits, the threads of
+//   a pool included (see ha_alloc_trim).
+
+#include <stdbool.h>
+
+
+struct ha_pool;
+
+
+// ha_pool_create(threads) creates a pool of threads threads, the calling
+//   thread included
+// notes: without thread support, the tasks all run on the calling thread
+// requires: threads > 0
+// effects: allocates memory and starts threads - 1 threads (client must call
+//          ha_pool_destroy)
+// time: O(threads)
+struct ha_pool *ha_pool_create(int threads);
+
+// ha_pool_destroy(pool) stops the threads of pool and destroys it
+// requires: pool is valid (not NULL) and is not running tasks
+//           pool is not the current pool of any thread
+// effects: pool is no longer valid
+// time: O(threads)
+void ha_pool_destroy(struct ha_pool *pool);
+
+// ha_pool_threads(pool) gives the number of threads of pool, the calling
+//   thread included
+// requires: pool is valid (not NULL)
+// time: O(1)
+int ha_pool_threads(const struct ha_pool *pool);
+
+// ha_pool_run(pool, tasks, run, ctx) calls run(ctx, task) for every task from
+//   0 to tasks - 1, on the threads of pool, and returns once they are all
+//   done
+// notes: tasks run in no particular order, several at the same time
+//        whichever thread they run on, tasks start with the heap as their
+//          allocation context and with no current pool, so the matrix
+//          operations of a task run on the thread of the task
+//        runs of the same pool from several threads take turns
+// requires: pool is valid (not NULL), tasks >= 0, run is not NULL
+// effects: whatever run does
+// time: O(tasks / threads) times the time of one task, if they are similar
+void ha_pool_run(struct ha_pool *pool, int tasks,
+                 void (*run)(void *ctx, int task), void *ctx);
+
+// ha_pool_use(pool) makes pool the current pool of the calling thread and
+//   returns the previous one, where NULL stands for no pool
+// effects: later matrix operations of the calling thread run on pool's
+//          threads
+// time: O(1)
+struct ha_pool *ha_pool_use(struct ha_pool *pool);
+
+// ha_pool_current() gives the current pool of the calling thread, or NULL if
+//   there is none
+// time: O(1)
+struct ha_pool *ha_pool_current(void);
@@ -0,0 +1,759 @@
+// This module provides sparse matrices of arbitrarily large complex numbers
+
+// For all program scope functions, see high-accuracy-sparse.h for details
+
+// The following applies to all functions:
+// requires: all sparse matrix parameters are valid (not NULL)
+
+// Elimination: the rows being eliminated are kept apart from the CSR arrays,
+//   each as its own sorted list of columns and pointers to its numbers, so
+//   that an update merges two lists into a new one and moves the numbers by
+//   their pointers (numbers must never be moved with memcpy, see
+//   high-accuracy-layout.h). Every column keeps its count of nonzero entries
+//   in the active rows, for the Markowitz rule, and the list of rows that
+//   got an entry in it; a row in that list may have lost the entry since,
+//   which is checked when the column is pivoted on.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-matrix.h"
+#include "high-accuracy-sparse.h"
+
+struct ha_sparse {
+  int rows;
+  int cols;
+  int count; // number of nonzero entries
+  int *row_start; // the entries of row i are [row_start[i], row_start[i + 1])
+  int *col_index; // column of every entry
+  struct ha_comp *values; // the entries, row by row
+};
+
+// a row being eliminated
+struct elim_row {
+  int len;
+  int *cols; // sorted
+  struct ha_comp **vals; // nonzero, from new_value
+};
+
+// a list of rows
+struct row_list {
+  int len;
+  int cap;
+  int *rows;
+};
+
+// the state of an elimination
+struct elim {
+  int rows;
+  int cols;
+  struct elim_row *r;
+  int *col_count; // nonzero entries of each column in the active rows
+  struct row_list *col_rows; // rows that got an entry in each column
+  bool *row_done; // the row was a pivot row
+  int *pivot_rows; // the pivot of step k is at pivot_rows[k] and
+  int *pivot_cols; //   pivot_cols[k]
+  int rank; // number of steps taken
+  struct ha_matrix *rhs; // right-hand sides, updated with the rows, or NULL
+};
+
+
+// zero() gives the constant 0
+// time: O(1)
+static const struct ha_comp *zero(void) {
+  return ha_comp_constant(0);
+}
+
+// new_sparse(rows, cols, size) gives a sparse matrix of the given size with
+//   room for size entries, all initialized to 0, and no rows
+// effects: allocates memory (client must call ha_sparse_destroy with count
+//          set to size, or clear the unused entries)
+// time: O(rows + size)
+static struct ha_sparse *new_sparse(int rows, int cols, int size) {
+  struct ha_sparse *sp = ha_alloc(NULL, sizeof(struct ha_sparse));
+  sp->rows = rows;
+  sp->cols = cols;
+  sp->count = size;
+  sp->row_start = ha_alloc(NULL, (rows + 1) * sizeof(int));
+  memset(sp->row_start, 0, (rows + 1) * sizeof(int));
+  sp->col_index = ha_alloc(NULL, (size > 0 ? size : 1) * sizeof(int));
+  sp->values = ha_alloc(NULL, (size > 0 ? size : 1) * sizeof(struct ha_comp));
+  for (int i = 0; i < size; ++i) {
+    ha_comp_init(&sp->values[i], NULL);
+  }
+  return sp;
+}
+
+// shrink(sp, count) clears the entries of sp from count on, which are no
+//   longer used
+// effects: modifies sp
+// time: O(sp->count - count)
+static void shrink(struct ha_sparse *sp, int count) {
+  assert(sp);
+  assert(count <= sp->count);
+  for (int i = count; i < sp->count; ++i) {
+    ha_comp_clear(&sp->values[i]);
+  }
+  sp->count = count;
+}
+
+// move_comp(dst, src) gives the value of src to dst, and that of dst to src
+// time: O(1)
+static void move_comp(struct ha_comp *dst, struct ha_comp *src) {
+  assert(dst);
+  assert(src);
+  ha_frac_swap(&dst->real, &src->real);
+  ha_frac_swap(&dst->ima, &src->ima);
+}
+
+// counting_sort(keys, in, out, count, range) sets out to the indices of in
+//   stably sorted by keys[in[i]], where 0 <= keys[_] < range
+// time: O(count + range)
+static void counting_sort(const int *keys, const int *in, int *out, int count,
+                          int range) {
+  int *start = ha_alloc(NULL, (range + 1) * sizeof(int));
+  memset(start, 0, (range + 1) * sizeof(int));
+  for (int i = 0; i < count; ++i) {
+    ++start[keys[in[i]] + 1];
+  }
+  for (int k = 0; k < range; ++k) {
+    start[k + 1] += start[k];
+  }
+  for (int i = 0; i < count; ++i) {
+    out[start[keys[in[i]]]++] = in[i];
+  }
+  ha_release(NULL, start);
+}
+
+struct ha_sparse *ha_sparse_create(int rows, int cols, int count,
+                                   const int *row_idx, const int *col_idx,
+                                   const struct ha_comp *const *values) {
+  assert(rows > 0);
+  assert(cols > 0);
+  assert(count >= 0);
+  assert(count == 0 || (row_idx && col_idx && values));
+  // sort the triplets by row, then column, as two stable passes
+  int *identity = ha_alloc(NULL, (count > 0 ? count : 1) * sizeof(int));
+  int *by_col = ha_alloc(NULL, (count > 0 ? count : 1) * sizeof(int));
+  int *order = ha_alloc(NULL, (count > 0 ? count : 1) * sizeof(int));
+  for (int i = 0; i < count; ++i) {
+    assert(0 <= row_idx[i] && row_idx[i] < rows);
+    assert(0 <= col_idx[i] && col_idx[i] < cols);
+    identity[i] = i;
+  }
+  counting_sort(col_idx, identity, by_col, count, cols);
+  counting_sort(row_idx, by_col, order, count, rows);
+  int distinct = 0;
+  for (int i = 0; i < count; ++i) {
+    const int t = order[i];
+    const int s = i > 0 ? order[i - 1] : -1;
+    if (s < 0 || row_idx[s] != row_idx[t] || col_idx[s] != col_idx[t]) {
+      ++distinct;
+    }
+  }
+
+  // sum up every entry in the next free slot, which is kept if it is not 0
+  struct ha_sparse *sp = new_sparse(rows, cols, distinct);
+  int used = 0;
+  for (int i = 0; i < count; ++i) {
+    const int t = order[i];
+    const int s = i > 0 ? order[i - 1] : -1;
+    if (s >= 0 && row_idx[s] == row_idx[t] && col_idx[s] == col_idx[t]) {
+      ha_comp_add_into(&sp->values[used], &sp->values[used], values[t]);
+      continue;
+    }
+    if (s >= 0 && !ha_comp_is_zero(&sp->values[used])) {
+      sp->col_index[used++] = col_idx[s];
+      ++sp->row_start[row_idx[s] + 1];
+    }
+    ha_comp_set(&sp->values[used], values[t]);
+  }
+  if (count > 0 && !ha_comp_is_zero(&sp->values[used])) {
+    const int s = order[count - 1];
+    sp->col_index[used++] = col_idx[s];
+    ++sp->row_start[row_idx[s] + 1];
+  }
+  shrink(sp, used);
+  for (int i = 0; i < rows; ++i) {
+    sp->row_start[i + 1] += sp->row_start[i];
+  }
+  ha_release(NULL, identity);
+  ha_release(NULL, by_col);
+  ha_release(NULL, order);
+  return sp;
+}
+
+struct ha_sparse *ha_sparse_from_matrix(const struct ha_matrix *mat) {
+  assert(mat);
+  const int rows = ha_matrix_rows(mat);
+  const int cols = ha_matrix_cols(mat);
+  int count = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      count += !ha_comp_is_zero(ha_matrix_get(mat, i, j));
+    }
+  }
+  struct ha_sparse *sp = new_sparse(rows, cols, count);
+  int k = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const struct ha_comp *x = ha_matrix_get(mat, i, j);
+      if (!ha_comp_is_zero(x)) {
+        sp->col_index[k] = j;
+        ha_comp_set(&sp->values[k], x);
+        ++k;
+      }
+    }
+    sp->row_start[i + 1] = k;
+  }
+  return sp;
+}
+
+struct ha_matrix *ha_sparse_to_matrix(const struct ha_sparse *sp) {
+  assert(sp);
+  struct ha_matrix *mat = ha_matrix_create(sp->rows, sp->cols);
+  for (int i = 0; i < sp->rows; ++i) {
+    for (int k = sp->row_start[i]; k < sp->row_start[i + 1]; ++k) {
+      ha_matrix_set(mat, i, sp->col_index[k], &sp->values[k]);
+    }
+  }
+  return mat;
+}
+
+void ha_sparse_destroy(struct ha_sparse *sp) {
+  assert(sp);
+  shrink(sp, 0);
+  ha_release(NULL, sp->row_start);
+  ha_release(NULL, sp->col_index);
+  ha_release(NULL, sp->values);
+  ha_release(NULL, sp);
+}
+
+int ha_sparse_rows(const struct ha_sparse *sp) {
+  assert(sp);
+  return sp->rows;
+}
+
+int ha_sparse_cols(const struct ha_sparse *sp) {
+  assert(sp);
+  return sp->cols;
+}
+
+int ha_sparse_nonzeros(const struct ha_sparse *sp) {
+  assert(sp);
+  return sp->count;
+}
+
+// find_col(cols, len, col) gives the index of col in the sorted cols[0..len),
+//   or -1 if it is not there
+// time: O(log(len))
+static int find_col(const int *cols, int len, int col) {
+  int low = 0;
+  int high = len;
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    if (cols[mid] < col) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low < len && cols[low] == col ? low : -1;
+}
+
+const struct ha_comp *ha_sparse_get(const struct ha_sparse *sp, int row,
+                                    int col) {
+  assert(sp);
+  assert(0 <= row && row < sp->rows);
+  assert(0 <= col && col < sp->cols);
+  const int start = sp->row_start[row];
+  const int k = find_col(sp->col_index + start, sp->row_start[row + 1] - start,
+                         col);
+  return k < 0 ? zero() : &sp->values[start + k];
+}
+
+// compare_ints(a, b) orders ints for qsort
+static int compare_ints(const void *a, const void *b) {
+  const int x = *(const int *)a;
+  const int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+struct ha_sparse *ha_sparse_mult(const struct ha_sparse *n,
+                                 const struct ha_sparse *m) {
+  assert(n);
+  assert(m);
+  if (n->cols != m->rows) {
+    printf("Error: cannot multiply a %dx%d matrix and a %dx%d matrix\n",
+           n->rows, n->cols, m->rows, m->cols);
+    return NULL;
+  }
+  // mark[j] is the last row of the product with an entry in the column j
+  int *mark = ha_alloc(NULL, m->cols * sizeof(int));
+  for (int j = 0; j < m->cols; ++j) {
+    mark[j] = -1;
+  }
+  // a symbolic pass counts the entries of every row, ignoring cancellation
+  int size = 0;
+  for (int i = 0; i < n->rows; ++i) {
+    for (int a = n->row_start[i]; a < n->row_start[i + 1]; ++a) {
+      const int k = n->col_index[a];
+      for (int b = m->row_start[k]; b < m->row_start[k + 1]; ++b) {
+        const int j = m->col_index[b];
+        if (mark[j] != i) {
+          mark[j] = i;
+          ++size;
+        }
+      }
+    }
+  }
+
+  struct ha_sparse *result = new_sparse(n->rows, m->cols, size);
+  struct ha_comp *acc = ha_alloc(NULL, m->cols * sizeof(struct ha_comp));
+  int *touched = ha_alloc(NULL, m->cols * sizeof(int));
+  for (int j = 0; j < m->cols; ++j) {
+    ha_comp_init(&acc[j], NULL);
+    mark[j] = -1;
+  }
+  const bool lazy = ha_frac_set_lazy(true);
+  int used = 0;
+  for (int i = 0; i < n->rows; ++i) {
+    int touched_num = 0;
+    for (int a = n->row_start[i]; a < n->row_start[i + 1]; ++a) {
+      const int k = n->col_index[a];
+      const struct ha_comp *x = &n->values[a];
+      for (int b = m->row_start[k]; b < m->row_start[k + 1]; ++b) {
+        const int j = m->col_index[b];
+        if (mark[j] != i) {
+          mark[j] = i;
+          touched[touched_num++] = j;
+          ha_comp_mult_into(&acc[j], x, &m->values[b]);
+        } else {
+          ha_comp_fma(&acc[j], x, &m->values[b]);
+        }
+      }
+    }
+    qsort(touched, touched_num, sizeof(int), compare_ints);
+    for (int t = 0; t < touched_num; ++t) {
+      struct ha_comp *x = &acc[touched[t]];
+      if (!lazy) {
+        ha_frac_normalize(&x->real);
+        ha_frac_normalize(&x->ima);
+      }
+      if (!ha_comp_is_zero(x)) {
+        result->col_index[used] = touched[t];
+        move_comp(&result->values[used], x); // x gets the 0 of the slot
+        ++used;
+      }
+    }
+    result->row_start[i + 1] = used;
+  }
+  ha_frac_set_lazy(lazy);
+  shrink(result, used);
+  for (int j = 0; j < m->cols; ++j) {
+    ha_comp_clear(&acc[j]);
+  }
+  ha_release(NULL, acc);
+  ha_release(NULL, touched);
+  ha_release(NULL, mark);
+  return result;
+}
+
+
+// new_value() gives a new number 0 for an elimination row
+// effects: allocates memory (client must call free_value)
+// time: O(1)
+static struct ha_comp *new_value(void) {
+  struct ha_comp *x = ha_alloc_node(NULL, sizeof(struct ha_comp));
+  ha_comp_init(x, NULL);
+  return x;
+}
+
+// free_value(x) frees a number from new_value
+// effects: x is no longer valid
+// time: O(1)
+static void free_value(struct ha_comp *x) {
+  assert(x);
+  ha_comp_clear(x);
+  ha_release_node(NULL, x, sizeof(struct ha_comp));
+}
+
+// list_add(list, row) appends row to list
+// effects: modifies list
+//          may allocate memory
+// time: O(1) amortized
+static void list_add(struct row_list *list, int row) {
+  assert(list);
+  if (list->len == list->cap) {
+    list->cap = list->cap ? 2 * list->cap : 4;
+    int *bigger = ha_alloc(NULL, list->cap * sizeof(int));
+    if (list->rows) {
+      memcpy(bigger, list->rows, list->len * sizeof(int));
+      ha_release(NULL, list->rows);
+    }
+    list->rows = bigger;
+  }
+  list->rows[list->len++] = row;
+}
+
+// elim_init(e, sp, rhs) sets up the elimination of sp, carrying the rows of
+//   rhs along if it is not NULL
+// requires: rhs has the rows of sp, if it is not NULL
+// effects: e is valid (client must call elim_clear)
+// time: O(r + c + z * e)
+static void elim_init(struct elim *e, const struct ha_sparse *sp,
+                      struct ha_matrix *rhs) {
+  assert(e);
+  assert(sp);
+  e->rows = sp->rows;
+  e->cols = sp->cols;
+  e->r = ha_alloc(NULL, sp->rows * sizeof(struct elim_row));
+  e->col_count = ha_alloc(NULL, sp->cols * sizeof(int));
+  e->col_rows = ha_alloc(NULL, sp->cols * sizeof(struct row_list));
+  e->row_done = ha_alloc(NULL, sp->rows * sizeof(bool));
+  const int steps = sp->rows < sp->cols ? sp->rows : sp->cols;
+  e->pivot_rows = ha_alloc(NULL, steps * sizeof(int));
+  e->pivot_cols = ha_alloc(NULL, steps * sizeof(int));
+  e->rank = 0;
+  e->rhs = rhs;
+  for (int j = 0; j < sp->cols; ++j) {
+    e->col_count[j] = 0;
+    e->col_rows[j] = (struct row_list){0, 0, NULL};
+  }
+  for (int i = 0; i < sp->rows; ++i) {
+    const int start = sp->row_start[i];
+    struct elim_row *row = &e->r[i];
+    row->len = sp->row_start[i + 1] - start;
+    row->cols = ha_alloc(NULL, (row->len > 0 ? row->len : 1) * sizeof(int));
+    row->vals = ha_alloc(NULL, (row->len > 0 ? row->len : 1) *
+                               sizeof(struct ha_comp *));
+    for (int k = 0; k < row->len; ++k) {
+      const int j = sp->col_index[start + k];
+      row->cols[k] = j;
+      row->vals[k] = new_value();
+      ha_comp_set(row->vals[k], &sp->values[start + k]);
+      ++e->col_count[j];
+      list_add(&e->col_rows[j], i);
+    }
+    e->row_done[i] = false;
+  }
+}
+
+// free_row(row) frees the numbers and lists of row
+// effects: row is no longer valid
+// time: O(len)
+static void free_row(struct elim_row *row) {
+  assert(row);
+  for (int k = 0; k < row->len; ++k) {
+    free_value(row->vals[k]);
+  }
+  ha_release(NULL, row->cols);
+  ha_release(NULL, row->vals);
+}
+
+// elim_clear(e) frees the memory of e, but not its right-hand sides
+// effects: e is no longer valid
+// time: O(r + c + z)
+static void elim_clear(struct elim *e) {
+  assert(e);
+  for (int i = 0; i < e->rows; ++i) {
+    free_row(&e->r[i]);
+  }
+  for (int j = 0; j < e->cols; ++j) {
+    if (e->col_rows[j].rows) {
+      ha_release(NULL, e->col_rows[j].rows);
+    }
+  }
+  ha_release(NULL, e->r);
+  ha_release(NULL, e->col_count);
+  ha_release(NULL, e->col_rows);
+  ha_release(NULL, e->row_done);
+  ha_release(NULL, e->pivot_rows);
+  ha_release(NULL, e->pivot_cols);
+}
+
+// comp_bits(x) gives the bits of the numerators and denominators of x
+// time: O(1)
+static int comp_bits(const struct ha_comp *x) {
+  assert(x);
+  return ha_int_bit_length(&x->real.nume) + ha_int_bit_length(&x->real.denom) +
+         ha_int_bit_length(&x->ima.nume) + ha_int_bit_length(&x->ima.denom);
+}
+
+// choose_pivot(e, row, idx) finds the pivot of the next step by the
+//   Markowitz rule: row and idx are set to its row and its index in the row,
+//   or false is returned if the active rows are all zero
+// notes: every entry of an active row is in a column not pivoted on yet
+// effects: modifies row and idx
+// time: O(z + f)
+static bool choose_pivot(const struct elim *e, int *row, int *idx) {
+  assert(e);
+  assert(row);
+  assert(idx);
+  long long best_cost = -1;
+  int best_bits = 0;
+  for (int i = 0; i < e->rows; ++i) {
+    const struct elim_row *r = &e->r[i];
+    if (e->row_done[i]) {
+      continue;
+    }
+    for (int k = 0; k < r->len; ++k) {
+      const long long cost =
+        (long long)(r->len - 1) * (e->col_count[r->cols[k]] - 1);
+      if (best_cost >= 0 && cost > best_cost) {
+        continue;
+      }
+      const int bits = comp_bits(r->vals[k]);
+      if (best_cost < 0 || cost < best_cost || bits < best_bits) {
+        best_cost = cost;
+        best_bits = bits;
+        *row = i;
+        *idx = k;
+      }
+    }
+    if (best_cost == 0 && best_bits <= 2) {
+      break; // a unit with no other entry in its row or column
+    }
+  }
+  return best_cost >= 0;
+}
+
+// eliminate_row(e, i, p, q, factor) sets the row i of e to itself plus
+//   factor times the pivot row p, which cancels its entry in the column q
+// requires: factor != 0
+// effects: modifies e
+//          may allocate memory
+// time: O((len_i + len_p) * e)
+static void eliminate_row(struct elim *e, int i, int p, int q,
+                          const struct ha_comp *factor) {
+  assert(e);
+  assert(factor);
+  struct elim_row *row = &e->r[i];
+  const struct elim_row *pivot = &e->r[p];
+  const int cap = row->len + pivot->len;
+  int *cols = ha_alloc(NULL, cap * sizeof(int));
+  struct ha_comp **vals = ha_alloc(NULL, cap * sizeof(struct ha_comp *));
+  int len = 0;
+  int a = 0;
+  int b = 0;
+  while (a < row->len || b < pivot->len) {
+    const int col_a = a < row->len ? row->cols[a] : e->cols;
+    const int col_b = b < pivot->len ? pivot->cols[b] : e->cols;
+    if (col_a < col_b) {
+      cols[len] = col_a;
+      vals[len++] = row->vals[a++];
+      continue;
+    }
+    struct ha_comp *x;
+    if (col_a == col_b) {
+      x = row->vals[a++];
+    } else { // fill-in
+      x = new_value();
+      ++e->col_count[col_b];
+      list_add(&e->col_rows[col_b], i);
+    }
+    if (col_b == q) {
+      // the pivot column is cancelled by construction
+      ha_comp_set(x, zero());
+    } else {
+      ha_comp_fma(x, factor, pivot->vals[b]);
+    }
+    ++b;
+    if (ha_comp_is_zero(x)) {
+      free_value(x);
+      --e->col_count[col_b];
+    } else {
+      cols[len] = col_b;
+      vals[len++] = x;
+    }
+  }
+  ha_release(NULL, row->cols);
+  ha_release(NULL, row->vals);
+  row->cols = cols;
+  row->vals = vals;
+  row->len = len;
+
+  if (e->rhs) {
+    const int rhs_cols = ha_matrix_cols(e->rhs);
+    for (int j = 0; j < rhs_cols; ++j) {
+      const struct ha_comp *y = ha_matrix_get(e->rhs, p, j);
+      if (!ha_comp_is_zero(y)) {
+        ha_comp_fma(ha_matrix_at(e->rhs, i, j), factor, y);
+      }
+    }
+  }
+}
+
+// eliminate(e) runs the elimination of e to the end, stopping once the active
+//   rows are all zero
+// effects: modifies e
+//          may allocate memory
+// time: see ha_sparse_det
+static void eliminate(struct elim *e) {
+  assert(e);
+  struct ha_comp factor;
+  ha_comp_init(&factor, NULL);
+  int p = 0;
+  int idx = 0;
+  while (choose_pivot(e, &p, &idx)) {
+    const struct elim_row *pivot = &e->r[p];
+    const int q = pivot->cols[idx];
+    e->row_done[p] = true;
+    e->pivot_rows[e->rank] = p;
+    e->pivot_cols[e->rank] = q;
+    ++e->rank;
+    // the pivot row leaves the active rows
+    for (int k = 0; k < pivot->len; ++k) {
+      --e->col_count[pivot->cols[k]];
+    }
+    const struct row_list *list = &e->col_rows[q];
+    for (int l = 0; l < list->len; ++l) {
+      const int i = list->rows[l];
+      const struct elim_row *row = &e->r[i];
+      if (e->row_done[i]) {
+        continue;
+      }
+      const int k = find_col(row->cols, row->len, q);
+      if (k < 0) {
+        continue; // cancelled since
+      }
+      // factor = -row[q] / pivot[q]
+      ha_comp_div_into(&factor, row->vals[k], pivot->vals[idx]);
+      ha_comp_sub_into(&factor, zero(), &factor);
+      eliminate_row(e, i, p, q, &factor);
+    }
+  }
+  ha_comp_clear(&factor);
+}
+
+// permutation_sign(perm, n) gives the sign of the permutation perm of
+//   0..n - 1
+// time: O(n)
+static int permutation_sign(const int *perm, int n) {
+  bool *seen = ha_alloc(NULL, n * sizeof(bool));
+  memset(seen, 0, n * sizeof(bool));
+  int sign = 1;
+  for (int i = 0; i < n; ++i) {
+    if (seen[i]) {
+      continue;
+    }
+    // a cycle of length len has the sign (-1)^(len - 1)
+    int len = 0;
+    for (int j = i; !seen[j]; j = perm[j]) {
+      seen[j] = true;
+      ++len;
+    }
+    if (len % 2 == 0) {
+      sign = -sign;
+    }
+  }
+  ha_release(NULL, seen);
+  return sign;
+}
+
+// pivot_value(e, k) gives the pivot of the step k of e
+// time: O(log(len))
+static const struct ha_comp *pivot_value(const struct elim *e, int k) {
+  assert(e);
+  const struct elim_row *row = &e->r[e->pivot_rows[k]];
+  const int idx = find_col(row->cols, row->len, e->pivot_cols[k]);
+  assert(idx >= 0);
+  return row->vals[idx];
+}
+
+struct ha_comp *ha_sparse_det(const struct ha_sparse *sp) {
+  assert(sp);
+  if (sp->rows != sp->cols) {
+    printf("Error: cannot take the determinant of a %dx%d matrix\n",
+           sp->rows, sp->cols);
+    return NULL;
+  }
+  struct elim e;
+  elim_init(&e, sp, NULL);
+  eliminate(&e);
+  struct ha_comp *det = ha_comp_create("0", "1", "0", "1");
+  if (e.rank == sp->rows) {
+    // P * A * Q = L * U for the permutations of the pivot rows and columns
+    ha_comp_set(det, ha_comp_constant(permutation_sign(e.pivot_rows, e.rank) *
+                                      permutation_sign(e.pivot_cols, e.rank)));
+    for (int k = 0; k < e.rank; ++k) {
+      ha_comp_mult_into(det, det, pivot_value(&e, k));
+    }
+  }
+  elim_clear(&e);
+  return det;
+}
+
+int ha_sparse_rank(const struct ha_sparse *sp) {
+  assert(sp);
+  struct elim e;
+  elim_init(&e, sp, NULL);
+  eliminate(&e);
+  const int rank = e.rank;
+  elim_clear(&e);
+  return rank;
+}
+
+struct ha_matrix *ha_sparse_solve(const struct ha_sparse *a,
+                                  const struct ha_matrix *b) {
+  assert(a);
+  assert(b);
+  const int n = a->rows;
+  if (a->rows != a->cols) {
+    printf("Error: cannot solve a system with a %dx%d matrix\n", a->rows,
+           a->cols);
+    return NULL;
+  }
+  if (ha_matrix_rows(b) != n) {
+    printf("Error: cannot solve a %dx%d matrix and a %dx%d matrix\n", n, n,
+           ha_matrix_rows(b), ha_matrix_cols(b));
+    return NULL;
+  }
+  struct ha_arena *arena = ha_arena_use(NULL);
+  struct ha_matrix *rhs = ha_matrix_copy(b);
+  ha_arena_use(arena);
+  struct elim e;
+  elim_init(&e, a, rhs);
+  eliminate(&e);
+  struct ha_matrix *x = NULL;
+  if (e.rank == n) {
+    // back substitution, from the last pivot: the pivot row of step k only
+    // has entries in the columns pivoted on at step k or later
+    const int cols = ha_matrix_cols(b);
+    x = ha_matrix_create(n, cols);
+    struct ha_comp sum;
+    ha_comp_init(&sum, NULL);
+    for (int k = n - 1; k >= 0; --k) {
+      const int p = e.pivot_rows[k];
+      const int q = e.pivot_cols[k];
+      const struct elim_row *row = &e.r[p];
+      for (int j = 0; j < cols; ++j) {
+        ha_comp_set(&sum, ha_matrix_get(rhs, p, j));
+        for (int t = 0; t < row->len; ++t) {
+          if (row->cols[t] != q) {
+            struct ha_comp *y = ha_matrix_at(x, row->cols[t], j);
+            if (!ha_comp_is_zero(y)) {
+              ha_comp_sub_into(y, zero(), y);
+              ha_comp_fma(&sum, row->vals[t], y);
+              ha_comp_sub_into(y, zero(), y);
+            }
+          }
+        }
+        ha_comp_div_into(ha_matrix_at(x, q, j), &sum, pivot_value(&e, k));
+      }
+    }
+    ha_comp_clear(&sum);
+  } else {
+    printf("Error: the matrix is singular\n");
+  }
+  elim_clear(&e);
+  ha_matrix_destroy(rhs);
+  return x;
+}
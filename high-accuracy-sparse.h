@@ -0,0 +1,121 @@
+#include <stdbool.h>
+#include "high-accuracy-complex.h"
+#include "high-accuracy-matrix.h"
+
+// This module provides sparse matrices of arbitrarily large complex numbers
+
+// The following applies to all functions:
+// requires: all sparse matrix, matrix and number parameters are valid (not
+//           NULL)
+// time: r and c are the numbers of rows and columns of the sparse matrix
+// parameter (of the first one if there are several), z is its number of
+// nonzero entries, and e is the time of one ha_comp operation on the entries
+// involved
+
+// Storage: a sparse matrix keeps only its nonzero entries, in compressed
+// sparse row (CSR) form: the entries row by row, each row sorted by column,
+// with their column indices in a parallel array and the start of every row
+// in a third one. Zeros are implicit: they take no memory, and are skipped
+// by their structure, without looking at any number. Memory and the time of
+// the operations below grow with z instead of r * c.
+
+// Elimination: the determinant, rank and solving functions eliminate over
+// the fractions, updating only the rows with an entry in the pivot column.
+// Pivots are chosen by the Markowitz rule, as the nonzero entry whose row
+// and column have the fewest other nonzero entries (the smallest entry on
+// ties), which keeps the fill-in (new nonzero entries) low. The time of an
+// elimination thus depends on the fill-in f rather than on r^3.
+
+// Sparse matrices live on the heap, whatever the allocation context.
+
+
+struct ha_sparse;
+
+
+// ha_sparse_create(rows, cols, count, row_idx, col_idx, values) creates the
+//   rows x cols sparse matrix whose entry at row_idx[i] and col_idx[i] is
+//   values[i], for i from 0 to count - 1, and that is 0 elsewhere
+// notes: the values given for the same entry are added up, and the entries
+//          that end up 0 are not kept
+//        the triplets may come in any order
+// requires: rows > 0, cols > 0, count >= 0
+//           0 <= row_idx[i] < rows, 0 <= col_idx[i] < cols for all i
+//           row_idx, col_idx and values are not NULL if count > 0
+// effects: allocates memory (client must call ha_sparse_destroy)
+// time: O(rows + cols + count * e)
+struct ha_sparse *ha_sparse_create(int rows, int cols, int count,
+                                   const int *row_idx, const int *col_idx,
+                                   const struct ha_comp *const *values);
+
+// ha_sparse_from_matrix(mat) gives the sparse form of mat
+// effects: allocates memory (client must call ha_sparse_destroy)
+// time: O(r * c + z * e), where r and c are the numbers of rows and columns
+//       of mat and z is its number of nonzero entries
+struct ha_sparse *ha_sparse_from_matrix(const struct ha_matrix *mat);
+
+// ha_sparse_to_matrix(sp) gives the dense matrix sp stands for
+// effects: allocates memory (client must call ha_matrix_destroy)
+// time: O(r * c + z * e)
+struct ha_matrix *ha_sparse_to_matrix(const struct ha_sparse *sp);
+
+// ha_sparse_destroy(sp) destroys sp
+// effects: sp is no longer valid
+// time: O(z)
+void ha_sparse_destroy(struct ha_sparse *sp);
+
+// ha_sparse_rows(sp) gives the number of rows of sp
+// time: O(1)
+int ha_sparse_rows(const struct ha_sparse *sp);
+
+// ha_sparse_cols(sp) gives the number of columns of sp
+// time: O(1)
+int ha_sparse_cols(const struct ha_sparse *sp);
+
+// ha_sparse_nonzeros(sp) gives the number of nonzero entries of sp
+// time: O(1)
+int ha_sparse_nonzeros(const struct ha_sparse *sp);
+
+// ha_sparse_get(sp, row, col) gives the entry of sp at row and col (both
+//   counted from 0)
+// notes: a zero entry is the shared constant 0 (see ha_comp_constant)
+// requires: 0 <= row < r, 0 <= col < c
+// time: O(log(z))
+const struct ha_comp *ha_sparse_get(const struct ha_sparse *sp, int row,
+                                    int col);
+
+// ha_sparse_mult(n, m) gives n * m, or returns NULL if the number of columns
+//   of n is not the number of rows of m
+// notes: the rows of the product are accumulated one at a time in a dense
+//          row (Gustavson's method), with deferred reduction, and only the
+//          pairs of nonzero entries are multiplied
+//        if the sizes do not match, an error message is printed
+// effects: may allocate memory (client must call ha_sparse_destroy)
+//          may produce output (error message)
+// time: O(r + cm + p * e), where cm is the number of columns of m and p is
+//       the number of products of nonzero entries
+struct ha_sparse *ha_sparse_mult(const struct ha_sparse *n,
+                                 const struct ha_sparse *m);
+
+// ha_sparse_det(sp) gives the determinant of sp, or returns NULL if sp is
+//   not square
+// notes: if sp is not square, an error message is printed
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(r * (z + f) + (z + f) * k * e), where f is the fill-in and k the
+//       number of nonzero entries of the longest row during the elimination
+struct ha_comp *ha_sparse_det(const struct ha_sparse *sp);
+
+// ha_sparse_rank(sp) gives the rank of sp
+// time: same as ha_sparse_det
+int ha_sparse_rank(const struct ha_sparse *sp);
+
+// ha_sparse_solve(a, b) gives the x with a * x = b, or returns NULL if a is
+//   not square, has not the rows of b, or is singular
+// notes: b is dense, and so is the result
+//        if there is no unique solution, an error message is printed
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: same as ha_sparse_det, plus O((z + f) * cb * e), where cb is the
+//       number of columns of b
+struct ha_matrix *ha_sparse_solve(const struct ha_sparse *a,
+                                  const struct ha_matrix *b);
@@ -0,0 +1,69 @@
+// This module counts the work done by the high-accuracy modules
+
+// For all program scope functions, see high-accuracy-stats.h for details
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "high-accuracy-stats.h"
+
+
+static _Thread_local struct ha_stats stats;
+
+
+bool ha_stats_enabled(void) {
+#ifdef HA_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ha_stats_get(struct ha_stats *dst) {
+  assert(dst);
+  *dst = stats;
+}
+
+void ha_stats_reset(void) {
+  const int64_t live_bytes = stats.live_bytes;
+  const int64_t live_limbs = stats.live_limbs;
+  stats = (struct ha_stats){0};
+  stats.live_bytes = live_bytes;
+  stats.peak_live_bytes = live_bytes;
+  stats.live_limbs = live_limbs;
+  stats.peak_live_limbs = live_limbs;
+}
+
+struct ha_stats *ha_stats_local(void) {
+  return &stats;
+}
+
+void ha_stats_count_mult(int limbs) {
+  assert(limbs >= 0);
+  int bits = 0; // the bit length of limbs
+  while (bits < 31 && limbs >> bits) {
+    ++bits;
+  }
+  // 2^(bits - 1) <= limbs < 2^bits, so the class is bits / 2
+  const int c = bits / 2;
+  ++stats.mult[c < HA_STATS_MULT_CLASSES ? c : HA_STATS_MULT_CLASSES - 1];
+}
+
+void ha_stats_count_bytes(int64_t change) {
+  if (change >= 0) {
+    stats.bytes_allocated += change;
+  } else {
+    stats.bytes_freed += -change;
+  }
+  stats.live_bytes += change;
+  if (stats.live_bytes > stats.peak_live_bytes) {
+    stats.peak_live_bytes = stats.live_bytes;
+  }
+}
+
+void ha_stats_count_limbs(int64_t change) {
+  stats.live_limbs += change;
+  if (stats.live_limbs > stats.peak_live_limbs) {
+    stats.peak_live_limbs = stats.live_limbs;
+  }
+}
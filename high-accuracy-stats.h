@@ -0,0 +1,101 @@
+// This module counts the work done by the high-accuracy modules, to find out
+//   why a calculation is slow
+
+// Counting is compiled in with -DHA_STATS (for every module of the program);
+//   otherwise the counting points expand to nothing, and the functions below
+//   report that there is nothing to count. Every thread counts its own work:
+//   the tasks a pool runs are counted on the threads that run them, and
+//   memory is counted as allocated or freed by the thread that does it.
+//   struct ha_stats before;
+//   ha_stats_get(&before);
+//   ... the job ...
+//   struct ha_stats after;
+//   ha_stats_get(&after);
+//   ... after.gcd - before.gcd gcds, and so on ...
+
+#ifndef HIGH_ACCURACY_STATS_H
+#define HIGH_ACCURACY_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// number of size classes of multiplications
+#define HA_STATS_MULT_CLASSES 8
+
+
+struct ha_stats {
+  // integer multiplications by the number of limbs k of the shorter operand:
+  // mult[0] counts k <= 1 and mult[c] counts 2^(2c - 1) <= k < 2^(2c + 1),
+  // the last class also counting every bigger k
+  uint64_t mult[HA_STATS_MULT_CLASSES];
+  uint64_t divmod; // integer divisions, including those of the gcds
+  uint64_t gcd; // integer gcds (plain and extended)
+  uint64_t reduce; // fractions brought to lowest terms
+  // fraction comparisons the estimates could not settle, done by
+  // cross-multiplying
+  uint64_t compare_exact;
+  uint64_t bytes_allocated; // through the allocation module, arenas included
+  uint64_t bytes_freed; // an arena frees all its bytes when it is reset
+  int64_t live_bytes; // bytes_allocated - bytes_freed
+  int64_t peak_live_bytes;
+  // limbs held by heap integers besides their own storage (an arena's are
+  // only counted in its bytes)
+  int64_t live_limbs;
+  int64_t peak_live_limbs;
+};
+
+
+// ha_stats_enabled() determines if the counting is compiled in
+// time: O(1)
+bool ha_stats_enabled(void);
+
+// ha_stats_get(stats) sets *stats to the counts of the calling thread since it
+//   started or since its last ha_stats_reset
+// notes: everything is 0 if the counting is not compiled in
+// requires: stats is not NULL
+// effects: modifies *stats
+// time: O(1)
+void ha_stats_get(struct ha_stats *stats);
+
+// ha_stats_reset() sets the counts of the calling thread back to 0, and its
+//   peaks to what is live now
+// effects: modifies the counts of the calling thread
+// time: O(1)
+void ha_stats_reset(void);
+
+
+// The functions and macros below are the counting points of the
+//   high-accuracy modules; without HA_STATS, the macros expand to nothing.
+
+// ha_stats_local() gives the counts of the calling thread
+// time: O(1)
+struct ha_stats *ha_stats_local(void);
+
+// ha_stats_count_mult(limbs) counts a multiplication whose shorter operand
+//   has limbs limbs
+// time: O(1)
+void ha_stats_count_mult(int limbs);
+
+// ha_stats_count_bytes(change) counts change bytes as allocated, or -change
+//   bytes as freed if change is negative, and updates the peak
+// time: O(1)
+void ha_stats_count_bytes(int64_t change);
+
+// ha_stats_count_limbs(change) counts change more limbs held by integers
+//   (fewer if change is negative), and updates the peak
+// time: O(1)
+void ha_stats_count_limbs(int64_t change);
+
+#ifdef HA_STATS
+#define HA_STATS_COUNT(field) ((void)++ha_stats_local()->field)
+#define HA_STATS_MULT(limbs) ha_stats_count_mult(limbs)
+#define HA_STATS_BYTES(change) ha_stats_count_bytes(change)
+#define HA_STATS_LIMBS(change) ha_stats_count_limbs(change)
+#else
+#define HA_STATS_COUNT(field) ((void)0)
+#define HA_STATS_MULT(limbs) ((void)0)
+#define HA_STATS_BYTES(change) ((void)0)
+#define HA_STATS_LIMBS(change) ((void)0)
+#endif
+
+#endif
@@ -1,240 +1,491 @@
 // This module turns the input into the corresponding ha_comp
 
-// We assume the input is in the proper form
-// examples of proper form: 
+// For all program scope functions, see read-input.h for details
+
+// examples of proper form:
 //   0, 12, -123 (integers)
 //   1/2, -2/3, 4/2 (fractions)
 //   i, -3i, (2/3)i (only imaginary parts)
 //   2+3i, -1/2-(3/4)i, -3+(4/5)i, 2/3-4i (complex numbers)
+// The integers follow the rules of ha_int_create, and denominators are
+// positive.
 
 // The following applies to all functions:
 // requires: all number parameters are valid (not NULL)
 // time: (n) is the length of the number
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "high-accuracy-alloc.h"
 #include "high-accuracy-complex.h"
+#include "high-accuracy-fraction.h"
+#include "high-accuracy-integer.h"
+#include "high-accuracy-layout.h"
+#include "high-accuracy-matrix.h"
 #include "read-input.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-// only_real(num) determines if num has only the real part
-// time: O(n)
-static bool only_real(const char *num) {
-  assert(num);
-  const int len = strlen(num);
-  for (int i = 0; i < len; ++i) {
-    if (num[i] == 'i') {
-      return false;	
-    }
-  }
-  return true;
+// size of the buffer a FILE is read into, which grows for longer numbers
+#define READ_BUFFER_SIZE (64 * 1024)
+
+
+struct reader {
+  const char *pos; // next character to read
+  const char *end; // end of the characters in memory
+  FILE *file; // source of the characters after end, NULL if none
+  bool owns_file; // file was opened by reader_from_path
+  char *buffer; // what file was read into, NULL if there is no file
+  size_t buffer_size;
+  void *map; // the mapped file, NULL if none
+  size_t map_size;
+  struct ha_int *nume; // integers being parsed, on the heap
+  struct ha_int *denom;
+};
+
+
+// is_space(c) determines if c separates numbers
+// time: O(1)
+static bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' ||
+         c == '\v';
 }
 
-// only_imaginary(num) determines if num has only the imaginary part
-// time: O(n)
-static bool only_imaginary(const char *num) {
-  assert(num);
-  if (only_real(num)) {
+// is_digit(c) determines if c is a decimal digit
+// time: O(1)
+static bool is_digit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+// new_reader(pos, end) creates a reader for the characters in [pos, end)
+// effects: allocates memory (client must call reader_destroy)
+// time: O(1)
+static struct reader *new_reader(const char *pos, const char *end) {
+  struct reader *reader = malloc(sizeof(struct reader));
+  reader->pos = pos;
+  reader->end = end;
+  reader->file = NULL;
+  reader->owns_file = false;
+  reader->buffer = NULL;
+  reader->buffer_size = 0;
+  reader->map = NULL;
+  reader->map_size = 0;
+  struct ha_arena *arena = ha_arena_use(NULL); // outlasts any arena
+  reader->nume = ha_int_create("0");
+  reader->denom = ha_int_create("0");
+  ha_arena_use(arena);
+  return reader;
+}
+
+// refill(reader) keeps the characters of reader that are not read yet and
+//   reads more of its file after them
+// notes: the buffer is doubled if it is full of unread characters
+// returns: false if nothing could be read
+// effects: reads from the file, may allocate memory
+//          pointers into the buffer are no longer valid
+// time: O(size of the buffer)
+static bool refill(struct reader *reader) {
+  assert(reader);
+  if (!reader->file) {
     return false;
   }
+  const size_t left = reader->end - reader->pos;
+  if (left == reader->buffer_size) {
+    reader->buffer_size *= 2;
+    char *buffer = malloc(reader->buffer_size);
+    memcpy(buffer, reader->pos, left);
+    free(reader->buffer);
+    reader->buffer = buffer;
+  } else {
+    memmove(reader->buffer, reader->pos, left);
+  }
+  const size_t got = fread(reader->buffer + left, 1,
+                           reader->buffer_size - left, reader->file);
+  reader->pos = reader->buffer;
+  reader->end = reader->buffer + left + got;
+  return got > 0;
+}
 
-  // num contains 'i'
-  const int len = strlen(num);
-  int i_idx = 0; //index of 'i'
-  for (int i = 0; i < len; ++i) {
-    if (num[i] == 'i') {
-      i_idx = i;
+// next_token(reader, len) skips the whitespace of reader and gives the next
+//   token with its length in *len, or NULL if there is none
+// notes: the token stays in memory until the next call
+// effects: consumes the whitespace, not the token
+//          modifies *len
+// time: O(length of the whitespace and the token)
+static const char *next_token(struct reader *reader, size_t *len) {
+  assert(reader);
+  assert(len);
+  for (;;) {
+    while (reader->pos < reader->end && is_space(*reader->pos)) {
+      ++reader->pos;
+    }
+    if (reader->pos < reader->end || !refill(reader)) {
       break;
     }
   }
-  for (int j = i_idx - 1; j >= 0; --j) {
-    if (num[j] == '+') {
-      return false;
-    } else if (num[j] == '-') {
-      return j == 0;
+  if (reader->pos == reader->end) {
+    return NULL;
+  }
+  size_t i = 0;
+  for (;;) {
+    while (reader->pos + i < reader->end && !is_space(reader->pos[i])) {
+      ++i;
+    }
+    // a token that reaches the end of the buffer may continue in the file
+    if (reader->pos + i < reader->end || !refill(reader)) {
+      break;
     }
   }
+  *len = i;
+  return reader->pos;
+}
+
+// parse_int(pos, end, n, negative) parses the integer at *pos into n, negated
+//   if negative is true, and moves *pos past it
+// returns: false if there is no valid integer at *pos (see ha_int_create;
+//          negative stands for the sign), in which case n is not modified
+// effects: modifies *pos and n
+// time: O(n^2)
+static bool parse_int(const char **pos, const char *end, struct ha_int *n,
+                      bool negative) {
+  assert(pos);
+  assert(end);
+  assert(n);
+  const char *digits = *pos;
+  const char *p = digits;
+  while (p < end && is_digit(*p)) {
+    ++p;
+  }
+  const size_t len = p - digits;
+  if (len == 0 || len > INT_MAX || (digits[0] == '0' && (len > 1 ||
+                                                         negative))) {
+    return false;
+  }
+  ha_int_set_digits(n, digits, len, negative);
+  *pos = p;
   return true;
 }
 
-// real(num) gives the real part of num
-// effects: allocates memory (caller must free)
-// time: O(n)
-static char *real(char *num) {
-  assert(num);
-  const int len = strlen(num);
-  char *copy = malloc((len + 1) * sizeof(char));
-  strcpy(copy, num);
-
-  if (only_real(copy)) {
-    return copy;
-  } else if (only_imaginary(copy)) {
-    copy = realloc(copy, sizeof(char));
-    copy[0] = '\0';
-    return copy;
-  }
-
-  // num has both real and imaginary part
-  for (int i = 1; i < len; ++i) {
-    if (copy[i] == '+' || copy[i] == '-') {
-      copy[i] = '\0';
-    }
+// parse_frac(reader, pos, end, negative) parses the fraction at *pos into
+//   reader->nume and reader->denom, negated if negative is true, and moves
+//   *pos past it
+// notes: the denominator is 1 if there is none
+// returns: false if there is no valid fraction at *pos
+// effects: modifies *pos, reader->nume and reader->denom
+// time: O(n^2)
+static bool parse_frac(struct reader *reader, const char **pos,
+                       const char *end, bool negative) {
+  assert(reader);
+  assert(pos);
+  assert(end);
+  if (!parse_int(pos, end, reader->nume, negative)) {
+    return false;
+  }
+  if (*pos < end && **pos == '/') {
+    ++*pos;
+    return parse_int(pos, end, reader->denom, false) &&
+           ha_int_sign(reader->denom) != 0;
   }
-  return copy;
+  ha_int_set_digits(reader->denom, "1", 1, false);
+  return true;
 }
 
-// imaginary(num) gives the imaginary part of num
-// effects: allocates memory (caller must free)
-// time: O(n)
-static char *imaginary(char *num) {
+// parse_term(reader, pos, end, num, negative, is_ima) parses the real or
+//   imaginary term at *pos into the matching part of num, negated if
+//   negative is true, and moves *pos past it
+// notes: *is_ima tells which part the term was
+//        the imaginary forms are i, bi and (b)i, where b is a fraction
+// returns: false if there is no valid term at *pos
+// effects: modifies *pos, num and *is_ima
+// time: O(n^2)
+static bool parse_term(struct reader *reader, const char **pos,
+                       const char *end, struct ha_comp *num, bool negative,
+                       bool *is_ima) {
+  assert(reader);
+  assert(pos);
+  assert(end);
   assert(num);
-  const int len = strlen(num);
-
-  if (only_imaginary(num)) {
-    char *copy = malloc((len + 1) * sizeof(char));
-    strcpy(copy, num);
-    return copy;
-  } else if (only_real(num)) {
-    char *copy = malloc(sizeof(char));
-    copy[0] = '\0';
-    return copy;
-  }
-
-  // num has both real and imaginary part
-  char *curpos = num + 1; // current position
-  int imaginary_len = len - 1;
-  while (*curpos != '\0') {
-    ++curpos;
-    --imaginary_len;
-    if (*(curpos - 1) == '+' || *(curpos - 1) == '-') {
-      if (*(curpos - 1) == '-') {
-        --curpos;
-        ++imaginary_len;
-      }
-      break;
+  assert(is_ima);
+  const char *p = *pos;
+  if (p < end && *p == '(') {
+    ++p;
+    if (p < end && *p == '-' && !negative) {
+      ++p;
+      negative = true;
+    }
+    if (!parse_frac(reader, &p, end, negative) || p + 2 > end ||
+        p[0] != ')' || p[1] != 'i') {
+      return false;
+    }
+    p += 2;
+    *is_ima = true;
+  } else if (p < end && *p == 'i') { // the coefficient is 1
+    ha_int_set_digits(reader->nume, "1", 1, negative);
+    ha_int_set_digits(reader->denom, "1", 1, false);
+    ++p;
+    *is_ima = true;
+  } else {
+    if (!parse_frac(reader, &p, end, negative)) {
+      return false;
+    }
+    *is_ima = p < end && *p == 'i';
+    if (*is_ima) {
+      ++p;
     }
   }
-  char *copy = malloc((imaginary_len + 1) * sizeof(char));
-  strcpy(copy, curpos);
-  return copy;
+  ha_frac_set_quotient(*is_ima ? &num->ima : &num->real, reader->nume,
+                       reader->denom);
+  *pos = p;
+  return true;
 }
 
-// coefficient(num) gives the coefficient of num
-// notes: coefficient of real part is itself
-//        coefficient of imaginary part is the fraction (exclude '()' and 'i')
-// effects: allocates memory (caller must free)
-// time: O(n)
-static char *coefficient(const char *num) {
-  assert(num);
-  const int len = strlen(num);
-  char *coe = NULL;
-
-  if (len == 1 && num[0] == 'i') { // special case: num is i
-    coe = malloc(2 * sizeof(char));
-    coe[0] = '1';
-    coe[1] = '\0';
-  } else if (len == 2 && num[0] == '-' && num[1] == 'i') { // num is -i
-    coe = malloc(3 * sizeof(char));
-    coe[0] = '-';
-    coe[1] = '1';
-    coe[2] = '\0';
-  } else { // other cases
-    coe = malloc((len + 1) * sizeof(char));
-    int coe_idx = 0;
-    for (int i = 0; i < len; ++i) {
-      if (num[i] == '(' || num[i] == ')' || num[i] == 'i') {
-        continue;
-      } else {
-        coe[coe_idx] = num[i];
-        ++coe_idx;
-      }
+// parse_comp(reader, s, len, dst) sets dst to the number written with the
+//   len characters at s
+// returns: false if s is not a valid number, in which case dst is left with
+//          an unspecified value
+// effects: modifies dst
+// time: O(n^2)
+static bool parse_comp(struct reader *reader, const char *s, size_t len,
+                       struct ha_comp *dst) {
+  assert(reader);
+  assert(s);
+  assert(dst);
+  const char *pos = s;
+  const char *end = s + len;
+  ha_int_set_digits(reader->nume, "0", 1, false);
+  ha_int_set_digits(reader->denom, "1", 1, false);
+  ha_frac_set_quotient(&dst->real, reader->nume, reader->denom);
+  ha_frac_set_quotient(&dst->ima, reader->nume, reader->denom);
+
+  bool negative = pos < end && *pos == '-';
+  if (negative) {
+    ++pos;
+  }
+  bool is_ima = false;
+  if (!parse_term(reader, &pos, end, dst, negative, &is_ima)) {
+    return false;
+  }
+  if (pos == end) {
+    return true;
+  } else if (is_ima || (*pos != '+' && *pos != '-')) {
+    return false;
+  }
+
+  // a real part followed by an imaginary one
+  negative = *pos == '-';
+  ++pos;
+  if (!parse_term(reader, &pos, end, dst, negative, &is_ima)) {
+    return false;
+  }
+  return is_ima && pos == end;
+}
+
+// parse_size(s, len, size) sets *size to the positive int written with the
+//   len characters at s
+// returns: false if s is not a positive int
+// effects: modifies *size
+// time: O(len)
+static bool parse_size(const char *s, size_t len, int *size) {
+  assert(s);
+  assert(size);
+  if (len == 0 || s[0] == '0') {
+    return false;
+  }
+  long value = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (!is_digit(s[i]) || value > (INT_MAX - (s[i] - '0')) / 10) {
+      return false;
     }
-    coe[coe_idx] = '\0';
-    int coe_len = strlen(coe);
-    coe = realloc(coe, (coe_len + 1) * sizeof(char));
+    value = value * 10 + (s[i] - '0');
   }
-  return coe;
+  *size = value;
+  return true;
 }
 
-// numerator(num) gives the numerator of num
-// requires: num only has the real part or imaginary part [not asserted]
-// effects: allocates memory (caller must free)
-// time: O(n)
-static char *numerator(const char *num) {
+// print_invalid_number(s, len) prints an error message in the form
+//   "Error: s is an invalid complex number"
+// effects: produces output
+// time: O(len)
+static void print_invalid_number(const char *s, size_t len) {
+  assert(s);
+  printf("Error: %.*s is an invalid complex number\n",
+         len > INT_MAX ? INT_MAX : (int)len, s);
+}
+
+// new_comp() gives a new ha_comp from the current allocation context
+// effects: allocates memory (client must call ha_comp_destroy)
+// time: O(1)
+static struct ha_comp *new_comp(void) {
+  struct ha_arena *arena = ha_arena_current();
+  struct ha_comp *num = ha_alloc_node(arena, sizeof(struct ha_comp));
+  ha_comp_init(num, arena);
+  return num;
+}
+
+struct ha_comp *read_input(char *num) {
   assert(num);
-  char *coe = coefficient(num);
-  const int len = strlen(coe);
-  char *nume = malloc((len + 1) * sizeof(char));
-  strcpy(nume, coe);
-
-  for (int i = 0; i < len; ++i) {
-    if (nume[i] == '/') {
-      nume[i] = '\0';
+  const size_t len = strlen(num);
+  struct reader *reader = new_reader(num, num + len);
+  struct ha_comp *result = new_comp();
+  if (!parse_comp(reader, num, len, result)) {
+    print_invalid_number(num, len);
+    ha_comp_destroy(result);
+    result = NULL;
+  }
+  reader_destroy(reader);
+  return result;
+}
+
+struct reader *reader_from_file(FILE *file) {
+  assert(file);
+  struct reader *reader = new_reader(NULL, NULL);
+  reader->file = file;
+  reader->buffer_size = READ_BUFFER_SIZE;
+  reader->buffer = malloc(reader->buffer_size);
+  reader->pos = reader->buffer;
+  reader->end = reader->buffer;
+  return reader;
+}
+
+struct reader *reader_from_path(const char *path) {
+  assert(path);
+#ifdef HAVE_MMAP
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Error: cannot open %s\n", path);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      close(fd); // the mapping stays valid
+      struct reader *reader = new_reader(map, (char *)map + st.st_size);
+      reader->map = map;
+      reader->map_size = st.st_size;
+      return reader;
     }
   }
-  int nume_len = strlen(nume);
-  if (nume_len == 0) { // empty string
-    nume = realloc(nume, 2 * sizeof(char));
-    nume[0] = '0';
-    nume[1] = '\0';
-  } else {
-    nume = realloc(nume, (nume_len + 1) * sizeof(char));
+  close(fd);
+#endif
+  // not mappable (an empty file, a pipe, or no mmap): read it as a FILE
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    printf("Error: cannot open %s\n", path);
+    return NULL;
   }
-  free(coe);
-  return nume;
+  struct reader *reader = reader_from_file(file);
+  reader->owns_file = true;
+  return reader;
 }
 
-// denominator(num) gives the denominator of num
-// requires: num only has the real part or imaginary part [not asserted]
-// effects: allocates memory (caller must free)
-// time: O(n)
-static char *denominator(const char *num) {
-  assert(num);
-  char *coe = coefficient(num);
-  const int len = strlen(coe);
-  char *curpos = coe;
-  int denom_len = len;
-
-  while (*curpos != '\0') {
-    ++curpos;
-    --denom_len;
-    if (*(curpos - 1) == '/') {
-      break;
-    }
+struct reader *reader_from_buffer(const char *buffer, size_t len) {
+  assert(buffer);
+  return new_reader(buffer, buffer + len);
+}
+
+void reader_destroy(struct reader *reader) {
+  assert(reader);
+#ifdef HAVE_MMAP
+  if (reader->map) {
+    munmap(reader->map, reader->map_size);
   }
-  char *denom = NULL;
-  if (denom_len == 0) { // empty string
-    denom = malloc(2 * sizeof(char));
-    denom[0] = '1';
-    denom[1] = '\0';
-  } else {
-    denom = malloc((denom_len + 1) * sizeof(char));
-    strcpy(denom, curpos);
+#endif
+  if (reader->owns_file) {
+    fclose(reader->file);
   }
-  free(coe);
-  return denom;
+  free(reader->buffer);
+  ha_int_destroy(reader->nume);
+  ha_int_destroy(reader->denom);
+  free(reader);
 }
 
-struct ha_comp *read_input(char *num) {
-  assert(num);
-  // change to ha_comp
-  char *real_part = real(num);
-  char *imaginary_part = imaginary(num);
-  char *real_nume = numerator(real_part);
-  char *real_denom = denominator(real_part);
-  char *imaginary_nume = numerator(imaginary_part);
-  char *imaginary_denom = denominator(imaginary_part);
-  struct ha_comp *ha_num = 
-    ha_comp_create(real_nume, real_denom, imaginary_nume, imaginary_denom);
-  free(real_part);
-  free(imaginary_part);
-  free(real_nume);
-  free(real_denom);
-  free(imaginary_nume);
-  free(imaginary_denom);
-  return ha_num;
+bool reader_at_end(struct reader *reader) {
+  assert(reader);
+  size_t len = 0;
+  return next_token(reader, &len) == NULL;
+}
+
+struct ha_comp *read_comp(struct reader *reader) {
+  assert(reader);
+  size_t len = 0;
+  const char *token = next_token(reader, &len);
+  if (!token) {
+    return NULL;
+  }
+  struct ha_comp *num = new_comp();
+  if (!parse_comp(reader, token, len, num)) {
+    print_invalid_number(token, len);
+    ha_comp_destroy(num);
+    num = NULL;
+  }
+  reader->pos = token + len;
+  return num;
+}
+
+struct ha_matrix *read_matrix(struct reader *reader) {
+  assert(reader);
+  int size[2] = {0, 0}; // rows and columns
+  for (int i = 0; i < 2; ++i) {
+    size_t len = 0;
+    const char *token = next_token(reader, &len);
+    if (!token) {
+      if (i > 0) {
+        printf("Error: the matrix has no number of columns\n");
+      }
+      return NULL;
+    } else if (!parse_size(token, len, &size[i])) {
+      printf("Error: %.*s is an invalid matrix size\n",
+             len > INT_MAX ? INT_MAX : (int)len, token);
+      reader->pos = token + len;
+      return NULL;
+    }
+    reader->pos = token + len;
+  }
+  // every entry takes at least a separator and a character, and the whole
+  // input is known unless it comes from a FILE
+  const size_t left = reader->end - reader->pos;
+  if (size[0] > INT_MAX / size[1]) {
+    printf("Error: %dx%d is an invalid matrix size\n", size[0], size[1]);
+    return NULL;
+  } else if (!reader->file && left / 2 < (size_t)size[0] * size[1]) {
+    printf("Error: the input is too short for a %dx%d matrix\n", size[0],
+           size[1]);
+    return NULL;
+  }
+
+  struct ha_matrix *mat = ha_matrix_create(size[0], size[1]);
+  for (int i = 0; i < size[0]; ++i) {
+    for (int j = 0; j < size[1]; ++j) {
+      size_t len = 0;
+      const char *token = next_token(reader, &len);
+      if (!token) {
+        printf("Error: the %dx%d matrix ends after %d entries\n", size[0],
+               size[1], i * size[1] + j);
+        ha_matrix_destroy(mat);
+        return NULL;
+      }
+      const bool valid = parse_comp(reader, token, len,
+                                    ha_matrix_at(mat, i, j));
+      reader->pos = token + len;
+      if (!valid) {
+        print_invalid_number(token, len);
+        ha_matrix_destroy(mat);
+        return NULL;
+      }
+    }
+  }
+  return mat;
 }
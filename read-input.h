@@ -1,11 +1,90 @@
 // This module turns the input into the corresponding ha_comp
 
+// Input is read from a string with read_input, or streamed from a FILE, a
+// file mapped into memory or a buffer with a reader. Numbers are separated
+// by whitespace, and each one is parsed in a single pass straight into its
+// ha_comp, without copying it anywhere else.
+
+// Matrices are given as the number of rows, the number of columns and then
+// the entries in row-major order, for example:
+//   2 2
+//   1 1/2
+//   i 2-(3/4)i
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
 #include "high-accuracy-complex.h"
+#include "high-accuracy-matrix.h"
+
+
+struct reader;
 
 
 // read_input(num) turns num into the corresponding ha_comp
 // note: if num is an invalid complex (real) number, then return NULL and print
 //         an error message
 // effects: may allocate memory (client must call ha_comp_destroy)
-// time: O(n)
-struct ha_comp *read_input(char *num); 
+// time: O(n^2)
+struct ha_comp *read_input(char *num);
+
+// reader_from_file(file) creates a reader for what is left of file
+// notes: file is read in large blocks, and is neither rewound nor closed
+// requires: file is open for reading
+// effects: allocates memory (client must call reader_destroy)
+// time: O(1)
+struct reader *reader_from_file(FILE *file);
+
+// reader_from_path(path) creates a reader for the file at path, mapped into
+//   memory where the system supports it, or returns NULL if the file cannot
+//   be opened
+// notes: if the file cannot be opened, an error message is printed
+// requires: path is a valid string (not NULL)
+// effects: may allocate memory (client must call reader_destroy)
+//          may produce output (error message)
+// time: O(1) if the file is mapped
+struct reader *reader_from_path(const char *path);
+
+// reader_from_buffer(buffer, len) creates a reader for the len characters at
+//   buffer
+// notes: buffer need not end with '\0', and is not copied
+// requires: buffer is valid (not NULL) and stays valid while the reader is
+//           used
+// effects: allocates memory (client must call reader_destroy)
+// time: O(1)
+struct reader *reader_from_buffer(const char *buffer, size_t len);
+
+// reader_destroy(reader) destroys reader, and unmaps its file if it has one
+// requires: reader is valid (not NULL)
+// effects: reader is no longer valid
+// time: O(1)
+void reader_destroy(struct reader *reader);
+
+// reader_at_end(reader) skips the whitespace of reader and determines if
+//   there is no input left
+// requires: reader is valid (not NULL)
+// effects: consumes the whitespace
+// time: O(whitespace)
+bool reader_at_end(struct reader *reader);
+
+// read_comp(reader) reads the next number of reader, or returns NULL if there
+//   is none or it is invalid
+// notes: if the number is invalid, an error message is printed
+// requires: reader is valid (not NULL)
+// effects: may allocate memory (client must call ha_comp_destroy)
+//          may produce output (error message)
+// time: O(n^2), where n is the length of the number
+struct ha_comp *read_comp(struct reader *reader);
+
+// read_matrix(reader) reads the next matrix of reader, or returns NULL if
+//   there is none or it is invalid
+// notes: the entries are parsed directly into the matrix
+//        if the matrix is invalid or incomplete, an error message is printed
+//        a size of more than INT_MAX entries is invalid, and so is one with
+//          more entries than the rest of the input can hold unless the
+//          reader reads a FILE; either is rejected before allocating
+// requires: reader is valid (not NULL)
+// effects: may allocate memory (client must call ha_matrix_destroy)
+//          may produce output (error message)
+// time: O(n^2), where n is the length of the input of the matrix
+struct ha_matrix *read_matrix(struct reader *reader);
@@ -0,0 +1,526 @@
+// This program serves matrix jobs, keeping its memory and threads warm from
+//   one job to the next
+
+// usage: server [threads [max_bytes]]
+//   reads jobs from standard input and writes one response per job to
+//   standard output, in the order of the jobs; the computations run on a
+//   pool of threads threads (1 by default, no pool), and payloads of more
+//   than max_bytes characters (FRAME_MAX by default) are refused. A socket
+//   is served by connecting it to standard input and output, with inetd or
+//   socat for example.
+// build: cc -std=c11 -O2 -o server server.c high-accuracy-*.c read-input.c
+//          -lpthread
+//        (POSIX systems only)
+
+// Protocol: a job is a frame made of a header line and a payload:
+//   <id> <op> <bytes>\n<payload: bytes characters>
+// where id is a token of up to ID_MAX characters, echoed in the response, op
+// is one of the names of op_names, and the payload holds the operands (one
+// matrix, or two for add, sub, mult and solve) as read_matrix reads them.
+// Every response is a frame as well:
+//   <id> <status> <bytes> <parse_us> <compute_us> <write_us> <latency_us>\n
+//   <payload: bytes characters>
+// where status is ok or error, and the payload is the result (a matrix as
+// ha_matrix_write writes it, a number or a rank, on their own line) or a
+// one-line error message. The times are the microseconds spent parsing,
+// computing and serializing the job, and the latency runs from the end of
+// its frame to its response, waits included. The messages of the library
+// (why an operation failed, for example) go to standard error. A header that
+// cannot be read ends the session.
+
+// Limits: the input is untrusted, so nothing is allocated from its sizes
+// alone. A payload longer than max_bytes is skipped without being stored,
+// and a matrix with more entries than the rest of its payload can hold (see
+// read_matrix) is refused before its entries are allocated; both jobs get
+// an error response.
+
+// Pipeline: a job goes through three threads, each one running a stage for
+//   all the jobs: this one reads and parses the frames, a second one
+//   computes, and a third one serializes and writes the responses, so that
+//   the parsing of a job overlaps the computation of the previous one and
+//   the writing of the one before. The stages pass the jobs along through
+//   queues, and the written jobs go back to the parsing stage. There are
+//   JOB_NUM jobs, each with its own arena and buffers; a job keeps them when
+//   it is recycled, and its arena is reset rather than freed, so that once
+//   the first jobs are through, the server hardly allocates anything. Each
+//   stage thread lives as long as the server, and so do the scratch numbers,
+//   free lists and caches of the number modules, which are per thread and
+//   given back as each stage ends, and the pool of the computing stage.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "high-accuracy-alloc.h"
+#include "high-accuracy-buffer.h"
+#include "high-accuracy-complex.h"
+#include "high-accuracy-matrix.h"
+#include "high-accuracy-pool.h"
+#include "read-input.h"
+
+
+// longest id of a job
+#define ID_MAX 63
+
+// longest name of an operation
+#define OP_NAME_MAX 15
+
+// number of jobs in flight, which bounds the memory of the server
+#define JOB_NUM 16
+
+// default longest payload of a frame, in characters
+#define FRAME_MAX (64 * 1024 * 1024)
+
+// size of the chunks a refused payload is skipped in
+#define SKIP_SIZE 4096
+
+// size of the error messages of the jobs, their end included
+#define ERROR_SIZE 128
+
+enum op {
+  OP_ADD, OP_SUB, OP_MULT, OP_DET, OP_DET_MODULAR, OP_RANK, OP_RREF,
+  OP_INVERSE, OP_SOLVE, OP_NUM
+};
+
+// the names of the operations in the protocol
+static const char *const op_names[OP_NUM] = {
+  "add", "sub", "mult", "det", "det_modular", "rank", "rref", "inverse",
+  "solve"
+};
+
+// the number of matrices each operation takes
+static const int op_operands[OP_NUM] = {2, 2, 2, 1, 1, 1, 1, 1, 2};
+
+struct job {
+  char id[ID_MAX + 1];
+  enum op op;
+  struct ha_buffer input; // the payload
+  struct ha_buffer output; // the response
+  struct ha_arena *arena; // the numbers of the job, until it is written
+  struct ha_matrix *operands[2];
+  struct ha_matrix *matrix; // the result, by operation
+  struct ha_comp *number;
+  int rank;
+  bool failed;
+  char error[ERROR_SIZE]; // the message, if failed
+  double received; // when the frame was read
+  double parse_time; // seconds spent in each stage
+  double compute_time;
+  double write_time;
+};
+
+// a bounded queue of jobs from one stage to the next
+struct queue {
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // a job was pushed or popped, or the queue closed
+  struct job *jobs[JOB_NUM];
+  int head; // index of the first job
+  int len;
+  bool closed; // no job will be pushed anymore
+};
+
+// the state shared by the stages
+struct server {
+  struct job jobs[JOB_NUM];
+  struct queue free_jobs; // written, ready to be reused
+  struct queue parsed;
+  struct queue computed;
+  FILE *out; // where the responses go
+  int threads; // threads of the pool of the computing stage
+  size_t max_bytes; // longest payload accepted
+};
+
+
+// now() gives the current time in seconds
+// time: O(1)
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// queue_init(q) sets up q as an empty queue
+// effects: q is valid (client must call queue_destroy)
+// time: O(1)
+static void queue_init(struct queue *q) {
+  assert(q);
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->changed, NULL);
+  q->head = 0;
+  q->len = 0;
+  q->closed = false;
+}
+
+// queue_destroy(q) frees the resources of q
+// effects: q is no longer valid
+// time: O(1)
+static void queue_destroy(struct queue *q) {
+  assert(q);
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->changed);
+}
+
+// queue_push(q, job) appends job to q, waiting for room if q is full
+// requires: q is not closed
+// effects: modifies q
+// time: O(1), plus the wait
+static void queue_push(struct queue *q, struct job *job) {
+  assert(q);
+  assert(job);
+  pthread_mutex_lock(&q->lock);
+  assert(!q->closed);
+  while (q->len == JOB_NUM) {
+    pthread_cond_wait(&q->changed, &q->lock);
+  }
+  q->jobs[(q->head + q->len) % JOB_NUM] = job;
+  ++q->len;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+}
+
+// queue_pop(q) removes and gives the first job of q, waiting for one if q is
+//   empty, or returns NULL if q is empty and closed
+// effects: modifies q
+// time: O(1), plus the wait
+static struct job *queue_pop(struct queue *q) {
+  assert(q);
+  pthread_mutex_lock(&q->lock);
+  while (q->len == 0 && !q->closed) {
+    pthread_cond_wait(&q->changed, &q->lock);
+  }
+  struct job *job = NULL;
+  if (q->len > 0) {
+    job = q->jobs[q->head];
+    q->head = (q->head + 1) % JOB_NUM;
+    --q->len;
+    pthread_cond_broadcast(&q->changed);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return job;
+}
+
+// queue_close(q) tells the consumer of q that no job will come anymore
+// effects: modifies q
+// time: O(1)
+static void queue_close(struct queue *q) {
+  assert(q);
+  pthread_mutex_lock(&q->lock);
+  q->closed = true;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+}
+
+// fail(job, message) marks job as failed with message, unless it already
+//   failed
+// effects: modifies job
+// time: O(1)
+static void fail(struct job *job, const char *message) {
+  assert(job);
+  assert(message);
+  if (!job->failed) {
+    job->failed = true;
+    snprintf(job->error, ERROR_SIZE, "%s", message);
+  }
+}
+
+// read_frame(in, job, max_bytes) reads the next frame of in into job, or
+//   returns false if there is none or its header is malformed
+// notes: a frame with an unknown operation is read all the same, and job
+//          fails
+//        a payload of more than max_bytes characters is skipped instead of
+//          stored, and job fails
+//        if the header is malformed, an error message is printed
+// effects: consumes the frame
+//          modifies job
+//          may produce output (error message)
+// time: O(bytes)
+static bool read_frame(FILE *in, struct job *job, size_t max_bytes) {
+  assert(in);
+  assert(job);
+  char name[OP_NAME_MAX + 1];
+  size_t bytes = 0;
+  const int got = fscanf(in, "%63s %15s %zu", job->id, name, &bytes);
+  if (got == EOF) {
+    return false;
+  } else if (got != 3 || getc(in) != '\n') {
+    fprintf(stderr, "Error: malformed frame header\n");
+    return false;
+  }
+  job->op = OP_NUM;
+  for (int op = 0; op < OP_NUM; ++op) {
+    if (!strcmp(name, op_names[op])) {
+      job->op = op;
+    }
+  }
+  if (job->op == OP_NUM) {
+    fail(job, "unknown operation");
+  }
+  if (bytes > max_bytes) {
+    fail(job, "frame too large");
+    char skipped[SKIP_SIZE];
+    while (bytes > 0) {
+      const size_t chunk = bytes < SKIP_SIZE ? bytes : SKIP_SIZE;
+      if (fread(skipped, 1, chunk, in) != chunk) {
+        fprintf(stderr, "Error: truncated frame\n");
+        return false;
+      }
+      bytes -= chunk;
+    }
+    return true;
+  }
+  char *payload = ha_buffer_reserve(&job->input, bytes);
+  if (fread(payload, 1, bytes, in) != bytes) {
+    fprintf(stderr, "Error: truncated frame\n");
+    return false;
+  }
+  job->input.len = bytes;
+  return true;
+}
+
+// parse(job) reads the operands of job from its payload, into its arena
+// effects: modifies job
+//          may allocate memory
+//          may produce output (error message)
+// time: O(bytes^2)
+static void parse(struct job *job) {
+  assert(job);
+  if (job->failed) {
+    return;
+  } else if (job->input.len == 0) {
+    fail(job, "invalid operands");
+    return;
+  }
+  struct ha_arena *previous = ha_arena_use(job->arena);
+  struct reader *reader = reader_from_buffer(job->input.data, job->input.len);
+  for (int i = 0; i < op_operands[job->op]; ++i) {
+    job->operands[i] = read_matrix(reader);
+    if (!job->operands[i]) {
+      fail(job, "invalid operands");
+      break;
+    }
+  }
+  if (!job->failed && !reader_at_end(reader)) {
+    fail(job, "too many operands");
+  }
+  reader_destroy(reader);
+  ha_arena_use(previous);
+}
+
+// compute(job) computes the result of job, into its arena
+// effects: modifies job
+//          may allocate memory
+//          may produce output (error message)
+// time: the time of the operation
+static void compute(struct job *job) {
+  assert(job);
+  if (job->failed) {
+    return;
+  }
+  struct ha_arena *previous = ha_arena_use(job->arena);
+  struct ha_matrix *const *a = job->operands;
+  switch (job->op) {
+  case OP_ADD:
+    job->matrix = ha_matrix_add(a[0], a[1]);
+    break;
+  case OP_SUB:
+    job->matrix = ha_matrix_sub(a[0], a[1]);
+    break;
+  case OP_MULT:
+    job->matrix = ha_matrix_mult(a[0], a[1]);
+    break;
+  case OP_DET:
+    job->number = ha_matrix_det(a[0]);
+    break;
+  case OP_DET_MODULAR:
+    job->number = ha_matrix_det_modular(a[0]);
+    break;
+  case OP_RANK:
+    job->rank = ha_matrix_rank(a[0]);
+    break;
+  case OP_RREF:
+    job->matrix = ha_matrix_rref(a[0]);
+    break;
+  case OP_INVERSE:
+    job->matrix = ha_matrix_inverse(a[0]);
+    break;
+  case OP_SOLVE:
+    job->matrix = ha_matrix_solve(a[0], a[1]);
+    break;
+  default:
+    assert(false);
+  }
+  ha_arena_use(previous);
+  if (job->op != OP_RANK && !job->matrix && !job->number) {
+    char message[ERROR_SIZE];
+    snprintf(message, ERROR_SIZE, "cannot compute %s", op_names[job->op]);
+    fail(job, message);
+  }
+}
+
+// serialize(job) writes the payload of the response of job to its output
+// effects: modifies job
+//          may allocate memory
+// time: O(length of the result)
+static void serialize(struct job *job) {
+  assert(job);
+  if (job->failed) {
+    ha_buffer_append(&job->output, job->error, strlen(job->error));
+    ha_buffer_putc(&job->output, '\n');
+  } else if (job->matrix) {
+    ha_matrix_write(&job->output, job->matrix);
+  } else if (job->number) {
+    ha_comp_write(&job->output, job->number);
+    ha_buffer_putc(&job->output, '\n');
+  } else {
+    char rank[16];
+    const int len = snprintf(rank, sizeof(rank), "%d\n", job->rank);
+    ha_buffer_append(&job->output, rank, len);
+  }
+}
+
+// recycle(job) gives back the numbers of job and empties it for the next
+//   frame, keeping its arena and buffers
+// effects: modifies job
+// time: O(number of blocks of the arena)
+static void recycle(struct job *job) {
+  assert(job);
+  ha_arena_reset(job->arena);
+  job->input.len = 0;
+  job->output.len = 0;
+  job->operands[0] = job->operands[1] = NULL;
+  job->matrix = NULL;
+  job->number = NULL;
+  job->rank = 0;
+  job->failed = false;
+}
+
+// compute_stage(arg) runs the computing stage of the server arg
+// effects: computes the jobs of arg
+// time: the time of the jobs
+static void *compute_stage(void *arg) {
+  struct server *server = arg;
+  struct ha_pool *pool = server->threads > 1 ?
+                         ha_pool_create(server->threads) : NULL;
+  ha_pool_use(pool);
+  struct job *job = NULL;
+  while ((job = queue_pop(&server->parsed))) {
+    const double start = now();
+    compute(job);
+    job->compute_time = now() - start;
+    queue_push(&server->computed, job);
+  }
+  queue_close(&server->computed);
+  ha_pool_use(NULL);
+  if (pool) {
+    ha_pool_destroy(pool);
+  }
+  ha_alloc_trim();
+  return NULL;
+}
+
+// write_stage(arg) runs the writing stage of the server arg, and prints the
+//   latencies of all the jobs to standard error at the end
+// effects: writes the responses of the jobs of arg
+// time: the time of the jobs
+static void *write_stage(void *arg) {
+  struct server *server = arg;
+  long jobs = 0;
+  double total_latency = 0;
+  double max_latency = 0;
+  struct job *job = NULL;
+  while ((job = queue_pop(&server->computed))) {
+    const double start = now();
+    serialize(job);
+    const double ready = now();
+    job->write_time = ready - start;
+    const double latency = ready - job->received;
+    fprintf(server->out, "%s %s %zu %.0f %.0f %.0f %.0f\n", job->id,
+            job->failed ? "error" : "ok", job->output.len,
+            job->parse_time * 1e6, job->compute_time * 1e6,
+            job->write_time * 1e6, latency * 1e6);
+    ha_buffer_flush(&job->output, server->out);
+    fflush(server->out);
+    ++jobs;
+    total_latency += latency;
+    max_latency = latency > max_latency ? latency : max_latency;
+    recycle(job);
+    queue_push(&server->free_jobs, job);
+  }
+  fprintf(stderr, "server jobs %ld mean_latency_us %.0f max_latency_us %.0f\n",
+          jobs, jobs ? total_latency / jobs * 1e6 : 0, max_latency * 1e6);
+  ha_alloc_trim();
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  const int threads = argc >= 2 ? atoi(argv[1]) : 1;
+  const long max_bytes = argc >= 3 ? atol(argv[2]) : FRAME_MAX;
+  if (argc > 3 || threads <= 0 || max_bytes <= 0) {
+    fprintf(stderr, "usage: %s [threads [max_bytes]]\n", argv[0]);
+    return 1;
+  }
+  // the responses get the standard output to themselves: the messages the
+  // library prints go to standard error instead
+  const int out_fd = dup(STDOUT_FILENO);
+  FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+  if (!out || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "Error: cannot set up the output\n");
+    return 1;
+  }
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  struct server *server = malloc(sizeof(struct server));
+  server->out = out;
+  server->threads = threads;
+  server->max_bytes = max_bytes;
+  queue_init(&server->free_jobs);
+  queue_init(&server->parsed);
+  queue_init(&server->computed);
+  for (int i = 0; i < JOB_NUM; ++i) {
+    struct job *job = &server->jobs[i];
+    ha_buffer_init(&job->input);
+    ha_buffer_init(&job->output);
+    job->arena = ha_arena_create();
+    recycle(job);
+    queue_push(&server->free_jobs, job);
+  }
+  pthread_t computer;
+  pthread_t writer;
+  pthread_create(&computer, NULL, compute_stage, server);
+  pthread_create(&writer, NULL, write_stage, server);
+
+  // the parsing stage
+  struct job *job = NULL;
+  while ((job = queue_pop(&server->free_jobs))) {
+    if (!read_frame(stdin, job, server->max_bytes)) {
+      queue_push(&server->free_jobs, job);
+      break;
+    }
+    job->received = now();
+    parse(job);
+    job->parse_time = now() - job->received;
+    queue_push(&server->parsed, job);
+  }
+  queue_close(&server->parsed);
+  pthread_join(computer, NULL);
+  pthread_join(writer, NULL);
+
+  for (int i = 0; i < JOB_NUM; ++i) {
+    ha_buffer_free(&server->jobs[i].input);
+    ha_buffer_free(&server->jobs[i].output);
+    ha_arena_destroy(server->jobs[i].arena);
+  }
+  queue_destroy(&server->free_jobs);
+  queue_destroy(&server->parsed);
+  queue_destroy(&server->computed);
+  free(server);
+  fclose(out);
+  ha_alloc_trim();
+  return 0;
+}